@@ -1,7 +1,47 @@
 /****************************************************
   * @Name	App.c
   * @Brief	
-
+  * @Instruction:
+  * --> Delta patch(FIRMWARE_NEW_DELTA_FLAG):
+  *			App_DeltaApply	: rebuild the new Firmware from the running Firmware and the patch into ExternalFlash(FIRMWARE_DELTA_TARGET_ADDRESS),
+  *							  one page buffered, the patch read as it is applied;
+  *							  checked by the source CRC16 before and the target CRC16 after,
+  *							  flagged FIRMWARE_NEW_DELTA_APPLIED, then copied to EmbeddedFlash like the whole Firmware
+  *			-------------------------------------------------------------------
+  *			The running Firmware is not touched until the rebuilt one is checked,
+  *			a patch not applicable is dropped(FIRMWARE_NEW_VERSION_DEFAULT) and the running Firmware started
+  *
+  * --> Compressed Firmware(FIRMWARE_NEW_LZ_FLAG):
+  *			App_LZStart		: header checked, size of the Firmware decompressed taken as the new Firmware size
+  *	 (Poll) App_LZInflate	: one page decompressed and written to EmbeddedFlash per poll, the sequence in progress kept across the polls,
+  *							  the compressed data read a page ahead, match copied from the page or from the Firmware written before;
+  *							  checked by the CRC16 of the Firmware decompressed once complete
+  *
+  * --> EmbeddedFlash programming:
+  *			The new Firmware is read from ExternalFlash a page ahead by DMA(App_ReadAheadNext) while the page before is programmed,
+  *			written through the EmbeddedFlash image writer(each page erased once, a page holding the data already skipped),
+  *			App_Pro woken again at once until the whole Firmware is written, the progress shown as it moves on
+  *
+  * --> Verified boot(boot record FIRMWARE_BOOT_RECORD_ADDRESS, backup FIRMWARE_BACKUP_ADDRESS in ExternalFlash):
+  *			App_BackupSave	: before a new Firmware is installed, the running one kept as the backup if confirmed and checked
+  *			App_UpdateFinish: new Firmware checked by the CRC16 of EmbeddedFlash, boot record written on trial, the new Firmware started
+  *			App_BootCheck	: every start, the Firmware checked by its CRC16 a page at a time(bounded by FIRMWARE_IMAGE_SIZE_MAX),
+  *							  a Firmware not confirmed spends one of FIRMWARE_TRIAL_BOOT_MAX trials
+  *			App_RollbackStart: Firmware damaged / trials spent / new Firmware failed: the backup checked then copied back(App_Pro),
+  *							  boot record written confirmed
+  *			-------------------------------------------------------------------
+  *			The new Firmware confirms itself(boot record Confirm) once it has run healthy,
+  *			a Firmware installed before the boot record was kept is started unchecked
+  *
+  * --> Serial recovery / factory flashing(Debug_USART USART1, YMODEM-1K at APP_RECOVERY_BAUDRATE):
+  *			App_RecoveryStart: Menu key held at start / FIRMWARE_RECOVERY_FLAG / Firmware damaged without a backup / no Firmware /
+  *							  new Firmware failed without a backup / backup not restored,
+  *							  the running Firmware kept as the backup first(key, flag)
+  *	 (Poll) App_RecoveryPro	: each block acknowledged as it is checked, then programmed through the EmbeddedFlash image writer
+  *							  while the sender puts the next block on the line(received by DMA);
+  *							  once the file ended, checked and started on trial like a new Firmware(version unknown: 0xFFFF)
+  *			-------------------------------------------------------------------
+  *			A transfer cancelled / a Firmware failing its check leaves the BootLoader waiting for the next file
   ***************************************************/
   
 /*-------------Header Files Include-----------------*/
@@ -11,12 +51,42 @@
 #include "hal_timer.h"
 #include "hal_embeddedflash.h"
 #include "hal_jumptoapp.h"
+#include "hal_key.h"
+#include "hal_usart.h"
 #include "mid_tftlcd.h"
 #include "mid_flash.h"
 #include "mid_embeddedflash.h"
+#include "mid_ymodem.h"
+#include "crc16.h"
+#include "os_system.h"
+#include "string.h"
 
 /*-------------Internal Functions Declaration------*/
-
+static uint8_t 	App_DeltaApply(uint32_t PatchSize);
+static uint8_t 	App_DeltaOut(uint8_t *pData, uint16_t Len);
+static void 	App_DeltaFlush(void);
+static uint32_t App_LZStart(uint32_t ImageSize);
+static uint8_t 	App_LZInflate(void);
+static uint8_t 	App_LZInByte(void);
+static uint32_t App_LZLength(uint32_t Len);
+static void 	App_UpdateFinish(void);
+static void 	App_ShowProgress(void);
+static void 	App_ReadAheadStart(uint32_t Addr, uint32_t EndAddr);
+static uint16_t App_ReadAheadNext(uint8_t **ppData);
+static void 	App_ReadAheadStop(void);
+static void 	App_UpdateFail(void);
+static uint8_t 	App_BootCheck(void);
+static void 	App_BackupSave(uint8_t *pVersion);
+static uint32_t App_BackupRead(uint8_t *pHeader);
+static uint8_t 	App_RollbackStart(void);
+static void 	App_RecordProgram(uint32_t Addr, uint8_t *pRecord, uint8_t Len);
+static uint16_t App_ImageCRC16(uint32_t Size);
+static uint16_t App_FlashCRC16(uint32_t Addr, uint32_t Size);
+static void 	App_ImageWrite(uint8_t *pData, uint16_t Len);
+static uint8_t 	App_RecoveryKeyHeld(void);
+static void 	App_RecoveryKeyHoldHandler(void);
+static void 	App_RecoveryStart(void);
+static void 	App_RecoveryPro(void);
 	
 
 /*-------------Module Variables Declaration--------*/
@@ -25,12 +95,45 @@ stu_FirmwareInfo_t *pFirmwareInfo;
 uint32_t WriteInFlashAddressOffset;		// Write-in address offset of EmbeddedFlash
 uint32_t ReadOutFlashAddressOffset;		// Read-out address offset of ExternalFlash
 
-uint16_t UpdateUnit_256Byte;	// use 256bytes as the counting unit of updating progress
-uint16_t UpdateUint_Residue;	// remaining data that less than 256bytes
-uint16_t UpdatePercentage;
+uint16_t UpdatePercentage;		// progress shown(unit: 0.1%)
+uint8_t  UpdateBusyFlag;		// 1->Firmware being written to EmbeddedFlash by App_Pro
 
 uint32_t NewFirmwareSize;
 uint8_t NewFirmwareVersion[2];
+uint16_t NewFirmwareCRC16;		// Mid_CRC16_Modbus of the new Firmware, checked over EmbeddedFlash once written
+
+uint8_t Boot_RollbackFlag;		// 1->backup being restored in place of the Firmware
+
+uint8_t  RecoveryFlag;				// 1->Firmware received over the Debug_USART(App_RecoveryPro)
+uint16_t Recovery_CRC16State;		// CRC16 of the Firmware received so far(Mid_CRC16_ModbusUpdate)
+volatile uint8_t Recovery_KeyHoldFlag;	// 1->APP_RECOVERY_KEY_HOLD passed(T_KEY_HOLD)
+
+/* ExternalFlash read-ahead: page read by DMA into ReadAhead_Buff[ReadAhead_Index] up to ReadOutFlashAddressOffset */
+uint8_t  ReadAhead_Buff[2][FLASH_PAGE_SIZE];
+uint8_t  ReadAhead_Index;
+uint16_t ReadAhead_Len;				// length of the page being read(0->none)
+uint32_t ReadAhead_EndAddr;
+
+/* delta patch: rebuilt Firmware written up to Delta_WriteAddr, the page not programmed yet in Delta_PageBuff */
+uint32_t Delta_TargetSize;
+uint32_t Delta_WriteAddr;
+uint16_t Delta_CRC16State;			// CRC16 of the rebuilt Firmware so far(Mid_CRC16_ModbusUpdate)
+uint8_t  Delta_PageBuff[FLASH_PAGE_SIZE];
+uint16_t Delta_PageLen;
+
+/* compressed Firmware: sequence in progress, page of compressed data read ahead in LZ_pInBuff, LZ_pInBuff[LZ_InPos] next */
+uint8_t  LZ_State;					// en_App_LZState_t
+uint8_t  LZ_Token;
+uint8_t  LZ_MatchPending;			// 1->literals of LZ_Token to be followed by its match
+uint32_t LZ_LiteralLen;
+uint32_t LZ_MatchLen;
+uint16_t LZ_MatchOffset;
+uint8_t  *LZ_pInBuff;
+uint16_t LZ_InPos;
+uint16_t LZ_InLen;
+uint8_t  LZ_ErrorFlag;				// 1->read beyond the compressed Firmware
+uint16_t LZ_CRC16State;				// CRC16 of the Firmware decompressed so far(Mid_CRC16_ModbusUpdate)
+uint16_t LZ_RawCRC16;
 
 
 
@@ -43,39 +146,121 @@ uint8_t NewFirmwareVersion[2];
 void App_Init(void)
 {
 	uint8_t DataBuff[20];
+	uint8_t Flag;
 	
 	/* Read out the FirmwareInfo from external Flash */
 	Mid_Flash_ReadData(&DataBuff[0], FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 13);
 	
 	pFirmwareInfo = (stu_FirmwareInfo_t *)DataBuff;
 	
-	/* find new Firmware is ready in external Flash */
-	if(pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_VERSION_FLAG)
+	/* FirmwareSize: little-endian, as kept by the AppPart(un_FirmwareSize_t) */
+	NewFirmwareSize = pFirmwareInfo->FirmwareSize[0];
+	NewFirmwareSize |= pFirmwareInfo->FirmwareSize[1] << 8;
+	NewFirmwareSize |= pFirmwareInfo->FirmwareSize[2] << 16;
+	NewFirmwareSize |= (uint32_t)pFirmwareInfo->FirmwareSize[3] << 24;
+	
+	/* serial recovery: Menu key held at start / requested by the Firmware */
+	if(App_RecoveryKeyHeld() || (pFirmwareInfo->NewVersionFlag == FIRMWARE_RECOVERY_FLAG))
+	{
+		App_BackupSave(&pFirmwareInfo->CurrentVersion[0]);
+		
+		App_RecoveryStart();
+		
+		return;
+	}
+	
+	/* new Firmware of any kind: the running Firmware kept before it is overwritten */
+	if((pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_VERSION_FLAG) || (pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_DELTA_FLAG) ||
+	   (pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_LZ_FLAG))
+	{
+		App_BackupSave(&pFirmwareInfo->CurrentVersion[0]);
+	}
+	
+	/* delta patch in external Flash: rebuild the new Firmware first */
+	if(pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_DELTA_FLAG)
+	{
+		Mid_TFTLCD_ScreenClear();
+		Mid_TFTLCD_ShowString(60, 60, "Firmware Patching...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+		
+		if(App_DeltaApply(NewFirmwareSize))
+		{
+			Flag = FIRMWARE_NEW_DELTA_APPLIED;
+		}
+		else
+		{
+			Flag = FIRMWARE_NEW_VERSION_DEFAULT;
+		}
+		
+		Mid_Flash_WriteData(&Flag, FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 1);
+		
+		pFirmwareInfo->NewVersionFlag = Flag;
+	}
+	
+	/* compressed Firmware in external Flash: size of the Firmware decompressed in the header */
+	if(pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_LZ_FLAG)
 	{
-		ReadOutFlashAddressOffset = FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS;
+		NewFirmwareSize = App_LZStart(NewFirmwareSize);
 		
-		NewFirmwareSize = pFirmwareInfo->FirmwareSize[0] << 24;
-		NewFirmwareSize |= pFirmwareInfo->FirmwareSize[1] << 16;
-		NewFirmwareSize |= pFirmwareInfo->FirmwareSize[2] << 8;
-		NewFirmwareSize |= pFirmwareInfo->FirmwareSize[3];
+		if(NewFirmwareSize == 0)
+		{
+			Flag = FIRMWARE_NEW_VERSION_DEFAULT;
+			
+			Mid_Flash_WriteData(&Flag, FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 1);
+			
+			pFirmwareInfo->NewVersionFlag = Flag;
+		}
+	}
+	
+	/* find new Firmware is ready in external Flash */
+	if((pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_VERSION_FLAG) || (pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_DELTA_APPLIED) ||
+	   (pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_LZ_FLAG))
+	{
+		/* rebuilt from the delta patch: target size and CRC16 in the patch header */
+		if(pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_DELTA_APPLIED)
+		{
+			Mid_Flash_ReadData(&DataBuff[13], FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + DELTA_OFFSET_TARGET_SIZE, 6);
+			
+			NewFirmwareSize = DataBuff[13];
+			NewFirmwareSize |= DataBuff[14] << 8;
+			NewFirmwareSize |= DataBuff[15] << 16;
+			NewFirmwareSize |= (uint32_t)DataBuff[16] << 24;
+			
+			NewFirmwareCRC16 = (DataBuff[17] << 8) | DataBuff[18];
+			
+			App_ReadAheadStart(FIRMWARE_DELTA_TARGET_ADDRESS, FIRMWARE_DELTA_TARGET_ADDRESS + NewFirmwareSize);
+		}
+		/* whole Firmware: whole-file CRC16(compressed Firmware: read ahead since App_LZStart, CRC16 in its header) */
+		else if(pFirmwareInfo->NewVersionFlag == FIRMWARE_NEW_VERSION_FLAG)
+		{
+			NewFirmwareCRC16 = (pFirmwareInfo->CRC16[0] << 8) | pFirmwareInfo->CRC16[1];
+			
+			App_ReadAheadStart(FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + NewFirmwareSize);
+		}
+		else
+		{
+			NewFirmwareCRC16 = LZ_RawCRC16;
+		}
 		
 		NewFirmwareVersion[0] = pFirmwareInfo->NewVersion[0];
 		NewFirmwareVersion[1] = pFirmwareInfo->NewVersion[1];
-	
-		UpdateUnit_256Byte = NewFirmwareSize >> 8;
-		UpdateUint_Residue = NewFirmwareSize % 256;
+		
+		Mid_EmbeddedFlash_ImageWriteStart();
 		
 		WriteInFlashAddressOffset = 0;
 		UpdatePercentage = 0;
+		UpdateBusyFlag = 1;
 		
 		Mid_TFTLCD_ScreenClear();
 		Mid_TFTLCD_ShowString(60, 60, "Firmware Updating...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
 		Mid_TFTLCD_ShowString(130, 120, "0%", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
 	}
-	/* no new Firmware detected, jump and execute the current version code */
-	else
+	/* no new Firmware detected, jump and execute the current version code once checked(rolled back / damaged: not started) */
+	else if(App_BootCheck())
 	{
 		Hal_JumpToApp_Jump();
+		
+		/* not started: no Firmware in EmbeddedFlash */
+		App_RecoveryStart();
 	}
 }
   
@@ -86,104 +271,1170 @@ void App_Init(void)
   */
 void App_Pro(void)
 {
-	uint16_t i;
 	uint16_t Len;
+	uint8_t *pData = 0;
 	
-	uint16_t EmbeddedFlashBuff[128];	// store halfword data
-	uint8_t DataBuff[256];
-	
-	static uint16_t DownloadUnitNumber_256Byte = 0;
-	
-	if(DownloadUnitNumber_256Byte < UpdateUnit_256Byte)
+	/* Firmware received over the Debug_USART */
+	if(RecoveryFlag)
 	{
-		/* read-out next uint data(256bytes) from external Flash */
-		Mid_Flash_ReadData(&DataBuff[0], ReadOutFlashAddressOffset, 256);
+		App_RecoveryPro();
 		
-		ReadOutFlashAddressOffset += 256;
+		OS_TaskGetUp(OS_TASK1);
 		
-		/* transfer the read-out data into halfword aligned */
-		for(i=0; i<128; i++)
+		return;
+	}
+	
+	/* nothing being written(update failed / Firmware damaged) */
+	if(UpdateBusyFlag == 0)
+	{
+		return;
+	}
+	
+	/* compressed Firmware: decompressed a page per poll */
+	if(LZ_State != APP_LZ_STA_IDLE)
+	{
+		if(LZ_State == APP_LZ_STA_BUSY)
 		{
-			EmbeddedFlashBuff[i] = (DataBuff[i*2 + 1] << 8) & 0xFF00;
-			EmbeddedFlashBuff[i] |= (DataBuff[i*2]) & 0xFF;
+			LZ_State = App_LZInflate();
+			
+			if(LZ_State == APP_LZ_STA_BUSY)
+			{
+				App_ShowProgress();
+				
+				OS_TaskGetUp(OS_TASK1);
+			}
+			else if(LZ_State == APP_LZ_STA_DONE)
+			{
+				App_UpdateFinish();
+			}
+			else
+			{
+				App_UpdateFail();
+			}
 		}
 		
-		/* write-in the halfword aligned data into EmbeddedFlash */
-		Mid_EmbeddedFlash_WriteHalfWord(EMBEDDED_FLASH_Address_APP_BASE + WriteInFlashAddressOffset, &EmbeddedFlashBuff[0], 128);
-		WriteInFlashAddressOffset += 256;
+		return;
+	}
+	
+	/* next page read ahead, the one after it read while this one is programmed */
+	Len = App_ReadAheadNext(&pData);
+	
+	if(Len)
+	{
+		App_ImageWrite(pData, Len);
+	}
+	
+	if((Len == 0) || (WriteInFlashAddressOffset >= NewFirmwareSize))
+	{
+		App_UpdateFinish();
+	}
+	else
+	{
+		App_ShowProgress();
+		
+		OS_TaskGetUp(OS_TASK1);
+	}
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	New Firmware written to EmbeddedFlash: check it, show the progress, flag it ready and jump to it
+  * @Param	None
+  * @Retval	None
+  *	@Note	The boot record is written before the flag: a reset in between installs the new Firmware again
+  */
+static void App_UpdateFinish(void)
+{
+	uint8_t DataBuff[BOOT_RECORD_OFFSET_CONFIRM + 1];
+	
+	App_ReadAheadStop();
+	Mid_EmbeddedFlash_ImageWriteEnd();
+	
+	UpdatePercentage = 0;
+	App_ShowProgress();
+	
+	/* Firmware as programmed in EmbeddedFlash */
+	if(App_ImageCRC16(NewFirmwareSize) != NewFirmwareCRC16)
+	{
+		App_UpdateFail();
+		
+		return;
+	}
+	
+	/* boot record: backup restored confirmed already, new Firmware on trial until it confirms itself */
+	DataBuff[BOOT_RECORD_OFFSET_MARK] = FIRMWARE_BOOT_RECORD_MARK;
+	DataBuff[BOOT_RECORD_OFFSET_SIZE] = NewFirmwareSize & 0xFF;
+	DataBuff[BOOT_RECORD_OFFSET_SIZE + 1] = (NewFirmwareSize >> 8) & 0xFF;
+	DataBuff[BOOT_RECORD_OFFSET_SIZE + 2] = (NewFirmwareSize >> 16) & 0xFF;
+	DataBuff[BOOT_RECORD_OFFSET_SIZE + 3] = (NewFirmwareSize >> 24) & 0xFF;
+	DataBuff[BOOT_RECORD_OFFSET_CRC16] = NewFirmwareCRC16 >> 8;
+	DataBuff[BOOT_RECORD_OFFSET_CRC16 + 1] = NewFirmwareCRC16 & 0xFF;
+	DataBuff[BOOT_RECORD_OFFSET_VERSION] = NewFirmwareVersion[0];
+	DataBuff[BOOT_RECORD_OFFSET_VERSION + 1] = NewFirmwareVersion[1];
+	DataBuff[BOOT_RECORD_OFFSET_CONFIRM] = Boot_RollbackFlag ? FIRMWARE_BOOT_CONFIRMED : 0xFF;
+	
+	Mid_Flash_EraseSector(FIRMWARE_BOOT_RECORD_ADDRESS / FLASH_SECTOR_SIZE);
+	App_RecordProgram(FIRMWARE_BOOT_RECORD_ADDRESS, &DataBuff[0], BOOT_RECORD_OFFSET_CONFIRM + 1);
+	
+	if(Boot_RollbackFlag)
+	{
+		Mid_TFTLCD_ShowString(0, 120, "Restore Successfully", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+	}
+	else
+	{
+		DataBuff[0] = FIRMWARE_NEW_VERSION_READY;	// New Firmware is ready
+		DataBuff[1] = NewFirmwareVersion[0];
+		DataBuff[2] = NewFirmwareVersion[1];
 		
-		DownloadUnitNumber_256Byte++;
+		/* update the FirmwareInfo to external Flash */
+		Mid_Flash_WriteData(&DataBuff[0], FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 3);
 		
+		Mid_TFTLCD_ShowString(0, 120, "Update Successfully", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+	}
+	
+	/* jump and execute the new version code */
+	Hal_JumpToApp_Jump();
+}
 
+/**
+  * @Brief	New Firmware not installed(decompress / CRC16 check fail): restore the backup in place of it
+  * @Param	None
+  * @Retval	None
+  *	@Note	New Firmware dropped once the backup is being restored, left flagged without one(installed again at the next reset).
+  *			No backup / backup not restored: EmbeddedFlash holds no Firmware to start, sent over the Debug_USART
+  */
+static void App_UpdateFail(void)
+{
+	uint8_t Flag;
+	
+	App_ReadAheadStop();
+	Mid_EmbeddedFlash_ImageWriteEnd();
+	
+	/* received over the Debug_USART: sent again */
+	if(RecoveryFlag)
+	{
+		UpdateBusyFlag = 0;
+		
+		Mid_TFTLCD_ShowString(0, 120, "Recovery Failed", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+		
+		return;
 	}
-	else if(DownloadUnitNumber_256Byte == UpdateUnit_256Byte)
+	
+	if(App_RollbackStart())
 	{
-		/* read-out the residue data from external Flash */
-		Mid_Flash_ReadData(&DataBuff[0], ReadOutFlashAddressOffset, UpdateUint_Residue);
+		Flag = FIRMWARE_NEW_VERSION_DEFAULT;
 		
-		Len = UpdateUint_Residue;
+		Mid_Flash_WriteData(&Flag, FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 1);
 		
-		/* if the residue is odd, to make sure the data alignment add 1 byte(0xFF) at the end */
-		if(Len % 2)
+		return;
+	}
+	
+	App_RecoveryStart();
+	
+	Mid_TFTLCD_ShowString(0, 120, Boot_RollbackFlag ? "Restore Failed" : "Update Failed", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+}
+
+/**
+  * @Brief	Check the Firmware in EmbeddedFlash against the boot record before it is started
+  * @Param	None
+  * @Retval	1->Firmware to be started, 0->backup being restored(App_Pro) / serial recovery(Firmware damaged)
+  *	@Note	CRC16 read over the whole Firmware a page at a time: start time bounded by FIRMWARE_IMAGE_SIZE_MAX.
+  *			A Firmware not confirmed spends one trial per start, the backup restored once FIRMWARE_TRIAL_BOOT_MAX are spent
+  *			(started as it is without a backup)
+  */
+static uint8_t App_BootCheck(void)
+{
+	uint8_t  Record[BOOT_RECORD_OFFSET_TRIAL + FIRMWARE_TRIAL_BOOT_MAX];
+	uint32_t Size;
+	uint8_t  i;
+	
+	Mid_Flash_ReadData(&Record[0], FIRMWARE_BOOT_RECORD_ADDRESS, sizeof(Record));
+	
+	/* Firmware installed before the boot record was kept */
+	if(Record[BOOT_RECORD_OFFSET_MARK] != FIRMWARE_BOOT_RECORD_MARK)
+	{
+		return 1;
+	}
+	
+	Size = Record[BOOT_RECORD_OFFSET_SIZE] | (Record[BOOT_RECORD_OFFSET_SIZE + 1] << 8) | 
+		   (Record[BOOT_RECORD_OFFSET_SIZE + 2] << 16) | ((uint32_t)Record[BOOT_RECORD_OFFSET_SIZE + 3] << 24);
+	
+	if((Size == 0) || (Size > FIRMWARE_IMAGE_SIZE_MAX) || 
+	   (App_ImageCRC16(Size) != ((Record[BOOT_RECORD_OFFSET_CRC16] << 8) | Record[BOOT_RECORD_OFFSET_CRC16 + 1])))
+	{
+		/* damaged without a backup: sent over the Debug_USART */
+		if(App_RollbackStart() == 0)
 		{
-			DataBuff[Len] = 0xFF;
-			Len++;
+			App_RecoveryStart();
 		}
 		
-		Len /= 2;	// halfword align
-		
-		/* transfer the read-out data into halfword aligned */
-		for(i=0; i<Len; i++)
+		return 0;
+	}
+	
+	if(Record[BOOT_RECORD_OFFSET_CONFIRM] == FIRMWARE_BOOT_CONFIRMED)
+	{
+		return 1;
+	}
+	
+	/* on trial: next trial spent */
+	for(i=0; i<FIRMWARE_TRIAL_BOOT_MAX; i++)
+	{
+		if(Record[BOOT_RECORD_OFFSET_TRIAL + i] == 0xFF)
 		{
-			EmbeddedFlashBuff[i] = (DataBuff[i*2 + 1] << 8) & 0xFF00;
-			EmbeddedFlashBuff[i] |= (DataBuff[i*2]) & 0xFF;
+			Record[BOOT_RECORD_OFFSET_TRIAL + i] = 0x00;
+			
+			Mid_Flash_WritePage(&Record[BOOT_RECORD_OFFSET_TRIAL + i], FIRMWARE_BOOT_RECORD_ADDRESS + BOOT_RECORD_OFFSET_TRIAL + i, 1);
+			
+			return 1;
 		}
+	}
+	
+	return (App_RollbackStart() == 0);
+}
+
+/**
+  * @Brief	Keep the running Firmware as the backup before a new Firmware overwrites it
+  * @Param	pVersion: version of the running Firmware(FirmwareInfo CurrentVersion), taken without a boot record
+  * @Retval	None
+  *	@Note	Only a Firmware confirmed and checked is kept, the one kept already is not written again.
+  *			Without a boot record the whole application area is kept, once(a copy cut short is not taken for the Firmware),
+  *			not kept without a valid stack address in the vector table.
+  *			The header is programmed after the image is read back and checked
+  */
+static void App_BackupSave(uint8_t *pVersion)
+{
+	uint8_t  Record[BOOT_RECORD_OFFSET_CONFIRM + 1];
+	uint8_t  Header[BOOT_RECORD_OFFSET_CONFIRM];
+	uint32_t Size;
+	uint32_t Offset;
+	uint16_t Len;
+	uint16_t CRC16;
+	
+	Mid_Flash_ReadData(&Record[0], FIRMWARE_BOOT_RECORD_ADDRESS, sizeof(Record));
+	
+	if(Record[BOOT_RECORD_OFFSET_MARK] == FIRMWARE_BOOT_RECORD_MARK)
+	{
+		Size = Record[BOOT_RECORD_OFFSET_SIZE] | (Record[BOOT_RECORD_OFFSET_SIZE + 1] << 8) | 
+			   (Record[BOOT_RECORD_OFFSET_SIZE + 2] << 16) | ((uint32_t)Record[BOOT_RECORD_OFFSET_SIZE + 3] << 24);
 		
-		Mid_EmbeddedFlash_WriteHalfWord(EMBEDDED_FLASH_Address_APP_BASE + WriteInFlashAddressOffset, &EmbeddedFlashBuff[0], Len);
+		CRC16 = (Record[BOOT_RECORD_OFFSET_CRC16] << 8) | Record[BOOT_RECORD_OFFSET_CRC16 + 1];
 		
-		WriteInFlashAddressOffset += UpdateUint_Residue;
-	
-		UpdatePercentage = (WriteInFlashAddressOffset * 1000) / NewFirmwareSize;
+		/* on trial / damaged(new Firmware copy cut short) */
+		if((Record[BOOT_RECORD_OFFSET_CONFIRM] != FIRMWARE_BOOT_CONFIRMED) || (Size == 0) || (Size > FIRMWARE_IMAGE_SIZE_MAX) || 
+		   (App_ImageCRC16(Size) != CRC16))
+		{
+			return;
+		}
 		
-		if(UpdatePercentage < 1000)
+		if((App_BackupRead(&Header[0]) == Size) && (memcmp(&Header[BOOT_RECORD_OFFSET_CRC16], &Record[BOOT_RECORD_OFFSET_CRC16], 4) == 0))
 		{
-			DataBuff[0] = (UpdatePercentage / 100) + '0';
-			DataBuff[1] = ((UpdatePercentage % 100) / 10) + '0';
-			DataBuff[2] = '.';
-			DataBuff[3] = (UpdatePercentage % 10) + '0';
-			DataBuff[4] = '%';
-			DataBuff[5] = '\0';
+			return;
 		}
-		else
+	}
+	else
+	{
+		/* kept already / no Firmware(blank EmbeddedFlash) */
+		if(App_BackupRead(&Header[0]) || ((*(volatile uint32_t *)EMBEDDED_FLASH_Address_APP_BASE & 0x2FFF0000) != 0x20000000))
 		{
-			DataBuff[0] = '1';
-			DataBuff[1] = '0';
-			DataBuff[2] = '0';
-			DataBuff[3] = '.';
-			DataBuff[4] = '0';
-			DataBuff[5] = '%';
-			DataBuff[6] = '\0';
+			return;
 		}
+		
+		Size = FIRMWARE_IMAGE_SIZE_MAX;
+		CRC16 = App_ImageCRC16(Size);
+		
+		Record[BOOT_RECORD_OFFSET_SIZE] = Size & 0xFF;
+		Record[BOOT_RECORD_OFFSET_SIZE + 1] = (Size >> 8) & 0xFF;
+		Record[BOOT_RECORD_OFFSET_SIZE + 2] = (Size >> 16) & 0xFF;
+		Record[BOOT_RECORD_OFFSET_SIZE + 3] = (Size >> 24) & 0xFF;
+		Record[BOOT_RECORD_OFFSET_CRC16] = CRC16 >> 8;
+		Record[BOOT_RECORD_OFFSET_CRC16 + 1] = CRC16 & 0xFF;
+		Record[BOOT_RECORD_OFFSET_VERSION] = pVersion[0];
+		Record[BOOT_RECORD_OFFSET_VERSION + 1] = pVersion[1];
+	}
 	
-		/* Display download progress */
-		Mid_TFTLCD_ShowString(130, 120, &DataBuff[0], LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+	Mid_TFTLCD_ScreenClear();
+	Mid_TFTLCD_ShowString(60, 60, "Firmware Backup...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+	
+	/* header erased first: the backup is not taken until it is complete */
+	Mid_Flash_EraseSector(FIRMWARE_BACKUP_ADDRESS / FLASH_SECTOR_SIZE);
+	
+	for(Offset=0; Offset<Size; Offset+=Len)
+	{
+		if((Offset % FLASH_SECTOR_SIZE) == 0)
+		{
+			Mid_Flash_EraseSector((FIRMWARE_BACKUP_IMAGE_ADDRESS + Offset) / FLASH_SECTOR_SIZE);
+		}
 		
-		DataBuff[0] = FIRMWARE_NEW_VERSION_READY;	// New Firmware is ready
-		DataBuff[1] = NewFirmwareVersion[0];
-		DataBuff[2] = NewFirmwareVersion[1];
+		Len = ((Size - Offset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (Size - Offset);
 		
-		/* update the FirmwareInfo to external Flash */
-		Mid_Flash_WriteData(&DataBuff[0], FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 3);
+		Mid_Flash_WritePage((uint8_t *)(EMBEDDED_FLASH_Address_APP_BASE + Offset), FIRMWARE_BACKUP_IMAGE_ADDRESS + Offset, Len);
+	}
+	
+	if(App_FlashCRC16(FIRMWARE_BACKUP_IMAGE_ADDRESS, Size) == CRC16)
+	{
+		Record[BOOT_RECORD_OFFSET_MARK] = FIRMWARE_BOOT_RECORD_MARK;
 		
-		Mid_TFTLCD_ShowString(0, 120, "Update Successfully", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+		App_RecordProgram(FIRMWARE_BACKUP_ADDRESS, &Record[0], BOOT_RECORD_OFFSET_CONFIRM);
+	}
+}
+
+/**
+  * @Brief	Read the header of the backup
+  * @Param	pHeader: point to the buffer to store the header(BOOT_RECORD_OFFSET_CONFIRM byte)
+  * @Retval	size of the backup Firmware, 0->no backup
+  */
+static uint32_t App_BackupRead(uint8_t *pHeader)
+{
+	uint32_t Size;
+	
+	Mid_Flash_ReadData(pHeader, FIRMWARE_BACKUP_ADDRESS, BOOT_RECORD_OFFSET_CONFIRM);
+	
+	if(pHeader[BOOT_RECORD_OFFSET_MARK] != FIRMWARE_BOOT_RECORD_MARK)
+	{
+		return 0;
+	}
+	
+	Size = pHeader[BOOT_RECORD_OFFSET_SIZE] | (pHeader[BOOT_RECORD_OFFSET_SIZE + 1] << 8) | 
+		   (pHeader[BOOT_RECORD_OFFSET_SIZE + 2] << 16) | ((uint32_t)pHeader[BOOT_RECORD_OFFSET_SIZE + 3] << 24);
+	
+	return (Size > FIRMWARE_IMAGE_SIZE_MAX) ? 0 : Size;
+}
+
+/**
+  * @Brief	Start restoring the backup to EmbeddedFlash, copied by App_Pro like a new Firmware
+  * @Param	None
+  * @Retval	1->backup checked and being restored, 0->no backup / backup damaged / restored already
+  *	@Note	The backup is checked by its CRC16 before EmbeddedFlash is touched
+  */
+static uint8_t App_RollbackStart(void)
+{
+	uint8_t  Header[BOOT_RECORD_OFFSET_CONFIRM];
+	uint32_t Size;
+	uint16_t CRC16;
+	
+	if(Boot_RollbackFlag)
+	{
+		return 0;
+	}
+	
+	Size = App_BackupRead(&Header[0]);
+	CRC16 = (Header[BOOT_RECORD_OFFSET_CRC16] << 8) | Header[BOOT_RECORD_OFFSET_CRC16 + 1];
+	
+	if((Size == 0) || (App_FlashCRC16(FIRMWARE_BACKUP_IMAGE_ADDRESS, Size) != CRC16))
+	{
+		return 0;
+	}
+	
+	Boot_RollbackFlag = 1;
+	LZ_State = APP_LZ_STA_IDLE;
+	
+	NewFirmwareSize = Size;
+	NewFirmwareCRC16 = CRC16;
+	NewFirmwareVersion[0] = Header[BOOT_RECORD_OFFSET_VERSION];
+	NewFirmwareVersion[1] = Header[BOOT_RECORD_OFFSET_VERSION + 1];
+	
+	App_ReadAheadStart(FIRMWARE_BACKUP_IMAGE_ADDRESS, FIRMWARE_BACKUP_IMAGE_ADDRESS + Size);
+	
+	Mid_EmbeddedFlash_ImageWriteStart();
+	
+	WriteInFlashAddressOffset = 0;
+	UpdatePercentage = 0;
+	UpdateBusyFlag = 1;
+	
+	Mid_TFTLCD_ScreenClear();
+	Mid_TFTLCD_ShowString(60, 60, "Firmware Restoring...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+	Mid_TFTLCD_ShowString(130, 120, "0%", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+	
+	return 1;
+}
+
+/**
+  * @Brief	Program a boot record / backup header into its Sector erased
+  * @Param	Addr   : address of the record
+  *			pRecord: point to the record(Mark set)
+  *			Len	   : record length
+  * @Retval	None
+  *	@Note	Mark programmed last: a record cut short by a reset is not taken
+  */
+static void App_RecordProgram(uint32_t Addr, uint8_t *pRecord, uint8_t Len)
+{
+	Mid_Flash_WritePage(&pRecord[1], Addr + 1, Len - 1);
+	Mid_Flash_WritePage(&pRecord[0], Addr, 1);
+}
+
+/**
+  * @Brief	CRC16(Modbus) of the Firmware in EmbeddedFlash
+  * @Param	Size: size of the Firmware
+  * @Retval	CRC16 value(as Mid_CRC16_Modbus)
+  */
+static uint16_t App_ImageCRC16(uint32_t Size)
+{
+	uint32_t Offset;
+	uint16_t Len;
+	uint16_t CRC16State;
+	
+	CRC16State = CRC16_MODBUS_INIT;
+	
+	for(Offset=0; Offset<Size; Offset+=Len)
+	{
+		Len = ((Size - Offset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (Size - Offset);
 		
-		/* jump and execute the new version code */
-		Hal_JumpToApp_Jump();
+		CRC16State = Mid_CRC16_ModbusUpdate((uint8_t *)(EMBEDDED_FLASH_Address_APP_BASE + Offset), Len, CRC16State);
+	}
+	
+	return Mid_CRC16_ModbusResult(CRC16State);
+}
+
+/**
+  * @Brief	CRC16(Modbus) of data in ExternalFlash
+  * @Param	Addr: address of the data
+  *			Size: data length
+  * @Retval	CRC16 value(as Mid_CRC16_Modbus)
+  */
+static uint16_t App_FlashCRC16(uint32_t Addr, uint32_t Size)
+{
+	uint8_t  DataBuff[FLASH_PAGE_SIZE];
+	uint32_t Offset;
+	uint16_t Len;
+	uint16_t CRC16State;
+	
+	CRC16State = CRC16_MODBUS_INIT;
+	
+	for(Offset=0; Offset<Size; Offset+=Len)
+	{
+		Len = ((Size - Offset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (Size - Offset);
+		
+		Mid_Flash_ReadData(&DataBuff[0], Addr + Offset, Len);
+		
+		CRC16State = Mid_CRC16_ModbusUpdate(&DataBuff[0], Len, CRC16State);
 	}
+	
+	return Mid_CRC16_ModbusResult(CRC16State);
 }
 
+/**
+  * @Brief	Write a piece of the new Firmware to EmbeddedFlash, after the piece written before
+  * @Param	pData: point to the data(the byte after it writable)
+  *			Len	 : data length(odd only at the end of the Firmware)
+  * @Retval	None
+  */
+static void App_ImageWrite(uint8_t *pData, uint16_t Len)
+{
+	uint16_t i;
+	uint16_t Number;
+	uint16_t EmbeddedFlashBuff[128];	// store halfword data
+	
+	/* if the data is odd, to make sure the data alignment add 1 byte(0xFF) at the end */
+	if(Len % 2)
+	{
+		pData[Len] = 0xFF;
+		Len++;
+	}
+	
+	while(Len)
+	{
+		Number = (Len > 256) ? 128 : (Len / 2);
+		
+		/* transfer the data into halfword aligned */
+		for(i=0; i<Number; i++)
+		{
+			EmbeddedFlashBuff[i] = (pData[i*2 + 1] << 8) & 0xFF00;
+			EmbeddedFlashBuff[i] |= (pData[i*2]) & 0xFF;
+		}
+		
+		/* write-in the halfword aligned data into EmbeddedFlash */
+		Mid_EmbeddedFlash_ImageWrite(EMBEDDED_FLASH_Address_APP_BASE + WriteInFlashAddressOffset, &EmbeddedFlashBuff[0], Number);
+		
+		WriteInFlashAddressOffset += Number * 2;
+		pData += Number * 2;
+		Len -= Number * 2;
+	}
+}
 
-/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Check the Menu key is held at start(serial recovery requested)
+  * @Param	None
+  * @Retval	1->held for APP_RECOVERY_KEY_HOLD, 0->not pressed / released before
+  *	@Note	Timed by T_KEY_HOLD: returns at once when the key is not pressed
+  */
+static uint8_t App_RecoveryKeyHeld(void)
+{
+	Recovery_KeyHoldFlag = 0;
+	
+	Hal_Timer_Creat(T_KEY_HOLD, App_RecoveryKeyHoldHandler, APP_RECOVERY_KEY_HOLD, T_STATE_START);
+	
+	while(Recovery_KeyHoldFlag == 0)
+	{
+		if(Hal_Key_GetValue() != KEY_VALUE_MENU)
+		{
+			Hal_Timer_Delete(T_KEY_HOLD);
+			
+			return 0;
+		}
+	}
+	
+	Hal_Timer_Delete(T_KEY_HOLD);
+	
+	return 1;
+}
+
+/**
+  * @Brief	Timer handler: Menu key held for APP_RECOVERY_KEY_HOLD
+  * @Param	None
+  * @Retval	None
+  */
+static void App_RecoveryKeyHoldHandler(void)
+{
+	Recovery_KeyHoldFlag = 1;
+}
+
+/**
+  * @Brief	Start waiting for the Firmware over the Debug_USART(YMODEM)
+  * @Param	None
+  * @Retval	None
+  *	@Note	DMA1_Channel5 taken by USART1_RX: no ExternalFlash read ahead from then on
+  */
+static void App_RecoveryStart(void)
+{
+	RecoveryFlag = 1;
+	UpdateBusyFlag = 0;
+	LZ_State = APP_LZ_STA_IDLE;
+	
+	Hal_USART_DebugStart(APP_RECOVERY_BAUDRATE);
+	Mid_YModem_Start();
+	
+	Mid_TFTLCD_ScreenClear();
+	Mid_TFTLCD_ShowString(60, 60, "Serial Recovery...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+}
+
+/**
+  * @Brief	Polling of the serial recovery: Firmware received block by block into EmbeddedFlash
+  * @Param	None
+  * @Retval	None
+  *	@Note	Each block is acknowledged before it is programmed, the next one received by DMA in the meantime.
+  *			Only the first file of a batch is taken
+  */
+static void App_RecoveryPro(void)
+{
+	uint8_t  *pData;
+	uint16_t Len;
+	
+	switch(Mid_YModem_Pro(&pData, &Len))
+	{
+		case YMODEM_EVT_FILE:
+		{
+			NewFirmwareSize = Mid_YModem_GetFileSize();
+			
+			if((NewFirmwareSize == 0) || (NewFirmwareSize > FIRMWARE_IMAGE_SIZE_MAX))
+			{
+				Mid_YModem_Cancel();
+				Mid_YModem_Start();
+				
+				Mid_TFTLCD_ShowString(0, 120, "Size Invalid", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+				
+				break;
+			}
+			
+			Mid_EmbeddedFlash_ImageWriteStart();
+			
+			/* backup not restored before: the Firmware received started on trial like a new one */
+			Boot_RollbackFlag = 0;
+			
+			Recovery_CRC16State = CRC16_MODBUS_INIT;
+			WriteInFlashAddressOffset = 0;
+			UpdatePercentage = 0;
+			UpdateBusyFlag = 1;
+			
+			Mid_TFTLCD_ScreenClear();
+			Mid_TFTLCD_ShowString(60, 60, "Serial Recovery...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+			Mid_TFTLCD_ShowString(130, 120, "0%", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+		}
+		break;
+		
+		case YMODEM_EVT_DATA:
+		{
+			/* padding of the last block dropped */
+			if(Len > (NewFirmwareSize - WriteInFlashAddressOffset))
+			{
+				Len = NewFirmwareSize - WriteInFlashAddressOffset;
+			}
+			
+			Recovery_CRC16State = Mid_CRC16_ModbusUpdate(pData, Len, Recovery_CRC16State);
+			
+			App_ImageWrite(pData, Len);
+			App_ShowProgress();
+		}
+		break;
+		
+		case YMODEM_EVT_END:
+		{
+			/* batch ended without a file */
+			if(UpdateBusyFlag == 0)
+			{
+				Mid_YModem_Start();
+				
+				break;
+			}
+			
+			if(WriteInFlashAddressOffset < NewFirmwareSize)
+			{
+				App_UpdateFail();
+				Mid_YModem_Start();
+				
+				break;
+			}
+			
+			NewFirmwareCRC16 = Mid_CRC16_ModbusResult(Recovery_CRC16State);
+			NewFirmwareVersion[0] = 0xFF;
+			NewFirmwareVersion[1] = 0xFF;
+			
+			/* checked and started(on trial) */
+			App_UpdateFinish();
+			
+			/* check fail / not started: next file */
+			UpdateBusyFlag = 0;
+			Mid_YModem_Start();
+		}
+		break;
+		
+		case YMODEM_EVT_ABORT:
+		{
+			if(UpdateBusyFlag)
+			{
+				Mid_EmbeddedFlash_ImageWriteEnd();
+				
+				UpdateBusyFlag = 0;
+			}
+			
+			Mid_YModem_Start();
+			
+			Mid_TFTLCD_ShowString(0, 120, "Recovery Cancelled", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+		}
+		break;
+		
+	}
+}
+
+/**
+  * @Brief	Show the progress of the EmbeddedFlash programming
+  * @Param	None
+  * @Retval	None
+  *	@Note	Shown once per 1% moved on(the LCD string takes a few ms)
+  */
+static void App_ShowProgress(void)
+{
+	uint8_t  DataBuff[8];
+	uint16_t Percentage;
+	
+	Percentage = NewFirmwareSize ? ((WriteInFlashAddressOffset * 1000) / NewFirmwareSize) : 1000;
+	
+	if((Percentage / 10) == (UpdatePercentage / 10))
+	{
+		return;
+	}
+	
+	UpdatePercentage = Percentage;
+	
+	if(UpdatePercentage < 1000)
+	{
+		DataBuff[0] = (UpdatePercentage / 100) + '0';
+		DataBuff[1] = ((UpdatePercentage % 100) / 10) + '0';
+		DataBuff[2] = '.';
+		DataBuff[3] = (UpdatePercentage % 10) + '0';
+		DataBuff[4] = '%';
+		DataBuff[5] = '\0';
+	}
+	else
+	{
+		DataBuff[0] = '1';
+		DataBuff[1] = '0';
+		DataBuff[2] = '0';
+		DataBuff[3] = '.';
+		DataBuff[4] = '0';
+		DataBuff[5] = '%';
+		DataBuff[6] = '\0';
+	}
+	
+	/* Display download progress */
+	Mid_TFTLCD_ShowString(130, 120, &DataBuff[0], LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+}
+
+/**
+  * @Brief	Start reading ExternalFlash a page ahead
+  * @Param	Addr   : address of the first page
+  *			EndAddr: address after the last byte to read
+  * @Retval	None
+  */
+static void App_ReadAheadStart(uint32_t Addr, uint32_t EndAddr)
+{
+	ReadOutFlashAddressOffset = Addr;
+	ReadAhead_EndAddr = EndAddr;
+	ReadAhead_Index = 0;
+	ReadAhead_Len = 0;
+	
+	if(ReadOutFlashAddressOffset < ReadAhead_EndAddr)
+	{
+		ReadAhead_Len = ((ReadAhead_EndAddr - ReadOutFlashAddressOffset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (ReadAhead_EndAddr - ReadOutFlashAddressOffset);
+		
+		Mid_Flash_ReadDataStart(&ReadAhead_Buff[ReadAhead_Index][0], ReadOutFlashAddressOffset, ReadAhead_Len);
+		
+		ReadOutFlashAddressOffset += ReadAhead_Len;
+	}
+}
+
+/**
+  * @Brief	Take the page read ahead, start reading the next one
+  * @Param	ppData: point to the pointer of the page taken(valid until the next call)
+  * @Retval	length of the page taken, 0->end reached
+  */
+static uint16_t App_ReadAheadNext(uint8_t **ppData)
+{
+	uint16_t Len;
+	
+	if(ReadAhead_Len == 0)
+	{
+		return 0;
+	}
+	
+	Mid_Flash_ReadDataWait();
+	
+	*ppData = &ReadAhead_Buff[ReadAhead_Index][0];
+	Len = ReadAhead_Len;
+	
+	ReadAhead_Index ^= 1;
+	ReadAhead_Len = 0;
+	
+	/* next page read by DMA while this one is used */
+	if(ReadOutFlashAddressOffset < ReadAhead_EndAddr)
+	{
+		ReadAhead_Len = ((ReadAhead_EndAddr - ReadOutFlashAddressOffset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (ReadAhead_EndAddr - ReadOutFlashAddressOffset);
+		
+		Mid_Flash_ReadDataStart(&ReadAhead_Buff[ReadAhead_Index][0], ReadOutFlashAddressOffset, ReadAhead_Len);
+		
+		ReadOutFlashAddressOffset += ReadAhead_Len;
+	}
+	
+	return Len;
+}
+
+/**
+  * @Brief	Stop reading ahead, ExternalFlash free for other access
+  * @Param	None
+  * @Retval	None
+  */
+static void App_ReadAheadStop(void)
+{
+	if(ReadAhead_Len)
+	{
+		Mid_Flash_ReadDataWait();
+		
+		ReadAhead_Len = 0;
+	}
+}
+
+/**
+  * @Brief	Rebuild the new Firmware from the running Firmware and the delta patch, into ExternalFlash(FIRMWARE_DELTA_TARGET_ADDRESS)
+  * @Param	PatchSize: size of the delta patch(from FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS)
+  * @Retval	1->new Firmware rebuilt and checked(target size and CRC16), 0->patch not applicable
+  *	@Note	The patch is read command by command, COPY reads the running Firmware in EmbeddedFlash directly
+  */
+static uint8_t App_DeltaApply(uint32_t PatchSize)
+{
+	uint8_t  Header[DELTA_OFFSET_CMD];
+	uint8_t  Cmd[6];
+	uint8_t  DataBuff[FLASH_PAGE_SIZE];
+	
+	uint32_t SourceSize;
+	uint32_t SourceOffset;
+	uint32_t ReadAddr;		// next command of the patch
+	uint32_t PatchEnd;
+	uint32_t Offset;
+	uint16_t Len;
+	uint16_t CRC16State;
+	
+	if((PatchSize <= DELTA_OFFSET_CMD) || (PatchSize > FIRMWARE_IMAGE_SIZE_MAX))
+	{
+		return 0;
+	}
+	
+	Mid_Flash_ReadData(&Header[0], FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, DELTA_OFFSET_CMD);
+	
+	if((Header[DELTA_OFFSET_MAGIC] != FIRMWARE_DELTA_MAGIC_0) || (Header[DELTA_OFFSET_MAGIC + 1] != FIRMWARE_DELTA_MAGIC_1))
+	{
+		return 0;
+	}
+	
+	SourceSize = Header[DELTA_OFFSET_SOURCE_SIZE] | (Header[DELTA_OFFSET_SOURCE_SIZE + 1] << 8) | 
+				 (Header[DELTA_OFFSET_SOURCE_SIZE + 2] << 16) | ((uint32_t)Header[DELTA_OFFSET_SOURCE_SIZE + 3] << 24);
+	Delta_TargetSize = Header[DELTA_OFFSET_TARGET_SIZE] | (Header[DELTA_OFFSET_TARGET_SIZE + 1] << 8) | 
+					   (Header[DELTA_OFFSET_TARGET_SIZE + 2] << 16) | ((uint32_t)Header[DELTA_OFFSET_TARGET_SIZE + 3] << 24);
+	
+	if((SourceSize == 0) || (SourceSize > FIRMWARE_IMAGE_SIZE_MAX) || (Delta_TargetSize == 0) || (Delta_TargetSize > FIRMWARE_IMAGE_SIZE_MAX))
+	{
+		return 0;
+	}
+	
+	/* the patch is made against the running Firmware */
+	CRC16State = CRC16_MODBUS_INIT;
+	
+	for(Offset=0; Offset<SourceSize; Offset+=Len)
+	{
+		Len = ((SourceSize - Offset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (SourceSize - Offset);
+		
+		CRC16State = Mid_CRC16_ModbusUpdate((uint8_t *)(EMBEDDED_FLASH_Address_APP_BASE + Offset), Len, CRC16State);
+	}
+	
+	if(Mid_CRC16_ModbusResult(CRC16State) != ((Header[DELTA_OFFSET_SOURCE_CRC16] << 8) | Header[DELTA_OFFSET_SOURCE_CRC16 + 1]))
+	{
+		return 0;
+	}
+	
+	Delta_WriteAddr = FIRMWARE_DELTA_TARGET_ADDRESS;
+	Delta_CRC16State = CRC16_MODBUS_INIT;
+	Delta_PageLen = 0;
+	
+	ReadAddr = FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + DELTA_OFFSET_CMD;
+	PatchEnd = FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + PatchSize;
+	
+	while(1)
+	{
+		if(ReadAddr >= PatchEnd)
+		{
+			return 0;
+		}
+		
+		Mid_Flash_ReadData(&Cmd[0], ReadAddr, 1);
+		
+		if(Cmd[0] == FIRMWARE_DELTA_CMD_END)
+		{
+			break;
+		}
+		else if(Cmd[0] == FIRMWARE_DELTA_CMD_COPY)
+		{
+			Mid_Flash_ReadData(&Cmd[1], ReadAddr + 1, 5);
+			ReadAddr += 6;
+			
+			SourceOffset = Cmd[1] | (Cmd[2] << 8) | ((uint32_t)Cmd[3] << 16);
+			Len = Cmd[4] | (Cmd[5] << 8);
+			
+			if((SourceOffset + Len) > SourceSize)
+			{
+				return 0;
+			}
+			
+			if(!App_DeltaOut((uint8_t *)(EMBEDDED_FLASH_Address_APP_BASE + SourceOffset), Len))
+			{
+				return 0;
+			}
+		}
+		else if(Cmd[0] == FIRMWARE_DELTA_CMD_INSERT)
+		{
+			Mid_Flash_ReadData(&Cmd[1], ReadAddr + 1, 2);
+			ReadAddr += 3;
+			
+			Offset = Cmd[1] | (Cmd[2] << 8);
+			
+			if((ReadAddr + Offset) > PatchEnd)
+			{
+				return 0;
+			}
+			
+			/* insert data read a page at a time */
+			while(Offset)
+			{
+				Len = (Offset > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : Offset;
+				
+				Mid_Flash_ReadData(&DataBuff[0], ReadAddr, Len);
+				ReadAddr += Len;
+				Offset -= Len;
+				
+				if(!App_DeltaOut(&DataBuff[0], Len))
+				{
+					return 0;
+				}
+			}
+		}
+		else
+		{
+			return 0;
+		}
+	}
+	
+	App_DeltaFlush();
+	
+	/* rebuilt Firmware: whole size, CRC16 of the new Firmware */
+	if((Delta_WriteAddr - FIRMWARE_DELTA_TARGET_ADDRESS) != Delta_TargetSize)
+	{
+		return 0;
+	}
+	
+	return (Mid_CRC16_ModbusResult(Delta_CRC16State) == ((Header[DELTA_OFFSET_TARGET_CRC16] << 8) | Header[DELTA_OFFSET_TARGET_CRC16 + 1]));
+}
+
+/**
+  * @Brief	Append data to the rebuilt Firmware
+  * @Param	pData: point to the data
+  *			Len	 : data length
+  * @Retval	1->appended, 0->beyond the target size
+  *	@Note	Programmed a page at a time, each Sector of the target area erased as the first page of it is programmed
+  */
+static uint8_t App_DeltaOut(uint8_t *pData, uint16_t Len)
+{
+	uint16_t Num;
+	
+	if((Delta_WriteAddr - FIRMWARE_DELTA_TARGET_ADDRESS + Delta_PageLen + Len) > Delta_TargetSize)
+	{
+		return 0;
+	}
+	
+	while(Len)
+	{
+		Num = FLASH_PAGE_SIZE - Delta_PageLen;
+		
+		if(Num > Len)
+		{
+			Num = Len;
+		}
+		
+		memcpy(&Delta_PageBuff[Delta_PageLen], pData, Num);
+		
+		Delta_PageLen += Num;
+		pData += Num;
+		Len -= Num;
+		
+		if(Delta_PageLen == FLASH_PAGE_SIZE)
+		{
+			App_DeltaFlush();
+		}
+	}
+	
+	return 1;
+}
+
+/**
+  * @Brief	Program the page buffered of the rebuilt Firmware
+  * @Param	None
+  * @Retval	None
+  */
+static void App_DeltaFlush(void)
+{
+	if(Delta_PageLen == 0)
+	{
+		return;
+	}
+	
+	if((Delta_WriteAddr % FLASH_SECTOR_SIZE) == 0)
+	{
+		Mid_Flash_EraseSector(Delta_WriteAddr / FLASH_SECTOR_SIZE);
+	}
+	
+	Mid_Flash_WritePage(&Delta_PageBuff[0], Delta_WriteAddr, Delta_PageLen);
+	
+	Delta_CRC16State = Mid_CRC16_ModbusUpdate(&Delta_PageBuff[0], Delta_PageLen, Delta_CRC16State);
+	
+	Delta_WriteAddr += Delta_PageLen;
+	Delta_PageLen = 0;
+}
+
+/**
+  * @Brief	Check the header of the compressed Firmware and start decompressing it
+  * @Param	ImageSize: size of the compressed Firmware(from FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS)
+  * @Retval	size of the Firmware decompressed, 0->not a compressed Firmware
+  */
+static uint32_t App_LZStart(uint32_t ImageSize)
+{
+	uint8_t  Header[LZ_OFFSET_DATA];
+	uint32_t RawSize;
+	
+	if((ImageSize <= LZ_OFFSET_DATA) || (ImageSize > FIRMWARE_IMAGE_SIZE_MAX))
+	{
+		return 0;
+	}
+	
+	Mid_Flash_ReadData(&Header[0], FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, LZ_OFFSET_DATA);
+	
+	if((Header[LZ_OFFSET_MAGIC] != FIRMWARE_LZ_MAGIC_0) || (Header[LZ_OFFSET_MAGIC + 1] != FIRMWARE_LZ_MAGIC_1))
+	{
+		return 0;
+	}
+	
+	RawSize = Header[LZ_OFFSET_RAW_SIZE] | (Header[LZ_OFFSET_RAW_SIZE + 1] << 8) | 
+			  (Header[LZ_OFFSET_RAW_SIZE + 2] << 16) | ((uint32_t)Header[LZ_OFFSET_RAW_SIZE + 3] << 24);
+	
+	if((RawSize == 0) || (RawSize > FIRMWARE_IMAGE_SIZE_MAX))
+	{
+		return 0;
+	}
+	
+	LZ_RawCRC16 = (Header[LZ_OFFSET_RAW_CRC16] << 8) | Header[LZ_OFFSET_RAW_CRC16 + 1];
+	LZ_CRC16State = CRC16_MODBUS_INIT;
+	
+	/* compressed data read a page ahead */
+	App_ReadAheadStart(FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + LZ_OFFSET_DATA, FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + ImageSize);
+	
+	LZ_InPos = 0;
+	LZ_InLen = 0;
+	LZ_ErrorFlag = 0;
+	
+	LZ_LiteralLen = 0;
+	LZ_MatchLen = 0;
+	LZ_MatchPending = 0;
+	
+	LZ_State = APP_LZ_STA_BUSY;
+	
+	return RawSize;
+}
+
+/**
+  * @Brief	Decompress the next page of the new Firmware and write it to EmbeddedFlash
+  * @Param	None
+  * @Retval	APP_LZ_STA_BUSY->page written, APP_LZ_STA_DONE->whole Firmware written and checked, APP_LZ_STA_FAIL->sequences / CRC16 check fail
+  *	@Note	A match reaches back into the page being decompressed or into the Firmware written before(image writer page open / EmbeddedFlash)
+  */
+static uint8_t App_LZInflate(void)
+{
+	uint16_t i;
+	uint16_t Len;
+	uint32_t Source;
+	
+	uint16_t EmbeddedFlashBuff[FLASH_PAGE_SIZE / 2];
+	uint8_t  DataBuff[FLASH_PAGE_SIZE];
+	
+	Len = 0;
+	
+	while((Len < FLASH_PAGE_SIZE) && ((WriteInFlashAddressOffset + Len) < NewFirmwareSize))
+	{
+		if(LZ_LiteralLen)
+		{
+			DataBuff[Len++] = App_LZInByte();
+			LZ_LiteralLen--;
+		}
+		else if(LZ_MatchLen)
+		{
+			Source = WriteInFlashAddressOffset + Len - LZ_MatchOffset;
+			
+			if(Source < WriteInFlashAddressOffset)
+			{
+				DataBuff[Len++] = Mid_EmbeddedFlash_ImageReadByte(EMBEDDED_FLASH_Address_APP_BASE + Source);
+			}
+			else
+			{
+				DataBuff[Len++] = DataBuff[Source - WriteInFlashAddressOffset];
+			}
+			
+			LZ_MatchLen--;
+		}
+		/* literals of the sequence done: its match */
+		else if(LZ_MatchPending)
+		{
+			LZ_MatchOffset = App_LZInByte();
+			LZ_MatchOffset |= App_LZInByte() << 8;
+			
+			LZ_MatchLen = App_LZLength(LZ_Token & 0x0F) + FIRMWARE_LZ_MATCH_MIN;
+			LZ_MatchPending = 0;
+			
+			if((LZ_MatchOffset == 0) || (LZ_MatchOffset > (WriteInFlashAddressOffset + Len)))
+			{
+				return APP_LZ_STA_FAIL;
+			}
+		}
+		/* next sequence */
+		else
+		{
+			LZ_Token = App_LZInByte();
+			
+			LZ_LiteralLen = App_LZLength(LZ_Token >> 4);
+			LZ_MatchPending = 1;
+		}
+		
+		if(LZ_ErrorFlag)
+		{
+			return APP_LZ_STA_FAIL;
+		}
+	}
+	
+	/* the last sequence ends with the Firmware */
+	if(((WriteInFlashAddressOffset + Len) == NewFirmwareSize) && (LZ_LiteralLen || LZ_MatchLen))
+	{
+		return APP_LZ_STA_FAIL;
+	}
+	
+	LZ_CRC16State = Mid_CRC16_ModbusUpdate(&DataBuff[0], Len, LZ_CRC16State);
+	
+	/* if the page is odd, to make sure the data alignment add 1 byte(0xFF) at the end */
+	if(Len % 2)
+	{
+		DataBuff[Len] = 0xFF;
+	}
+	
+	for(i=0; i<((Len + 1) / 2); i++)
+	{
+		EmbeddedFlashBuff[i] = (DataBuff[i*2 + 1] << 8) & 0xFF00;
+		EmbeddedFlashBuff[i] |= (DataBuff[i*2]) & 0xFF;
+	}
+	
+	Mid_EmbeddedFlash_ImageWrite(EMBEDDED_FLASH_Address_APP_BASE + WriteInFlashAddressOffset, &EmbeddedFlashBuff[0], (Len + 1) / 2);
+	
+	WriteInFlashAddressOffset += Len;
+	
+	if(WriteInFlashAddressOffset < NewFirmwareSize)
+	{
+		return APP_LZ_STA_BUSY;
+	}
+	
+	if(Mid_CRC16_ModbusResult(LZ_CRC16State) != LZ_RawCRC16)
+	{
+		return APP_LZ_STA_FAIL;
+	}
+	
+	return APP_LZ_STA_DONE;
+}
+
+/**
+  * @Brief	Next byte of the compressed Firmware
+  * @Param	None
+  * @Retval	byte read, 0 with LZ_ErrorFlag set beyond the compressed Firmware
+  */
+static uint8_t App_LZInByte(void)
+{
+	if(LZ_InPos == LZ_InLen)
+	{
+		LZ_InLen = App_ReadAheadNext(&LZ_pInBuff);
+		LZ_InPos = 0;
+		
+		if(LZ_InLen == 0)
+		{
+			LZ_ErrorFlag = 1;
+			
+			return 0;
+		}
+	}
+	
+	return LZ_pInBuff[LZ_InPos++];
+}
+
+/**
+  * @Brief	Length of a sequence field, continued by bytes added after a nibble of 15
+  * @Param	Len: nibble of the token
+  * @Retval	length
+  */
+static uint32_t App_LZLength(uint32_t Len)
+{
+	uint8_t Data;
+	
+	if(Len == 15)
+	{
+		do
+		{
+			Data = App_LZInByte();
+			Len += Data;
+			
+		}while((Data == 255) && (Len <= FIRMWARE_IMAGE_SIZE_MAX));
+	}
+	
+	return Len;
+}
 
 
 /*-------------Interrupt Functions Definition--------*/
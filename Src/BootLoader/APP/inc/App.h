@@ -7,6 +7,46 @@
 #define FIRMWARE_NEW_VERSION_FLAG		0xAA	// new Firmware version detected, is ready to download from ExternalFlash
 #define FIRMWARE_NEW_VERSION_READY		0xBB	// new Firmware is ready in EmbeddedFlash
 #define FIRMWARE_NEW_VERSION_DEFAULT	0xCC
+#define FIRMWARE_NEW_DELTA_FLAG			0xAD	// delta patch of the running Firmware is ready in ExternalFlash, applied by the BootLoader
+#define FIRMWARE_NEW_DELTA_APPLIED		0xAE	// new Firmware rebuilt from the patch at FIRMWARE_DELTA_TARGET_ADDRESS, checked
+#define FIRMWARE_NEW_LZ_FLAG			0xAC	// compressed Firmware is ready in ExternalFlash, decompressed by the BootLoader into EmbeddedFlash
+#define FIRMWARE_RECOVERY_FLAG			0xAF	// Firmware to be sent over the Debug_USART(serial recovery of the BootLoader)
+
+/* Largest image: EmbeddedFlash(256KB) - BootLoader(0x0800C800 - 0x08000000) */
+#define FIRMWARE_IMAGE_SIZE_MAX			206848
+
+/* ExternalFlash area the BootLoader rebuilds the new Firmware in from the delta patch(Sector aligned, beyond the checkpoint) */
+#define FIRMWARE_DELTA_TARGET_ADDRESS	0x50000
+
+/* Delta patch: header, then commands until FIRMWARE_DELTA_CMD_END(sizes and offsets little-endian)
+ *		COPY	: Cmd, SourceOffset(3), Len(2)	-> Len bytes of the running Firmware
+ *		INSERT	: Cmd, Len(2), data(Len)		-> Len bytes of the patch
+ * CRC16: Mid_CRC16_Modbus of the whole image as one run */
+#define FIRMWARE_DELTA_MAGIC_0			0x44	// 'D'
+#define FIRMWARE_DELTA_MAGIC_1			0x50	// 'P'
+#define FIRMWARE_DELTA_CMD_END			0x00
+#define FIRMWARE_DELTA_CMD_COPY			0x01
+#define FIRMWARE_DELTA_CMD_INSERT		0x02
+
+/* Compressed Firmware(LZ4 block format): header, then sequences until the raw size is reached(sizes and offsets little-endian)
+ *		Token(literal length << 4 | match length - FIRMWARE_LZ_MATCH_MIN), literals, Offset(2),
+ *		a length nibble of 15 continued by bytes added until one below 255, the last sequence has literals only
+ * Offset: back from the next byte into the Firmware decompressed so far(1 -> 65535) */
+#define FIRMWARE_LZ_MAGIC_0				0x4C	// 'L'
+#define FIRMWARE_LZ_MAGIC_1				0x5A	// 'Z'
+#define FIRMWARE_LZ_MATCH_MIN			4
+
+/* Boot record in ExternalFlash(Sector beyond the delta target area): Firmware installed in EmbeddedFlash, checked by the BootLoader at every start
+ *		Mark | Size(4) | CRC16(2) | Version(2) | Confirm | Trial(FIRMWARE_TRIAL_BOOT_MAX)
+ * Trial: one byte programmed to 0x00 per start of a Firmware not confirmed, rolled back once all of them are spent */
+#define FIRMWARE_BOOT_RECORD_ADDRESS	0x8F000
+#define FIRMWARE_BOOT_RECORD_MARK		0xA5
+#define FIRMWARE_BOOT_CONFIRMED			0x00	// Confirm programmed by the Firmware once it has run healthy(0xFF->on trial)
+#define FIRMWARE_TRIAL_BOOT_MAX			3
+
+/* Backup of the last Firmware confirmed(rolled back to by the BootLoader): header Sector(boot record Mark -> Version), then the image */
+#define FIRMWARE_BACKUP_ADDRESS			0x90000
+#define FIRMWARE_BACKUP_IMAGE_ADDRESS	(FIRMWARE_BACKUP_ADDRESS + 4096)
 
 /* Flash Address offset of FirmwareInfo define */
 typedef enum
@@ -25,6 +65,40 @@ typedef enum
 	
 }en_FlashAddress_FirmwareInfo_t;
 
+/* Offset of the delta patch header fields(from FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS) */
+typedef enum
+{
+	DELTA_OFFSET_MAGIC 			= 0,	// 2 byte: FIRMWARE_DELTA_MAGIC_0, FIRMWARE_DELTA_MAGIC_1
+	DELTA_OFFSET_SOURCE_SIZE 	= 2,	// 4 byte: size of the running Firmware the patch is made against
+	DELTA_OFFSET_SOURCE_CRC16 	= 6,	// 2 byte
+	DELTA_OFFSET_TARGET_SIZE 	= 8,	// 4 byte: size of the new Firmware
+	DELTA_OFFSET_TARGET_CRC16 	= 12,	// 2 byte
+	DELTA_OFFSET_CMD 			= 14,	// commands
+	
+}en_DeltaPatch_Offset_t;
+
+/* Offset of the compressed Firmware header fields(from FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS) */
+typedef enum
+{
+	LZ_OFFSET_MAGIC 		= 0,	// 2 byte: FIRMWARE_LZ_MAGIC_0, FIRMWARE_LZ_MAGIC_1
+	LZ_OFFSET_RAW_SIZE 		= 2,	// 4 byte: size of the Firmware decompressed
+	LZ_OFFSET_RAW_CRC16 	= 6,	// 2 byte: Mid_CRC16_Modbus of the Firmware decompressed
+	LZ_OFFSET_DATA 			= 8,	// sequences
+	
+}en_LZImage_Offset_t;
+
+/* Offset of the boot record fields(from FIRMWARE_BOOT_RECORD_ADDRESS, backup header from FIRMWARE_BACKUP_ADDRESS) */
+typedef enum
+{
+	BOOT_RECORD_OFFSET_MARK 	= 0,	// FIRMWARE_BOOT_RECORD_MARK
+	BOOT_RECORD_OFFSET_SIZE 	= 1,	// 4 byte: size of the Firmware(little-endian)
+	BOOT_RECORD_OFFSET_CRC16 	= 5,	// 2 byte: Mid_CRC16_Modbus of the Firmware
+	BOOT_RECORD_OFFSET_VERSION 	= 7,	// 2 byte
+	BOOT_RECORD_OFFSET_CONFIRM 	= 9,	// FIRMWARE_BOOT_CONFIRMED / 0xFF(boot record only)
+	BOOT_RECORD_OFFSET_TRIAL 	= 16,	// FIRMWARE_TRIAL_BOOT_MAX byte(boot record only)
+	
+}en_BootRecord_Offset_t;
+
 /**************************************************************/
 
 /* structure of FirmwareInfo part(the first 13 bytes of Flash)*/
@@ -33,11 +107,27 @@ typedef struct
 	unsigned char NewVersionFlag;		// FirmwareUpdate State
 	unsigned char CurrentVersion[2];    // current Firmware Version
 	unsigned char NewVersion[2];        // New Firmware Version
-	unsigned char FirmwareSize[4];      // size of New Firmware (byte)
+	unsigned char FirmwareSize[4];      // size of New Firmware (byte, little-endian) / of the delta patch
 	unsigned char PackageNumber[2];     // number of Packages
 	unsigned char CRC16[2];             // CRC16 check value of the whole file, grab from Server info
 }stu_FirmwareInfo_t;
 
+/* Serial recovery(YMODEM-1K over the Debug_USART): 72MHz / 16 / 4.875 -> 923kbps */
+#define APP_RECOVERY_BAUDRATE			921600
+
+/* Menu key held for 1s(20000 * 50us) at start: serial recovery requested */
+#define APP_RECOVERY_KEY_HOLD			20000
+
+/* Compressed Firmware install state(App_Pro) */
+typedef enum
+{
+	APP_LZ_STA_IDLE = 0,		// no compressed Firmware to install
+	APP_LZ_STA_BUSY,			// a page decompressed and written per poll
+	APP_LZ_STA_DONE,			// whole Firmware written, size and CRC16 checked
+	APP_LZ_STA_FAIL,			// sequences / CRC16 check fail: backup restored, left flagged without one(installed again at the next reset)
+	
+}en_App_LZState_t;
+
 
 void App_Init(void);
 void App_Pro(void);
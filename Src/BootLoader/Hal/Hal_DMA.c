@@ -9,10 +9,11 @@
 #include "hal_gpio.h"
 
 /*-------------Internal Functions Declaration------*/
+static void Hal_DMA1_Config(void);	// SPI2_RX --> RAM, dummy byte --> SPI2_TX(ExternalFlash read) / USART1_RX --> RAM(serial recovery)
 static void Hal_DMA2_Config(void);	// RAM --> SPI3_TX(TFTLCD)
 
 /*-------------Module Variables Declaration--------*/
-
+uint8_t DMA_SPI2TxDummy = 0xFF;		// clocked out by SPI2_TX while SPI2_RX receives
 
 /*-------------Module Functions Definition---------*/
 /**
@@ -22,6 +23,7 @@ static void Hal_DMA2_Config(void);	// RAM --> SPI3_TX(TFTLCD)
   */
 void Hal_DMA_Init(void)
 {
+	Hal_DMA1_Config();
 	Hal_DMA2_Config();
 }
 
@@ -58,8 +60,127 @@ void Hal_DMA_SPI3Tx_Stdlib(uint8_t *pBuffer, uint16_t Len)
 	DMA_Cmd(DMA2_Channel2, DISABLE);
 }
 
+/**
+  * @Brief	Start receiving over SPI2 by DMA, returns at once
+  * @Param	pBuffer: pointer to the RAM buffer
+  *			Len: data length(1 -> 65535)
+  * @Retval	None
+  *	@Note	SPI2 clocked by the dummy bytes of DMA1_Channel5, no SPI2 byte read / write until Hal_DMA_SPI2Rx_Stop
+  */
+void Hal_DMA_SPI2Rx_Start(uint8_t *pBuffer, uint16_t Len)
+{
+	DMA_ClearFlag(DMA1_FLAG_GL4 | DMA1_FLAG_GL5);
+	
+	DMA_SetCurrDataCounter(DMA1_Channel4, Len);
+	DMA_SetCurrDataCounter(DMA1_Channel5, Len);
+	DMA1_Channel4->CMAR = (uint32_t)pBuffer;
+	
+	SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+	
+	/* receiving channel first, no byte lost */
+	DMA_Cmd(DMA1_Channel4, ENABLE);
+	DMA_Cmd(DMA1_Channel5, ENABLE);
+}
+
+/**
+  * @Brief	Check the SPI2 DMA receiving is complete
+  * @Param	None
+  * @Retval	1->all bytes received, 0->in progress
+  */
+uint8_t Hal_DMA_SPI2Rx_IsComplete(void)
+{
+	return (DMA_GetFlagStatus(DMA1_FLAG_TC4) == SET);
+}
+
+/**
+  * @Brief	Stop the SPI2 DMA receiving, SPI2 back to byte read / write
+  * @Param	None
+  * @Retval	None
+  */
+void Hal_DMA_SPI2Rx_Stop(void)
+{
+	DMA_Cmd(DMA1_Channel5, DISABLE);
+	DMA_Cmd(DMA1_Channel4, DISABLE);
+	
+	SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+}
+
+/**
+  * @Brief	Start receiving USART1 by DMA into a ring buffer, kept running
+  * @Param	pBuffer: pointer to the RAM ring buffer
+  *			Len: ring buffer length
+  * @Retval	None
+  *	@Note	DMA1_Channel5 taken from SPI2_TX: ExternalFlash read byte by byte from then on(Hal_DMA_SPI2Rx_Start not used).
+  *			Bytes keep coming in while the CPU waits on an EmbeddedFlash erase / program
+  */
+void Hal_DMA_USART1Rx_Start(uint8_t *pBuffer, uint16_t Len)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	
+	DMA_DeInit(DMA1_Channel5);	// DMA1_Channel5 --> USART1_RX
+	
+	DMA_InitStructure.DMA_BufferSize = Len;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)pBuffer;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t) &USART1->DR;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+	DMA_Init(DMA1_Channel5, &DMA_InitStructure);
+	
+	DMA_Cmd(DMA1_Channel5, ENABLE);
+}
+
+/**
+  * @Brief	Get the bytes left before the USART1 DMA wraps in its ring buffer
+  * @Param	None
+  * @Retval	DMA counter(ring buffer length -> 1)
+  */
+uint16_t Hal_DMA_USART1Rx_GetCounter(void)
+{
+	return DMA_GetCurrDataCounter(DMA1_Channel5);
+}
+
 
 /*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	DMA1 config
+  * @Param	None
+  * @Retval	None
+  */
+static void Hal_DMA1_Config(void)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	
+	DMA_DeInit(DMA1_Channel4);	// DMA1_Channel4 --> SPI2_RX
+	DMA_DeInit(DMA1_Channel5);	// DMA1_Channel5 --> SPI2_TX
+	
+	DMA_InitStructure.DMA_BufferSize = 1;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t) &DMA_SPI2TxDummy;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t) &SPI2->DR;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+	DMA_Init(DMA1_Channel4, &DMA_InitStructure);
+	
+	/* the same dummy byte sent for every byte received */
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+	DMA_Init(DMA1_Channel5, &DMA_InitStructure);
+}
+
 /**
   * @Brief	DMA2 config
   * @Param	None
@@ -23,6 +23,7 @@ static void Hal_GPIO_LEDConfig(void);
 
 static void Hal_GPIO_SPI2Config(void);
 static void Hal_GPIO_TFTLCDConfig(void);
+static void Hal_GPIO_KeyConfig(void);
 
 
 /*-------------Module Variables Declaration--------*/
@@ -41,6 +42,7 @@ void Hal_GPIO_Init(void)
 
 	Hal_GPIO_SPI2Config();
 	Hal_GPIO_TFTLCDConfig();
+	Hal_GPIO_KeyConfig();
 
 
 }
@@ -158,3 +160,26 @@ static void Hal_GPIO_TFTLCDConfig(void)
 	
 }
 
+/**
+  * @Brief	Config key pins and parameters
+  * @Param	None
+  * @Retval	None
+  */
+static void Hal_GPIO_KeyConfig(void)
+{
+	GPIO_InitTypeDef GPIO_InitStructure;
+	
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOC, ENABLE);
+	
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
+	GPIO_InitStructure.GPIO_Pin = KEY_DB4_PIN;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(KEY_DB4_PORT, &GPIO_InitStructure);
+	
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
+	GPIO_InitStructure.GPIO_Pin = KEY_DB0_PIN | KEY_DB1_PIN | KEY_DB2_PIN | KEY_DB3_PIN;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(KEY_DB0_PORT, &GPIO_InitStructure);
+}
+
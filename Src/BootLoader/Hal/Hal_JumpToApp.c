@@ -88,6 +88,9 @@ static void Hal_JumpToApp_PeripheralDeInit(void)
 
 	SPI_Cmd(SPI2, DISABLE); 	
 	SPI_Cmd(SPI3, DISABLE);
+	
+	DMA_DeInit(DMA1_Channel4);
+	DMA_DeInit(DMA1_Channel5);	// USART1_RX ring(serial recovery)
 
 	RCC_RTCCLKCmd(DISABLE); 
 	
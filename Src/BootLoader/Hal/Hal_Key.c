@@ -0,0 +1,44 @@
+/****************************************************
+  * @Name	Hal_Key.c
+  * @Brief	ADA20A 16_key capacitor key pad, read once at start(serial recovery key)
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include "stm32f10x.h"
+#include "hal_key.h"
+#include "hal_gpio.h"
+
+
+/*-------------Internal Functions Declaration------*/
+
+
+/*-------------Module Variables Declaration--------*/
+
+
+/*-------------Module Functions Definition---------*/
+/**
+  * @Brief	Get the value of the key pressed
+  * @Param	None
+  * @Retval	KeyValue = DB4 DB3 DB2 DB1 DB0(0->no key pressed, KEY_VALUE_MENU...)
+  *	@Note	The key pad encodes one key at a time
+  */
+uint8_t Hal_Key_GetValue(void)
+{
+	uint8_t KeyValue = 0;
+	
+	KeyValue |= GPIO_ReadInputDataBit(KEY_DB4_PORT, KEY_DB4_PIN) << 4;
+	KeyValue |= GPIO_ReadInputDataBit(KEY_DB3_PORT, KEY_DB3_PIN) << 3;
+	KeyValue |= GPIO_ReadInputDataBit(KEY_DB2_PORT, KEY_DB2_PIN) << 2;
+	KeyValue |= GPIO_ReadInputDataBit(KEY_DB1_PORT, KEY_DB1_PIN) << 1;
+	KeyValue |= GPIO_ReadInputDataBit(KEY_DB0_PORT, KEY_DB0_PIN);
+	
+	return KeyValue;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+
+
+/*-------------Interrupt Functions Definition--------*/
+
+
@@ -0,0 +1,141 @@
+/****************************************************
+  * @Name	Hal_USART.c
+  * @Brief	USART1 --> Debug USART(serial recovery)
+  * @Instruction:
+  *			Started only in serial recovery(Hal_USART_DebugStart), at a baud rate up to 4.5Mbps(APB2 72MHz / 16),
+  *			received by DMA into the ring buffer Buffer_DebugRx[] and taken out by polling,
+  *			transmitted byte by byte(a few handshake bytes per block)
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include "stm32f10x.h"
+#include "hal_usart.h"
+#include "hal_gpio.h"
+#include "hal_dma.h"
+
+/*-------------Internal Functions Declaration------*/
+
+
+/*-------------Module Variables Declaration--------*/
+uint8_t  Buffer_DebugRx[BUFFER_DEBUG_RX_SIZE];
+uint16_t DebugRx_Tail;		// next byte to take out of Buffer_DebugRx[]
+
+/*---Module Call-Back function pointer Definition---*/
+
+
+/*-------------Module Functions Definition---------*/
+/**	!!! For USART: better to set GPIO and USART parameters in the same function, avoid sending error byte(0xE0)
+  * @Brief	Config USART_1 as Debug_USART and start receiving
+  * @Param	BaudRate: baud rate of the Debug_USART
+  * @Retval	None
+  */
+void Hal_USART_DebugStart(uint32_t BaudRate)
+{
+	GPIO_InitTypeDef GPIO_InitStructure;
+	USART_InitTypeDef USART_InitStructure;
+	
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, ENABLE);
+	
+	// USART1_TX -> PA9
+	GPIO_InitStructure.GPIO_Pin = DEBUG_TX_PIN;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(DEBUG_TX_PORT, &GPIO_InitStructure);
+	
+	// USART1_RX -> PA10
+	GPIO_InitStructure.GPIO_Pin = DEBUG_RX_PIN;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(DEBUG_RX_PORT, &GPIO_InitStructure);
+	
+	USART_InitStructure.USART_BaudRate = BaudRate;
+	USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+	USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
+	USART_InitStructure.USART_Parity = USART_Parity_No;
+	USART_InitStructure.USART_StopBits = USART_StopBits_1;
+	USART_InitStructure.USART_WordLength = USART_WordLength_8b;
+	USART_Init(DEBUG_USART_PORT, &USART_InitStructure);
+	
+	// USART1_Rx use DMA1_Channel5, no interrupt
+	DebugRx_Tail = 0;
+	Hal_DMA_USART1Rx_Start(&Buffer_DebugRx[0], BUFFER_DEBUG_RX_SIZE);
+	
+	USART_DMACmd(DEBUG_USART_PORT, USART_DMAReq_Rx, ENABLE);
+	USART_Cmd(DEBUG_USART_PORT, ENABLE);
+}
+
+/**
+  * @Brief	Get the number of bytes received and not taken out yet
+  * @Param	None
+  * @Retval	data length
+  */
+uint16_t Hal_USART_DebugRxLen(void)
+{
+	uint16_t Head;
+	
+	Head = BUFFER_DEBUG_RX_SIZE - Hal_DMA_USART1Rx_GetCounter();
+	
+	if(Head == BUFFER_DEBUG_RX_SIZE)
+	{
+		Head = 0;
+	}
+	
+	return (Head + BUFFER_DEBUG_RX_SIZE - DebugRx_Tail) % BUFFER_DEBUG_RX_SIZE;
+}
+
+/**
+  * @Brief	Take out the bytes received
+  * @Param	pData: pointer to the buffer to store the data
+  *			Len	 : data length(not beyond Hal_USART_DebugRxLen)
+  * @Retval	None
+  */
+void Hal_USART_DebugRxData(uint8_t *pData, uint16_t Len)
+{
+	while(Len)
+	{
+		*pData++ = Buffer_DebugRx[DebugRx_Tail];
+	
+		DebugRx_Tail = (DebugRx_Tail + 1) % BUFFER_DEBUG_RX_SIZE;
+		Len--;
+	}
+}
+
+/**
+  * @Brief	Drop the bytes received and not taken out yet
+  * @Param	None
+  * @Retval	None
+  */
+void Hal_USART_DebugRxFlush(void)
+{
+	DebugRx_Tail = (DebugRx_Tail + Hal_USART_DebugRxLen()) % BUFFER_DEBUG_RX_SIZE;
+}
+
+/**
+  * @Brief	Send data through Debug_USART_Tx(USART1)
+  * @Param	pData: pointer to the Data address
+  *			Len	 : data length
+  * @Retval	None
+  */
+void Hal_USART_DebugDataTx(uint8_t *pData, uint16_t Len)
+{
+	while(Len)
+	{
+		USART_SendData(DEBUG_USART_PORT, *pData);
+	
+		while(USART_GetFlagStatus(DEBUG_USART_PORT, USART_FLAG_TC) == RESET)
+		{
+	
+		}
+		pData++;
+		Len--;
+	}
+}
+
+
+/*-------------Internal Functions Definition--------*/
+
+
+/*-------------Interrupt Functions Definition--------*/
+
+
@@ -7,9 +7,19 @@
 /* Debug_USART_Tx buffer size */
 #define BUFFER_DEBUG_TX_SIZE	512
 
+/* Debug_USART_Rx ring buffer size(serial recovery: a 1K block and the next one coming in) */
+#define BUFFER_DEBUG_RX_SIZE	4096
+
 
 void Hal_DMA_Init(void);
 void Hal_DMA_SPI3Tx_Reg(uint8_t *pBuffer, uint16_t Len);
 void Hal_DMA_SPI3Tx_Stdlib(uint8_t *pBuffer, uint16_t Len);
 
+void 	Hal_DMA_SPI2Rx_Start(uint8_t *pBuffer, uint16_t Len);
+uint8_t Hal_DMA_SPI2Rx_IsComplete(void);
+void 	Hal_DMA_SPI2Rx_Stop(void);
+
+void 	 Hal_DMA_USART1Rx_Start(uint8_t *pBuffer, uint16_t Len);
+uint16_t Hal_DMA_USART1Rx_GetCounter(void);
+
 #endif
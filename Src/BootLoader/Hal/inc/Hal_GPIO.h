@@ -40,6 +40,31 @@
 #define TFTLCD_LEDA_EN_PORT		GPIOC
 #define TFTLCD_LEDA_EN_PIN		GPIO_Pin_10	
 
+/* Key Pin */
+#define KEY_DB0_PORT   	GPIOC
+#define KEY_DB0_PIN    	GPIO_Pin_6
+
+#define KEY_DB1_PORT   	GPIOC
+#define KEY_DB1_PIN    	GPIO_Pin_7
+
+#define KEY_DB2_PORT   	GPIOC
+#define KEY_DB2_PIN    	GPIO_Pin_8
+
+#define KEY_DB3_PORT   	GPIOC
+#define KEY_DB3_PIN    	GPIO_Pin_9
+
+#define KEY_DB4_PORT   	GPIOA
+#define KEY_DB4_PIN    	GPIO_Pin_8
+
+/* Debug USART Pin */
+#define DEBUG_TX_PORT		GPIOA
+#define DEBUG_TX_PIN		GPIO_Pin_9
+
+#define DEBUG_RX_PORT		GPIOA
+#define DEBUG_RX_PIN		GPIO_Pin_10
+
+#define DEBUG_USART_PORT	USART1
+
 
 /*-------------Module Functions Declaration---------*/
 void Hal_GPIO_Init(void);
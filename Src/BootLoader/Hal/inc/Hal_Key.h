@@ -0,0 +1,11 @@
+#ifndef __HAL_KEY_H_
+#define __HAL_KEY_H_
+
+/* KeyValue(DB4 -> DB0) of the keys, as decoded by the AppPart Hal_Key */
+#define KEY_VALUE_NONE		0x00
+#define KEY_VALUE_MENU		0x01	// Key16: Menu/Confirm
+
+
+uint8_t Hal_Key_GetValue(void);
+
+#endif
@@ -23,6 +23,8 @@ typedef enum
 {
 	T_LED,	
 	T_SENSOR_OFFLINE,
+	T_YMODEM,
+	T_KEY_HOLD,
 	
 	T_SUM,
 }en_Timer_ID_t;
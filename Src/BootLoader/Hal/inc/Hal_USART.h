@@ -0,0 +1,11 @@
+#ifndef __HAL_USART_H_
+#define __HAL_USART_H_
+
+void 	 Hal_USART_DebugStart(uint32_t BaudRate);
+
+uint16_t Hal_USART_DebugRxLen(void);
+void 	 Hal_USART_DebugRxData(uint8_t *pData, uint16_t Len);
+void 	 Hal_USART_DebugRxFlush(void);
+void 	 Hal_USART_DebugDataTx(uint8_t *pData, uint16_t Len);
+
+#endif
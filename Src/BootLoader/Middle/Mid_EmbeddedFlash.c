@@ -1,18 +1,32 @@
 /****************************************************
   * @Name	Mid_EmbeddedFlash.c
   * @Brief	
+  * @Instruction:
+  * --> Image writer:
+  *			Mid_EmbeddedFlash_ImageWriteStart	: unlock the Flash write, no page open
+  *			Mid_EmbeddedFlash_ImageWrite		: halfwords put in the page open in Image_PageBuff(read from the Flash as it is opened),
+  *												  the page committed once the data moves on to the next page
+  *			Mid_EmbeddedFlash_ImageWriteEnd		: commit the last page, lock the Flash write
+  *			-------------------------------------------------------------------
+  *			A page committed is left as it is if it holds the data already, erased at most once otherwise
   ***************************************************/
   
 /*-------------Header Files Include-----------------*/
 #include "stm32f10x.h"
 #include "mid_embeddedflash.h"
 #include "hal_embeddedflash.h"
+#include "string.h"
 
 /*-------------Internal Functions Declaration------*/
+static void Mid_EmbeddedFlash_ImageCommit(void);
 
 
 /*-------------Module Variables Declaration--------*/
+/* image writer: page open(0->none) and its data */
+uint32_t Image_PageAddr;
+uint16_t Image_PageBuff[EMBEDDED_FLASH_SECTOR_SIZE / 2];
 
+stu_EmbeddedFlash_Stat_t stu_EmbeddedFlash_Stat;
 
 /*---Module Call-Back function pointer Definition---*/
 
@@ -168,9 +182,167 @@ void Mid_EmbeddedFlash_WriteHalfWord(uint32_t Address, uint16_t *pData, uint16_t
 	
 	Hal_EmbeddedFlash_Lock();	// lock Flash write
 }
+
+/**
+  * @Brief	Start writing an image to EmbeddedFlash
+  * @Param	None
+  * @Retval	None
+  */
+void Mid_EmbeddedFlash_ImageWriteStart(void)
+{
+	Hal_EmbeddedFlash_Unlock();		// unlock Flash write
+	
+	Image_PageAddr = 0;
+	
+	memset(&stu_EmbeddedFlash_Stat, 0, sizeof(stu_EmbeddedFlash_Stat));
+}
+
+/**
+  * @Brief	Write-in halfwords of the image
+  * @Param	Address	  : The address of the halfwords to write-in
+  *			pData	  : point to the Data to write-in
+  *			Number	  : number of halfword to write-in
+  * @Retval	None
+  *	@Note	Address must be multiples of uint 2, the halfwords of a page written in one run(the page is committed as the data moves on)
+  */
+void Mid_EmbeddedFlash_ImageWrite(uint32_t Address, uint16_t *pData, uint16_t Number)
+{
+	uint16_t i;
+	uint32_t PageAddr;
+	
+	/* Check Write-in Address, found invalid Address return: */
+	if(Address < EMBEDDED_FLASH_Address_Base || ((Address + Number * 2) > EMBEDDED_FLASH_Address_Base + 1024 * EMBEDDED_FLASH_SIZE))
+	{
+		return;
+	}
+	
+	for(i=0; i<Number; i++)
+	{
+		PageAddr = Address - ((Address - EMBEDDED_FLASH_Address_Base) % EMBEDDED_FLASH_SECTOR_SIZE);
+		
+		/* data moves on to the next page: commit the page open, open the next one with its Flash data */
+		if(PageAddr != Image_PageAddr)
+		{
+			Mid_EmbeddedFlash_ImageCommit();
+			
+			Image_PageAddr = PageAddr;
+			Mid_EmbeddedFlash_ReadHalfWord_Sequence(Image_PageAddr, &Image_PageBuff[0], EMBEDDED_FLASH_SECTOR_SIZE / 2);
+		}
+		
+		Image_PageBuff[(Address - Image_PageAddr) / 2] = pData[i];
+		
+		Address += 2;
+	}
+}
+
+/**
+  * @Brief	End writing the image: commit the last page
+  * @Param	None
+  * @Retval	None
+  */
+void Mid_EmbeddedFlash_ImageWriteEnd(void)
+{
+	Mid_EmbeddedFlash_ImageCommit();
+	
+	Hal_EmbeddedFlash_Lock();	// lock Flash write
+}
+
+/**
+  * @Brief	Read a byte of the image written
+  * @Param	Address: The address of the byte
+  * @Retval	byte of the page open / of the Flash
+  */
+uint8_t Mid_EmbeddedFlash_ImageReadByte(uint32_t Address)
+{
+	uint16_t Data;
+	
+	if(Image_PageAddr && (Address >= Image_PageAddr) && (Address < (Image_PageAddr + EMBEDDED_FLASH_SECTOR_SIZE)))
+	{
+		Data = Image_PageBuff[(Address - Image_PageAddr) / 2];
+		
+		return (Address % 2) ? (Data >> 8) : (Data & 0xFF);
+	}
+	
+	return *(volatile uint8_t *)Address;
+}
+
+/**
+  * @Brief	Get the statistics of the image writer
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_EmbeddedFlash_GetStat(stu_EmbeddedFlash_Stat_t *pStat)
+{
+	*pStat = stu_EmbeddedFlash_Stat;
+}
 	
 
 /*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Commit the page open of the image to EmbeddedFlash
+  * @Param	None
+  * @Retval	None
+  *	@Note	Left as it is if the Flash holds the data already, 
+  *			erased only if a halfword differs from an unprogrammed one(0xFFFF), then only the halfwords needed programmed
+  */
+static void Mid_EmbeddedFlash_ImageCommit(void)
+{
+	uint16_t i;
+	uint16_t Data;
+	uint8_t  DiffFlag;
+	uint8_t  EraseFlag;
+	
+	if(Image_PageAddr == 0)
+	{
+		return;
+	}
+	
+	DiffFlag = 0;
+	EraseFlag = 0;
+	
+	for(i=0; i<(EMBEDDED_FLASH_SECTOR_SIZE / 2); i++)
+	{
+		Data = Mid_EmbeddedFlash_ReadHalfWord(Image_PageAddr + i * 2);
+		
+		if(Data != Image_PageBuff[i])
+		{
+			DiffFlag = 1;
+			
+			if(Data != 0xFFFF)
+			{
+				EraseFlag = 1;
+				
+				break;
+			}
+		}
+	}
+	
+	if(!DiffFlag)
+	{
+		stu_EmbeddedFlash_Stat.PageSkipNumber++;
+	}
+	else
+	{
+		if(EraseFlag)
+		{
+			Hal_EmbeddedFlash_EarsePage(Image_PageAddr);
+			
+			stu_EmbeddedFlash_Stat.PageEraseNumber++;
+		}
+		
+		for(i=0; i<(EMBEDDED_FLASH_SECTOR_SIZE / 2); i++)
+		{
+			if((Image_PageBuff[i] != 0xFFFF) && (Mid_EmbeddedFlash_ReadHalfWord(Image_PageAddr + i * 2) != Image_PageBuff[i]))
+			{
+				Hal_EmbeddedFlash_ProgramHalfWord(Image_PageAddr + i * 2, Image_PageBuff[i]);
+				
+				stu_EmbeddedFlash_Stat.ProgramHalfWordNumber++;
+			}
+		}
+	}
+	
+	Image_PageAddr = 0;
+}
 
 
 /*-------------Interrupt Functions Definition--------*/
@@ -9,6 +9,7 @@
 #include "stm32f10x.h"
 #include "mid_flash.h"
 #include "hal_spi.h"
+#include "hal_dma.h"
 
 
 /*-------------Internal Functions Declaration------*/
@@ -81,6 +82,40 @@ void Mid_Flash_ReadData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
 	Hal_SPI2_CSDriver(1);
 }
 
+/**
+  * @Brief	Start reading data from Flash chip by DMA, returns once the command is sent
+  * @Param	pBuffer: pointer to the address of stored data 
+  * 		Addr: the starting address of data (3 bytes)
+  * 		Num: the number of bytes to read(1 -> 65535)
+  * @Retval	None
+  *	@Note	Ended by Mid_Flash_ReadDataWait, no other Flash access in between
+  */
+void Mid_Flash_ReadDataStart(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
+{
+	Hal_SPI2_CSDriver(0);
+	
+	Hal_SPI2_ReadWriteByte(READ_DATA);
+	Hal_SPI2_ReadWriteByte((uint8_t)(Addr >> 16));	// High 8 bit address
+	Hal_SPI2_ReadWriteByte((uint8_t)(Addr >> 8));	// Middle 8 bit address
+	Hal_SPI2_ReadWriteByte((uint8_t)(Addr));		// Low 8 bit address
+	
+	Hal_DMA_SPI2Rx_Start(pBuffer, Num);
+}
+
+/**
+  * @Brief	Wait for the data read by Mid_Flash_ReadDataStart
+  * @Param	None
+  * @Retval	None
+  */
+void Mid_Flash_ReadDataWait(void)
+{
+	while(!Hal_DMA_SPI2Rx_IsComplete());
+	
+	Hal_DMA_SPI2Rx_Stop();
+	
+	Hal_SPI2_CSDriver(1);
+}
+
 /**
   * @Brief	Write Page data to Flash
   * @Param	pBuffer: pointer to the address of data to write in
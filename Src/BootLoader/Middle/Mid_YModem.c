@@ -0,0 +1,343 @@
+/****************************************************
+  * @Name	Mid_YModem.c
+  * @Brief	YMODEM(1K, CRC16) receiver over the Debug_USART(serial recovery)
+  * @Instruction:
+  *			Mid_YModem_Start	: 'C' sent, waiting for the file header(block 0: name, size in decimal)
+  *	 (Poll) Mid_YModem_Pro		: bytes taken out of the receiving ring, one block checked(Seq, ~Seq, CRC16) per event,
+  *								  the data block acknowledged before it is handed over:
+  *								  the sender puts the next block on the line while the data is programmed
+  *			-------------------------------------------------------------------
+  *			Block repeated(ACK lost) acknowledged again and dropped, block damaged requested again(NAK),
+  *			first EOT answered by NAK, the second by ACK, then the header ending the batch requested
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include "stm32f10x.h"
+#include "mid_ymodem.h"
+#include "hal_usart.h"
+#include "hal_timer.h"
+#include "crc16.h"
+
+/*-------------Internal Functions Declaration------*/
+static void 	Mid_YModem_SendByte(uint8_t Data);
+static uint8_t 	Mid_YModem_Header(void);
+static void 	Mid_YModem_TimeoutHandler(void);
+
+
+/*-------------Module Variables Declaration--------*/
+uint8_t  YModem_State;				// en_YModem_State_t
+uint8_t  YModem_Block[YMODEM_BLOCK_HEAD + YMODEM_BLOCK_SIZE_1K + YMODEM_BLOCK_TAIL];
+uint16_t YModem_BlockPos;			// bytes of the block received(0->waiting for SOH / STX / EOT / CAN)
+uint16_t YModem_BlockLen;			// whole block length
+uint8_t  YModem_Seq;				// Seq of the next data block
+uint8_t  YModem_ErrorCount;
+uint8_t  YModem_EOTCount;
+uint8_t  YModem_CANCount;
+uint32_t YModem_FileSize;
+
+volatile uint8_t YModem_TimeoutFlag;
+
+
+/*-------------Module Functions Definition---------*/
+/**
+  * @Brief	Start waiting for a file
+  * @Param	None
+  * @Retval	None
+  *	@Note	Hal_USART_DebugStart called before
+  */
+void Mid_YModem_Start(void)
+{
+	YModem_State = YMODEM_STA_WAIT_FILE;
+	YModem_BlockPos = 0;
+	YModem_ErrorCount = 0;
+	YModem_CANCount = 0;
+	YModem_FileSize = 0;
+	YModem_TimeoutFlag = 0;
+	
+	Hal_Timer_Creat(T_YMODEM, Mid_YModem_TimeoutHandler, YMODEM_TIMEOUT, T_STATE_START);
+	
+	Hal_USART_DebugRxFlush();
+	Mid_YModem_SendByte(YMODEM_CRC);
+}
+
+/**
+  * @Brief	Polling of the receiver
+  * @Param	ppData: point to the pointer to store the address of the data block(YMODEM_EVT_DATA)
+  *			pLen  : point to the buffer to store the data length(YMODEM_EVT_DATA, padding of the last block included)
+  * @Retval	en_YModem_Event_t
+  *	@Note	The data block is kept until the next call
+  */
+uint8_t Mid_YModem_Pro(uint8_t **ppData, uint16_t *pLen)
+{
+	uint16_t Len;
+	uint16_t Size;
+	uint16_t CRC16;
+	uint8_t  Seq;
+	
+	if(YModem_State == YMODEM_STA_IDLE)
+	{
+		return YMODEM_EVT_NONE;
+	}
+	
+	/* no byte for a while: block requested again */
+	if(YModem_TimeoutFlag)
+	{
+		YModem_TimeoutFlag = 0;
+		YModem_BlockPos = 0;
+	
+		if(YModem_State == YMODEM_STA_WAIT_FILE)
+		{
+			Mid_YModem_SendByte(YMODEM_CRC);
+		}
+		else if(YModem_State == YMODEM_STA_WAIT_END)
+		{
+			/* sender ended without the batch header */
+			YModem_State = YMODEM_STA_IDLE;
+	
+			return YMODEM_EVT_END;
+		}
+		else if(++YModem_ErrorCount > YMODEM_ERROR_MAX)
+		{
+			Mid_YModem_Cancel();
+	
+			return YMODEM_EVT_ABORT;
+		}
+		else
+		{
+			Mid_YModem_SendByte(YMODEM_NAK);
+		}
+	}
+	
+	while((Len = Hal_USART_DebugRxLen()) != 0)
+	{
+		Hal_Timer_Reset(T_YMODEM, T_STATE_START);
+	
+		/* first byte: block / EOT / CAN */
+		if(YModem_BlockPos == 0)
+		{
+			Hal_USART_DebugRxData(&YModem_Block[0], 1);
+	
+			if(YModem_Block[0] == YMODEM_CAN)
+			{
+				if(++YModem_CANCount >= 2)
+				{
+					YModem_State = YMODEM_STA_IDLE;
+					Hal_Timer_Reset(T_YMODEM, T_STATE_STOP);
+	
+					return YMODEM_EVT_ABORT;
+				}
+	
+				continue;
+			}
+	
+			YModem_CANCount = 0;
+	
+			if((YModem_Block[0] == YMODEM_SOH) || (YModem_Block[0] == YMODEM_STX))
+			{
+				YModem_BlockLen = YMODEM_BLOCK_HEAD + YMODEM_BLOCK_TAIL +
+								  ((YModem_Block[0] == YMODEM_SOH) ? YMODEM_BLOCK_SIZE_128 : YMODEM_BLOCK_SIZE_1K);
+				YModem_BlockPos = 1;
+			}
+			else if((YModem_Block[0] == YMODEM_EOT) && (YModem_State != YMODEM_STA_WAIT_FILE))
+			{
+				/* first EOT checked by asking for it again */
+				if((YModem_State == YMODEM_STA_DATA) && (++YModem_EOTCount < 2))
+				{
+					Mid_YModem_SendByte(YMODEM_NAK);
+				}
+				else
+				{
+					YModem_State = YMODEM_STA_WAIT_END;
+	
+					Mid_YModem_SendByte(YMODEM_ACK);
+					Mid_YModem_SendByte(YMODEM_CRC);
+				}
+			}
+	
+			/* anything else: line noise between the blocks */
+			continue;
+		}
+	
+		if(Len > (YModem_BlockLen - YModem_BlockPos))
+		{
+			Len = YModem_BlockLen - YModem_BlockPos;
+		}
+	
+		Hal_USART_DebugRxData(&YModem_Block[YModem_BlockPos], Len);
+		YModem_BlockPos += Len;
+	
+		if(YModem_BlockPos < YModem_BlockLen)
+		{
+			continue;
+		}
+	
+		/* whole block */
+		YModem_BlockPos = 0;
+	
+		Size = YModem_BlockLen - YMODEM_BLOCK_HEAD - YMODEM_BLOCK_TAIL;
+		Seq = YModem_Block[1];
+		CRC16 = (YModem_Block[YMODEM_BLOCK_HEAD + Size] << 8) | YModem_Block[YMODEM_BLOCK_HEAD + Size + 1];
+	
+		if(((uint8_t)(Seq ^ YModem_Block[2]) != 0xFF) || (Mid_CRC16_XModem(&YModem_Block[YMODEM_BLOCK_HEAD], Size) != CRC16))
+		{
+			if(++YModem_ErrorCount > YMODEM_ERROR_MAX)
+			{
+				Mid_YModem_Cancel();
+	
+				return YMODEM_EVT_ABORT;
+			}
+	
+			/* rest of the block dropped, sent again from its start */
+			Hal_USART_DebugRxFlush();
+			Mid_YModem_SendByte(YMODEM_NAK);
+	
+			continue;
+		}
+	
+		YModem_ErrorCount = 0;
+	
+		/* file header / header ending the batch */
+		if(YModem_State != YMODEM_STA_DATA)
+		{
+			if(Seq != 0)
+			{
+				continue;
+			}
+	
+			Mid_YModem_SendByte(YMODEM_ACK);
+	
+			if(YModem_State == YMODEM_STA_WAIT_END)
+			{
+				YModem_State = YMODEM_STA_IDLE;
+				Hal_Timer_Reset(T_YMODEM, T_STATE_STOP);
+	
+				return YMODEM_EVT_END;
+			}
+	
+			/* empty header: nothing sent, still waiting */
+			if(Mid_YModem_Header() == 0)
+			{
+				continue;
+			}
+	
+			YModem_State = YMODEM_STA_DATA;
+			YModem_Seq = 1;
+			YModem_EOTCount = 0;
+	
+			Mid_YModem_SendByte(YMODEM_CRC);
+	
+			return YMODEM_EVT_FILE;
+		}
+	
+		if(Seq == YModem_Seq)
+		{
+			/* acknowledged at once: next block received by DMA while this one is programmed */
+			Mid_YModem_SendByte(YMODEM_ACK);
+	
+			YModem_Seq++;
+	
+			*ppData = &YModem_Block[YMODEM_BLOCK_HEAD];
+			*pLen = Size;
+	
+			return YMODEM_EVT_DATA;
+		}
+	
+		/* ACK lost: block repeated / file header repeated */
+		if((uint8_t)(Seq + 1) == YModem_Seq)
+		{
+			Mid_YModem_SendByte(YMODEM_ACK);
+	
+			if(Seq == 0)
+			{
+				Mid_YModem_SendByte(YMODEM_CRC);
+			}
+	
+			continue;
+		}
+	
+		/* block lost: the file can not be completed */
+		Mid_YModem_Cancel();
+	
+		return YMODEM_EVT_ABORT;
+	}
+	
+	return YMODEM_EVT_NONE;
+}
+
+/**
+  * @Brief	Cancel the transfer(CAN CAN sent), receiver stopped
+  * @Param	None
+  * @Retval	None
+  */
+void Mid_YModem_Cancel(void)
+{
+	YModem_State = YMODEM_STA_IDLE;
+	Hal_Timer_Reset(T_YMODEM, T_STATE_STOP);
+	
+	Mid_YModem_SendByte(YMODEM_CAN);
+	Mid_YModem_SendByte(YMODEM_CAN);
+}
+
+/**
+  * @Brief	Get the size of the file in its header
+  * @Param	None
+  * @Retval	file size(byte)
+  */
+uint32_t Mid_YModem_GetFileSize(void)
+{
+	return YModem_FileSize;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Send a control byte to the sender
+  * @Param	Data: control byte
+  * @Retval	None
+  */
+static void Mid_YModem_SendByte(uint8_t Data)
+{
+	Hal_USART_DebugDataTx(&Data, 1);
+}
+
+/**
+  * @Brief	Take the file size out of the file header(block 0: name '\0' size ...)
+  * @Param	None
+  * @Retval	1->file header, 0->empty header(batch ended)
+  */
+static uint8_t Mid_YModem_Header(void)
+{
+	uint16_t i;
+	
+	if(YModem_Block[YMODEM_BLOCK_HEAD] == 0)
+	{
+		return 0;
+	}
+	
+	/* name skipped */
+	for(i=YMODEM_BLOCK_HEAD; (i < YMODEM_BLOCK_HEAD + YMODEM_BLOCK_SIZE_128) && (YModem_Block[i] != 0); i++);
+	
+	YModem_FileSize = 0;
+	
+	for(i++; (i < YMODEM_BLOCK_HEAD + YMODEM_BLOCK_SIZE_128) && (YModem_Block[i] >= '0') && (YModem_Block[i] <= '9'); i++)
+	{
+		YModem_FileSize = YModem_FileSize * 10 + (YModem_Block[i] - '0');
+	}
+	
+	return 1;
+}
+
+/**
+  * @Brief	Timer handler: no byte received for YMODEM_TIMEOUT
+  * @Param	None
+  * @Retval	None
+  */
+static void Mid_YModem_TimeoutHandler(void)
+{
+	YModem_TimeoutFlag = 1;
+}
+
+
+/*-------------Interrupt Functions Definition--------*/
+
+
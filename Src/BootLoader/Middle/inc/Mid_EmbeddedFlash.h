@@ -15,10 +15,25 @@
 /* Base-address of the embedded Flash */
 #define EMBEDDED_FLASH_Address_Base		0x08000000
 
+/* EmbeddedFlash image writer statistics */
+typedef struct
+{
+	uint32_t PageEraseNumber;			// pages erased
+	uint32_t PageSkipNumber;			// pages already holding the data, left as they are
+	uint32_t ProgramHalfWordNumber;		// halfwords programmed(0xFFFF not programmed over an erased page)
+	
+}stu_EmbeddedFlash_Stat_t;
+
 uint16_t 	Mid_EmbeddedFlash_ReadHalfWord(uint32_t Address);
 void 		Mid_EmbeddedFlash_WriteHalfWord_NoCheck(uint32_t Address, uint16_t *pData, uint16_t Number);
 void 		Mid_EmbeddedFlash_ReadHalfWord_Sequence(uint32_t Address, uint16_t *pData, uint16_t Number);
 void 		Mid_EmbeddedFlash_WriteHalfWord(uint32_t Address, uint16_t *pData, uint16_t Number);
 
+void 		Mid_EmbeddedFlash_ImageWriteStart(void);
+void 		Mid_EmbeddedFlash_ImageWrite(uint32_t Address, uint16_t *pData, uint16_t Number);
+void 		Mid_EmbeddedFlash_ImageWriteEnd(void);
+uint8_t 	Mid_EmbeddedFlash_ImageReadByte(uint32_t Address);
+void 		Mid_EmbeddedFlash_GetStat(stu_EmbeddedFlash_Stat_t *pStat);
+
 
 #endif
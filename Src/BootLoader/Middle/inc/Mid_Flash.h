@@ -67,6 +67,8 @@ void Mid_Flash_WriteSector(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
 void Mid_Flash_EraseSector(uint32_t Addr);
 
 void Mid_Flash_ReadData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
+void Mid_Flash_ReadDataStart(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
+void Mid_Flash_ReadDataWait(void);
 void Mid_Flash_WriteData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
 
 #endif
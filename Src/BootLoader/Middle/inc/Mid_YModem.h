@@ -0,0 +1,50 @@
+#ifndef __MID_YMODEM_H_
+#define __MID_YMODEM_H_
+
+/* YMODEM control bytes */
+#define YMODEM_SOH				0x01	// 128 byte block
+#define YMODEM_STX				0x02	// 1024 byte block
+#define YMODEM_EOT				0x04
+#define YMODEM_ACK				0x06
+#define YMODEM_NAK				0x15
+#define YMODEM_CAN				0x18
+#define YMODEM_CRC				0x43	// 'C': CRC16 blocks requested
+
+/* Block: SOH/STX, Seq, ~Seq, data, CRC16(high byte first) */
+#define YMODEM_BLOCK_SIZE_128	128
+#define YMODEM_BLOCK_SIZE_1K	1024
+#define YMODEM_BLOCK_HEAD		3
+#define YMODEM_BLOCK_TAIL		2
+
+/* no byte for 1s(20000 * 50us): 'C' sent again / block requested again, the transfer dropped after YMODEM_ERROR_MAX in a row */
+#define YMODEM_TIMEOUT			20000
+#define YMODEM_ERROR_MAX		10
+
+/* Mid_YModem_Pro event */
+typedef enum
+{
+	YMODEM_EVT_NONE = 0,
+	YMODEM_EVT_FILE,			// file header received: Mid_YModem_GetFileSize
+	YMODEM_EVT_DATA,			// data block received and acknowledged
+	YMODEM_EVT_END,				// file ended(EOT, then the batch ended)
+	YMODEM_EVT_ABORT,			// cancelled by the sender / too many errors
+	
+}en_YModem_Event_t;
+
+/* Receiver state */
+typedef enum
+{
+	YMODEM_STA_IDLE = 0,
+	YMODEM_STA_WAIT_FILE,		// 'C' sent once per timeout until a file header comes
+	YMODEM_STA_DATA,			// data blocks until EOT
+	YMODEM_STA_WAIT_END,		// EOT acknowledged, waiting for the header ending the batch
+	
+}en_YModem_State_t;
+
+
+void 	 Mid_YModem_Start(void);
+uint8_t  Mid_YModem_Pro(uint8_t **ppData, uint16_t *pLen);
+void 	 Mid_YModem_Cancel(void);
+uint32_t Mid_YModem_GetFileSize(void);
+
+#endif
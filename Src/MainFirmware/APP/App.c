@@ -43,7 +43,9 @@
 #include "mid_tftlcd.h"
 #include "mid_lora.h"
 #include "mid_wifi.h"
+#include "mid_clock.h"
 #include "mid_eeprom.h"
+#include "mid_flash.h"
 #include "mid_firmware.h"
 #include "tftlcd_icon.h"
 #include "device.h"
@@ -98,6 +100,7 @@ static void 	App_TerminalMode_DisarmHandler(void);
 /*-------------Module Variables Declaration--------*/
 uint16_t TimeoutCounter_ReturnDesktop;
 uint16_t TimeoutCounter_ScreenSleep;
+uint16_t TimeoutCounter_BootConfirm;
 uint8_t ScreenState;	// 0->screen sleep; 1->screen on
 
 /* General-Menu structure collections: */
@@ -188,6 +191,7 @@ void App_Init(void)
 	
 	TimeoutCounter_ReturnDesktop = 0;
 	TimeoutCounter_ScreenSleep = 0;
+	TimeoutCounter_BootConfirm = 0;
 	
 	App_ScreenControl(1);	// turn on the Screen
 	
@@ -200,6 +204,24 @@ void App_Init(void)
   */
 void App_Pro(void)
 {
+	uint8_t Version[2];
+	
+	/* Running 30s, Firmware confirmed to the BootLoader(no rollback), version kept as the Firmware running(rolled back): */
+	if(TimeoutCounter_BootConfirm < TIMEOUT_COUNTER_BOOT_CONFIRM)
+	{
+		TimeoutCounter_BootConfirm++;
+		
+		if((TimeoutCounter_BootConfirm == TIMEOUT_COUNTER_BOOT_CONFIRM) && 
+		   Mid_Firmware_BootConfirm(&Mid_Flash_ReadData, &Mid_Flash_WriteSector, &Version[0]) &&
+		   ((Version[0] != Device_Get_SystemPara_FirmwareVersion(0)) || (Version[1] != Device_Get_SystemPara_FirmwareVersion(1))))
+		{
+			Device_Set_SystemPara_FirmwareVersion(0, Version[0]);
+			Device_Set_SystemPara_FirmwareVersion(1, Version[1]);
+			
+			Mid_EEPROM_PageWrite(EEPROM_ADDRESS_SYSTEMPARA_OFFSET, (uint8_t *)(&stu_SystemPara), sizeof(stu_SystemPara));
+		}
+	}
+	
 	/* Idle 20s, return to the Desktop Menu: */
 	if((pMenu->MenuDepth == MENU_SUB_MENU) || (pMenu->MenuDepth == MENU_SUB_1) || (pMenu->MenuDepth == MENU_SUB_2))
 	{
@@ -260,12 +282,12 @@ void App_Terminal_ModeChange(uint8_t Zone, en_Terminal_WorkMode_t WorkMode, en_T
 		/* Host send alarm command */
 		if(Zone == 0xFF)
 		{
-			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_ALARM_SOS, 0xFF);
+			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_ALARM_SOS, 0xFF, MQTT_EVENT_CLASS_ALARM);
 		}
 		/* Detector(Sensor) send alarm command */
 		else
 		{
-			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_ALARM, Zone);
+			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_ALARM, Zone, MQTT_EVENT_CLASS_ALARM);
 		}
 	}
 	else if(WorkMode == TERMINAL_WORK_MODE_DISARM)
@@ -284,19 +306,19 @@ void App_Terminal_ModeChange(uint8_t Zone, en_Terminal_WorkMode_t WorkMode, en_T
 		{
 			case TERMINAL_CMD_SOURCE_KEY:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DISARM_BY_HOST, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DISARM_BY_HOST, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
 			case TERMINAL_CMD_SOURCE_REMOTE:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DISARM_BY_REMOTE, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DISARM_BY_REMOTE, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
 			case TERMINAL_CMD_SOURCE_SERVER:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DISARM_BY_SERVER, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DISARM_BY_SERVER, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
@@ -309,19 +331,19 @@ void App_Terminal_ModeChange(uint8_t Zone, en_Terminal_WorkMode_t WorkMode, en_T
 		{
 			case TERMINAL_CMD_SOURCE_KEY:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOMEARM_BY_HOST, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOMEARM_BY_HOST, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
 			case TERMINAL_CMD_SOURCE_REMOTE:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOMEARM_BY_REMOTE, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOMEARM_BY_REMOTE, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
 			case TERMINAL_CMD_SOURCE_SERVER:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOMEARM_BY_SERVER, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOMEARM_BY_SERVER, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
@@ -334,19 +356,19 @@ void App_Terminal_ModeChange(uint8_t Zone, en_Terminal_WorkMode_t WorkMode, en_T
 		{
 			case TERMINAL_CMD_SOURCE_KEY:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_AWAYARM_BY_HOST, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_AWAYARM_BY_HOST, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
 			case TERMINAL_CMD_SOURCE_REMOTE:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_AWAYARM_BY_REMOTE, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_AWAYARM_BY_REMOTE, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
 			case TERMINAL_CMD_SOURCE_SERVER:
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_AWAYARM_BY_SERVER, Zone);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_AWAYARM_BY_SERVER, Zone, MQTT_EVENT_CLASS_NORMAL);
 			}
 			break;
 			
@@ -401,7 +423,7 @@ void App_SensorOffline_Handler(void)
 				
 				if(Device_Get_SensorPara_Sensor_Type(i) != SENSOR_TYPE_REMOTE)
 				{
-					MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_OFFLINE, i);
+					MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_OFFLINE, i, MQTT_EVENT_CLASS_NORMAL);
 				}
 			}
 		}
@@ -483,7 +505,7 @@ static void App_GeneralMenu_DesktopHandler(void)
 		Mid_TFTLCD_ScreenClear();
 		Mid_TFTLCD_DisplayTH(COOR_ICON_TEMP_X, COOR_ICON_TEMP_Y, COOR_ICON_HUM_X, COOR_ICON_HUM_Y);
 		Mid_TFTLCD_DisplayPowerState(COOR_ICON_AC_X, COOR_ICON_AC_Y, COOR_ICON_BAT_X, COOR_ICON_BAT_Y);
-		Mid_TFTLCD_ShowSystemTime(&SystemTime[0]);
+		Mid_TFTLCD_ShowSystemTime(Mid_Clock_GetDateTime());
 		Mid_TFTLCD_DisplayWiFiSignal();
 		Mid_TFTLCD_DisplayMQTTConnection();
 			
@@ -492,7 +514,7 @@ static void App_GeneralMenu_DesktopHandler(void)
 	
 	Mid_TFTLCD_DisplayTH(COOR_ICON_TEMP_X, COOR_ICON_TEMP_Y, COOR_ICON_HUM_X, COOR_ICON_HUM_Y);
 	Mid_TFTLCD_DisplayPowerState(COOR_ICON_AC_X, COOR_ICON_AC_Y, COOR_ICON_BAT_X, COOR_ICON_BAT_Y);
-	Mid_TFTLCD_ShowSystemTime(&SystemTime[0]);
+	Mid_TFTLCD_ShowSystemTime(Mid_Clock_GetDateTime());
 	Mid_TFTLCD_DisplayWiFiSignal();
 	Mid_TFTLCD_DisplayMQTTConnection();
 	
@@ -1211,7 +1233,7 @@ static void App_GeneralMenu_FirmwareUpdateHandler(void)
 							Mid_TFTLCD_ShowString(COOR_MENU_FIRMWARE_UPDATE_PERCENTAGE_X, COOR_MENU_FIRMWARE_UPDATE_PERCENTAGE_Y, "000.0%", LCD_FONT_COLOR, LCD_BACK_COLOR, 48, 0);
 							
 							/* Start downloading Firmware */
-							Mid_Firmware_StartDownload();
+							Mid_Firmware_StartDownload(&Mid_Flash_ImageWriteStart, &Mid_Flash_ReadData, &Mid_Flash_WriteSector, &Mid_Flash_EraseSector);
 							
 							UpdateFlag = 1;
 							Percentage = 0;
@@ -3910,7 +3932,7 @@ static void App_TerminalMode_AwayArmHandler(void)
 						}
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 					else if(FunctionCode == LORA_COM_DOORCLOSE)
 					{
@@ -3922,7 +3944,7 @@ static void App_TerminalMode_AwayArmHandler(void)
 						PromptDisplayFlag = 1;
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_CLOSE, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_CLOSE, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 					else if(FunctionCode == LORA_COM_BAT_LOW)
 					{
@@ -3934,7 +3956,7 @@ static void App_TerminalMode_AwayArmHandler(void)
 						PromptDisplayFlag = 1;
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_BATLOW, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_BATLOW, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 				}
 			}
@@ -4051,7 +4073,7 @@ static void App_TerminalMode_HomeArmHandler(void)
 						}
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 					else if(FunctionCode == LORA_COM_DOORCLOSE)
 					{
@@ -4063,7 +4085,7 @@ static void App_TerminalMode_HomeArmHandler(void)
 						PromptDisplayFlag = 1;
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_CLOSE, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_CLOSE, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 					else if(FunctionCode == LORA_COM_BAT_LOW)
 					{
@@ -4075,7 +4097,7 @@ static void App_TerminalMode_HomeArmHandler(void)
 						PromptDisplayFlag = 1;
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_BATLOW, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_BATLOW, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 				}
 			}
@@ -4154,7 +4176,7 @@ static void App_TerminalMode_AlarmingHandler(void)
 						}
 
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 				}
 			}
@@ -4253,7 +4275,7 @@ static void App_TerminalMode_DisarmHandler(void)
 						}
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 					else if(FunctionCode == LORA_COM_DOORCLOSE)
 					{
@@ -4265,7 +4287,7 @@ static void App_TerminalMode_DisarmHandler(void)
 						PromptDisplayFlag = 1;
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_CLOSE, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_CLOSE, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 					else if(FunctionCode == LORA_COM_BAT_LOW)
 					{
@@ -4277,7 +4299,7 @@ static void App_TerminalMode_DisarmHandler(void)
 						PromptDisplayFlag = 1;
 						
 						/* queue-in EventUpload MQTT message */
-						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_BATLOW, SensorIndex);
+						MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_BATLOW, SensorIndex, MQTT_EVENT_CLASS_NORMAL);
 					}
 				}
 			}
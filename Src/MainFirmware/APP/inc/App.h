@@ -11,6 +11,8 @@
 #define TIMEOUT_COUNTER_RETURN_DESKTOP	2000
 /* Auto sleep if no action */
 #define TIMEOUT_COUNTER_SCREEN_SLEEP		3000
+/* Firmware confirmed to the BootLoader once running */
+#define TIMEOUT_COUNTER_BOOT_CONFIRM		3000
 
 /* Menu-EnterPin Coordinates Define: */
 #define COOR_MENU_ENTERPIN_TITLE_X			90
@@ -163,10 +163,10 @@ void Hal_USART_LoraDataTx(uint8_t *pData, uint8_t Len)
 /**
   * @Brief	Send data through WiFi_USART_Tx(USART3) to the esp8266 WiFi-module 
   * @Param	pData: pointer to the Data address
-			Len	 : data length(0-255)
+			Len	 : data length(0-65535)
   * @Retval	None
   */
-void Hal_USART_WiFiDataTx(uint8_t *pData, uint8_t Len)
+void Hal_USART_WiFiDataTx(uint8_t *pData, uint16_t Len)
 {
 	while(Len)
 	{
@@ -21,7 +21,7 @@ void Hal_USART_DebugStringQueueIn(const char pData[]);
 void Hal_USART_DebugDataQueueIn(uint8_t *pData, uint16_t Len);
 
 void Hal_USART_LoraDataTx(uint8_t *pData, uint8_t Len);
-void Hal_USART_WiFiDataTx(uint8_t *pData, uint8_t Len);
+void Hal_USART_WiFiDataTx(uint8_t *pData, uint16_t Len);
 void Hal_USART_GSMDataTx(uint8_t *pData, uint8_t Len);
 void Hal_USART_GSMStringTx(uint8_t *pData);
 
@@ -29,6 +29,43 @@
   *			0x29 : Get SystemTime				DataFrameID	: 1 byte
   *												UTC-Offset	: 2 byte(highest bit: 1->positive, 0->negative)
   *	---------------------------------------------------------------------------------------------------------
+  *			0x53 : Link telemetry				Payload length	: 2 byte
+  *												RSSI Last/Min/Mean/Max	: 4 byte(signed, dBm)
+  *												SampleNumber	: 1 byte
+  *												Channel			: 1 byte
+  *												AP/MQTT drops	: 2 byte + 2 byte
+  *	---------------------------------------------------------------------------------------------------------
+  *			0x55 : State snapshot(retained)	Payload length	: 2 byte
+  *												Version			: 1 byte(MQTT_STATE_VERSION)
+  *												StateSeq		: 2 byte(sequence of the last delta, the next delta carries StateSeq + 1)
+  *												FirmwareVersion	: 2 byte
+  *												FieldNumber		: 1 byte(MQTT_STATE_FIELD_SUM)
+  *												Field			: 1 byte per field, in en_MQTTStateField_t order
+  *												(published again MQTT_STATE_RETAIN_DELAY after the last delta: retained fields up to date)
+  *	---------------------------------------------------------------------------------------------------------
+  *			0x56 : State delta					Payload length	: 2 byte
+  *												Version			: 1 byte(MQTT_STATE_VERSION)
+  *												StateSeq		: 2 byte(gap->request the snapshot again, PROTOCOL_SERVER_REQUEST_STATE_SNAPSHOT)
+  *												FieldNumber		: 1 byte
+  *												FieldID			: 1 byte	\ repeated FieldNumber times
+  *												Field			: 1 byte	/
+  *	---------------------------------------------------------------------------------------------------------
+  *			0x52 : EventUpload batch			Payload length	: 2 byte
+  *												RecordNumber	: 1 byte
+  *												RecordLength	: 1 byte	\ repeated RecordNumber times,
+  *												Record			: N byte	/ Record is the payload of a single 0x51 EventUpload
+  *	---------------------------------------------------------------------------------------------------------
+  *			0x54 : EventUpload compact			Payload length	: 2 byte
+  *												Version			: 1 byte(MQTT_EVENT_COMPACT_VERSION)
+  *												RecordNumber	: 1 byte
+  *												RecordLength	: 1 byte	\ repeated RecordNumber times
+  *												Record			: N byte	/
+  *												-> Epoch		: 4 byte(UNIX TimeStamp, UTC, big-endian, 0->SystemTime not received yet)
+  *												-> EventCode	: 1 byte(en_Terminal_UpEvent_t)
+  *												-> Zone			: 1 byte(0xFF->Terminal / Server, 1-20->Sensor)
+  *												-> Flags		: 1 byte(bit0: SensorType follows)
+  *												-> SensorType	: 1 byte(optional)
+  *	---------------------------------------------------------------------------------------------------------
   *	
   *	
   *	Server-->Terminal:
@@ -87,6 +124,11 @@
   *	AA 		00 05 			21 			00 00 			  	24 			55
   *	Head	Datalength		Command		Payload length		XOR value	Tail
   *  
+  *	-> Compact EventUpload from Terminal:
+  *	AwayArm:(Terminal Key, 2025-05-25-15:10)
+  *	AA		00 0D			54			00 0A			  01			01				07				68 33 6B 08		0D			FF		00		9E			55
+  *	Head	Datalength		Command		Payload length	  Version		RecordNumber	RecordLength	Epoch			EventCode	Zone	Flags	XOR value	Tail
+  *	
   *	-> Response from Terminal:
   *	Host Info:
   *	AA		00 16			51			00 11			  00 64 				00 00 00 		38 FF D9 05 34 42 36 36 36 44 18 43 	76 			55
@@ -107,6 +149,10 @@
   *	AA		00 18			51			00 13			  02			02			44 65 76 69 63 65 2D 30 30 32 00 00 00 00 00 00 	01 				7C			55
   *	Head	Datalength		Command		Payload length	  SensorID		SensorType	D  e  v  i  c  e  _  0  0  2 (SensorName)			SensorArmType	XOR value	Tail
   *	
+  *	Get All Devices Info:(NextIndex: start index of the following dataframe, FF->last dataframe)
+  *	AA		00 xx			51			00 xx			  0C			02				01 01 44 65 76 69 63 65 2D 30 30 31 00 00 00 00 00 00 01 	02 02 ...	xx			55
+  *	Head	Datalength		Command		Payload length	  NextIndex		RecordNumber	Device info record(same as Get Device_N Info) 				...			XOR value	Tail
+  *	
   *	Server Change WorkMode Successfully:
   *	AA		00 0B			51			00 06			  53 65 74 20 4F 4B 	3A 			55
   *	Head	Datalength		Command		Payload length	  S  e  t     O  K		XOR value	Tail
@@ -147,6 +193,15 @@
   *		PROTOCOL_SERVER_REQUEST_SET_WORKMODE_ALARM:		AA0006500001194E55
   *		AA 00 06 50 00 01 19 4E 55
   *		
+  *		PROTOCOL_SERVER_REQUEST_ALL_DEVICE_INFO:		AA00075000021A004F55(argument: start Device index 0x00)
+  *		AA 00 07 50 00 02 1A 00 4F 55
+  *		
+  *		PROTOCOL_SERVER_REQUEST_SET_EVENT_FORMAT:		AA00075000021B014F55(argument: 0x00->text, 0x01->compact)
+  *		AA 00 07 50 00 02 1B 01 4F 55
+  *		
+  *		PROTOCOL_SERVER_REQUEST_STATE_SNAPSHOT:			AA00065000011C4B55
+  *		AA 00 06 50 00 01 1C 4B 55
+  *		
   ***************************************************/
   
 /*-------------Header Files Include-----------------*/
@@ -155,21 +210,133 @@
 #include "mid_wifi.h"
 #include "mid_firmware.h"
 #include "mid_flash.h"
+#include "mid_outbox.h"
 #include "device.h"
 #include "os_system.h"
 #include "app.h"
+#include "timestamp.h"
+#include "mid_powermanage.h"
+#include "mid_clock.h"
 
 /*-------------Internal Functions Declaration------*/
 static void 							MQTTProtocol_DataPack(en_Protocol_CommType_t CommType, unsigned char *pData);
-static en_Protocol_ServerRequestCode_t 	MQTTProtocol_ReceiveDataParse(en_Protocol_CommType_t CommType, unsigned char *pData);
+static en_Protocol_ServerRequestCode_t 	MQTTProtocol_ReceiveDataParse(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned char *pRequestArg);
 static void 							MQTTProtocol_TerminalRequest_SystemTime(en_Protocol_CommType_t CommType);
+static void 							MQTTProtocol_FrameDecode_Scan(en_Protocol_CommType_t CommType, stu_MQTTFrameDecoder_t *pDecoder);
+static void 							MQTTProtocol_FrameDecode_Timeout(en_Protocol_CommType_t CommType);
+
+static unsigned char 					MQTTProtocol_EventLane_Ready(unsigned char Class);
+static unsigned char 					MQTTProtocol_EventLane_Full(unsigned char Class);
+static unsigned char 					MQTTProtocol_EventLane_Select(void);
+static unsigned char 					MQTTProtocol_EventLane_Out(en_Protocol_CommType_t CommType, unsigned char Class);
+static void 							MQTTProtocol_EventClass_Latency(unsigned char Class, unsigned short QueueInTick);
+static unsigned char 					MQTTProtocol_EventUpload_Dispatch(en_Protocol_CommType_t CommType, unsigned char Event, unsigned char Data, unsigned short QueueInTick, unsigned char *pTime);
+static unsigned char 					MQTTProtocol_EventRecord_Pack(unsigned char *pRecord, unsigned char *pTime, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint);
+static unsigned char 					MQTTProtocol_EventRecord_PackCompact(unsigned char *pRecord, unsigned char *pTime, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint);
+static void 							MQTTProtocol_EventBatch_Add(unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint, unsigned short QueueInTick, unsigned char *pTime);
+static unsigned char 					MQTTProtocol_EventBatch_Full(void);
+static void 							MQTTProtocol_EventBatch_AlarmFlush(void);
+static void 							MQTTProtocol_EventBatch_Publish(en_Protocol_CommType_t CommType);
+static unsigned char 					MQTTProtocol_UplinkReady(en_Protocol_CommType_t CommType);
+static unsigned char 					MQTTProtocol_EventJournalCheck(unsigned char Event);
+static void 							MQTTProtocol_PublishResult(unsigned char Result);
+static void 							MQTTProtocol_OutboxRewind(void);
+static void 							MQTTProtocol_State_Read(unsigned char *pField);
+static unsigned char 					MQTTProtocol_State_Pro(en_Protocol_CommType_t CommType);
+
+static unsigned char 					MQTTProtocol_DeviceInfo_Pack(unsigned char *pRecord, unsigned char SensorIndex);
+static unsigned short 					MQTTProtocol_Response_HostInfo(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_WorkMode(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_DeviceInfo(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_AllDeviceInfo(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_SetWorkMode(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_SetEventFormat(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_StateSnapshot(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+static unsigned short 					MQTTProtocol_Response_Error(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
 
 
 /*-------------Module Variables Declaration--------*/
 stu_SystemTime_t	stu_SystemTime;
 
-/* EventUpload buffer for MQTT server */
-Queue32 Queue_MQTTEventUpload;
+/* EventUpload lanes for MQTT server(one per class): Event, Data, QueueIn-Tick(2 byte), Outbox slot(2 byte, 0xFFFF->not claimed) per event */
+Queue120 		Queue_MQTTEventLane[MQTT_EVENT_CLASS_SUM];
+unsigned char 	MQTTEventLane_SkipNumber[MQTT_EVENT_CLASS_SUM];		// times the waiting lane was passed over by the higher lanes
+
+/* EventUpload batch: [0,1]DataFrame length, [2]Command, [3,4]Payload length, [5]RecordNumber, [6...]RecordLength/Record pairs */
+unsigned char 	MQTTEventBatch_Buff[MQTT_PROTOCOL_DATA_SIZE_MAX];
+unsigned short 	MQTTEventBatch_PayloadLen;
+unsigned char 	MQTTEventBatch_RecordNumber;
+unsigned char 	MQTTEventBatch_FlushFlag;
+unsigned short 	MQTTEventBatch_QueueInTick[MQTT_EVENT_BATCH_RECORD_MAX];
+unsigned char 	MQTTEventBatch_Class[MQTT_EVENT_BATCH_RECORD_MAX];
+unsigned char 	MQTTEventBatch_Format;		// EventUpload format of the records in the batch(latched by the first record)
+
+/* EventUpload format selected for the new records */
+en_MQTTEventFormat_t MQTTEvent_Format;
+
+stu_MQTTEventBatchStat_t stu_MQTTEventBatchStat;
+
+/* Outbox: the batch holds outbox records, outbox read mark of the publish being packed(0xFFFF->no outbox record) */
+unsigned char 	MQTTEventBatch_OutboxFlag;
+unsigned short 	MQTTPub_OutboxMark;
+
+/* Outbox records claimed by the alarm lane: held by the batch, carried by the publish being packed */
+unsigned char 	MQTTEventBatch_ClaimNumber;
+unsigned char 	MQTTPub_OutboxClaim;
+
+/* Publish being packed is retained by the broker, carries the Terminal state(snapshot / delta) */
+unsigned char 	MQTTPub_Retain;
+unsigned char 	MQTTPub_State;
+
+/* Terminal state: snapshot waiting to be published, fields published last, sequence of the last delta, tick of the last delta check,
+   retained snapshot behind the deltas(1->published again MQTT_STATE_RETAIN_DELAY after the last delta) */
+unsigned char 	MQTTState_SnapshotFlag;
+unsigned char 	MQTTState_Shadow[MQTT_STATE_FIELD_SUM];
+unsigned short 	MQTTState_Seq;
+unsigned short 	MQTTState_CheckTick;
+unsigned char 	MQTTState_RetainFlag;
+unsigned short 	MQTTState_DeltaTick;
+
+/* Publishes waiting for the broker's answer, in the order published: outbox read mark, claimed records, Terminal state carried of each publish */
+unsigned short 	MQTTPub_InFlightMark[MQTT_PUB_INFLIGHT_SUM];
+unsigned char 	MQTTPub_InFlightClaim[MQTT_PUB_INFLIGHT_SUM];
+unsigned char 	MQTTPub_InFlightState[MQTT_PUB_INFLIGHT_SUM];
+unsigned char 	MQTTPub_InFlightHead;
+unsigned char 	MQTTPub_InFlightNumber;
+
+/* Downlink message queue: filled by the Rx parser, emptied by MQTTProtocol_Downlink_Pro(OS task) */
+stu_MQTTDownlinkMsg_t 	MQTTDownlink_Msg[MQTT_DOWNLINK_QUEUE_SUM];
+unsigned char 			MQTTDownlink_Head;		// index of the oldest message
+unsigned char 			MQTTDownlink_Number;	// messages queued
+stu_MQTTDownlinkStat_t 	stu_MQTTDownlinkStat;
+
+/* Frame decoder of each communication type: server dataframes cut / joined arbitrarily by the MQTT messages */
+stu_MQTTFrameDecoder_t 	MQTTFrameDecoder[PROTOCOL_COMM_TYPE_SUM];
+
+/* "all devices" response: start Device index of the next dataframe to publish, 0xFF->none */
+unsigned char MQTTDeviceSync_NextIndex;
+
+/* Server request descriptor table */
+const stu_MQTTServerRequest_t MQTTServerRequest_Table[] = 
+{
+	{PROTOCOL_SERVER_REQUEST_HOST_INFO, 			PROTOCOL_SERVER_REQUEST_HOST_INFO, 			MQTTProtocol_Response_HostInfo},
+	{PROTOCOL_SERVER_REQUEST_WORKMODE, 				PROTOCOL_SERVER_REQUEST_WORKMODE, 			MQTTProtocol_Response_WorkMode},
+	{PROTOCOL_SERVER_REQUEST_DEVICE_1_INFO, 		PROTOCOL_SERVER_REQUEST_DEVICE_20_INFO, 	MQTTProtocol_Response_DeviceInfo},
+	{PROTOCOL_SERVER_REQUEST_SET_WORKMODE_AWAYARM, 	PROTOCOL_SERVER_REQUEST_SET_WORKMODE_ALARM, MQTTProtocol_Response_SetWorkMode},
+	{PROTOCOL_SERVER_REQUEST_ALL_DEVICE_INFO, 		PROTOCOL_SERVER_REQUEST_ALL_DEVICE_INFO, 	MQTTProtocol_Response_AllDeviceInfo},
+	{PROTOCOL_SERVER_REQUEST_SET_EVENT_FORMAT, 		PROTOCOL_SERVER_REQUEST_SET_EVENT_FORMAT, 	MQTTProtocol_Response_SetEventFormat},
+	{PROTOCOL_SERVER_REQUEST_STATE_SNAPSHOT, 		PROTOCOL_SERVER_REQUEST_STATE_SNAPSHOT, 	MQTTProtocol_Response_StateSnapshot},
+	{PROTOCOL_SERVER_REQUEST_ERROR, 				PROTOCOL_SERVER_REQUEST_ERROR, 				MQTTProtocol_Response_Error},
+};
+
+/* Terminal WorkMode of PROTOCOL_SERVER_REQUEST_SET_WORKMODE_AWAYARM -> PROTOCOL_SERVER_REQUEST_SET_WORKMODE_ALARM */
+const en_Terminal_WorkMode_t MQTTServerRequest_WorkMode[] = 
+{
+	TERMINAL_WORK_MODE_AWAYARM,
+	TERMINAL_WORK_MODE_HOMEARM,
+	TERMINAL_WORK_MODE_DISARM,
+	TERMINAL_WORK_MODE_ALARMING,
+};
 
 /* message payload of EventUpload */
 const unsigned char MQTTEventUpload_FunctionMessage[][18] = 
@@ -212,7 +379,53 @@ const unsigned char MQTTEventUpload_ArmMessage[][20] =
   */
 void MQTTProtocol_Init(void)
 {
-	QueueEmpty(Queue_MQTTEventUpload);
+	unsigned char i;
+	
+	for(i=0; i<MQTT_EVENT_CLASS_SUM; i++)
+	{
+		QueueEmpty(Queue_MQTTEventLane[i]);
+		
+		MQTTEventLane_SkipNumber[i] = 0;
+	}
+	
+	MQTTDownlink_Head = 0;
+	MQTTDownlink_Number = 0;
+	
+	for(i=0; i<PROTOCOL_COMM_TYPE_SUM; i++)
+	{
+		MQTTFrameDecoder[i].Start = 0;
+		MQTTFrameDecoder[i].Number = 0;
+	}
+	
+	MQTTDeviceSync_NextIndex = 0xFF;
+	
+	MQTTEventBatch_PayloadLen = 1;		// RecordNumber
+	MQTTEventBatch_RecordNumber = 0;
+	MQTTEventBatch_FlushFlag = 0;
+	MQTTEventBatch_OutboxFlag = 0;
+	MQTTEventBatch_ClaimNumber = 0;
+	MQTTEventBatch_Format = MQTT_EVENT_FORMAT_DEFAULT;
+	
+	MQTTEvent_Format = MQTT_EVENT_FORMAT_DEFAULT;
+	
+	MQTTPub_Retain = 0;
+	MQTTPub_State = 0;
+	
+	MQTTState_SnapshotFlag = 0;
+	MQTTState_Seq = 0;
+	MQTTState_CheckTick = 0;
+	MQTTState_RetainFlag = 0;
+	MQTTState_DeltaTick = 0;
+	
+	MQTTPub_OutboxMark = 0xFFFF;
+	MQTTPub_OutboxClaim = 0;
+	MQTTPub_InFlightHead = 0;
+	MQTTPub_InFlightNumber = 0;
+	
+	MQTTProtocol_ClearEventBatchStat();
+	
+	/* register MQTTProtocol_PublishResult as the CBF of WiFi MQTT publish result */
+	Mid_WiFi_MQTT_PublishCBFRegister(MQTTProtocol_PublishResult);
 }
 
 /**
@@ -226,19 +439,21 @@ void MQTTProtocol_Pro(en_Protocol_CommType_t CommType)
 }
 
 /**
-  * @Brief	Process the data received from MQTT server
+  * @Brief	Process a complete server dataframe
   * @Param	CommType: communication type
-  *			pData	: point to the data received
-  *			Len		: data length
+  *			pData	: point to the dataframe(Header first)
+  *			Len		: dataframe length
   * @Retval	None
+  *	@Note	Dataframes are delimited and checked by MQTTProtocol_FrameDecode in advance
   */
-void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned char Len)
+void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned short Len)
 {
 	unsigned short DataLen;
 	en_Protocol_ServerRequestCode_t ServerRequestCode;
 	
 	stu_Firmware_t FirmwareBuff;
 	unsigned short VersionBuff;
+	unsigned char RequestArg;
 	
 	if(pData[0] == 0xAA)	// detect DataFrame Header
 	{
@@ -252,6 +467,11 @@ void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned c
 			return;
 		}
 		
+		if((DataLen < 3) || ((DataLen + 3) > Len))	// DataLength beyond the data received
+		{
+			return;
+		}
+		
 		if(pData[DataLen+2] == 0x55)	// detect Dataframe Tail, indicate a complete dataframe
 		{
 			switch(pData[3])	// get CommandCode
@@ -268,6 +488,9 @@ void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned c
 						Set_SystemTime_Hour(pData[10]);
 						Set_SystemTime_Minute(pData[11]);
 						Set_SystemTime_Second(pData[12]);
+						
+						Mid_Clock_Sync(TimeStamp_Local_ToTimeStamp(stu_SystemTime.year, stu_SystemTime.month, stu_SystemTime.day, 
+																   stu_SystemTime.hour, stu_SystemTime.minute, stu_SystemTime.second));
 					}
 				}
 				break;
@@ -275,8 +498,10 @@ void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned c
 				case PROTOCOL_SERVER_RESPONSE_UPDATE_CHECK:
 				{
 					/*  Server Response DataFrame format:
-						AA 00 0D 22 	XX XX 	XX XX XX XX		XX XX		XX XX	XX 	55
-										version	FirmwareSize	PackageSize CRC16	XOR	
+						AA 00 10 22 	XX 			XX XX 	XX XX XX XX		XX XX			XX XX	XX XX		XX 	55
+									DataFrameID	version	FirmwareSize	PackageNumber 	CRC16	PackageSize	XOR	
+						(AA 00 0E 22 ...: server not negotiating the PackageSize, 100 byte per package)
+						(AA 00 11 22 ... PackageSize ImageType XOR 55: ImageType 1->delta patch against the version of the update check, 2->compressed Firmware)
 					*/
 					FirmwareBuff.NewVersion.Version[0] = pData[5];
 					FirmwareBuff.NewVersion.Version[1] = pData[6];
@@ -297,6 +522,27 @@ void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned c
 						FirmwareBuff.CRC16[0] = pData[13];
 						FirmwareBuff.CRC16[1] = pData[14];
 						
+						if(DataLen >= 0x10)
+						{
+							FirmwareBuff.PackageSize = (pData[15] << 8) | pData[16];
+							FirmwareBuff.NegotiatedFlag = 1;
+						}
+						else
+						{
+							FirmwareBuff.PackageSize = FIRMWARE_PACKAGE_SIZE_DEFAULT;
+							FirmwareBuff.NegotiatedFlag = 0;
+						}
+						
+						/* image offered: delta patch against the version given in the update check / compressed, the whole Firmware otherwise */
+						if((DataLen >= 0x11) && ((pData[17] == FIRMWARE_IMAGE_TYPE_DELTA) || (pData[17] == FIRMWARE_IMAGE_TYPE_LZ)))
+						{
+							FirmwareBuff.ImageType = pData[17];
+						}
+						else
+						{
+							FirmwareBuff.ImageType = FIRMWARE_IMAGE_TYPE_FULL;
+						}
+						
 						// Update the Firmware Info according to the NewFirmware from server
 						Mid_Firmware_InfoUpdate(FirmwareBuff);
 					}
@@ -306,17 +552,17 @@ void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned c
 				case PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE:
 				{
 					// AA LEN1 LEN2 0x25 DATA DATA DATA ... 0x55, effective data start from pData[4]
-					Mid_Firmware_Download_Pro(&Mid_Flash_WriteData, &Mid_Flash_ReadData, &pData[4]);
+					Mid_Firmware_Download_Pro(&Mid_Flash_ImageWrite, &Mid_Flash_ReadData, &Mid_Flash_WriteSector, &pData[4]);
 				}
 				break;
 				
 				case PROTOCOL_SERVER_COMMAND:
 				{
 					/* extract ServerRequestCode from dataframe */
-					ServerRequestCode = MQTTProtocol_ReceiveDataParse(CommType, &pData[1]);
+					ServerRequestCode = MQTTProtocol_ReceiveDataParse(CommType, &pData[1], &RequestArg);
 					
 					/* prepare and package response dataframe */
-					MQTTProtocol_ServerRequestResponse_DataPack(CommType, ServerRequestCode);
+					MQTTProtocol_ServerRequestResponse_DataPack(CommType, ServerRequestCode, RequestArg);
 				}
 				break;
 				
@@ -326,850 +572,1934 @@ void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned c
 }
 
 /**
-  * @Brief	Queue-in Event and Message payload index to Queue_MQTTEventUpload
-  * @Param	Event: Event index
-  *			Data : Message index
-  * @Retval	None
-  */
-void MQTTProtocol_EventUpQueueIn(unsigned char Event, unsigned char Data)
-{
-	QueueDataIn(Queue_MQTTEventUpload, &Event, 1);
-	QueueDataIn(Queue_MQTTEventUpload, &Data, 1);
-}
-
-/**
-  * @Brief	Polling function, if Queue_MQTTEventUpload has data to process, pack the data according to the protocol
-  *			upload the packed dataframe to the server through WiFi-module/LTE-module
-  * @Param	CommType: communication type(0->WiFi, 1->LTE)
+  * @Brief	Feed a chunk of the server data stream to the frame decoder, handle every complete dataframe found
+  * @Param	CommType: communication type
+  *			pData	: point to the data received(any part of the stream: partial / several dataframes / garbage)
+  *			Len		: data length
   * @Retval	None
+  *	@Note	Header, DataLength, Tail and CheckValue are validated before a dataframe is handled,
+  *			on any error the decoder resynchronizes on the next Header after the failed one
   */
-void MQTTProtocol_EventUpload_Pro(en_Protocol_CommType_t CommType)
+void MQTTProtocol_FrameDecode(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned short Len)
 {
-	stu_MQTTEventUpload_t EventUploadBuff;
+	stu_MQTTFrameDecoder_t *pDecoder;
+	unsigned short Free;
+	unsigned short i;
 	
-	if(QueueDataLen(Queue_MQTTEventUpload) > 1)
+	if(CommType >= PROTOCOL_COMM_TYPE_SUM)
 	{
-		if(Mid_WiFi_GetMQTTState() == MQTT_STA_READY)
-		{
-			QueueDataOut(Queue_MQTTEventUpload, (unsigned char *)&EventUploadBuff.Event);
-			QueueDataOut(Queue_MQTTEventUpload, &EventUploadBuff.Buff);
-			
-			switch((unsigned char)EventUploadBuff.Event)
-			{
-				case TERMINAL_UPEVENT_UPDATE_CHECK:
-				{
-					MQTTProtocol_NewFirmwareCheck_DataPack(CommType);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_GET_SYSTIME:
-				{
-				
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DETECTOR_ALARM:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, EventUploadBuff.Buff, TERMINAL_UPEVENT_DETECTOR_ALARM, ENDPOINT_MESSAGE_UPLOAD);
-				}			
-				break;
-				
-				case TERMINAL_UPEVENT_DETECTOR_OFFLINE:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, EventUploadBuff.Buff, TERMINAL_UPEVENT_DETECTOR_OFFLINE, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DETECTOR_ONLINE:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, EventUploadBuff.Buff, TERMINAL_UPEVENT_DETECTOR_ONLINE, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DETECTOR_BATLOW:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, EventUploadBuff.Buff, TERMINAL_UPEVENT_DETECTOR_BATLOW, ENDPOINT_MESSAGE_UPLOAD);
-				}					
-				break;
-				
-				case TERMINAL_UPEVENT_DETECTOR_ALARM_TEMPER:
-				{
-					
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_HOST_ALARM_SOS:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOST_ALARM_SOS, ENDPOINT_MESSAGE_UPLOAD);
-				}	
-				break;
-				
-				case TERMINAL_UPEVENT_HOST_BATLOW:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOST_BATLOW, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_HOST_AC_DISCONN:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOST_AC_DISCONN, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_HOST_AC_CONNECT:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOST_AC_CONNECT, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DOOR_OPEN:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, EventUploadBuff.Buff, TERMINAL_UPEVENT_DOOR_OPEN, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DOOR_CLOSE:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, EventUploadBuff.Buff, TERMINAL_UPEVENT_DOOR_CLOSE, ENDPOINT_MESSAGE_UPLOAD);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_AWAYARM_BY_HOST:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_AWAYARM_BY_HOST, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_AWAYARM_BY_REMOTE:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_AWAYARM_BY_REMOTE, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_AWAYARM_BY_SERVER:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_AWAYARM_BY_SERVER, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_HOMEARM_BY_HOST:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOMEARM_BY_HOST, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_HOMEARM_BY_REMOTE:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOMEARM_BY_REMOTE, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_HOMEARM_BY_SERVER:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_HOMEARM_BY_SERVER, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-			
-				case TERMINAL_UPEVENT_DISARM_BY_HOST:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_DISARM_BY_HOST, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DISARM_BY_REMOTE:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_DISARM_BY_REMOTE, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-				case TERMINAL_UPEVENT_DISARM_BY_SERVER:
-				{
-					MQTTProtocol_EventUpload_DataPack(CommType, 0xFF, TERMINAL_UPEVENT_DISARM_BY_SERVER, ENDPOINT_TERMINAL_WORMODE_CHANGE);
-				}
-				break;
-				
-			}
-		}
+		return;
 	}
-}
-
-/**
-  * @Brief	Pack the provided data prepare the Upload payload Data
-  * @Param	CommType	: communication type
-  *			ZoneNo		: 0xFF->Terminal / Server, 1-20->Sensor
-  *			EventType	: event type
-  *			Endpoint	: manage the different datapackage (messgae upload, Terminal arm mode change)
-  * @Retval	None
-  */
-void MQTTProtocol_EventUpload_DataPack(en_Protocol_CommType_t CommType, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint)
-{
-	unsigned char DataBuff[100];
-	unsigned char i, j;
-	unsigned short Len;
 	
-	i = 2;
+	pDecoder = &MQTTFrameDecoder[CommType];
 	
-	DataBuff[i++] = PROTOCOL_TERMINAL_RESPONSE;		// Terminal response command
-	
-	DataBuff[i++] = 0;								// payload Length highbyte
-	DataBuff[i++] = 0;								// payload Length lowbyte
-	Len = 0;
-	DataBuff[i++] = SystemTime[0];					// year
-	DataBuff[i++] = SystemTime[1];					// year
-	DataBuff[i++] = SystemTime[2];					// year
-	DataBuff[i++] = SystemTime[3];					// year
-	DataBuff[i++] = SystemTime[4];					// '-'
-	DataBuff[i++] = SystemTime[5];					// month
-	DataBuff[i++] = SystemTime[6];					// month
-	DataBuff[i++] = SystemTime[7];					// '-'
-	DataBuff[i++] = SystemTime[8];					// day
-	DataBuff[i++] = SystemTime[9];					// day
-	DataBuff[i++] = '-';							
-	DataBuff[i++] = SystemTime[11];					// hour
-	DataBuff[i++] = SystemTime[12];					// hour
-	DataBuff[i++] = SystemTime[13];					// ':'
-	DataBuff[i++] = SystemTime[14];					// minute
-	DataBuff[i++] = SystemTime[15];					// minute
-	DataBuff[i++] = ' ';
-	Len = 17;
+	pDecoder->InputTick = OS_GetTickCount() & 0xFFFF;
+	stu_MQTTDownlinkStat.DecodeByteNumber += Len;
 	
-	if(Endpoint == ENDPOINT_MESSAGE_UPLOAD)
+	while(Len)
 	{
-		/* event from Terminal */
-		if(ZoneNo == 0xFF)
+		/* move the bytes kept to the front of the buffer */
+		if(pDecoder->Start)
 		{
-			DataBuff[i++] = 'H';
-			DataBuff[i++] = 'O';
-			DataBuff[i++] = 'S';
-			DataBuff[i++] = 'T';
-		
-			for(j=0; j<12; j++)
+			for(i=0; i<pDecoder->Number; i++)
 			{
-				DataBuff[i++] = ' '; 	// leave SensorName blank
+				pDecoder->Buff[i] = pDecoder->Buff[pDecoder->Start + i];
 			}
+			
+			pDecoder->Start = 0;
 		}
-		/* event from Sensor */
-		else
+		
+		Free = MQTT_DOWNLINK_FRAME_SIZE_MAX - pDecoder->Number;
+		
+		if(Free > Len)
 		{
-			ZoneNo -= 1;	// SensorIndex = ZoneNo - 1
+			Free = Len;
+		}
 		
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(ZoneNo, j);	// SensorName
-			}
+		for(i=0; i<Free; i++)
+		{
+			pDecoder->Buff[pDecoder->Number++] = *pData++;
 		}
+		
+		Len -= Free;
+		
+		MQTTProtocol_FrameDecode_Scan(CommType, pDecoder);
+	}
+}
+
+/**
+  * @Brief	Queue-in the decoded server dataframe to the Downlink message queue
+  * @Param	CommType: communication type
+  *			pData	: point to the dataframe received
+  *			Len		: dataframe length
+  * @Retval	0->queue-in succeed, 0xFF->dataframe dropped(queue full / dataframe oversize)
+  *	@Note	Called by the Rx parser, the dataframe is handled later by MQTTProtocol_Downlink_Pro,
+  *			so that the Rx parser never waits for flash operations(e.g. Firmware download)
+  */
+unsigned char MQTTProtocol_DownlinkQueueIn(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned short Len)
+{
+	stu_MQTTDownlinkMsg_t *pMsg;
+	unsigned short i;
 	
-		Len += 16;
+	if(Len > MQTT_DOWNLINK_FRAME_SIZE_MAX)
+	{
+		stu_MQTTDownlinkStat.DropOversizeNumber++;
+		
+		return 0xFF;
+	}
 	
-		/* add payload message */
-		if((EventType >= TERMINAL_UPEVENT_DETECTOR_ALARM) && (EventType <= TERMINAL_UPEVENT_DOOR_CLOSE))
-		{
-			for(j=0; j<18; j++)
-			{
-				DataBuff[i++] = MQTTEventUpload_FunctionMessage[EventType - TERMINAL_UPEVENT_DETECTOR_ALARM][j];
-			}
+	if(MQTTDownlink_Number >= MQTT_DOWNLINK_QUEUE_SUM)
+	{
+		stu_MQTTDownlinkStat.DropFullNumber++;
 		
-			Len += 18;
-		}
+		return 0xFF;
 	}
-	else if(Endpoint == ENDPOINT_TERMINAL_WORMODE_CHANGE)
+	
+	pMsg = &MQTTDownlink_Msg[(MQTTDownlink_Head + MQTTDownlink_Number) % MQTT_DOWNLINK_QUEUE_SUM];
+	
+	pMsg->CommType = CommType;
+	pMsg->QueueInTick = OS_GetTickCount() & 0xFFFF;
+	pMsg->Len = Len;
+	
+	for(i=0; i<Len; i++)
 	{
-		if((EventType >= TERMINAL_UPEVENT_AWAYARM_BY_HOST) && (Endpoint <= TERMINAL_UPEVENT_DISARM_BY_SERVER))
-		{
-			for(j=0; j<20; j++)
-			{
-				DataBuff[i++] = MQTTEventUpload_ArmMessage[EventType - TERMINAL_UPEVENT_AWAYARM_BY_HOST][j];
-			}
-			
-			Len += 20;
-		}
+		pMsg->Data[i] = pData[i];
 	}
 	
-	DataBuff[3] = (Len >> 8) & 0xFF;	// payload length
-	DataBuff[4] = Len & 0xFF;			
+	MQTTDownlink_Number++;
+	stu_MQTTDownlinkStat.QueueInNumber++;
 	
-	DataBuff[0] = (i >> 8) & 0xFF;		// DataFrame length
-	DataBuff[1] = i & 0xFF;
+	if(MQTTDownlink_Number > stu_MQTTDownlinkStat.PeakNumber)
+	{
+		stu_MQTTDownlinkStat.PeakNumber = MQTTDownlink_Number;
+	}
 	
-	// pack processed payload data
-	MQTTProtocol_DataPack(CommType, &DataBuff[0]);
+	return 0;
 }
 
 /**
-  * @Brief	According to the ServerRequestCode, prepare the corresponding final MQTT_Protocol DataFrame reply the server
-  * @Param	CommType			: communication type
-  *			ServerRequestCode	: Server Request Code extracted
+  * @Brief	Polling function(OS task), handle one queued server dataframe per run
+  * @Param	None
   * @Retval	None
   */
-void MQTTProtocol_ServerRequestResponse_DataPack(en_Protocol_CommType_t CommType, en_Protocol_ServerRequestCode_t ServerRequestCode)
+void MQTTProtocol_Downlink_Pro(void)
 {
-	unsigned char DataBuff[100];
-	unsigned char i, j;
-	unsigned short Len;
+	stu_MQTTDownlinkMsg_t *pMsg;
+	unsigned short WaitTick;
 	
-	i = 2;
+	/* Debug Mode: */
+	#ifdef MQTT_FRAME_DECODE_DEBUG_MODE
+	static unsigned short DebugCounter = 0;
+	/* garbage, HostInfo request cut in two, WorkMode request with wrong CheckValue, WorkMode request */
+	static unsigned char DebugStream[] = 
+	{
+		0x00, 0xAA, 0x55, 0x12,
+		0xAA, 0x00, 0x06, 0x50, 0x00, 0x01, 0x00, 0x57, 0x55,
+		0xAA, 0x00, 0x06, 0x50, 0x00, 0x01, 0x01, 0x00, 0x55,
+		0xAA, 0x00, 0x06, 0x50, 0x00, 0x01, 0x01, 0x56, 0x55,
+	};
+	
+	DebugCounter++;
 	
-	DataBuff[i++] = PROTOCOL_TERMINAL_RESPONSE;		// Terminal response command
-	DataBuff[i++] = 0;								// payload Length highbyte
-	DataBuff[i++] = 0;								// payload Length lowbyte
+	if(DebugCounter > 3000)	// every 30s: expect 2 dataframes, 11 garbage bytes, 1 DataLength error, 1 CheckValue error
+	{
+		DebugCounter = 0;
+		
+		MQTTProtocol_FrameDecode(PROTOCOL_COMM_TYPE_WIFI, &DebugStream[0], 8);
+		MQTTProtocol_FrameDecode(PROTOCOL_COMM_TYPE_WIFI, &DebugStream[8], sizeof(DebugStream) - 8);
+	}
+	#endif
 	
-	Len = 0;
+	MQTTProtocol_FrameDecode_Timeout(PROTOCOL_COMM_TYPE_WIFI);
 	
-	switch((unsigned char)ServerRequestCode)
+	if(MQTTDownlink_Number)
 	{
-		case PROTOCOL_SERVER_REQUEST_HOST_INFO:
-		{
-			DataBuff[i++] = Device_Get_SystemPara_FirmwareVersion(0);		// FirmwareVersion high byte
-			DataBuff[i++] = Device_Get_SystemPara_FirmwareVersion(1);		// FirmwareVersion low byte
+		pMsg = &MQTTDownlink_Msg[MQTTDownlink_Head];
 		
-			DataBuff[i++] = 0x00;
-			DataBuff[i++] = 0x00;
-			DataBuff[i++] = 0x00;
-			
-			for(j=0; j<12; j++)
-			{
-				DataBuff[i++] = Device_Get_MCU_UID(j);		// MCU-UID
-			}
-
-			Len += 17;
-		}
-		break;
+		WaitTick = (OS_GetTickCount() & 0xFFFF) - pMsg->QueueInTick;
 		
-		case PROTOCOL_SERVER_REQUEST_WORKMODE:
+		if(WaitTick > stu_MQTTDownlinkStat.WaitTickMax)
 		{
-			/* obtain the current Terminal WorkMode from App module */
-			DataBuff[i++] = pTerminalMode->WorkMode;
-			
-			Len += 1;
+			stu_MQTTDownlinkStat.WaitTickMax = WaitTick;
 		}
-		break;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_1_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(0);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(0);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(0, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(0);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		MQTTProtocol_FrameDecode(pMsg->CommType, &pMsg->Data[0], pMsg->Len);
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_2_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(1);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(1);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(1, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(1);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		MQTTDownlink_Head = (MQTTDownlink_Head + 1) % MQTT_DOWNLINK_QUEUE_SUM;
+		MQTTDownlink_Number--;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_3_INFO:
+		stu_MQTTDownlinkStat.DispatchNumber++;
+	}
+}
+
+/**
+  * @Brief	Get the statistics of Downlink message queue
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void MQTTProtocol_GetDownlinkStat(stu_MQTTDownlinkStat_t *pStat)
+{
+	*pStat = stu_MQTTDownlinkStat;
+}
+
+/**
+  * @Brief	Queue-in Event and Message payload index to the outbox(terminal events) / the EventUpload lane of the class
+  * @Param	Event: Event index
+  *			Data : Message index
+  *			Class: priority class(en_MQTTEventClass_t)
+  * @Retval	None
+  *	@Note	The QueueIn-Tick is stored with the event to measure the upload latency,
+  *			alarm-class terminal events are journaled and claimed by the alarm lane(not stuck behind the outbox backlog),
+  *			terminal events fall back to the lane of the class if the outbox is not usable
+  */
+void MQTTProtocol_EventUpQueueIn(unsigned char Event, unsigned char Data, en_MQTTEventClass_t Class)
+{
+	unsigned char DataBuff[MQTT_EVENT_LANE_RECORD_SIZE];
+	unsigned short Tick;
+	unsigned short Slot = 0xFFFF;
+	
+	if(Class >= MQTT_EVENT_CLASS_SUM)
+	{
+		Class = MQTT_EVENT_CLASS_NORMAL;
+	}
+	
+	Tick = OS_GetTickCount() & 0xFFFF;
+	
+	/* terminal events are journaled in the outbox, kept through link outage / reboot until the broker accepts them */
+	if(MQTTProtocol_EventJournalCheck(Event))
+	{
+		if(Mid_Outbox_Append(Event, Data, Tick, Mid_Clock_GetDateTime(), &Slot) == 0)
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(2);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(2);			// SensorType
-			
-			for(j=0; j<16; j++)
+			/* left to the outbox replay: not alarm-class / alarm lane full / no free claim */
+			if((Class != MQTT_EVENT_CLASS_ALARM) || MQTTProtocol_EventLane_Full(Class) || Mid_Outbox_Claim(Slot))
 			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(2, j);		// SensorName
+				return;
 			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(2);		// Sensor ArmType
-			
-			Len += 19;
 		}
-		break;
+	}
+	
+	if(MQTTProtocol_EventLane_Full(Class))
+	{
+		stu_MQTTEventBatchStat.Class[Class].DropNumber++;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_4_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(3);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(3);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(3, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(3);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		return;
+	}
+	
+	DataBuff[0] = Event;
+	DataBuff[1] = Data;
+	DataBuff[2] = (Tick >> 8) & 0xFF;
+	DataBuff[3] = Tick & 0xFF;
+	DataBuff[4] = (Slot >> 8) & 0xFF;
+	DataBuff[5] = Slot & 0xFF;
+	
+	QueueDataIn(Queue_MQTTEventLane[Class], &DataBuff[0], MQTT_EVENT_LANE_RECORD_SIZE);
+}
+
+/**
+  * @Brief	Polling function, if the EventUpload lanes have data to process, pack the events into the EventUpload batch,
+  *			upload the batch to the server through WiFi-module/LTE-module in one dataframe
+  * @Param	CommType: communication type(0->WiFi, 1->LTE)
+  * @Retval	None
+  *	@Note	Lanes are drained highest class first: alarm lane -> normal lane(RAM, then outbox) -> request lane,
+  *			a lower lane passed over MQTT_EVENT_LANE_STARVE_MAX times is served once ahead of the higher lanes
+  *			The batch is published when:
+  *			1. the oldest event in the batch waits for MQTT_EVENT_BATCH_DELAY_MAX
+  *			2. the batch reaches MQTT_EVENT_BATCH_SIZE_MAX / MQTT_EVENT_BATCH_RECORD_MAX
+  *			3. an alarm-class event joins the batch(published immediately)
+  *			At most one dataframe is published per polling, and only if the module can take a full-size publish
+  */
+void MQTTProtocol_EventUpload_Pro(en_Protocol_CommType_t CommType)
+{
+	unsigned char Class;
+	unsigned char Result;
+	
+	/* Debug Mode: */
+	#ifdef MQTT_EVENT_BATCH_DEBUG_MODE
+	static unsigned short DebugCounter = 0;
+	unsigned char i;
+	
+	DebugCounter++;
+	
+	if(DebugCounter > 3000)	// synthetic burst: 10 DoorOpen events and an alarm behind them every 30s
+	{
+		DebugCounter = 0;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_5_INFO:
+		for(i=0; i<10; i++)
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(4);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(4);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(4, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(4);		// Sensor ArmType
-			
-			Len += 19;
+			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN, 1, MQTT_EVENT_CLASS_NORMAL);
 		}
-		break;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_6_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(5);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(5);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(5, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(5);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DETECTOR_ALARM, 1, MQTT_EVENT_CLASS_ALARM);
+	}
+	#endif
+	
+	if(!MQTTProtocol_UplinkReady(CommType))
+	{
+		return;
+	}
+	
+	/* state snapshot / delta, one dataframe per polling(alarm lane first) */
+	if(!MQTTProtocol_EventLane_Ready(MQTT_EVENT_CLASS_ALARM) && MQTTProtocol_State_Pro(CommType))
+	{
+		return;
+	}
+	
+	/* rest of the "all devices" response, one dataframe per polling(alarm lane first) */
+	if((MQTTDeviceSync_NextIndex != 0xFF) && !MQTTProtocol_EventLane_Ready(MQTT_EVENT_CLASS_ALARM))
+	{
+		MQTTProtocol_ServerRequestResponse_DataPack(CommType, PROTOCOL_SERVER_REQUEST_ALL_DEVICE_INFO, MQTTDeviceSync_NextIndex);
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_7_INFO:
+		return;
+	}
+	
+	while(!MQTTEventBatch_FlushFlag)
+	{
+		/* no room for another record, publish the batch first */
+		if(MQTTProtocol_EventBatch_Full())
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(6);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(6);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(6, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(6);		// Sensor ArmType
+			MQTTEventBatch_FlushFlag = 1;
 			
-			Len += 19;
+			break;
 		}
-		break;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_8_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(7);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(7);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(7, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(7);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		Class = MQTTProtocol_EventLane_Select();
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_9_INFO:
+		if(Class >= MQTT_EVENT_CLASS_SUM)	// all lanes empty
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(8);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(8);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(8, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(8);		// Sensor ArmType
-			
-			Len += 19;
+			break;
 		}
-		break;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_10_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(9);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(9);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(9, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(9);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		Result = MQTTProtocol_EventLane_Out(CommType, Class);
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_11_INFO:
+		if(Result == 1)			// request published directly
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(10);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(10);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(10, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(10);		// Sensor ArmType
-			
-			Len += 19;
+			return;
 		}
-		break;
-		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_12_INFO:
+		else if(Result == 0xFF)	// outbox waits for the alarm lane
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(11);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(11);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(11, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(11);		// Sensor ArmType
-			
-			Len += 19;
+			break;
 		}
-		break;
-		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_13_INFO:
+	}
+	
+	if(MQTTEventBatch_RecordNumber)
+	{
+		if((unsigned short)(OS_GetTickCount() - MQTTEventBatch_QueueInTick[0]) >= MQTT_EVENT_BATCH_DELAY_MAX)
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(12);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(12);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(12, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(12);		// Sensor ArmType
-			
-			Len += 19;
+			MQTTEventBatch_FlushFlag = 1;
 		}
-		break;
+	}
+	
+	if(MQTTEventBatch_FlushFlag)
+	{
+		MQTTProtocol_EventBatch_Publish(CommType);
+	}
+}
+
+/**
+  * @Brief	Get the statistics of EventUpload batch
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void MQTTProtocol_GetEventBatchStat(stu_MQTTEventBatchStat_t *pStat)
+{
+	*pStat = stu_MQTTEventBatchStat;
+}
+
+/**
+  * @Brief	Clear the statistics of EventUpload batch and restart the measurement
+  * @Param	None
+  * @Retval	None
+  */
+void MQTTProtocol_ClearEventBatchStat(void)
+{
+	unsigned char *pStat;
+	unsigned char i;
+	
+	pStat = (unsigned char *)&stu_MQTTEventBatchStat.Class[0];
+	
+	for(i=0; i<sizeof(stu_MQTTEventBatchStat.Class); i++)
+	{
+		pStat[i] = 0;
+	}
+	
+	stu_MQTTEventBatchStat.StartTick = OS_GetTickCount();
+	stu_MQTTEventBatchStat.EventNumber = 0;
+	stu_MQTTEventBatchStat.FrameNumber = 0;
+	stu_MQTTEventBatchStat.AlarmFlushNumber = 0;
+	stu_MQTTEventBatchStat.LatencySum = 0;
+	stu_MQTTEventBatchStat.LatencyMax = 0;
+}
+
+/**
+  * @Brief	Request the Terminal state snapshot to be published(MQTT connected / server request)
+  * @Param	None
+  * @Retval	None
+  *	@Note	Published by MQTTProtocol_EventUpload_Pro when the uplink is ready
+  */
+void MQTTProtocol_StateSnapshot_Request(void)
+{
+	MQTTState_SnapshotFlag = 1;
+}
+
+/**
+  * @Brief	Select the EventUpload format of the new events
+  * @Param	Format: MQTT_EVENT_FORMAT_TEXT / MQTT_EVENT_FORMAT_COMPACT
+  * @Retval	None
+  *	@Note	The batch being filled keeps its format, the new format applies from the next batch
+  */
+void MQTTProtocol_SetEventFormat(en_MQTTEventFormat_t Format)
+{
+	if(Format < MQTT_EVENT_FORMAT_SUM)
+	{
+		MQTTEvent_Format = Format;
+	}
+}
+
+/**
+  * @Brief	Get the EventUpload format of the new events
+  * @Param	None
+  * @Retval	MQTT_EVENT_FORMAT_TEXT / MQTT_EVENT_FORMAT_COMPACT
+  */
+en_MQTTEventFormat_t MQTTProtocol_GetEventFormat(void)
+{
+	return MQTTEvent_Format;
+}
+
+/**
+  * @Brief	Pack the provided data prepare the Upload payload Data
+  * @Param	CommType	: communication type
+  *			ZoneNo		: 0xFF->Terminal / Server, 1-20->Sensor
+  *			EventType	: event type
+  *			Endpoint	: manage the different datapackage (messgae upload, Terminal arm mode change)
+  * @Retval	None
+  *	@Note	Publish the single event immediately, bypass the EventUpload batch
+  *			Compact format: sent as a single record Command 0x54
+  */
+void MQTTProtocol_EventUpload_DataPack(en_Protocol_CommType_t CommType, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint)
+{
+	unsigned char DataBuff[MQTT_EVENT_RECORD_SIZE_MAX + 5];
+	unsigned short Len;
+	unsigned short i;
+	
+	i = 2;
+	
+	if(MQTTEvent_Format == MQTT_EVENT_FORMAT_COMPACT)
+	{
+		DataBuff[i++] = PROTOCOL_TERMINAL_EVENT_COMPACT;	// Terminal compact eventupload command
+		
+		DataBuff[i++] = 0;								// payload Length highbyte
+		DataBuff[i++] = 0;								// payload Length lowbyte
+		
+		DataBuff[i++] = MQTT_EVENT_COMPACT_VERSION;		// Version
+		DataBuff[i++] = 1;								// RecordNumber
+		
+		DataBuff[i] = MQTTProtocol_EventRecord_PackCompact(&DataBuff[i + 1], Mid_Clock_GetDateTime(), ZoneNo, EventType, Endpoint);
+		
+		Len = DataBuff[i] + 3;
+		i += DataBuff[i] + 1;
+	}
+	else
+	{
+		DataBuff[i++] = PROTOCOL_TERMINAL_RESPONSE;		// Terminal response command
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_14_INFO:
+		DataBuff[i++] = 0;								// payload Length highbyte
+		DataBuff[i++] = 0;								// payload Length lowbyte
+		
+		Len = MQTTProtocol_EventRecord_Pack(&DataBuff[i], Mid_Clock_GetDateTime(), ZoneNo, EventType, Endpoint);
+		i += Len;
+	}
+	
+	DataBuff[3] = (Len >> 8) & 0xFF;	// payload length
+	DataBuff[4] = Len & 0xFF;			
+	
+	DataBuff[0] = (i >> 8) & 0xFF;		// DataFrame length
+	DataBuff[1] = i & 0xFF;
+	
+	// pack processed payload data
+	MQTTProtocol_DataPack(CommType, &DataBuff[0]);
+}
+
+/**
+  * @Brief	According to the ServerRequestCode, prepare the corresponding final MQTT_Protocol DataFrame reply the server
+  * @Param	CommType			: communication type
+  *			ServerRequestCode	: Server Request Code extracted
+  *			RequestArg			: argument byte following the Server Request Code(0 if none)
+  * @Retval	None
+  *	@Note	The responder is looked up in MQTTServerRequest_Table, unknown request codes are answered with "Error"
+  */
+void MQTTProtocol_ServerRequestResponse_DataPack(en_Protocol_CommType_t CommType, en_Protocol_ServerRequestCode_t ServerRequestCode, unsigned char RequestArg)
+{
+	static unsigned char DataBuff[MQTT_PROTOCOL_DATA_SIZE_MAX];
+	const stu_MQTTServerRequest_t *pRequest;
+	unsigned short Len;
+	unsigned char i;
+	
+	pRequest = 0;
+	
+	for(i=0; i<(sizeof(MQTTServerRequest_Table) / sizeof(MQTTServerRequest_Table[0])); i++)
+	{
+		if(((unsigned char)ServerRequestCode >= MQTTServerRequest_Table[i].FirstCode) && 
+		   ((unsigned char)ServerRequestCode <= MQTTServerRequest_Table[i].LastCode))
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(13);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(13);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(13, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(13);		// Sensor ArmType
+			pRequest = &MQTTServerRequest_Table[i];
 			
-			Len += 19;
+			break;
 		}
-		break;
-		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_15_INFO:
+	}
+	
+	/* payload packed by the responder */
+	if(pRequest)
+	{
+		Len = pRequest->pResponse(&DataBuff[5], (unsigned char)ServerRequestCode - pRequest->FirstCode, RequestArg);
+	}
+	else
+	{
+		Len = MQTTProtocol_Response_Error(&DataBuff[5], 0, 0);
+	}
+	
+	if(Len == 0)	// answered by another dataframe
+	{
+		return;
+	}
+	
+	DataBuff[2] = PROTOCOL_TERMINAL_RESPONSE;		// Terminal response command
+	DataBuff[3] = (Len >> 8) & 0xFF;				// payload length
+	DataBuff[4] = Len & 0xFF;			
+	
+	Len += 5;
+	
+	DataBuff[0] = (Len >> 8) & 0xFF;				// DataFrame length
+	DataBuff[1] = Len & 0xFF;
+	
+	// pack processed payload data
+	MQTTProtocol_DataPack(CommType, &DataBuff[0]);
+}
+
+/**
+  * @Brief	Pack the Check New Firmware command payload
+  * @Param	CommType: communication type
+  * @Retval	None
+  *	@Note	Payload: largest PackageSize accepted(2 byte), limited by the Downlink dataframe and the WiFi message received,
+  *			the server answers with the PackageSize chosen(not above it),
+  *			images accepted(FIRMWARE_IMAGE_ACCEPT_X: delta patch / compressed Firmware installed by the BootLoader), running version(2 byte)
+  */
+void MQTTProtocol_NewFirmwareCheck_DataPack(unsigned char CommType)
+{
+	unsigned char DataBuff[100];
+	unsigned short PackageSize;
+	unsigned short i;
+	
+	PackageSize = FIRMWARE_PACKAGE_SIZE_MAX;
+	
+	if(PackageSize > (MQTT_DOWNLINK_FRAME_SIZE_MAX - MQTT_FIRMWARE_PACKAGE_OVERHEAD))
+	{
+		PackageSize = MQTT_DOWNLINK_FRAME_SIZE_MAX - MQTT_FIRMWARE_PACKAGE_OVERHEAD;
+	}
+	
+	/* hex string over the WiFi-module */
+	if((CommType == PROTOCOL_COMM_TYPE_WIFI) && (PackageSize > ((WIFI_MQTT_RECV_DATA_SIZE / 2) - MQTT_FIRMWARE_PACKAGE_OVERHEAD)))
+	{
+		PackageSize = (WIFI_MQTT_RECV_DATA_SIZE / 2) - MQTT_FIRMWARE_PACKAGE_OVERHEAD;
+	}
+	
+	i = 2;
+	
+	DataBuff[i++] = PROTOCOL_TERMINAL_REQUEST_UPDATE_CHECK;		// CommandCode
+	DataBuff[i++] = 0;	// payload length
+	DataBuff[i++] = 5;	// payload length
+	
+	DataBuff[i++] = (PackageSize >> 8) & 0xFF;
+	DataBuff[i++] = PackageSize & 0xFF;
+	
+	DataBuff[i++] = FIRMWARE_IMAGE_ACCEPT_DELTA | FIRMWARE_IMAGE_ACCEPT_LZ;
+	DataBuff[i++] = Device_Get_SystemPara_FirmwareVersion(0);
+	DataBuff[i++] = Device_Get_SystemPara_FirmwareVersion(1);
+	
+	DataBuff[0] = (i >> 8) & 0xFF;		// dataframe length high byte
+	DataBuff[1] = i & 0xFF;				// dataframe length low byte
+	
+	// pack processed payload data
+	MQTTProtocol_DataPack((en_Protocol_CommType_t)CommType, &DataBuff[0]);
+}
+
+/**
+  * @Brief	Pack the WiFi link telemetry payload
+  * @Param	CommType: communication type
+  * @Retval	None
+  */
+void MQTTProtocol_LinkTelemetry_DataPack(unsigned char CommType)
+{
+	unsigned char DataBuff[20];
+	unsigned short i;
+	stu_WiFi_LinkQuality_t LinkQuality;
+	stu_WiFi_ReconnectStat_t ReconnectStat;
+	
+	Mid_WiFi_GetLinkQuality(&LinkQuality);
+	
+	i = 2;
+	
+	DataBuff[i++] = PROTOCOL_TERMINAL_LINK_TELEMETRY;	// CommandCode
+	DataBuff[i++] = 0;			// payload length
+	DataBuff[i++] = 10;			// payload length
+	
+	DataBuff[i++] = (unsigned char)LinkQuality.Last;
+	DataBuff[i++] = (unsigned char)LinkQuality.Min;
+	DataBuff[i++] = (unsigned char)LinkQuality.Mean;
+	DataBuff[i++] = (unsigned char)LinkQuality.Max;
+	DataBuff[i++] = LinkQuality.SampleNumber;
+	DataBuff[i++] = LinkQuality.Channel;
+	
+	Mid_WiFi_GetReconnectStat(WIFI_RECONNECT_LAYER_AP, &ReconnectStat);
+	DataBuff[i++] = (ReconnectStat.DropNumber >> 8) & 0xFF;
+	DataBuff[i++] = ReconnectStat.DropNumber & 0xFF;
+	
+	Mid_WiFi_GetReconnectStat(WIFI_RECONNECT_LAYER_MQTT, &ReconnectStat);
+	DataBuff[i++] = (ReconnectStat.DropNumber >> 8) & 0xFF;
+	DataBuff[i++] = ReconnectStat.DropNumber & 0xFF;
+	
+	DataBuff[0] = (i >> 8) & 0xFF;
+	DataBuff[1] = i & 0xFF;
+	
+	// pack processed payload data
+	MQTTProtocol_DataPack((en_Protocol_CommType_t)CommType, &DataBuff[0]);
+}
+
+/**
+  * @Brief	Pack the Get New Firmware Version command payload
+  * @Param	CommType	: communication type
+  *			PackageIndex: index of target package 
+  *			pVersion	: Version of New Firmware to download
+  * @Retval	None
+  *	@Note	FrameID	: used for identifying dataframe, server will response the same FrameID to indicate receiving the corresponding dataframe
+  */
+void MQTTProtocol_GetNewFirmware_DataPack(unsigned char CommType, unsigned short PackageIndex, unsigned char *pVersion)
+{
+	unsigned char DataBuff[100];
+	unsigned short i;
+	
+	static unsigned char FrameID = 0;	// indicate the index of request dataframe
+	
+	i = 2;
+	
+	DataBuff[i++] = PROTOCOL_TERMINAL_REQUEST_UPDATE_FIRMWARE;	// CommandCode
+	DataBuff[i++] = 0;			// payload length
+	DataBuff[i++] = 0;			// payload length
+	DataBuff[i++] = FrameID++;
+	
+	DataBuff[i++] = *pVersion;	// Version high byte
+	pVersion++;
+	DataBuff[i++] = *pVersion;	// Version low byte
+	
+	DataBuff[i++] = (PackageIndex >> 8) & 0xFF;
+	DataBuff[i++] = PackageIndex & 0xFF;
+	
+	DataBuff[0] = (i >> 8) & 0xFF;
+	DataBuff[1] = i & 0xFF;
+	
+	DataBuff[3] = 0;
+	DataBuff[4] = 5;
+	
+	// pack processed payload data
+	MQTTProtocol_DataPack((en_Protocol_CommType_t)CommType, &DataBuff[0]);
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Pack the provided payload to prepare(add Header and XORCheck) the final MQTT_Protocol DataFrame to the server
+  * @Param	CommType: communication type
+  *			pData	: point to the provided data(Data Length: first 2 byte)
+  * @Retval	None
+  */
+static void MQTTProtocol_DataPack(en_Protocol_CommType_t CommType, unsigned char *pData)
+{
+	unsigned char XORCheck;
+	static unsigned char DataBuff[MQTT_PROTOCOL_DATA_SIZE_MAX + 5];
+	unsigned char Published;
+	unsigned short Len;
+	unsigned short i;
+	
+	Published = 0;
+	
+	Len = pData[0];
+	Len <<= 8;
+	Len |= pData[1];
+	
+	XORCheck = 0;
+	
+	DataBuff[2] = 0xAA;								// Header
+	DataBuff[3] = (Len >> 8) & 0xFF;	// Length highbyte
+	DataBuff[4] = Len & 0xFF;					// Length lowbyte
+	
+	Len -= 2;
+	
+	XORCheck = DataBuff[3];
+	XORCheck ^= DataBuff[4];
+	
+	for(i=0; i<Len; i++)				// DataPayload
+	{
+		DataBuff[i+5] = pData[i+2];
+		XORCheck ^= pData[i+2];
+	}
+	
+	Len = Len + 5;
+	
+	DataBuff[Len++] = XORCheck;		// CheckValue
+	DataBuff[Len++] = 0x55;				// Tail
+	
+	Len -= 2;
+	
+	DataBuff[0] = (Len >> 8) & 0xFF;	// Length of whole DataFrame(First 2 byte)
+	DataBuff[1] = Len & 0xFF;
+	
+	/* sendout packed dataframe to the MQTT server according to the specified module */
+	if(CommType == PROTOCOL_COMM_TYPE_WIFI)
+	{
+		if(Mid_WiFi_MQTT_PublishMessage(&DataBuff[0], MQTTPub_Retain) == 0)
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(14);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(14);			// SensorType
+			Published = 1;
 			
-			for(j=0; j<16; j++)
+			/* wait for the broker's answer, reported by MQTTProtocol_PublishResult */
+			if(MQTTPub_InFlightNumber >= MQTT_PUB_INFLIGHT_SUM)		// answers out of track, replay the outbox records, publish the state again
 			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(14, j);		// SensorName
+				MQTTProtocol_OutboxRewind();
+				MQTTProtocol_StateSnapshot_Request();
+				
+				MQTTPub_InFlightNumber = 0;
 			}
 			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(14);		// Sensor ArmType
+			MQTTPub_InFlightMark[(MQTTPub_InFlightHead + MQTTPub_InFlightNumber) % MQTT_PUB_INFLIGHT_SUM] = MQTTPub_OutboxMark;
+			MQTTPub_InFlightClaim[(MQTTPub_InFlightHead + MQTTPub_InFlightNumber) % MQTT_PUB_INFLIGHT_SUM] = MQTTPub_OutboxClaim;
+			MQTTPub_InFlightState[(MQTTPub_InFlightHead + MQTTPub_InFlightNumber) % MQTT_PUB_INFLIGHT_SUM] = MQTTPub_State;
+			MQTTPub_InFlightNumber++;
+		}
+		else if((MQTTPub_OutboxMark != 0xFFFF) || MQTTPub_OutboxClaim)	// not published, read the outbox records again
+		{
+			MQTTProtocol_OutboxRewind();
 			
-			Len += 19;
+			Mid_Outbox_Release(MQTTPub_OutboxClaim, 0);		// newer than the claims in flight, given back after them
 		}
-		break;
+	}
+	else if((MQTTPub_OutboxMark != 0xFFFF) || MQTTPub_OutboxClaim)
+	{
+		MQTTProtocol_OutboxRewind();
+		
+		Mid_Outbox_Release(MQTTPub_OutboxClaim, 0);
+	}
+	
+	/* Terminal state not published: the shadow is ahead of the server, every field published again */
+	if(MQTTPub_State && !Published)
+	{
+		MQTTProtocol_StateSnapshot_Request();
+	}
+	
+	MQTTPub_OutboxMark = 0xFFFF;
+	MQTTPub_OutboxClaim = 0;
+	MQTTPub_Retain = 0;
+	MQTTPub_State = 0;
+}
+
+/**
+  * @Brief	Check whether the EventUpload lane has an event to upload
+  * @Param	Class: priority class of the lane
+  * @Retval	1->event waiting, 0->lane empty
+  *	@Note	The outbox is part of the normal lane
+  */
+static unsigned char MQTTProtocol_EventLane_Ready(unsigned char Class)
+{
+	if(QueueDataLen(Queue_MQTTEventLane[Class]) >= MQTT_EVENT_LANE_RECORD_SIZE)
+	{
+		return 1;
+	}
+	
+	if((Class == MQTT_EVENT_CLASS_NORMAL) && Mid_Outbox_GetUnreadState())
+	{
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Check whether the EventUpload lane has no room for another event
+  * @Param	Class: priority class of the lane
+  * @Retval	1->full, 0->room for another event
+  */
+static unsigned char MQTTProtocol_EventLane_Full(unsigned char Class)
+{
+	if((QueueDataLen(Queue_MQTTEventLane[Class]) + MQTT_EVENT_LANE_RECORD_SIZE) > Queue120_Length)
+	{
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Select the EventUpload lane to take the next event from
+  * @Param	None
+  * @Retval	Priority class of the lane, MQTT_EVENT_CLASS_SUM->all lanes empty
+  *	@Note	Highest class first, a lower lane passed over MQTT_EVENT_LANE_STARVE_MAX times is selected once instead
+  */
+static unsigned char MQTTProtocol_EventLane_Select(void)
+{
+	unsigned char Class;
+	unsigned char Select = MQTT_EVENT_CLASS_SUM;
+	
+	for(Class=0; Class<MQTT_EVENT_CLASS_SUM; Class++)
+	{
+		if(!MQTTProtocol_EventLane_Ready(Class))
+		{
+			continue;
+		}
+		
+		if(Select == MQTT_EVENT_CLASS_SUM)
+		{
+			Select = Class;
+		}
+		else if(MQTTEventLane_SkipNumber[Class] >= MQTT_EVENT_LANE_STARVE_MAX)	// starving lower lane
+		{
+			Select = Class;
+			
+			stu_MQTTEventBatchStat.Class[Class].StarveNumber++;
+			
+			break;
+		}
+	}
+	
+	if(Select == MQTT_EVENT_CLASS_SUM)
+	{
+		return Select;
+	}
+	
+	/* the lower lanes waiting are passed over once more */
+	for(Class=Select+1; Class<MQTT_EVENT_CLASS_SUM; Class++)
+	{
+		if(MQTTProtocol_EventLane_Ready(Class) && (MQTTEventLane_SkipNumber[Class] < 0xFF))
+		{
+			MQTTEventLane_SkipNumber[Class]++;
+		}
+	}
+	
+	MQTTEventLane_SkipNumber[Select] = 0;
+	
+	return Select;
+}
+
+/**
+  * @Brief	Take the oldest event of the EventUpload lane, pack it into the batch / publish the request directly
+  * @Param	CommType: communication type
+  *			Class	: priority class of the lane
+  * @Retval	1->request published directly, 0->event packed into the batch / ignored, 0xFF->outbox waits for the alarm lane
+  */
+static unsigned char MQTTProtocol_EventLane_Out(en_Protocol_CommType_t CommType, unsigned char Class)
+{
+	stu_Outbox_Record_t OutboxRecord;
+	unsigned char DataBuff[MQTT_EVENT_LANE_RECORD_SIZE];
+	unsigned char RecordNumber;
+	unsigned short QueueInTick;
+	unsigned char i;
+	
+	RecordNumber = MQTTEventBatch_RecordNumber;
+	
+	if(QueueDataLen(Queue_MQTTEventLane[Class]) >= MQTT_EVENT_LANE_RECORD_SIZE)
+	{
+		for(i=0; i<MQTT_EVENT_LANE_RECORD_SIZE; i++)
+		{
+			QueueDataOut(Queue_MQTTEventLane[Class], &DataBuff[i]);
+		}
+		
+		QueueInTick = (DataBuff[2] << 8) | DataBuff[3];
+		
+		if(MQTTProtocol_EventUpload_Dispatch(CommType, DataBuff[0], DataBuff[1], QueueInTick, Mid_Clock_GetDateTime()))
+		{
+			MQTTProtocol_EventClass_Latency(Class, QueueInTick);
+			
+			return 1;
+		}
+		
+		if((DataBuff[4] != 0xFF) || (DataBuff[5] != 0xFF))	// claimed outbox record, released with the publish
+		{
+			MQTTEventBatch_ClaimNumber++;
+		}
+	}
+	else
+	{
+		/* journaled events, in the order of the outbox(replayed after link outage / reboot) */
+		if(Mid_Outbox_Read(&OutboxRecord))
+		{
+			return 0xFF;
+		}
+		
+		MQTTEventBatch_OutboxFlag = 1;
+		
+		MQTTProtocol_EventUpload_Dispatch(CommType, OutboxRecord.Event, OutboxRecord.Data, OutboxRecord.QueueInTick, &OutboxRecord.Time[0]);
+	}
+	
+	if(MQTTEventBatch_RecordNumber != RecordNumber)
+	{
+		MQTTEventBatch_Class[RecordNumber] = Class;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Update the latency statistics of the priority class with an event published
+  * @Param	Class		: priority class of the event
+  *			QueueInTick	: OS tick(low 16 bit) when the event was queued-in
+  * @Retval	None
+  */
+static void MQTTProtocol_EventClass_Latency(unsigned char Class, unsigned short QueueInTick)
+{
+	unsigned short Latency;
+	
+	Latency = (OS_GetTickCount() & 0xFFFF) - QueueInTick;
+	
+	stu_MQTTEventBatchStat.Class[Class].EventNumber++;
+	stu_MQTTEventBatchStat.Class[Class].LatencySum += Latency;
+	
+	if(Latency > stu_MQTTEventBatchStat.Class[Class].LatencyMax)
+	{
+		stu_MQTTEventBatchStat.Class[Class].LatencyMax = Latency;
+	}
+}
+
+/**
+  * @Brief	Pack the event into the EventUpload batch / publish the request directly
+  * @Param	CommType	: communication type
+  *			Event		: event index
+  *			Data		: message index
+  *			QueueInTick	: OS tick(low 16 bit) when the event was raised
+  *			pTime		: point to the SystemTime when the event was raised
+  * @Retval	1->request published directly(one publish per polling), 0->event packed into the batch / ignored
+  */
+static unsigned char MQTTProtocol_EventUpload_Dispatch(en_Protocol_CommType_t CommType, unsigned char Event, unsigned char Data, unsigned short QueueInTick, unsigned char *pTime)
+{
+	switch(Event)
+	{
+		case TERMINAL_UPEVENT_UPDATE_CHECK:
+		{
+			MQTTProtocol_NewFirmwareCheck_DataPack(CommType);
+			
+			return 1;	// one publish per polling
+		}
+		
+		case TERMINAL_UPEVENT_GET_SYSTIME:
+		{
+			MQTTProtocol_TerminalRequest_SystemTime(CommType);
+			
+			return 1;	// one publish per polling
+		}
+		
+		case TERMINAL_UPEVENT_LINK_TELEMETRY:
+		{
+			MQTTProtocol_LinkTelemetry_DataPack(CommType);
+			
+			return 1;	// one publish per polling
+		}
+		
+		case TERMINAL_UPEVENT_DETECTOR_ALARM:
+		{
+			MQTTProtocol_EventBatch_Add(Data, TERMINAL_UPEVENT_DETECTOR_ALARM, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+			
+			MQTTProtocol_EventBatch_AlarmFlush();
+		}			
+		break;
+		
+		case TERMINAL_UPEVENT_DETECTOR_OFFLINE:
+		{
+			MQTTProtocol_EventBatch_Add(Data, TERMINAL_UPEVENT_DETECTOR_OFFLINE, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_DETECTOR_ONLINE:
+		{
+			MQTTProtocol_EventBatch_Add(Data, TERMINAL_UPEVENT_DETECTOR_ONLINE, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_DETECTOR_BATLOW:
+		{
+			MQTTProtocol_EventBatch_Add(Data, TERMINAL_UPEVENT_DETECTOR_BATLOW, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}					
+		break;
+		
+		case TERMINAL_UPEVENT_DETECTOR_ALARM_TEMPER:
+		{
+			
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_HOST_ALARM_SOS:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOST_ALARM_SOS, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+			
+			MQTTProtocol_EventBatch_AlarmFlush();
+		}	
+		break;
+		
+		case TERMINAL_UPEVENT_HOST_BATLOW:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOST_BATLOW, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_HOST_AC_DISCONN:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOST_AC_DISCONN, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_HOST_AC_CONNECT:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOST_AC_CONNECT, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_DOOR_OPEN:
+		{
+			MQTTProtocol_EventBatch_Add(Data, TERMINAL_UPEVENT_DOOR_OPEN, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_DOOR_CLOSE:
+		{
+			MQTTProtocol_EventBatch_Add(Data, TERMINAL_UPEVENT_DOOR_CLOSE, ENDPOINT_MESSAGE_UPLOAD, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_AWAYARM_BY_HOST:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_AWAYARM_BY_HOST, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_AWAYARM_BY_REMOTE:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_AWAYARM_BY_REMOTE, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_AWAYARM_BY_SERVER:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_AWAYARM_BY_SERVER, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_HOMEARM_BY_HOST:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOMEARM_BY_HOST, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_HOMEARM_BY_REMOTE:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOMEARM_BY_REMOTE, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_HOMEARM_BY_SERVER:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_HOMEARM_BY_SERVER, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+	
+		case TERMINAL_UPEVENT_DISARM_BY_HOST:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_DISARM_BY_HOST, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_DISARM_BY_REMOTE:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_DISARM_BY_REMOTE, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+		case TERMINAL_UPEVENT_DISARM_BY_SERVER:
+		{
+			MQTTProtocol_EventBatch_Add(0xFF, TERMINAL_UPEVENT_DISARM_BY_SERVER, ENDPOINT_TERMINAL_WORMODE_CHANGE, QueueInTick, pTime);
+		}
+		break;
+		
+	}	
+	return 0;
+}
+
+/**
+  * @Brief	Pack one EventUpload record: SystemTime + SensorName(Terminal: "HOST") + Message
+  * @Param	pRecord		: point to the buffer to store the record(at least MQTT_EVENT_RECORD_SIZE_MAX bytes)
+  *			ZoneNo		: 0xFF->Terminal / Server, 1-20->Sensor
+  *			EventType	: event type
+  *			Endpoint	: manage the different datapackage (messgae upload, Terminal arm mode change)
+  * @Retval	Length of the record
+  */
+static unsigned char MQTTProtocol_EventRecord_Pack(unsigned char *pRecord, unsigned char *pTime, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint)
+{
+	unsigned char i, j;
+	
+	i = 0;
+	
+	pRecord[i++] = pTime[0];					// year
+	pRecord[i++] = pTime[1];					// year
+	pRecord[i++] = pTime[2];					// year
+	pRecord[i++] = pTime[3];					// year
+	pRecord[i++] = pTime[4];					// '-'
+	pRecord[i++] = pTime[5];					// month
+	pRecord[i++] = pTime[6];					// month
+	pRecord[i++] = pTime[7];					// '-'
+	pRecord[i++] = pTime[8];					// day
+	pRecord[i++] = pTime[9];					// day
+	pRecord[i++] = '-';							
+	pRecord[i++] = pTime[11];					// hour
+	pRecord[i++] = pTime[12];					// hour
+	pRecord[i++] = pTime[13];					// ':'
+	pRecord[i++] = pTime[14];					// minute
+	pRecord[i++] = pTime[15];					// minute
+	pRecord[i++] = ' ';
+	
+	if(Endpoint == ENDPOINT_MESSAGE_UPLOAD)
+	{
+		/* event from Terminal */
+		if(ZoneNo == 0xFF)
+		{
+			pRecord[i++] = 'H';
+			pRecord[i++] = 'O';
+			pRecord[i++] = 'S';
+			pRecord[i++] = 'T';
+		
+			for(j=0; j<12; j++)
+			{
+				pRecord[i++] = ' '; 	// leave SensorName blank
+			}
+		}
+		/* event from Sensor */
+		else
+		{
+			ZoneNo -= 1;	// SensorIndex = ZoneNo - 1
+		
+			for(j=0; j<16; j++)
+			{
+				pRecord[i++] = Device_Get_SensorPara_SensorName(ZoneNo, j);	// SensorName
+			}
+		}
+	
+		/* add payload message */
+		if((EventType >= TERMINAL_UPEVENT_DETECTOR_ALARM) && (EventType <= TERMINAL_UPEVENT_DOOR_CLOSE))
+		{
+			for(j=0; j<18; j++)
+			{
+				pRecord[i++] = MQTTEventUpload_FunctionMessage[EventType - TERMINAL_UPEVENT_DETECTOR_ALARM][j];
+			}
+		}
+	}
+	else if(Endpoint == ENDPOINT_TERMINAL_WORMODE_CHANGE)
+	{
+		if((EventType >= TERMINAL_UPEVENT_AWAYARM_BY_HOST) && (EventType <= TERMINAL_UPEVENT_DISARM_BY_SERVER))
+		{
+			for(j=0; j<20; j++)
+			{
+				pRecord[i++] = MQTTEventUpload_ArmMessage[EventType - TERMINAL_UPEVENT_AWAYARM_BY_HOST][j];
+			}
+		}
+	}
+	
+	return i;
+}
+
+/**
+  * @Brief	Pack one compact EventUpload record: Epoch + EventCode + Zone + Flags(+ SensorType)
+  * @Param	pRecord		: point to the buffer to store the record(at least MQTT_EVENT_RECORD_SIZE_MAX bytes)
+  *			pTime		: point to the SystemTime when the event was raised
+  *			ZoneNo		: 0xFF->Terminal / Server, 1-20->Sensor
+  *			EventType	: event type
+  *			Endpoint	: manage the different datapackage (messgae upload, Terminal arm mode change)
+  * @Retval	Length of the record
+  *	@Note	SensorName and message text are left to the server(looked up by Zone / EventCode)
+  */
+static unsigned char MQTTProtocol_EventRecord_PackCompact(unsigned char *pRecord, unsigned char *pTime, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint)
+{
+	unsigned long Epoch;
+	unsigned char i;
+	
+	Epoch = TimeStamp_DateTime_ToTimeStamp(pTime);
+	
+	i = 0;
+	
+	pRecord[i++] = (Epoch >> 24) & 0xFF;		// Epoch
+	pRecord[i++] = (Epoch >> 16) & 0xFF;
+	pRecord[i++] = (Epoch >> 8) & 0xFF;
+	pRecord[i++] = Epoch & 0xFF;
+	
+	pRecord[i++] = EventType;					// EventCode
+	pRecord[i++] = ZoneNo;						// Zone
+	
+	/* event from Sensor: add SensorType */
+	if((Endpoint == ENDPOINT_MESSAGE_UPLOAD) && (ZoneNo >= 1) && (ZoneNo <= SENSOR_NUMBER_MAX))
+	{
+		pRecord[i++] = MQTT_EVENT_COMPACT_FLAG_SENSOR_TYPE;		// Flags
+		pRecord[i++] = Device_Get_SensorPara_Sensor_Type(ZoneNo - 1);
+	}
+	else
+	{
+		pRecord[i++] = 0;						// Flags
+	}
+	
+	return i;
+}
+
+/**
+  * @Brief	Pack the event into the EventUpload batch as a RecordLength/Record pair
+  * @Param	ZoneNo		: 0xFF->Terminal / Server, 1-20->Sensor
+  *			EventType	: event type
+  *			Endpoint	: manage the different datapackage (messgae upload, Terminal arm mode change)
+  *			QueueInTick	: OS tick(low 16 bit) when the event was queued-in
+  *			pTime		: point to the SystemTime when the event was raised
+  * @Retval	None
+  *	@Note	Free space of the batch must be checked in advance
+  */
+static void MQTTProtocol_EventBatch_Add(unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint, unsigned short QueueInTick, unsigned char *pTime)
+{
+	unsigned char *pRecord;
+	
+	/* the first record latches the format of the batch */
+	if(MQTTEventBatch_RecordNumber == 0)
+	{
+		MQTTEventBatch_Format = MQTTEvent_Format;
+	}
+	
+	pRecord = &MQTTEventBatch_Buff[5 + MQTTEventBatch_PayloadLen];
+	
+	if(MQTTEventBatch_Format == MQTT_EVENT_FORMAT_COMPACT)
+	{
+		pRecord[0] = MQTTProtocol_EventRecord_PackCompact(&pRecord[1], pTime, ZoneNo, EventType, Endpoint);
+	}
+	else
+	{
+		pRecord[0] = MQTTProtocol_EventRecord_Pack(&pRecord[1], pTime, ZoneNo, EventType, Endpoint);
+	}
+	
+	MQTTEventBatch_PayloadLen += pRecord[0] + 1;
+	MQTTEventBatch_QueueInTick[MQTTEventBatch_RecordNumber++] = QueueInTick;
+}
+
+/**
+  * @Brief	Check whether the EventUpload batch has no room for another record
+  * @Param	None
+  * @Retval	1->full, 0->room for another record
+  */
+static unsigned char MQTTProtocol_EventBatch_Full(void)
+{
+	if((MQTTEventBatch_RecordNumber >= MQTT_EVENT_BATCH_RECORD_MAX) || 
+	   ((MQTTEventBatch_PayloadLen + 1 + MQTT_EVENT_RECORD_SIZE_MAX) > MQTT_EVENT_BATCH_SIZE_MAX))
+	{
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Mark the EventUpload batch to be published immediately(alarm-class event joined)
+  * @Param	None
+  * @Retval	None
+  */
+static void MQTTProtocol_EventBatch_AlarmFlush(void)
+{
+	MQTTEventBatch_FlushFlag = 1;
+	
+	stu_MQTTEventBatchStat.AlarmFlushNumber++;
+}
+
+/**
+  * @Brief	Publish the EventUpload batch and update the statistics
+  * @Param	CommType: communication type
+  * @Retval	None
+  *	@Note	Text format: single record batch is sent as the classic EventUpload dataframe(Command 0x51)
+  *			Compact format: Version is inserted ahead of RecordNumber(Command 0x54)
+  */
+static void MQTTProtocol_EventBatch_Publish(en_Protocol_CommType_t CommType)
+{
+	unsigned short Len;
+	unsigned short Latency;
+	unsigned short Tick;
+	unsigned char i;
+	
+	MQTTEventBatch_FlushFlag = 0;
+	
+	if(MQTTEventBatch_RecordNumber == 0)
+	{
+		return;
+	}
+	
+	if(MQTTEventBatch_Format == MQTT_EVENT_FORMAT_COMPACT)
+	{
+		Len = MQTTEventBatch_PayloadLen;
+		
+		for(i=Len; i>0; i--)	// make room for Version
+		{
+			MQTTEventBatch_Buff[5 + i] = MQTTEventBatch_Buff[4 + i];
+		}
+		
+		Len += 1;
+		
+		MQTTEventBatch_Buff[2] = PROTOCOL_TERMINAL_EVENT_COMPACT;
+		MQTTEventBatch_Buff[5] = MQTT_EVENT_COMPACT_VERSION;
+		MQTTEventBatch_Buff[6] = MQTTEventBatch_RecordNumber;
+	}
+	else if(MQTTEventBatch_RecordNumber == 1)
+	{
+		Len = MQTTEventBatch_Buff[6];
+		
+		for(i=0; i<Len; i++)	// drop RecordNumber and RecordLength
+		{
+			MQTTEventBatch_Buff[5 + i] = MQTTEventBatch_Buff[7 + i];
+		}
+		
+		MQTTEventBatch_Buff[2] = PROTOCOL_TERMINAL_RESPONSE;
+	}
+	else
+	{
+		Len = MQTTEventBatch_PayloadLen;
+		
+		MQTTEventBatch_Buff[2] = PROTOCOL_TERMINAL_EVENT_BATCH;
+		MQTTEventBatch_Buff[5] = MQTTEventBatch_RecordNumber;
+	}
+	
+	MQTTEventBatch_Buff[3] = (Len >> 8) & 0xFF;		// payload length
+	MQTTEventBatch_Buff[4] = Len & 0xFF;
+	
+	Len += 5;
+	
+	MQTTEventBatch_Buff[0] = (Len >> 8) & 0xFF;		// DataFrame length
+	MQTTEventBatch_Buff[1] = Len & 0xFF;
+	
+	/* outbox records are acked when the broker accepts this publish */
+	if(MQTTEventBatch_OutboxFlag)
+	{
+		MQTTEventBatch_OutboxFlag = 0;
+		
+		MQTTPub_OutboxMark = Mid_Outbox_GetReadMark();
+	}
+	
+	MQTTPub_OutboxClaim = MQTTEventBatch_ClaimNumber;
+	MQTTEventBatch_ClaimNumber = 0;
+	
+	MQTTProtocol_DataPack(CommType, &MQTTEventBatch_Buff[0]);
+	
+	/* statistics */
+	Tick = OS_GetTickCount() & 0xFFFF;
+	
+	for(i=0; i<MQTTEventBatch_RecordNumber; i++)
+	{
+		Latency = Tick - MQTTEventBatch_QueueInTick[i];
+		
+		stu_MQTTEventBatchStat.LatencySum += Latency;
+		
+		if(Latency > stu_MQTTEventBatchStat.LatencyMax)
+		{
+			stu_MQTTEventBatchStat.LatencyMax = Latency;
+		}
+		
+		MQTTProtocol_EventClass_Latency(MQTTEventBatch_Class[i], MQTTEventBatch_QueueInTick[i]);
+	}
+	
+	stu_MQTTEventBatchStat.EventNumber += MQTTEventBatch_RecordNumber;
+	stu_MQTTEventBatchStat.FrameNumber++;
+	
+	/* reset batch */
+	MQTTEventBatch_RecordNumber = 0;
+	MQTTEventBatch_PayloadLen = 1;	// RecordNumber
+}
+
+/**
+  * @Brief	Check whether the uplink of specified communication type can take a publish now
+  * @Param	CommType: communication type
+  * @Retval	1->ready, 0->not ready
+  */
+static unsigned char MQTTProtocol_UplinkReady(en_Protocol_CommType_t CommType)
+{
+	if(MQTTPub_InFlightNumber >= MQTT_PUB_INFLIGHT_MAX)
+	{
+		return 0;
+	}
+	
+	if(CommType == PROTOCOL_COMM_TYPE_WIFI)
+	{
+		return Mid_WiFi_MQTT_PublishReady();
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Check whether the event is journaled in the outbox
+  * @Param	Event: Event index
+  * @Retval	1->terminal event(journaled), 0->request to the server(not journaled)
+  */
+static unsigned char MQTTProtocol_EventJournalCheck(unsigned char Event)
+{
+	if((Event >= TERMINAL_UPEVENT_DETECTOR_ALARM) && (Event <= TERMINAL_UPEVENT_DISARM_BY_SERVER) && 
+	   (Event != TERMINAL_UPEVENT_DETECTOR_ALARM_TEMPER))
+	{
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Handle the broker's answer of the oldest publish in flight(CBF of WiFi MQTT publish result)
+  * @Param	Result: en_WiFi_MQTTPubResult_t
+  * @Retval	None
+  *	@Note	OK->ack the outbox records of the publish, FAIL/LOST->replay the outbox records not acked,
+  *			records claimed by the alarm lane are marked delivered(OK) / given back to the replay(FAIL/LOST),
+  *			Terminal state not delivered(FAIL/LOST)->snapshot published again
+  */
+static void MQTTProtocol_PublishResult(unsigned char Result)
+{
+	unsigned short Mark;
+	unsigned char i;
+	
+	if(Result == WIFI_MQTT_PUB_LOST)
+	{
+		for(i=0; i<MQTTPub_InFlightNumber; i++)
+		{
+			if(MQTTPub_InFlightState[(MQTTPub_InFlightHead + i) % MQTT_PUB_INFLIGHT_SUM])
+			{
+				MQTTProtocol_StateSnapshot_Request();
+			}
+		}
+		
+		MQTTProtocol_OutboxRewind();
+		
+		MQTTPub_InFlightNumber = 0;
+		
+		return;
+	}
+	
+	if(MQTTPub_InFlightNumber == 0)
+	{
+		return;
+	}
+	
+	if((Result != WIFI_MQTT_PUB_OK) && MQTTPub_InFlightState[MQTTPub_InFlightHead])
+	{
+		MQTTProtocol_StateSnapshot_Request();
+	}
+	
+	Mark = MQTTPub_InFlightMark[MQTTPub_InFlightHead];
+	
+	Mid_Outbox_Release(MQTTPub_InFlightClaim[MQTTPub_InFlightHead], (Result == WIFI_MQTT_PUB_OK) ? 1 : 0);
+	
+	MQTTPub_InFlightHead = (MQTTPub_InFlightHead + 1) % MQTT_PUB_INFLIGHT_SUM;
+	MQTTPub_InFlightNumber--;
+	
+	if(Mark == 0xFFFF)	// publish without outbox record
+	{
+		return;
+	}
+	
+	if(Result == WIFI_MQTT_PUB_OK)
+	{
+		Mid_Outbox_Ack(Mark);
+	}
+	else
+	{
+		MQTTProtocol_OutboxRewind();
+	}
+}
+
+/**
+  * @Brief	Give the outbox records in flight back for replay
+  * @Param	None
+  * @Retval	None
+  *	@Note	A batch holding outbox records is dropped too, the records are read out again in order,
+  *			claims are given back oldest first: publishes in flight, then the batch(claimed in the same order)
+  */
+static void MQTTProtocol_OutboxRewind(void)
+{
+	unsigned char i;
+	
+	Mid_Outbox_Rewind();
+	
+	for(i=0; i<MQTTPub_InFlightNumber; i++)
+	{
+		Mid_Outbox_Release(MQTTPub_InFlightClaim[(MQTTPub_InFlightHead + i) % MQTT_PUB_INFLIGHT_SUM], 0);
+		
+		MQTTPub_InFlightClaim[(MQTTPub_InFlightHead + i) % MQTT_PUB_INFLIGHT_SUM] = 0;
+	}
+	
+	if(MQTTEventBatch_OutboxFlag)
+	{
+		Mid_Outbox_Release(MQTTEventBatch_ClaimNumber, 0);
+		
+		MQTTEventBatch_ClaimNumber = 0;
+		MQTTEventBatch_OutboxFlag = 0;
+		MQTTEventBatch_FlushFlag = 0;
+		MQTTEventBatch_RecordNumber = 0;
+		MQTTEventBatch_PayloadLen = 1;	// RecordNumber
+	}
+}
+
+/**
+  * @Brief	Read the current Terminal state fields
+  * @Param	pField: point to the buffer to store the fields(MQTT_STATE_FIELD_SUM byte, en_MQTTStateField_t order)
+  * @Retval	None
+  */
+static void MQTTProtocol_State_Read(unsigned char *pField)
+{
+	unsigned char i;
+	
+	pField[MQTT_STATE_FIELD_WORKMODE] = pTerminalMode->WorkMode;
+	pField[MQTT_STATE_FIELD_POWER] = Mid_PowerManage_GetACState() | (Mid_PowerManage_GetBatteryLow() << 1);
+	
+	for(i=0; i<SENSOR_NUMBER_MAX; i++)
+	{
+		if(Device_Get_SensorPara_PairFlag(i))
+		{
+			pField[MQTT_STATE_FIELD_SENSOR + i] = 0x01 | 
+												  ((Device_Get_SensorPara_SleepTime(i) <= SENSOR_OFFLINE_COUNT) ? 0x02 : 0x00) | 
+												  ((Device_Get_SensorPara_Sensor_ArmType(i) & 0x03) << 2) | 
+												  ((Device_Get_SensorPara_Sensor_Type(i) & 0x0F) << 4);
+		}
+		else
+		{
+			pField[MQTT_STATE_FIELD_SENSOR + i] = 0;
+		}
+	}
+}
+
+/**
+  * @Brief	Publish the Terminal state snapshot if requested, otherwise the state delta if any field changed
+  * @Param	CommType: communication type
+  * @Retval	1->dataframe published, 0->nothing to publish
+  *	@Note	The snapshot is retained by the broker, the fields are checked every MQTT_STATE_CHECK_PERIOD.
+  *			The deltas are not retained: the snapshot is published again once the fields are unchanged
+  *			for MQTT_STATE_RETAIN_DELAY, a subscriber joining later gets the fields merged.
+  *			The shadow holds the fields published, a snapshot / delta not delivered requests the snapshot again
+  */
+static unsigned char MQTTProtocol_State_Pro(en_Protocol_CommType_t CommType)
+{
+	static unsigned char DataBuff[5 + 4 + MQTT_STATE_FIELD_SUM * 2];
+	unsigned char Field[MQTT_STATE_FIELD_SUM];
+	unsigned char Number;
+	unsigned short Len;
+	unsigned char i;
+	
+	/* retained snapshot behind the deltas: brought up to date once the fields settle */
+	if(MQTTState_RetainFlag && ((unsigned short)(OS_GetTickCount() - MQTTState_DeltaTick) >= MQTT_STATE_RETAIN_DELAY))
+	{
+		MQTTState_SnapshotFlag = 1;
+	}
+	
+	if(!MQTTState_SnapshotFlag && 
+	   ((unsigned short)(OS_GetTickCount() - MQTTState_CheckTick) < MQTT_STATE_CHECK_PERIOD))
+	{
+		return 0;
+	}
+	
+	MQTTState_CheckTick = OS_GetTickCount() & 0xFFFF;
+	
+	MQTTProtocol_State_Read(&Field[0]);
+	
+	Len = 5;
+	
+	DataBuff[Len++] = MQTT_STATE_VERSION;				// Version
+	
+	/* snapshot: every field */
+	if(MQTTState_SnapshotFlag)
+	{
+		MQTTState_SnapshotFlag = 0;
+		MQTTState_RetainFlag = 0;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_16_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(15);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(15);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(15, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(15);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		DataBuff[Len++] = (MQTTState_Seq >> 8) & 0xFF;	// StateSeq
+		DataBuff[Len++] = MQTTState_Seq & 0xFF;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_17_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(16);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(16);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(16, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(16);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		DataBuff[Len++] = Device_Get_SystemPara_FirmwareVersion(0);		// FirmwareVersion high byte
+		DataBuff[Len++] = Device_Get_SystemPara_FirmwareVersion(1);		// FirmwareVersion low byte
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_18_INFO:
-		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(17);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(17);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(17, j);		// SensorName
-			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(17);		// Sensor ArmType
-			
-			Len += 19;
-		}
-		break;
+		DataBuff[Len++] = MQTT_STATE_FIELD_SUM;			// FieldNumber
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_19_INFO:
+		for(i=0; i<MQTT_STATE_FIELD_SUM; i++)
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(18);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(18);			// SensorType
-			
-			for(j=0; j<16; j++)
-			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(18, j);		// SensorName
-			}
+			DataBuff[Len++] = Field[i];
 			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(18);		// Sensor ArmType
-			
-			Len += 19;
+			MQTTState_Shadow[i] = Field[i];
 		}
-		break;
 		
-		case PROTOCOL_SERVER_REQUEST_DEVICE_20_INFO:
+		DataBuff[2] = PROTOCOL_TERMINAL_STATE_SNAPSHOT;
+		
+		MQTTPub_Retain = 1;
+	}
+	/* delta: changed fields only */
+	else
+	{
+		Number = 0;
+		
+		Len += 3;	// StateSeq + FieldNumber
+		
+		for(i=0; i<MQTT_STATE_FIELD_SUM; i++)
 		{
-			DataBuff[i++] = Device_Get_SensorPara_ID(19);					// SensorID
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_Type(19);			// SensorType
-			
-			for(j=0; j<16; j++)
+			if(Field[i] != MQTTState_Shadow[i])
 			{
-				DataBuff[i++] = Device_Get_SensorPara_SensorName(19, j);		// SensorName
+				DataBuff[Len++] = i;					// FieldID
+				DataBuff[Len++] = Field[i];
+				
+				MQTTState_Shadow[i] = Field[i];
+				Number++;
 			}
-			
-			DataBuff[i++] = Device_Get_SensorPara_Sensor_ArmType(19);		// Sensor ArmType
-			
-			Len += 19;
 		}
-		break;	
 		
-		case PROTOCOL_SERVER_REQUEST_SET_WORKMODE_AWAYARM:
+		if(Number == 0)
 		{
-			App_Terminal_ModeChange(0xFF, TERMINAL_WORK_MODE_AWAYARM, TERMINAL_CMD_SOURCE_SERVER);
-			
-			DataBuff[i++] = 'S';
-			DataBuff[i++] = 'e';
-			DataBuff[i++] = 't';
-			DataBuff[i++] = ' ';
-			DataBuff[i++] = 'O';
-			DataBuff[i++] = 'K';
-
-			Len += 6;
+			return 0;
 		}
-		break;
 		
-		case PROTOCOL_SERVER_REQUEST_SET_WORKMODE_HOMEARM:
-		{
-			App_Terminal_ModeChange(0xFF, TERMINAL_WORK_MODE_HOMEARM, TERMINAL_CMD_SOURCE_SERVER);
-			
-			DataBuff[i++] = 'S';
-			DataBuff[i++] = 'e';
-			DataBuff[i++] = 't';
-			DataBuff[i++] = ' ';
-			DataBuff[i++] = 'O';
-			DataBuff[i++] = 'K';
-
-			Len += 6;
-		}
-		break;
+		MQTTState_Seq++;
 		
-		case PROTOCOL_SERVER_REQUEST_SET_WORKMODE_DISARM:
-		{
-			App_Terminal_ModeChange(0xFF, TERMINAL_WORK_MODE_DISARM, TERMINAL_CMD_SOURCE_SERVER);
-			
-			DataBuff[i++] = 'S';
-			DataBuff[i++] = 'e';
-			DataBuff[i++] = 't';
-			DataBuff[i++] = ' ';
-			DataBuff[i++] = 'O';
-			DataBuff[i++] = 'K';
-
-			Len += 6;
-		}
-		break;
+		MQTTState_RetainFlag = 1;
+		MQTTState_DeltaTick = OS_GetTickCount() & 0xFFFF;
 		
-		case PROTOCOL_SERVER_REQUEST_SET_WORKMODE_ALARM:
-		{
-			App_Terminal_ModeChange(0xFF, TERMINAL_WORK_MODE_ALARMING, TERMINAL_CMD_SOURCE_SERVER);
-			
-			DataBuff[i++] = 'S';
-			DataBuff[i++] = 'e';
-			DataBuff[i++] = 't';
-			DataBuff[i++] = ' ';
-			DataBuff[i++] = 'O';
-			DataBuff[i++] = 'K';
-
-			Len += 6;
-		}
-		break;
+		DataBuff[6] = (MQTTState_Seq >> 8) & 0xFF;		// StateSeq
+		DataBuff[7] = MQTTState_Seq & 0xFF;
+		DataBuff[8] = Number;							// FieldNumber
 		
-		case PROTOCOL_SERVER_REQUEST_ERROR:
-		{
-			DataBuff[i++] = 'E';
-			DataBuff[i++] = 'r';
-			DataBuff[i++] = 'r';
-			DataBuff[i++] = 'o';
-			DataBuff[i++] = 'r';
-
-			Len += 5;
-		}
-		break;	
+		DataBuff[2] = PROTOCOL_TERMINAL_STATE_DELTA;
 	}
 	
-	DataBuff[3] = (Len >> 8) & 0xFF;	// payload length
-	DataBuff[4] = Len & 0xFF;			
+	DataBuff[3] = ((Len - 5) >> 8) & 0xFF;				// payload length
+	DataBuff[4] = (Len - 5) & 0xFF;
 	
-	DataBuff[0] = (i >> 8) & 0xFF;		// DataFrame length
-	DataBuff[1] = i & 0xFF;
+	DataBuff[0] = (Len >> 8) & 0xFF;					// DataFrame length
+	DataBuff[1] = Len & 0xFF;
 	
-	// pack processed payload data
-	MQTTProtocol_DataPack((en_Protocol_CommType_t)CommType, &DataBuff[0]);
+	MQTTPub_State = 1;
+	
+	MQTTProtocol_DataPack(CommType, &DataBuff[0]);
+	
+	return 1;
 }
 
 /**
-  * @Brief	Pack the Check New Firmware command payload
-  * @Param	CommType: communication type
-  * @Retval	None
+  * @Brief	Pack the attribute info record of a Device
+  * @Param	pRecord		: point to the buffer to store the record(MQTT_DEVICE_INFO_SIZE byte)
+  *			SensorIndex	: Device index(0 -> SENSOR_NUMBER_MAX-1)
+  * @Retval	Length of the record
   */
-void MQTTProtocol_NewFirmwareCheck_DataPack(unsigned char CommType)
+static unsigned char MQTTProtocol_DeviceInfo_Pack(unsigned char *pRecord, unsigned char SensorIndex)
 {
-	unsigned char DataBuff[100];
-	unsigned short i;
+	unsigned char i, j;
 	
-	i = 2;
+	i = 0;
 	
-	DataBuff[i++] = PROTOCOL_TERMINAL_REQUEST_UPDATE_CHECK;		// CommandCode
-	DataBuff[i++] = 0;	// payload length
-	DataBuff[i++] = 0;	// payload length
+	pRecord[i++] = Device_Get_SensorPara_ID(SensorIndex);					// SensorID
+	pRecord[i++] = Device_Get_SensorPara_Sensor_Type(SensorIndex);			// SensorType
 	
-	DataBuff[0] = (i >> 8) & 0xFF;		// dataframe length high byte
-	DataBuff[1] = i & 0xFF;				// dataframe length low byte
+	for(j=0; j<16; j++)
+	{
+		pRecord[i++] = Device_Get_SensorPara_SensorName(SensorIndex, j);	// SensorName
+	}
 	
-	// pack processed payload data
-	MQTTProtocol_DataPack((en_Protocol_CommType_t)CommType, &DataBuff[0]);
+	pRecord[i++] = Device_Get_SensorPara_Sensor_ArmType(SensorIndex);		// Sensor ArmType
+	
+	return i;
 }
 
 /**
-  * @Brief	Pack the Get New Firmware Version command payload
-  * @Param	CommType	: communication type
-  *			PackageIndex: index of target package 
-  *			pVersion	: Version of New Firmware to download
-  * @Retval	None
-  *	@Note	FrameID	: used for identifying dataframe, server will response the same FrameID to indicate receiving the corresponding dataframe
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_HOST_INFO: FirmwareVersion + MCU-UID
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: not used
+  *			Arg		: not used
+  * @Retval	Payload length
   */
-void MQTTProtocol_GetNewFirmware_DataPack(unsigned char CommType, unsigned short PackageIndex, unsigned char *pVersion)
+static unsigned short MQTTProtocol_Response_HostInfo(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
 {
-	unsigned char DataBuff[100];
-	unsigned short i;
-	
-	static unsigned char FrameID = 0;	// indicate the index of request dataframe
-	
-	i = 2;
+	unsigned char i, j;
 	
-	DataBuff[i++] = PROTOCOL_TERMINAL_REQUEST_UPDATE_FIRMWARE;	// CommandCode
-	DataBuff[i++] = 0;			// payload length
-	DataBuff[i++] = 0;			// payload length
-	DataBuff[i++] = FrameID++;
+	i = 0;
 	
-	DataBuff[i++] = *pVersion;	// Version high byte
-	pVersion++;
-	DataBuff[i++] = *pVersion;	// Version low byte
+	pPayload[i++] = Device_Get_SystemPara_FirmwareVersion(0);		// FirmwareVersion high byte
+	pPayload[i++] = Device_Get_SystemPara_FirmwareVersion(1);		// FirmwareVersion low byte
 	
-	DataBuff[i++] = (PackageIndex >> 8) & 0xFF;
-	DataBuff[i++] = PackageIndex & 0xFF;
+	pPayload[i++] = 0x00;
+	pPayload[i++] = 0x00;
+	pPayload[i++] = 0x00;
 	
-	DataBuff[0] = (i >> 8) & 0xFF;
-	DataBuff[1] = i & 0xFF;
+	for(j=0; j<12; j++)
+	{
+		pPayload[i++] = Device_Get_MCU_UID(j);		// MCU-UID
+	}
 	
-	DataBuff[3] = 0;
-	DataBuff[4] = 5;
+	return i;
+}
+
+/**
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_WORKMODE: current Terminal WorkMode
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: not used
+  *			Arg		: not used
+  * @Retval	Payload length
+  */
+static unsigned short MQTTProtocol_Response_WorkMode(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
+{
+	/* obtain the current Terminal WorkMode from App module */
+	pPayload[0] = pTerminalMode->WorkMode;
 	
-	// pack processed payload data
-	MQTTProtocol_DataPack((en_Protocol_CommType_t)CommType, &DataBuff[0]);
+	return 1;
 }
 
+/**
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_DEVICE_1_INFO -> PROTOCOL_SERVER_REQUEST_DEVICE_20_INFO
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: Device index
+  *			Arg		: not used
+  * @Retval	Payload length
+  */
+static unsigned short MQTTProtocol_Response_DeviceInfo(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
+{
+	return MQTTProtocol_DeviceInfo_Pack(pPayload, Index);
+}
 
-/*-------------Internal Functions Definition--------*/
 /**
-  * @Brief	Pack the provided payload to prepare(add Header and XORCheck) the final MQTT_Protocol DataFrame to the server
-  * @Param	CommType: communication type
-  *			pData	: point to the provided data(Data Length: first 2 byte)
-  * @Retval	None
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_ALL_DEVICE_INFO: records of the paired Devices from the start index
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: not used
+  *			Arg		: start Device index
+  * @Retval	Payload length
+  *	@Note	Payload: NextIndex(1 byte, 0xFF->last dataframe) + RecordNumber(1 byte) + RecordNumber * Device info record,
+  *			the dataframes from NextIndex are published by MQTTProtocol_EventUpload_Pro without another request
   */
-static void MQTTProtocol_DataPack(en_Protocol_CommType_t CommType, unsigned char *pData)
+static unsigned short MQTTProtocol_Response_AllDeviceInfo(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
 {
-	unsigned char XORCheck;
-	unsigned char DataBuff[200];
 	unsigned short Len;
-	unsigned short i;
+	unsigned char SensorIndex;
+	unsigned char Number;
 	
-	Len = pData[0];
-	Len <<= 8;
-	Len |= pData[1];
+	Len = 2;
+	Number = 0;
 	
-	XORCheck = 0;
+	for(SensorIndex=Arg; SensorIndex<SENSOR_NUMBER_MAX; SensorIndex++)
+	{
+		if(!Device_Get_SensorPara_PairFlag(SensorIndex))
+		{
+			continue;
+		}
+		
+		if(Number >= MQTT_DEVICE_INFO_PER_FRAME)	// no room, continued in the next dataframe
+		{
+			break;
+		}
+		
+		Len += MQTTProtocol_DeviceInfo_Pack(&pPayload[Len], SensorIndex);
+		Number++;
+	}
 	
-	DataBuff[2] = 0xAA;								// Header
-	DataBuff[3] = (Len >> 8) & 0xFF;	// Length highbyte
-	DataBuff[4] = Len & 0xFF;					// Length lowbyte
+	MQTTDeviceSync_NextIndex = (SensorIndex < SENSOR_NUMBER_MAX) ? SensorIndex : 0xFF;
 	
-	Len -= 2;
+	pPayload[0] = MQTTDeviceSync_NextIndex;
+	pPayload[1] = Number;
 	
-	XORCheck = DataBuff[3];
-	XORCheck ^= DataBuff[4];
+	return Len;
+}
+
+/**
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_SET_WORKMODE_AWAYARM -> PROTOCOL_SERVER_REQUEST_SET_WORKMODE_ALARM
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: index of MQTTServerRequest_WorkMode
+  *			Arg		: not used
+  * @Retval	Payload length
+  */
+static unsigned short MQTTProtocol_Response_SetWorkMode(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
+{
+	App_Terminal_ModeChange(0xFF, MQTTServerRequest_WorkMode[Index], TERMINAL_CMD_SOURCE_SERVER);
 	
-	for(i=0; i<Len; i++)				// DataPayload
+	pPayload[0] = 'S';
+	pPayload[1] = 'e';
+	pPayload[2] = 't';
+	pPayload[3] = ' ';
+	pPayload[4] = 'O';
+	pPayload[5] = 'K';
+	
+	return 6;
+}
+
+/**
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_SET_EVENT_FORMAT: select the EventUpload format, reply "Set OK"
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: not used
+  *			Arg		: 0->text, 1->compact
+  * @Retval	Payload length
+  */
+static unsigned short MQTTProtocol_Response_SetEventFormat(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
+{
+	if(Arg >= MQTT_EVENT_FORMAT_SUM)
 	{
-		DataBuff[i+5] = pData[i+2];
-		XORCheck ^= pData[i+2];
+		return MQTTProtocol_Response_Error(pPayload, 0, 0);
 	}
 	
-	Len = Len + 5;
+	MQTTProtocol_SetEventFormat((en_MQTTEventFormat_t)Arg);
 	
-	DataBuff[Len++] = XORCheck;		// CheckValue
-	DataBuff[Len++] = 0x55;				// Tail
+	pPayload[0] = 'S';
+	pPayload[1] = 'e';
+	pPayload[2] = 't';
+	pPayload[3] = ' ';
+	pPayload[4] = 'O';
+	pPayload[5] = 'K';
 	
-	Len -= 2;
+	return 6;
+}
+
+/**
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_STATE_SNAPSHOT: publish the Terminal state snapshot again
+  * @Param	pPayload: not used
+  *			Index	: not used
+  *			Arg		: not used
+  * @Retval	0(answered by the state snapshot dataframe, Command 0x55)
+  */
+static unsigned short MQTTProtocol_Response_StateSnapshot(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
+{
+	MQTTProtocol_StateSnapshot_Request();
 	
-	DataBuff[0] = (Len >> 8) & 0xFF;	// Length of whole DataFrame(First 2 byte)
-	DataBuff[1] = Len & 0xFF;
+	return 0;
+}
+
+/**
+  * @Brief	Responder of PROTOCOL_SERVER_REQUEST_ERROR / unknown request codes
+  * @Param	pPayload: point to the buffer to store the payload
+  *			Index	: not used
+  *			Arg		: not used
+  * @Retval	Payload length
+  */
+static unsigned short MQTTProtocol_Response_Error(unsigned char *pPayload, unsigned char Index, unsigned char Arg)
+{
+	pPayload[0] = 'E';
+	pPayload[1] = 'r';
+	pPayload[2] = 'r';
+	pPayload[3] = 'o';
+	pPayload[4] = 'r';
 	
-	/* sendout packed dataframe to the MQTT server according to the specified module */
-	if(CommType == PROTOCOL_COMM_TYPE_WIFI)
+	return 5;
+}
+
+/**
+  * @Brief	Search the bytes kept by the frame decoder for complete dataframes and handle them
+  * @Param	CommType: communication type
+  *			pDecoder: point to the frame decoder
+  * @Retval	None
+  *	@Note	Bytes in front of a Header are garbage, a Header with invalid DataLength / Tail / CheckValue is dropped
+  *			and the search goes on from the next byte(resynchronization), a partial dataframe waits for more data
+  */
+static void MQTTProtocol_FrameDecode_Scan(en_Protocol_CommType_t CommType, stu_MQTTFrameDecoder_t *pDecoder)
+{
+	unsigned char *pFrame;
+	unsigned short DataLen;
+	unsigned char XORCheck;
+	unsigned short i;
+	
+	while(pDecoder->Number)
+	{
+		pFrame = &pDecoder->Buff[pDecoder->Start];
+		
+		if(pFrame[0] != 0xAA)	// search Header
+		{
+			pDecoder->Start++;
+			pDecoder->Number--;
+			
+			stu_MQTTDownlinkStat.GarbageNumber++;
+			
+			continue;
+		}
+		
+		if(pDecoder->Number < 3)	// wait for DataLength
+		{
+			return;
+		}
+		
+		/* DataLength = Command + DataPayload + CheckValue + Tail */
+		DataLen = (pFrame[1] << 8) | pFrame[2];
+		
+		if((DataLen < 3) || ((DataLen + 3) > MQTT_DOWNLINK_FRAME_SIZE_MAX))
+		{
+			pDecoder->Start++;
+			pDecoder->Number--;
+			
+			stu_MQTTDownlinkStat.LengthErrorNumber++;
+			
+			continue;
+		}
+		
+		if(pDecoder->Number < (DataLen + 3))	// wait for the rest of the dataframe
+		{
+			return;
+		}
+		
+		XORCheck = 0;
+		
+		for(i=1; i<(DataLen + 1); i++)	// DataLength + Command + DataPayload
+		{
+			XORCheck ^= pFrame[i];
+		}
+		
+		if((pFrame[DataLen + 2] != 0x55) || (pFrame[DataLen + 1] != XORCheck))
+		{
+			pDecoder->Start++;
+			pDecoder->Number--;
+			
+			stu_MQTTDownlinkStat.CheckErrorNumber++;
+			
+			continue;
+		}
+		
+		pDecoder->Start += DataLen + 3;
+		pDecoder->Number -= DataLen + 3;
+		
+		stu_MQTTDownlinkStat.DecodeFrameNumber++;
+		
+		MQTTProtocol_ReceiveDataHandler(CommType, pFrame, DataLen + 3);
+	}
+	
+	pDecoder->Start = 0;
+}
+
+/**
+  * @Brief	Resynchronize the frame decoder if a partial dataframe waits too long for the rest
+  * @Param	CommType: communication type
+  * @Retval	None
+  *	@Note	A corrupted DataLength must not hold back the dataframes received after it
+  */
+static void MQTTProtocol_FrameDecode_Timeout(en_Protocol_CommType_t CommType)
+{
+	stu_MQTTFrameDecoder_t *pDecoder;
+	
+	pDecoder = &MQTTFrameDecoder[CommType];
+	
+	if(pDecoder->Number == 0)
 	{
-		Mid_WiFi_MQTT_PublishMessage(&DataBuff[0]);
+		return;
 	}
-	else if(CommType == PROTOCOL_COMM_TYPE_4G)
+	
+	if((unsigned short)((OS_GetTickCount() & 0xFFFF) - pDecoder->InputTick) < MQTT_FRAME_DECODE_TIMEOUT)
 	{
-		
+		return;
 	}
+	
+	/* drop the Header waiting, search the next one in the bytes kept */
+	pDecoder->Start++;
+	pDecoder->Number--;
+	pDecoder->InputTick = OS_GetTickCount() & 0xFFFF;
+	
+	stu_MQTTDownlinkStat.TimeoutNumber++;
+	
+	MQTTProtocol_FrameDecode_Scan(CommType, pDecoder);
 }
 
 /**
   * @Brief	Get the ServerRequestCode from the dataframe received
-  * @Param	CommType: communication type
-  *			pData	: point to the provided data
+  * @Param	CommType	: communication type
+  *			pData		: point to the provided data
+  *			pRequestArg	: point to store the argument byte following the ServerRequestCode(0 if none)
   * @Retval	ServerRequestCode / 0xFF = Error
   *	@Note	pData[0], pData[1]: Data Length(high byte, low byte)
   *			pData[2]		  : CommandCode
@@ -1179,9 +2509,9 @@ static void MQTTProtocol_DataPack(en_Protocol_CommType_t CommType, unsigned char
   *			pData[N-1]		  : XOR value
   *			pData[N]		  : Tail(0x55)
   */
-static en_Protocol_ServerRequestCode_t MQTTProtocol_ReceiveDataParse(en_Protocol_CommType_t CommType, unsigned char *pData)
+static en_Protocol_ServerRequestCode_t MQTTProtocol_ReceiveDataParse(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned char *pRequestArg)
 {
-	unsigned char i;
+	unsigned short i;
 	
 	unsigned char ServerRequestCode;
 	unsigned char XORCheckValue;
@@ -1200,6 +2530,9 @@ static en_Protocol_ServerRequestCode_t MQTTProtocol_ReceiveDataParse(en_Protocol
 	
 	ServerRequestCode = pData[5];
 	
+	/* Payload length > 1: argument follows the ServerRequestCode */
+	*pRequestArg = (((pData[3] << 8) | pData[4]) > 1) ? pData[6] : 0;
+	
 	/* check whether the dataframe is valid and complete */
 	if(XORCheckValue == pData[Len + 2 - 1 - 1])
 	{
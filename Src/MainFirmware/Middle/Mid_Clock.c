@@ -0,0 +1,340 @@
+/****************************************************
+  * @Name	Mid_Clock.c
+  * @Brief	Software wall clock driven by the OS tick, disciplined by the server time
+  * @Instruction:
+  * --> Clock:
+  *		TimeStamp = @BaseEpoch + (@BaseFrac + elapsed ticks - drift correction) / CLOCK_TICK_PER_SECOND
+  *		-------------------------------------------------------------------
+  *		@BaseEpoch	: UNIX TimeStamp at @BaseTick
+  *		@BaseFrac	: ticks of the second started at @BaseTick
+  *		@DriftPPM	: OS tick drift measured between the corrections(+: OS tick fast, ticks taken off)
+  *		@Residual	: remainder of the drift correction carried to the next rebase(unit: 1/1000000 tick)
+  *		-------------------------------------------------------------------
+  *		The clock never goes back for a server time up to CLOCK_HOLD_MAX behind, it holds until caught up
+  *
+  * --> Clock Process:
+  *			Mid_Clock_Sync			: correction from the server(datetime topic / SystemTime response), at most once per CLOCK_SYNC_PERIOD,
+  *									  the drift is measured against the raw OS tick between corrections CLOCK_DRIFT_INTERVAL_MIN apart
+  *			Mid_Clock_GetTimeStamp	: current UNIX TimeStamp(0->no correction received since power on)
+  *			Mid_Clock_GetDateTime	: SystemTime[] string, reformatted only when the minute changed
+  *	 (Poll) Mid_Clock_Pro			: fold the elapsed ticks into the base every CLOCK_REBASE_PERIOD,
+  *									  request the SystemTime if no correction for CLOCK_SYNC_TIMEOUT
+  *
+  *	@Note	No RTC driver in Hal layer, the OS tick is the only time base
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include "stm32f10x.h"
+#include "mid_clock.h"
+#include "mid_wifi.h"
+#include "mqtt_protocol.h"
+#include "timestamp.h"
+#include "os_system.h"
+#include "string.h"
+
+
+/*-------------Internal Functions Declaration------*/
+static unsigned long Mid_Clock_Now(void);
+static void 		 Mid_Clock_Rebase(void);
+
+
+/*-------------Module Variables Declaration--------*/
+uint8_t  		Clock_SyncFlag;			// 1->correction received since power on
+unsigned long 	Clock_BaseEpoch;
+int32_t  		Clock_BaseFrac;
+uint32_t 		Clock_BaseTick;
+int32_t  		Clock_Residual;
+int32_t  		Clock_DriftPPM;
+uint8_t  		Clock_DriftFlag;		// 1->drift measured at least once
+
+/* raw reference of the drift measurement: server time and OS tick of the correction */
+unsigned long 	Clock_DriftEpoch;
+uint32_t 		Clock_DriftTick;
+
+unsigned long 	Clock_HoldEpoch;		// last TimeStamp given out(monotonic floor)
+uint32_t 		Clock_SyncTick;			// OS tick of the last correction
+uint32_t 		Clock_RequestTick;		// OS tick of the last SystemTime request
+unsigned long 	Clock_FormatMinute;		// minute of SystemTime[]
+
+stu_Clock_Stat_t stu_Clock_Stat;
+
+
+/*-------------Module Functions Definition---------*/
+/**
+  * @Brief	Initialize Clock module
+  * @Param	None
+  * @Retval	None
+  */
+void Mid_Clock_Init(void)
+{
+	Clock_SyncFlag = 0;
+	Clock_BaseEpoch = 0;
+	Clock_BaseFrac = 0;
+	Clock_BaseTick = OS_GetTickCount();
+	Clock_Residual = 0;
+	Clock_DriftPPM = 0;
+	Clock_DriftFlag = 0;
+	
+	Clock_HoldEpoch = 0;
+	Clock_SyncTick = OS_GetTickCount();
+	Clock_RequestTick = OS_GetTickCount();
+	Clock_FormatMinute = 0xFFFFFFFF;
+	
+	memset(&stu_Clock_Stat, 0, sizeof(stu_Clock_Stat));
+}
+
+/**
+  * @Brief	Polling function of Clock module
+  * @Param	None
+  * @Retval	None
+  */
+void Mid_Clock_Pro(void)
+{
+	if(!Clock_SyncFlag)
+	{
+		return;
+	}
+	
+	if((OS_GetTickCount() - Clock_BaseTick) >= CLOCK_REBASE_PERIOD)
+	{
+		Mid_Clock_Rebase();
+	}
+	
+	/* no correction for long: request the SystemTime, once per CLOCK_SYNC_PERIOD until answered */
+	if(((OS_GetTickCount() - Clock_SyncTick) >= CLOCK_SYNC_TIMEOUT) &&
+	   ((OS_GetTickCount() - Clock_RequestTick) >= CLOCK_SYNC_PERIOD) &&
+	   (Mid_WiFi_GetMQTTState() == MQTT_STA_READY))
+	{
+		Clock_RequestTick = OS_GetTickCount();
+		stu_Clock_Stat.RequestNumber++;
+	
+		MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_GET_SYSTIME, 0, MQTT_EVENT_CLASS_REQUEST);
+	}
+}
+
+/**
+  * @Brief	Correct the clock with the server time
+  * @Param	TimeStamp: UNIX TimeStamp from server(0->not valid)
+  * @Retval	None
+  *	@Note	The drift is measured against the raw OS tick(not the corrected clock),
+  *			a measurement beyond CLOCK_DRIFT_PPM_MAX is a server time step and only restarts the measurement
+  */
+void Mid_Clock_Sync(unsigned long TimeStamp)
+{
+	unsigned long Interval;
+	uint32_t Tick;
+	int32_t  Offset;
+	int32_t  Error;
+	int32_t  PPM;
+	
+	if(TimeStamp == 0)
+	{
+		return;
+	}
+	
+	if(Clock_SyncFlag && ((OS_GetTickCount() - Clock_SyncTick) < CLOCK_SYNC_PERIOD))
+	{
+		stu_Clock_Stat.DropNumber++;
+	
+		return;
+	}
+	
+	Tick = OS_GetTickCount();
+	
+	if(Clock_SyncFlag)
+	{
+		Offset = (int32_t)(TimeStamp - Mid_Clock_Now());
+		stu_Clock_Stat.LastOffset = Offset;
+	
+		/* drift measurement */
+		Interval = TimeStamp - Clock_DriftEpoch;
+	
+		if((TimeStamp < Clock_DriftEpoch) || (Interval > CLOCK_DRIFT_INTERVAL_MAX))
+		{
+			Clock_DriftEpoch = TimeStamp;
+			Clock_DriftTick = Tick;
+		}
+		else if(Interval >= CLOCK_DRIFT_INTERVAL_MIN)
+		{
+			Error = (int32_t)(Tick - Clock_DriftTick) - (int32_t)(Interval * CLOCK_TICK_PER_SECOND);
+	
+			/* |Error| / (Interval * 100) <= 500ppm */
+			if((Error <= (int32_t)(Interval / 20)) && (Error >= -(int32_t)(Interval / 20)))
+			{
+				PPM = (Error * 10000) / (int32_t)Interval;
+	
+				Clock_DriftPPM = Clock_DriftFlag ? ((Clock_DriftPPM * 3 + PPM) / 4) : PPM;
+				Clock_DriftFlag = 1;
+	
+				stu_Clock_Stat.DriftPPM = Clock_DriftPPM;
+			}
+	
+			Clock_DriftEpoch = TimeStamp;
+			Clock_DriftTick = Tick;
+		}
+	
+		/* server behind the clock beyond the hold: step back */
+		if(Offset < -CLOCK_HOLD_MAX)
+		{
+			Clock_HoldEpoch = TimeStamp;
+			stu_Clock_Stat.StepNumber++;
+		}
+	}
+	else
+	{
+		Clock_DriftEpoch = TimeStamp;
+		Clock_DriftTick = Tick;
+		Clock_HoldEpoch = TimeStamp;
+	}
+	
+	Clock_BaseEpoch = TimeStamp;
+	Clock_BaseFrac = 0;
+	Clock_BaseTick = Tick;
+	Clock_Residual = 0;
+	
+	Clock_SyncFlag = 1;
+	Clock_SyncTick = Tick;
+	Clock_FormatMinute = 0xFFFFFFFF;
+	
+	stu_Clock_Stat.SyncNumber++;
+}
+
+/**
+  * @Brief	Check if the clock has been corrected since power on
+  * @Param	None
+  * @Retval	1->clock valid, 0->no correction yet
+  */
+uint8_t Mid_Clock_IsSynced(void)
+{
+	return Clock_SyncFlag;
+}
+
+/**
+  * @Brief	Get the current UNIX TimeStamp
+  * @Param	None
+  * @Retval	UNIX TimeStamp(seconds), 0->no correction yet
+  *	@Note	Never smaller than the TimeStamp given out before(unless stepped back by Mid_Clock_Sync)
+  */
+unsigned long Mid_Clock_GetTimeStamp(void)
+{
+	unsigned long TimeStamp;
+	
+	if(!Clock_SyncFlag)
+	{
+		return 0;
+	}
+	
+	TimeStamp = Mid_Clock_Now();
+	
+	if(TimeStamp < Clock_HoldEpoch)
+	{
+		return Clock_HoldEpoch;
+	}
+	
+	Clock_HoldEpoch = TimeStamp;
+	
+	return TimeStamp;
+}
+
+/**
+  * @Brief	Get the current datetime string
+  * @Param	None
+  * @Retval	point to SystemTime[]("YYYY-MM-DD\0HH:MM\0")
+  *	@Note	Formatted on demand, only when the minute changed,
+  *			SystemTime[] is left as it is until the first correction
+  */
+uint8_t *Mid_Clock_GetDateTime(void)
+{
+	unsigned long TimeStamp;
+	
+	if(Clock_SyncFlag)
+	{
+		TimeStamp = Mid_Clock_GetTimeStamp();
+	
+		if((TimeStamp / 60) != Clock_FormatMinute)
+		{
+			/* only the digits changed are rewritten, unless corrected since the last format */
+			if(Clock_FormatMinute == 0xFFFFFFFF)
+			{
+				TimeStamp_DateTime_Conversion(TimeStamp, &SystemTime[0]);
+			}
+			else
+			{
+				TimeStamp_DateTime_Update(TimeStamp, Clock_FormatMinute * 60, &SystemTime[0]);
+			}
+	
+			Clock_FormatMinute = TimeStamp / 60;
+	
+			stu_Clock_Stat.FormatNumber++;
+		}
+	}
+	
+	return &SystemTime[0];
+}
+
+/**
+  * @Brief	Get the statistics of Clock module
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_Clock_GetStat(stu_Clock_Stat_t *pStat)
+{
+	*pStat = stu_Clock_Stat;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Current UNIX TimeStamp of the clock, not limited by the monotonic floor
+  * @Param	None
+  * @Retval	UNIX TimeStamp(seconds)
+  *	@Note	Elapsed ticks stay below CLOCK_REBASE_PERIOD(+ polling delay), (ticks * ppm) fits in 32 bit
+  */
+static unsigned long Mid_Clock_Now(void)
+{
+	int32_t Elapsed;
+	int32_t Ticks;
+	
+	Elapsed = (int32_t)(OS_GetTickCount() - Clock_BaseTick);
+	
+	Ticks = Clock_BaseFrac + Elapsed - ((Elapsed * Clock_DriftPPM) + Clock_Residual) / 1000000;
+	
+	if(Ticks < 0)
+	{
+		Ticks = 0;
+	}
+	
+	return Clock_BaseEpoch + (Ticks / CLOCK_TICK_PER_SECOND);
+}
+
+/**
+  * @Brief	Fold the elapsed ticks into the base
+  * @Param	None
+  * @Retval	None
+  *	@Note	The remainder of the drift correction is carried in @Residual, no drift is lost by the rebase
+  */
+static void Mid_Clock_Rebase(void)
+{
+	int32_t Elapsed;
+	int32_t Product;
+	int32_t Correction;
+	int32_t Ticks;
+	
+	Elapsed = (int32_t)(OS_GetTickCount() - Clock_BaseTick);
+	
+	Product = (Elapsed * Clock_DriftPPM) + Clock_Residual;
+	Correction = Product / 1000000;
+	
+	Clock_Residual = Product - (Correction * 1000000);
+	
+	Ticks = Clock_BaseFrac + Elapsed - Correction;
+	
+	Clock_BaseEpoch += Ticks / CLOCK_TICK_PER_SECOND;
+	Clock_BaseFrac = Ticks % CLOCK_TICK_PER_SECOND;
+	Clock_BaseTick += Elapsed;
+}
+
+
+/*-------------Interrupt Functions Definition--------*/
+
+
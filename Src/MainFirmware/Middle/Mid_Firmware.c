@@ -1,14 +1,58 @@
 /****************************************************
   * @Name	Mid_Firmware.c
   * @Brief	
+  * @Instruction:
+  * --> Download window:
+  *	 (Poll) Mid_Firmware_DownloadProgress_Pro	: keeps FIRMWARE_DOWNLOAD_WINDOW package requests in flight(Download_Slot[]),
+  *												  resends the request of a slot not answered within FIRMWARE_DOWNLOAD_TIMEOUT
+  *			Mid_Firmware_Download_Pro			: package written to Flash at PackageIndex * PackageSize(negotiated in the update check) in any order,
+  *												  marked in Download_Bitmap[], its slot freed
+  *			-------------------------------------------------------------------
+  *			The whole-file CRC16 is combined in package order: a package received ahead of a missing one is
+  *			read back from Flash once the missing one arrives(Mid_Firmware_ChainReadBack)
+  *
+  * --> Flash write:
+  *			The info block and the image are one append-only region, opened by Mid_Firmware_StartDownload(pFlashWriteStart),
+  *			erased ahead of the packages by the writer(the info block of the old version is erased with it),
+  *			the info block is programmed last, once the whole-file CRC16 check succeed
+  *
+  * --> Download checkpoint(FIRMWARE_CHECKPOINT_ADDRESS, program only, erased when a new image starts):
+  *			-------------------------------------------------------------------
+  *			Mark(1) | Info(14) | Bitmap(bit cleared->package written) | Records(ChainIndex, CRC16 state, inverted copy)
+  *			(offsets: CHECKPOINT_OFFSET_xxx of mid_firmware.h)
+  *			-------------------------------------------------------------------
+  *			Mid_Firmware_StartDownload resumes a checkpoint of the same image(info): the packages written are not requested again,
+  *			the CRC16 state is taken from the last record and the packages after it read back(Mid_Firmware_ChainReadBack).
+  *			The last package is always downloaded again, it ends the download
+  *
+  * --> Delta patch(ImageType FIRMWARE_IMAGE_TYPE_DELTA, update check answer):
+  *			Downloaded the same way as the whole Firmware, checked against the running Firmware once complete(Mid_Firmware_DeltaCheck),
+  *			flagged FIRMWARE_NEW_DELTA_FLAG in the info block, applied by the BootLoader
+  *
+  * --> Compressed Firmware(ImageType FIRMWARE_IMAGE_TYPE_LZ, update check answer):
+  *			Downloaded and kept compressed(whole-file CRC16 of the compressed image), header checked once complete(Mid_Firmware_LZCheck),
+  *			flagged FIRMWARE_NEW_LZ_FLAG in the info block, decompressed by the BootLoader as it is copied to EmbeddedFlash
+  *
+  * --> Boot confirm(boot record FIRMWARE_BOOT_RECORD_ADDRESS, written by the BootLoader):
+  *			A new Firmware is started on trial, Mid_Firmware_BootConfirm programs its Confirm once it has run healthy,
+  *			otherwise the BootLoader rolls back to the backup after FIRMWARE_TRIAL_BOOT_MAX starts
   ***************************************************/
   
 /*-------------Header Files Include-----------------*/
 #include "stm32f10x.h"
 #include "mid_firmware.h"
 #include "crc16.h"
+#include "os_system.h"
+#include "string.h"
 
 /*-------------Internal Functions Declaration------*/
+static void 	Mid_Firmware_ChainReadBack(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num));
+static void 	Mid_Firmware_CheckpointInfo(uint8_t *pBuff);
+static uint8_t 	Mid_Firmware_CheckpointResume(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint32_t *pWrittenAddr);
+static void 	Mid_Firmware_CheckpointRecord(void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num));
+static void 	Mid_Firmware_CheckpointClose(void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num));
+static uint8_t 	Mid_Firmware_DeltaCheck(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num));
+static uint8_t 	Mid_Firmware_LZCheck(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num));
 
 
 /*-------------Module Variables Declaration--------*/
@@ -17,6 +61,20 @@ unsigned short CombinedCRC16Last;	// last combined CRC16 check value
 
 stu_Firmware_t stu_Firmware;
 
+/* download window: packages received, package requests in flight */
+uint8_t  			Download_Bitmap[(FIRMWARE_PACKAGE_NUMBER_MAX + 7) / 8];
+stu_DownloadSlot_t 	Download_Slot[FIRMWARE_DOWNLOAD_WINDOW];
+uint16_t 			Download_RequestIndex;		// next package never requested
+uint16_t 			Download_ChainIndex;		// packages 0 -> Download_ChainIndex-1 combined in CombinedCRC16
+uint8_t  			Download_ReadBuff[FIRMWARE_READBACK_SIZE];
+
+/* download checkpoint: next free record, ChainIndex of the last record, packages combined between the records */
+uint16_t 			Checkpoint_RecordIndex;
+uint16_t 			Checkpoint_RecordChain;
+uint16_t 			Checkpoint_RecordInterval;
+
+stu_Firmware_DownloadStat_t stu_Firmware_DownloadStat;
+
 /*---Module Call-Back function pointer Definition---*/
 
 
@@ -55,6 +113,10 @@ void Mid_Firmware_InfoUpdate(stu_Firmware_t FirmwarePara)
 		stu_Firmware.CRC16[0] = FirmwarePara.CRC16[0];
 		stu_Firmware.CRC16[1] = FirmwarePara.CRC16[1];
 		
+		stu_Firmware.PackageSize = FirmwarePara.PackageSize;
+		stu_Firmware.NegotiatedFlag = FirmwarePara.NegotiatedFlag;
+		stu_Firmware.ImageType = FirmwarePara.ImageType;
+		
 		CombinedCRC16 = 0;
 		CombinedCRC16Last = 0xFFFF;
 		
@@ -97,29 +159,91 @@ void Mid_Firmware_SetUpdateState(en_FirmwareUpdateState_t State)
 
 /**
   * @Brief	Start Firmware Update
-  * @Param	None
+  * @Param	pFlashWriteStart	: function pointer of FlashImageWriteStart, opens the Flash region written by Mid_Firmware_Download_Pro
+  *			pFlashReadData		: function pointer of FlashReadData
+  *			pFlashProgram		: function pointer of FlashWriteSector(program only, no erase)
+  *			pFlashEraseSector	: function pointer of FlashEraseSector
   * @Retval	None
+  *	@Note	Fails at once if the image info does not fit: size beyond FIRMWARE_IMAGE_SIZE_MAX, PackageSize beyond FIRMWARE_PACKAGE_SIZE_MAX,
+  *			PackageNumber not matching FirmwareSize / PackageSize.
+  *			Resumes the download checkpointed in Flash if it is the same image, starts a new checkpoint otherwise
   */
-void Mid_Firmware_StartDownload(void)
+void Mid_Firmware_StartDownload(void (*pFlashWriteStart)(uint32_t Addr, uint32_t Size, uint32_t WrittenAddr), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashEraseSector)(uint32_t SectorNo))
 {
+	uint8_t  i;
+	uint32_t WrittenAddr;	// image written up to here before(resumed)
+	
+	if((stu_Firmware.FirmwareSize.FirmwareSizeTotal > FIRMWARE_IMAGE_SIZE_MAX) || 
+	   (stu_Firmware.PackageSize == 0) || (stu_Firmware.PackageSize > FIRMWARE_PACKAGE_SIZE_MAX) || 
+	   (stu_Firmware.PackageNumber.PackageNumberTotal == 0) || 
+	   (stu_Firmware.PackageNumber.PackageNumberTotal > FIRMWARE_PACKAGE_NUMBER_MAX) || 
+	   (stu_Firmware.PackageNumber.PackageNumberTotal != ((stu_Firmware.FirmwareSize.FirmwareSizeTotal + stu_Firmware.PackageSize - 1) / stu_Firmware.PackageSize)))
+	{
+		stu_Firmware.UpdateState = FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL;
+		
+		return;
+	}
+	
 	stu_Firmware.UpdateState = FIRMWARE_UPDATE_STA_DOWNLOAD_START;
 	stu_Firmware.DownloadPackageNumber = 0;
 	stu_Firmware.DownloadByteNumber = 0;
 	
 	CombinedCRC16 = 0;
 	CombinedCRC16Last = 0xFFFF;
+	
+	memset(&Download_Bitmap[0], 0, sizeof(Download_Bitmap));
+	
+	for(i=0; i<FIRMWARE_DOWNLOAD_WINDOW; i++)
+	{
+		Download_Slot[i].PackageIndex = 0xFFFF;
+	}
+	
+	Download_RequestIndex = 0;
+	Download_ChainIndex = 0;
+	
+	memset(&stu_Firmware_DownloadStat, 0, sizeof(stu_Firmware_DownloadStat));
+	
+	Checkpoint_RecordIndex = 0;
+	Checkpoint_RecordChain = 0;
+	Checkpoint_RecordInterval = (stu_Firmware.PackageNumber.PackageNumberTotal / FIRMWARE_CHECKPOINT_RECORD_SUM) + 1;
+	
+	WrittenAddr = 0;
+	
+	/* same image checkpointed: carry on from the packages written */
+	if(Mid_Firmware_CheckpointResume(pFlashReadData, &WrittenAddr))
+	{
+		stu_Firmware_DownloadStat.ResumeNumber = stu_Firmware.DownloadPackageNumber;
+		
+		Mid_Firmware_ChainReadBack(pFlashReadData);
+	}
+	/* new checkpoint: Mark + Info */
+	else
+	{
+		pFlashEraseSector(FIRMWARE_CHECKPOINT_SECTOR);
+		
+		Download_ReadBuff[0] = FIRMWARE_CHECKPOINT_MARK;
+		Mid_Firmware_CheckpointInfo(&Download_ReadBuff[1]);
+		
+		pFlashProgram(&Download_ReadBuff[0], FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_MARK, 15);
+	}
+	
+	/* info block + image */
+	pFlashWriteStart(FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + stu_Firmware.FirmwareSize.FirmwareSizeTotal, WrittenAddr);
 }
 
 /**
   * @Brief	Polling function of downloading data from received data packages
 				check the CRC16 value of each received package 
-  * @Param	pFlashWriteData	: function pointer of FlashWriteData
+  * @Param	pFlashWriteData	: function pointer of FlashImageWrite(region opened by Mid_Firmware_StartDownload)
   *			pFlashReadData	: function pointer of FlashReadData
+  *			pFlashProgram	: function pointer of FlashWriteSector(program only, no erase), checkpoint
   *			pData			: point to the Data received
   * @Retval	0->Package download not complete yet, 
   *			1->Package download complete
+  *	@Note	Packages are accepted in any order, each written to its own place in Flash,
+  *			packages received already(answers of resent requests) are dropped
   */
-uint8_t Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pData)
+uint8_t Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pData)
 {
 	uint16_t CRC16_fromCalculation;
 	uint16_t CRC16_fromPackage;
@@ -128,93 +252,185 @@ uint8_t Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint
 	uint32_t WriteInAddress;	// start address for data write-in
 	
 	uint16_t PackageIndex;		// index of Download Package(0->PackageNumber-1)
+	uint16_t DataLen;			// effective data length
+	uint16_t ExpectLen;			// PackageSize, the rest of the image for the last package
+	uint8_t  *pPackageData;		// effective data + CRC16(2)
+	uint8_t  BitmapByte;		// byte of the checkpoint bitmap
+	uint8_t  i;
 	
 	uint8_t DataBuff[13];		// buffer of Firmware info, ahead of effective-data 
 	
-	stu_DownloadData_t *DownloadDataBuff;
+	if(stu_Firmware.UpdateState != FIRMWARE_UPDATE_STA_DOWNLOAD_START)
+	{
+		return 1;
+	}
 	
 	/* start parsing download data */
-	if(stu_Firmware.UpdateState == FIRMWARE_UPDATE_STA_DOWNLOAD_START)
+	PackageIndex = (pData[DOWNLOAD_DATA_OFFSET_PACKAGE_INDEX] << 8) | (pData[DOWNLOAD_DATA_OFFSET_PACKAGE_INDEX + 1]);
+	
+	if(PackageIndex >= stu_Firmware.PackageNumber.PackageNumberTotal)
+	{
+		return 0;
+	}
+	
+	/* received already */
+	if(Download_Bitmap[PackageIndex >> 3] & (1 << (PackageIndex & 0x07)))
 	{
-		DownloadDataBuff = (stu_DownloadData_t *)pData;
+		stu_Firmware_DownloadStat.DuplicateNumber++;
 		
-		PackageIndex = ((DownloadDataBuff->PackageIndex[0] << 8) | (DownloadDataBuff->PackageIndex[1]));
+		return 0;
+	}
+	
+	if(stu_Firmware.NegotiatedFlag)
+	{
+		DataLen = (pData[DOWNLOAD_DATA_OFFSET_DATA_LEN] << 8) | (pData[DOWNLOAD_DATA_OFFSET_DATA_LEN + 1]);
+		pPackageData = &pData[DOWNLOAD_DATA_OFFSET_DATA_LEN + 2];
+	}
+	else
+	{
+		DataLen = pData[DOWNLOAD_DATA_OFFSET_DATA_LEN];
+		pPackageData = &pData[DOWNLOAD_DATA_OFFSET_DATA_LEN + 1];
+	}
+	
+	/* all packages but the last carry PackageSize, the last one ends the image(checked by Mid_Firmware_StartDownload) */
+	WriteInAddress = (uint32_t)PackageIndex * stu_Firmware.PackageSize;
+	
+	if(PackageIndex == (stu_Firmware.PackageNumber.PackageNumberTotal - 1))
+	{
+		ExpectLen = stu_Firmware.FirmwareSize.FirmwareSizeTotal - WriteInAddress;
+	}
+	else
+	{
+		ExpectLen = stu_Firmware.PackageSize;
+	}
+	
+	if(DataLen != ExpectLen)
+	{
+		stu_Firmware_DownloadStat.RejectNumber++;
+		
+		return 0;
+	}
+	
+	/* calculate CRC16 of the new datapackage */
+	CRC16_fromCalculation = Mid_CRC16_Modbus(pPackageData, DataLen);
+	
+	/* get the CRC16 provided by the package(last 2 byte) */
+	CRC16_fromPackage = (pPackageData[DataLen] << 8) | (pPackageData[DataLen + 1]);
+	
+	/* CRC16 Check of this package fail: dropped, requested again on timeout */
+	if(CRC16_fromCalculation != CRC16_fromPackage)
+	{
+		stu_Firmware_DownloadStat.RejectNumber++;
 		
-		/* PackageIndex == stu_Firmware.DownloadPackageNumber indicates that the current processing datapackage is the next one of packages already downloaded */
-		if(PackageIndex == stu_Firmware.DownloadPackageNumber)
+		return 0;
+	}
+	
+	/* write-in effective data to Flash */
+	pFlashWriteData(pPackageData, WriteInAddress + FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, DataLen);
+	
+	Download_Bitmap[PackageIndex >> 3] |= (1 << (PackageIndex & 0x07));
+	
+	/* checkpoint: package written(bits of the packages written before are programmed again as they are) */
+	BitmapByte = ~Download_Bitmap[PackageIndex >> 3];
+	pFlashProgram(&BitmapByte, FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_BITMAP + (PackageIndex >> 3), 1);
+	
+	stu_Firmware.DownloadPackageNumber += 1;
+	stu_Firmware.DownloadByteNumber += DataLen;
+	
+	/* request answered: free the slot */
+	for(i=0; i<FIRMWARE_DOWNLOAD_WINDOW; i++)
+	{
+		if(Download_Slot[i].PackageIndex == PackageIndex)
 		{
-			/* calculate CRC16 of the new datapackage */
-			CRC16_fromCalculation = Mid_CRC16_Modbus(&DownloadDataBuff->DataBuff[0], DownloadDataBuff->DataLen);
+			Download_Slot[i].PackageIndex = 0xFFFF;
+		}
+	}
+	
+	/* the whole-file CRC16 is combined in package order: this package, then the packages received ahead of it */
+	if(PackageIndex == Download_ChainIndex)
+	{
+		CombinedCRC16 = Mid_CRC16_Modbus_Continuous(pPackageData, DataLen, CombinedCRC16Last);
+		CombinedCRC16Last = CombinedCRC16;
 		
-			/* get the CRC16 provided by the package(last 2 byte) */
-			CRC16_fromPackage = (DownloadDataBuff->DataBuff[DownloadDataBuff->DataLen] << 8) | (DownloadDataBuff->DataBuff[DownloadDataBuff->DataLen + 1]);
+		Download_ChainIndex++;
 		
-			/* CRC16 Check of this package succeed */
-			if(CRC16_fromCalculation == CRC16_fromPackage)
+		Mid_Firmware_ChainReadBack(pFlashReadData);
+	}
+	else
+	{
+		stu_Firmware_DownloadStat.OutOfOrderNumber++;
+	}
+	
+	/* checkpoint: CRC16 state, every Checkpoint_RecordInterval packages combined(the end of the download is not recorded) */
+	if((Download_ChainIndex >= (Checkpoint_RecordChain + Checkpoint_RecordInterval)) && 
+	   (Download_ChainIndex < stu_Firmware.PackageNumber.PackageNumberTotal))
+	{
+		Mid_Firmware_CheckpointRecord(pFlashProgram);
+	}
+	
+	/* download not complete yet */
+	if(Download_ChainIndex != stu_Firmware.PackageNumber.PackageNumberTotal)
+	{
+		return 0;
+	}
+	
+	/* check whether all data write-in complete */
+	if(stu_Firmware.DownloadByteNumber == stu_Firmware.FirmwareSize.FirmwareSizeTotal)
+	{
+		CRC16_Firmware = ((stu_Firmware.CRC16[0] << 8) | (stu_Firmware.CRC16[1]));
+		
+		/* CRC16 check of the whole file succeed(delta patch: made against the running Firmware, compressed: header fits) */
+		if((CombinedCRC16 == CRC16_Firmware) && 
+		   ((stu_Firmware.ImageType != FIRMWARE_IMAGE_TYPE_DELTA) || Mid_Firmware_DeltaCheck(pFlashReadData)) &&
+		   ((stu_Firmware.ImageType != FIRMWARE_IMAGE_TYPE_LZ) || Mid_Firmware_LZCheck(pFlashReadData)))
+		{
+			if(stu_Firmware.ImageType == FIRMWARE_IMAGE_TYPE_DELTA)
 			{
-				CombinedCRC16 = Mid_CRC16_Modbus_Continuous(&DownloadDataBuff->DataBuff[0], DownloadDataBuff->DataLen, CombinedCRC16Last);
-				CombinedCRC16Last = CombinedCRC16;
-				
-				WriteInAddress = stu_Firmware.DownloadByteNumber + FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS;
+				DataBuff[0] = FIRMWARE_NEW_DELTA_FLAG;
+			}
+			else if(stu_Firmware.ImageType == FIRMWARE_IMAGE_TYPE_LZ)
+			{
+				DataBuff[0] = FIRMWARE_NEW_LZ_FLAG;
+			}
+			else
+			{
+				DataBuff[0] = FIRMWARE_NEW_VERSION_FLAG;
+			}
 			
-				/* write-in effective data to Flash */
-				pFlashWriteData(&DownloadDataBuff->DataBuff[0], WriteInAddress, DownloadDataBuff->DataLen);
+			DataBuff[1] = stu_Firmware.CurrentVersion.Version[0];
+			DataBuff[2] = stu_Firmware.CurrentVersion.Version[1];
+			DataBuff[3] = stu_Firmware.NewVersion.Version[0];
+			DataBuff[4] = stu_Firmware.NewVersion.Version[1];
 			
-				stu_Firmware.DownloadPackageNumber += 1;
-				stu_Firmware.DownloadByteNumber += DownloadDataBuff->DataLen;
-				
-				/* check whether all data write-in complete */
-				if(stu_Firmware.DownloadPackageNumber == stu_Firmware.PackageNumber.PackageNumberTotal)
-				{
-					if(stu_Firmware.DownloadByteNumber == stu_Firmware.FirmwareSize.FirmwareSizeTotal)
-					{
-						CRC16_Firmware = ((stu_Firmware.CRC16[0] << 8) | (stu_Firmware.CRC16[1]));
-				
-						/* CRC16 check of the whole file succeed */
-						if(CombinedCRC16 == CRC16_Firmware)
-						{
-							DataBuff[0] = FIRMWARE_NEW_VERSION_FLAG;
-							
-							DataBuff[1] = stu_Firmware.CurrentVersion.Version[0];
-							DataBuff[2] = stu_Firmware.CurrentVersion.Version[1];
-							DataBuff[3] = stu_Firmware.NewVersion.Version[0];
-							DataBuff[4] = stu_Firmware.NewVersion.Version[1];
-							
-							DataBuff[5] = stu_Firmware.FirmwareSize.FirmwareSize[0];
-							DataBuff[6] = stu_Firmware.FirmwareSize.FirmwareSize[1];
-							DataBuff[7] = stu_Firmware.FirmwareSize.FirmwareSize[2];
-							DataBuff[8] = stu_Firmware.FirmwareSize.FirmwareSize[3];
-							
-							DataBuff[9] = stu_Firmware.PackageNumber.PackageNumber[0];
-							DataBuff[10] = stu_Firmware.PackageNumber.PackageNumber[1];
-							
-							DataBuff[11] = stu_Firmware.CRC16[0];
-							DataBuff[12] = stu_Firmware.CRC16[1];
-							
-							/* write-in Firmware info to Flash */
-							pFlashWriteData(&DataBuff[0], FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 13);
-							
-							Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_SUCCESS);
-						}
-						/* CRC16 check of the whole file fail*/
-						else
-						{
-							Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL);
-						}
-					}
-					else
-					{
-						Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL);
-					}
-				}
-				/* download not complete yet */
-				else
-				{
-					return 0;
-				}
-			}
+			DataBuff[5] = stu_Firmware.FirmwareSize.FirmwareSize[0];
+			DataBuff[6] = stu_Firmware.FirmwareSize.FirmwareSize[1];
+			DataBuff[7] = stu_Firmware.FirmwareSize.FirmwareSize[2];
+			DataBuff[8] = stu_Firmware.FirmwareSize.FirmwareSize[3];
+			
+			DataBuff[9] = stu_Firmware.PackageNumber.PackageNumber[0];
+			DataBuff[10] = stu_Firmware.PackageNumber.PackageNumber[1];
+			
+			DataBuff[11] = stu_Firmware.CRC16[0];
+			DataBuff[12] = stu_Firmware.CRC16[1];
+			
+			/* write-in Firmware info to Flash */
+			pFlashWriteData(&DataBuff[0], FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 13);
+			
+			Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_SUCCESS);
+		}
+		/* CRC16 check of the whole file fail / patch not made against the running Firmware */
+		else
+		{
+			Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL);
 		}
 	}
+	else
+	{
+		Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL);
+	}
+	
+	/* download ended: the checkpoint is not resumed */
+	Mid_Firmware_CheckpointClose(pFlashProgram);
 	
 	return 1;
 }
@@ -227,51 +443,63 @@ uint8_t Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint
   *			66.6% 		  -> return 666
   *			100.0% 		  -> return 1000
   *			download fail -> return 0xFFFF
+  *	@Note	Up to FIRMWARE_DOWNLOAD_WINDOW package requests in flight, a free slot requests the next package never requested,
+  *			a slot not answered within FIRMWARE_DOWNLOAD_TIMEOUT requests its package again(only the missing packages are resent),
+  *			one request per polling
   */
 uint16_t Mid_Firmware_DownloadProgress_Pro(uint8_t CommType, void (*pGetNewFirmware_DataPack)(uint8_t CommType, uint16_t PackageIdnex, uint8_t *pVersion))
 {
-	static uint32_t DownloadProgress = 0xFFFF;	// indicate the progress percentage with 2-byte
-	static uint16_t Counter = 0;
-	static uint8_t ResendCounter = 0;
+	uint8_t i;
 	
 	/* Firmware is downloading */
 	if(stu_Firmware.UpdateState == FIRMWARE_UPDATE_STA_DOWNLOAD_START)
 	{
-		/* check and update DownloadProgress */
-		if(DownloadProgress != stu_Firmware.DownloadPackageNumber)
+		for(i=0; i<FIRMWARE_DOWNLOAD_WINDOW; i++)
 		{
-			Counter = 0;
-			ResendCounter = 0;
-			DownloadProgress = stu_Firmware.DownloadPackageNumber;
-			
-			/* Pack the dataframe to request the next package data */
-			/* use stu_Firmware.DownloadPackageNumber as the PackageIndex of the next package data */
-			pGetNewFirmware_DataPack(CommType, stu_Firmware.DownloadPackageNumber, &stu_Firmware.CurrentVersion.Version[0]);
-		}
-		else
-		{
-			Counter++;
-			
-			/* resend the request if no response after 3s */
-			if(Counter > 300)
+			/* free slot: request the next package */
+			if(Download_Slot[i].PackageIndex == 0xFFFF)
 			{
-				Counter = 0;
-				
-				DownloadProgress = stu_Firmware.DownloadPackageNumber;
+				/* packages taken from the checkpoint are not requested */
+				while((Download_RequestIndex < stu_Firmware.PackageNumber.PackageNumberTotal) && 
+					  (Download_Bitmap[Download_RequestIndex >> 3] & (1 << (Download_RequestIndex & 0x07))))
+				{
+					Download_RequestIndex++;
+				}
 				
-				pGetNewFirmware_DataPack(CommType, stu_Firmware.DownloadPackageNumber, &stu_Firmware.CurrentVersion.Version[0]);
-			
-				ResendCounter++;
+				if(Download_RequestIndex < stu_Firmware.PackageNumber.PackageNumberTotal)
+				{
+					Download_Slot[i].PackageIndex = Download_RequestIndex++;
+					Download_Slot[i].RequestTick = OS_GetTickCount();
+					Download_Slot[i].ResendCounter = 0;
+					
+					pGetNewFirmware_DataPack(CommType, Download_Slot[i].PackageIndex, &stu_Firmware.CurrentVersion.Version[0]);
+					
+					stu_Firmware_DownloadStat.RequestNumber++;
+					
+					break;
+				}
+			}
+			/* resend the request if no response after 3s */
+			else if((OS_GetTickCount() - Download_Slot[i].RequestTick) > FIRMWARE_DOWNLOAD_TIMEOUT)
+			{
+				Download_Slot[i].ResendCounter++;
 				
 				/* resend 20 times, timeout */
 				/* download fail */
-				if(ResendCounter > 20)
+				if(Download_Slot[i].ResendCounter > FIRMWARE_DOWNLOAD_RESEND_MAX)
 				{
-					ResendCounter = 0;
-					DownloadProgress = 0xFFFF;
+					Download_Slot[i].PackageIndex = 0xFFFF;
 					
-					return DownloadProgress;
+					return 0xFFFF;
 				}
+				
+				Download_Slot[i].RequestTick = OS_GetTickCount();
+				
+				pGetNewFirmware_DataPack(CommType, Download_Slot[i].PackageIndex, &stu_Firmware.CurrentVersion.Version[0]);
+				
+				stu_Firmware_DownloadStat.ResendNumber++;
+				
+				break;
 			}
 		}
 	}
@@ -280,8 +508,329 @@ uint16_t Mid_Firmware_DownloadProgress_Pro(uint8_t CommType, void (*pGetNewFirmw
 	return ((stu_Firmware.DownloadPackageNumber * 1000) / stu_Firmware.PackageNumber.PackageNumberTotal);
 }
 
+/**
+  * @Brief	Get the statistics of Firmware download
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_Firmware_GetDownloadStat(stu_Firmware_DownloadStat_t *pStat)
+{
+	*pStat = stu_Firmware_DownloadStat;
+}
+
+/**
+  * @Brief	Confirm the running Firmware to the BootLoader(not rolled back at the next starts)
+  * @Param	pFlashReadData: function pointer of FlashReadData
+  *			pFlashProgram : function pointer of FlashWriteSector(program only, no erase)
+  *			pVersion	  : point to the buffer to store the version of the running Firmware(2 byte)
+  * @Retval	1->running Firmware in the boot record(version stored), 0->no boot record / version not known
+  *	@Note	Called once the Firmware has run healthy. The version differs from the one downloaded after a rollback,
+  *			not known(0xFFFF) for a Firmware sent over the BootLoader serial recovery
+  */
+uint8_t Mid_Firmware_BootConfirm(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pVersion)
+{
+	uint8_t Record[BOOT_RECORD_OFFSET_CONFIRM + 1];
+	
+	pFlashReadData(&Record[0], FIRMWARE_BOOT_RECORD_ADDRESS, sizeof(Record));
+	
+	/* Firmware installed before the BootLoader kept the boot record */
+	if(Record[BOOT_RECORD_OFFSET_MARK] != FIRMWARE_BOOT_RECORD_MARK)
+	{
+		return 0;
+	}
+	
+	if(Record[BOOT_RECORD_OFFSET_CONFIRM] != FIRMWARE_BOOT_CONFIRMED)
+	{
+		Record[BOOT_RECORD_OFFSET_CONFIRM] = FIRMWARE_BOOT_CONFIRMED;
+		
+		pFlashProgram(&Record[BOOT_RECORD_OFFSET_CONFIRM], FIRMWARE_BOOT_RECORD_ADDRESS + BOOT_RECORD_OFFSET_CONFIRM, 1);
+	}
+	
+	/* serial recovery: version kept as it is */
+	if((Record[BOOT_RECORD_OFFSET_VERSION] == 0xFF) && (Record[BOOT_RECORD_OFFSET_VERSION + 1] == 0xFF))
+	{
+		return 0;
+	}
+	
+	pVersion[0] = Record[BOOT_RECORD_OFFSET_VERSION];
+	pVersion[1] = Record[BOOT_RECORD_OFFSET_VERSION + 1];
+	
+	return 1;
+}
+
 
 /*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Combine the packages received ahead of order into the whole-file CRC16, read back from Flash
+  * @Param	pFlashReadData: function pointer of FlashReadData
+  * @Retval	None
+  *	@Note	Stops at the first package still missing(Download_ChainIndex).
+  *			The whole-file CRC16 is combined one package at a time(as received, Mid_CRC16_Modbus_Continuous):
+  *			the pieces read back of the same package carried as one run(Mid_CRC16_ModbusUpdate)
+  */
+static void Mid_Firmware_ChainReadBack(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num))
+{
+	uint32_t ReadAddress;
+	uint32_t ReadEnd;
+	uint16_t Len;
+	
+	while((Download_ChainIndex < stu_Firmware.PackageNumber.PackageNumberTotal) && 
+		  (Download_Bitmap[Download_ChainIndex >> 3] & (1 << (Download_ChainIndex & 0x07))))
+	{
+		ReadAddress = (uint32_t)Download_ChainIndex * stu_Firmware.PackageSize;
+		ReadEnd = ReadAddress + stu_Firmware.PackageSize;
+		
+		if(Download_ChainIndex == (stu_Firmware.PackageNumber.PackageNumberTotal - 1))
+		{
+			ReadEnd = stu_Firmware.FirmwareSize.FirmwareSizeTotal;
+		}
+		
+		CombinedCRC16 = CombinedCRC16Last;
+		
+		for(; ReadAddress < ReadEnd; ReadAddress += Len)
+		{
+			Len = ((ReadEnd - ReadAddress) > FIRMWARE_READBACK_SIZE) ? FIRMWARE_READBACK_SIZE : (ReadEnd - ReadAddress);
+			
+			pFlashReadData(&Download_ReadBuff[0], ReadAddress + FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, Len);
+			
+			CombinedCRC16 = Mid_CRC16_ModbusUpdate(&Download_ReadBuff[0], Len, CombinedCRC16);
+		}
+		
+		CombinedCRC16 = Mid_CRC16_ModbusResult(CombinedCRC16);
+		CombinedCRC16Last = CombinedCRC16;
+		
+		Download_ChainIndex++;
+	}
+}
+
+/**
+  * @Brief	Image info kept in the checkpoint, a checkpoint is resumed only for the same info
+  * @Param	pBuff: point to the buffer to store the info(14 byte)
+  * @Retval	None
+  */
+static void Mid_Firmware_CheckpointInfo(uint8_t *pBuff)
+{
+	pBuff[0] = stu_Firmware.NewVersion.Version[0];
+	pBuff[1] = stu_Firmware.NewVersion.Version[1];
+	
+	pBuff[2] = stu_Firmware.FirmwareSize.FirmwareSize[0];
+	pBuff[3] = stu_Firmware.FirmwareSize.FirmwareSize[1];
+	pBuff[4] = stu_Firmware.FirmwareSize.FirmwareSize[2];
+	pBuff[5] = stu_Firmware.FirmwareSize.FirmwareSize[3];
+	
+	pBuff[6] = stu_Firmware.PackageNumber.PackageNumber[0];
+	pBuff[7] = stu_Firmware.PackageNumber.PackageNumber[1];
+	
+	pBuff[8] = stu_Firmware.CRC16[0];
+	pBuff[9] = stu_Firmware.CRC16[1];
+	
+	pBuff[10] = (uint8_t)(stu_Firmware.PackageSize >> 8);
+	pBuff[11] = (uint8_t)(stu_Firmware.PackageSize);
+	
+	pBuff[12] = stu_Firmware.NegotiatedFlag;
+	pBuff[13] = stu_Firmware.ImageType;
+}
+
+/**
+  * @Brief	Resume the download from the checkpoint in Flash
+  * @Param	pFlashReadData	: function pointer of FlashReadData
+  *			pWrittenAddr	: point to the variable to store the end of the last package written(Flash address)
+  * @Retval	1->resumed: Download_Bitmap[], download counters, CRC16 state of the last record taken,
+  *			0->no checkpoint of this image
+  *	@Note	The packages after the last record are combined by Mid_Firmware_ChainReadBack,
+  *			the last package is taken as missing: it ends the download(whole-file CRC16 check, info block)
+  */
+static uint8_t Mid_Firmware_CheckpointResume(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint32_t *pWrittenAddr)
+{
+	uint8_t  Info[14];
+	uint8_t  *pRecord;
+	uint16_t Total;
+	uint16_t ChainIndex;
+	uint16_t i;
+	uint32_t PackageEnd;
+	
+	Total = stu_Firmware.PackageNumber.PackageNumberTotal;
+	
+	pFlashReadData(&Download_ReadBuff[0], FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_MARK, 15);
+	
+	Mid_Firmware_CheckpointInfo(&Info[0]);
+	
+	if((Download_ReadBuff[0] != FIRMWARE_CHECKPOINT_MARK) || (memcmp(&Download_ReadBuff[1], &Info[0], 14) != 0))
+	{
+		return 0;
+	}
+	
+	/* packages written: bit cleared in Flash */
+	pFlashReadData(&Download_Bitmap[0], FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_BITMAP, (Total + 7) / 8);
+	
+	for(i=0; i<((Total + 7) / 8); i++)
+	{
+		Download_Bitmap[i] = ~Download_Bitmap[i];
+	}
+	
+	Download_Bitmap[(Total - 1) >> 3] &= ((2 << ((Total - 1) & 0x07)) - 1);
+	Download_Bitmap[(Total - 1) >> 3] &= ~(1 << ((Total - 1) & 0x07));
+	
+	for(i=0; i<Total; i++)
+	{
+		if(Download_Bitmap[i >> 3] & (1 << (i & 0x07)))
+		{
+			PackageEnd = (uint32_t)(i + 1) * stu_Firmware.PackageSize;
+			
+			stu_Firmware.DownloadPackageNumber += 1;
+			stu_Firmware.DownloadByteNumber += stu_Firmware.PackageSize;
+			
+			*pWrittenAddr = PackageEnd + FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS;
+		}
+	}
+	
+	/* CRC16 state: last record intact(record and its inverted copy match) */
+	for(Checkpoint_RecordIndex=0; Checkpoint_RecordIndex<FIRMWARE_CHECKPOINT_RECORD_SUM; Checkpoint_RecordIndex++)
+	{
+		pRecord = &Download_ReadBuff[0];
+		
+		pFlashReadData(pRecord, FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_RECORD + (Checkpoint_RecordIndex * FIRMWARE_CHECKPOINT_RECORD_SIZE), FIRMWARE_CHECKPOINT_RECORD_SIZE);
+		
+		/* erased: no record beyond */
+		if((pRecord[0] & pRecord[1] & pRecord[2] & pRecord[3] & pRecord[4] & pRecord[5] & pRecord[6] & pRecord[7]) == 0xFF)
+		{
+			break;
+		}
+		
+		ChainIndex = (pRecord[0] << 8) | pRecord[1];
+		
+		if(((uint8_t)~pRecord[4] == pRecord[0]) && ((uint8_t)~pRecord[5] == pRecord[1]) && 
+		   ((uint8_t)~pRecord[6] == pRecord[2]) && ((uint8_t)~pRecord[7] == pRecord[3]) && 
+		   (ChainIndex > Download_ChainIndex) && (ChainIndex < Total))
+		{
+			Download_ChainIndex = ChainIndex;
+			CombinedCRC16Last = (pRecord[2] << 8) | pRecord[3];
+		}
+	}
+	
+	/* the packages combined in the record must be written */
+	for(i=0; i<Download_ChainIndex; i++)
+	{
+		if(!(Download_Bitmap[i >> 3] & (1 << (i & 0x07))))
+		{
+			Download_ChainIndex = 0;
+			CombinedCRC16Last = 0xFFFF;
+			
+			break;
+		}
+	}
+	
+	CombinedCRC16 = CombinedCRC16Last;
+	Checkpoint_RecordChain = Download_ChainIndex;
+	
+	return 1;
+}
+
+/**
+  * @Brief	Program the CRC16 state of the packages combined to the next checkpoint record
+  * @Param	pFlashProgram: function pointer of FlashWriteSector(program only, no erase)
+  * @Retval	None
+  */
+static void Mid_Firmware_CheckpointRecord(void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num))
+{
+	uint8_t Record[FIRMWARE_CHECKPOINT_RECORD_SIZE];
+	
+	if(Checkpoint_RecordIndex >= FIRMWARE_CHECKPOINT_RECORD_SUM)
+	{
+		return;
+	}
+	
+	Record[0] = (uint8_t)(Download_ChainIndex >> 8);
+	Record[1] = (uint8_t)(Download_ChainIndex);
+	Record[2] = (uint8_t)(CombinedCRC16Last >> 8);
+	Record[3] = (uint8_t)(CombinedCRC16Last);
+	Record[4] = ~Record[0];
+	Record[5] = ~Record[1];
+	Record[6] = ~Record[2];
+	Record[7] = ~Record[3];
+	
+	pFlashProgram(&Record[0], FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_RECORD + (Checkpoint_RecordIndex * FIRMWARE_CHECKPOINT_RECORD_SIZE), FIRMWARE_CHECKPOINT_RECORD_SIZE);
+	
+	Checkpoint_RecordIndex++;
+	Checkpoint_RecordChain = Download_ChainIndex;
+}
+
+/**
+  * @Brief	Close the checkpoint: Mark programmed to 0x00, not resumed any more
+  * @Param	pFlashProgram: function pointer of FlashWriteSector(program only, no erase)
+  * @Retval	None
+  */
+static void Mid_Firmware_CheckpointClose(void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num))
+{
+	uint8_t Mark = 0x00;
+	
+	pFlashProgram(&Mark, FIRMWARE_CHECKPOINT_ADDRESS + CHECKPOINT_OFFSET_MARK, 1);
+}
+
+/**
+  * @Brief	Check the delta patch downloaded is made against the running Firmware
+  * @Param	pFlashReadData: function pointer of FlashReadData
+  * @Retval	1->patch header fits, CRC16 of the running Firmware matches the source CRC16, 0->patch not applicable
+  *	@Note	Checked again by the BootLoader, a patch not applicable fails the download here instead of at the reboot
+  */
+static uint8_t Mid_Firmware_DeltaCheck(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num))
+{
+	uint8_t  Header[DELTA_OFFSET_CMD];
+	uint32_t SourceSize;
+	uint32_t TargetSize;
+	uint16_t CRC16;
+	
+	pFlashReadData(&Header[0], FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, DELTA_OFFSET_CMD);
+	
+	if((Header[DELTA_OFFSET_MAGIC] != FIRMWARE_DELTA_MAGIC_0) || (Header[DELTA_OFFSET_MAGIC + 1] != FIRMWARE_DELTA_MAGIC_1))
+	{
+		return 0;
+	}
+	
+	SourceSize = Header[DELTA_OFFSET_SOURCE_SIZE] | (Header[DELTA_OFFSET_SOURCE_SIZE + 1] << 8) | 
+				 (Header[DELTA_OFFSET_SOURCE_SIZE + 2] << 16) | ((uint32_t)Header[DELTA_OFFSET_SOURCE_SIZE + 3] << 24);
+	TargetSize = Header[DELTA_OFFSET_TARGET_SIZE] | (Header[DELTA_OFFSET_TARGET_SIZE + 1] << 8) | 
+				 (Header[DELTA_OFFSET_TARGET_SIZE + 2] << 16) | ((uint32_t)Header[DELTA_OFFSET_TARGET_SIZE + 3] << 24);
+	
+	if((SourceSize == 0) || (SourceSize > FIRMWARE_IMAGE_SIZE_MAX) || (TargetSize == 0) || (TargetSize > FIRMWARE_IMAGE_SIZE_MAX))
+	{
+		return 0;
+	}
+	
+	/* CRC16 of the running Firmware as one run */
+	CRC16 = Mid_CRC16_ModbusUpdate((uint8_t *)FIRMWARE_APP_BASE_ADDRESS, SourceSize, CRC16_MODBUS_INIT);
+	
+	return (Mid_CRC16_ModbusResult(CRC16) == ((Header[DELTA_OFFSET_SOURCE_CRC16] << 8) | Header[DELTA_OFFSET_SOURCE_CRC16 + 1]));
+}
+
+/**
+  * @Brief	Check the header of the compressed Firmware downloaded
+  * @Param	pFlashReadData: function pointer of FlashReadData
+  * @Retval	1->header fits(magic, size of the Firmware decompressed), 0->not a compressed Firmware
+  *	@Note	The sequences and the CRC16 of the Firmware decompressed are checked by the BootLoader as it decompresses
+  */
+static uint8_t Mid_Firmware_LZCheck(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num))
+{
+	uint8_t  Header[LZ_OFFSET_DATA];
+	uint32_t RawSize;
+	
+	if(stu_Firmware.FirmwareSize.FirmwareSizeTotal <= LZ_OFFSET_DATA)
+	{
+		return 0;
+	}
+	
+	pFlashReadData(&Header[0], FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS, LZ_OFFSET_DATA);
+	
+	if((Header[LZ_OFFSET_MAGIC] != FIRMWARE_LZ_MAGIC_0) || (Header[LZ_OFFSET_MAGIC + 1] != FIRMWARE_LZ_MAGIC_1))
+	{
+		return 0;
+	}
+	
+	RawSize = Header[LZ_OFFSET_RAW_SIZE] | (Header[LZ_OFFSET_RAW_SIZE + 1] << 8) | 
+			  (Header[LZ_OFFSET_RAW_SIZE + 2] << 16) | ((uint32_t)Header[LZ_OFFSET_RAW_SIZE + 3] << 24);
+	
+	return ((RawSize != 0) && (RawSize <= FIRMWARE_IMAGE_SIZE_MAX));
+}
 
 
 /*-------------Interrupt Functions Definition--------*/
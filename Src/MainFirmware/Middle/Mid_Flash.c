@@ -3,22 +3,42 @@
   * @Brief	Driver of W25Q64 flash
   * @API	--> Mid_Flash_ReadData
   *			--> Mid_Flash_WriteData
+  *			--> Mid_Flash_ImageWriteStart / Mid_Flash_ImageWrite
+  * @Instruction:
+  * --> Image writer(append-only region, e.g. the OTA image):
+  *			Mid_Flash_ImageWriteStart	: open the region [Addr, Addr + Size), nothing erased yet,
+  *										  or erased up to @WrittenAddr by the writer before(resumed)
+  *			Mid_Flash_ImageWrite		: erase ahead of the write(@Image_EraseAddr: region erased up to here),
+  *										  64 KB / 32 KB Block where aligned and inside the region, 4 KB Sector otherwise,
+  *										  then page-program only the bytes given
+  *			-------------------------------------------------------------------
+  *			Every Sector of the region is erased once, every byte programmed once(no read-modify-write),
+  *			the writes may come in any order, but each byte of the region must be written only once
   ***************************************************/
 
 /*-------------Header Files Include-----------------*/
 #include "stm32f10x.h"
 #include "mid_flash.h"
 #include "hal_spi.h"
+#include "string.h"
 
 
 /*-------------Internal Functions Declaration------*/
 static void 	Mid_Flash_WriteEnable(void);
 static uint8_t 	Mid_Flash_ReadSR1(void);
 static void 	Mid_Flash_WaitForIdle(void);
+static void 	Mid_Flash_Erase(uint8_t EraseCmd, uint32_t Addr);
+static void 	Mid_Flash_ImageErase(void);
+static uint32_t Mid_Flash_ImageEraseSize(void);
 //static void 	Mid_Flash_Debug(void);
 
 /*-------------Module Variables Declaration--------*/
+/* image writer: region [Image_StartAddr, Image_EndAddr), erased from Image_StartAddr up to Image_EraseAddr */
+uint32_t Image_StartAddr;
+uint32_t Image_EndAddr;
+uint32_t Image_EraseAddr;
 
+stu_Flash_Stat_t stu_Flash_Stat;
 
 
 /*-------------Module Functions Definition---------*/
@@ -29,7 +49,11 @@ static void 	Mid_Flash_WaitForIdle(void);
   */
 void Mid_Flash_Init(void)
 {
+	Image_StartAddr = 0;
+	Image_EndAddr = 0;
+	Image_EraseAddr = 0;
 	
+	memset(&stu_Flash_Stat, 0, sizeof(stu_Flash_Stat));
 }
 
 /**
@@ -110,6 +134,9 @@ void Mid_Flash_WritePage(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
 	Hal_SPI2_CSDriver(1);
 	
 	Mid_Flash_WaitForIdle();	// wait for Flash finish writing
+	
+	stu_Flash_Stat.PageProgramNumber++;
+	stu_Flash_Stat.ProgramByteNumber += Num;
 }
 
 /**
@@ -240,20 +267,71 @@ void Mid_Flash_WriteData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
   */
 void Mid_Flash_EraseSector(uint32_t SectorNo)
 {
-	uint32_t Addr = SectorNo * FLASH_SECTOR_SIZE;
-	
-	Mid_Flash_WriteEnable();
+	Mid_Flash_Erase(SECTOR_ERASE_4KB, SectorNo * FLASH_SECTOR_SIZE);
+}
+
+/**
+  * @Brief	Open the region of the image writer
+  * @Param	Addr: the starting address of the region(3 bytes)
+  * 		Size: the number of bytes of the region
+  * 		WrittenAddr: the region written up to here by the writer before a reset(resume), 0->new region
+  * @Note	Nothing erased here, the region is erased by Mid_Flash_ImageWrite ahead of the writes,
+  *			the bytes of the first Sector ahead of Addr are erased as well.
+  *			Resumed: the Blocks / Sectors the writer erased to reach WrittenAddr are taken as erased(same sequence),
+  *			an erase beyond them done before the reset is done again
+  * @Retval	None
+  */
+void Mid_Flash_ImageWriteStart(uint32_t Addr, uint32_t Size, uint32_t WrittenAddr)
+{
+	Image_StartAddr = Addr - (Addr % FLASH_SECTOR_SIZE);
+	Image_EndAddr = Addr + Size;
+	Image_EraseAddr = Image_StartAddr;
 	
-	Hal_SPI2_CSDriver(0);
+	while(Image_EraseAddr < WrittenAddr)
+	{
+		Image_EraseAddr += Mid_Flash_ImageEraseSize();
+	}
+}
+
+/**
+  * @Brief	Write data to the region of the image writer
+  * @Param	pBuffer: pointer to the address of data to write in
+  * 		Addr: the starting address of data to write in(3 bytes)
+  * 		Num: the number of bytes to write
+  * @Note	The region is erased up to the end of the data first(each Sector once), then only the data is page-programmed,
+  *			data not inside the region is written by Mid_Flash_WriteData(read-modify-write)
+  * @Retval	None
+  */
+void Mid_Flash_ImageWrite(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
+{
+	if(Num == 0)
+	{
+		return;
+	}
 	
-	Hal_SPI2_ReadWriteByte(SECTOR_ERASE_4KB);
-	Hal_SPI2_ReadWriteByte((uint8_t)(Addr >> 16));	
-	Hal_SPI2_ReadWriteByte((uint8_t)(Addr >> 8));	
-	Hal_SPI2_ReadWriteByte((uint8_t)(Addr));
+	if((Addr < Image_StartAddr) || ((Addr + Num) > Image_EndAddr))
+	{
+		Mid_Flash_WriteData(pBuffer, Addr, Num);
+		
+		return;
+	}
 	
-	Hal_SPI2_CSDriver(1);
+	while(Image_EraseAddr < (Addr + Num))
+	{
+		Mid_Flash_ImageErase();
+	}
 	
-	Mid_Flash_WaitForIdle();
+	Mid_Flash_WriteSector(pBuffer, Addr, Num);
+}
+
+/**
+  * @Brief	Get the statistics of Flash module
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_Flash_GetStat(stu_Flash_Stat_t *pStat)
+{
+	*pStat = stu_Flash_Stat;
 }
 
 
@@ -302,6 +380,92 @@ static void Mid_Flash_WaitForIdle(void)
 	while((Mid_Flash_ReadSR1() & 0x01) == 0x01); /*! infinite loop potential risk !*/
 }
 
+/**
+  * @Brief	Erase Sector / Block data
+  * @Param	EraseCmd: SECTOR_ERASE_4KB, BLOCK_ERASE_32KB or BLOCK_ERASE_64KB
+  * 		Addr: address inside the target Sector / Block(3 bytes)
+  * @Retval	None
+  */
+static void Mid_Flash_Erase(uint8_t EraseCmd, uint32_t Addr)
+{
+	Mid_Flash_WriteEnable();
+	
+	Hal_SPI2_CSDriver(0);
+	
+	Hal_SPI2_ReadWriteByte(EraseCmd);
+	Hal_SPI2_ReadWriteByte((uint8_t)(Addr >> 16));	
+	Hal_SPI2_ReadWriteByte((uint8_t)(Addr >> 8));	
+	Hal_SPI2_ReadWriteByte((uint8_t)(Addr));
+	
+	Hal_SPI2_CSDriver(1);
+	
+	Mid_Flash_WaitForIdle();
+	
+	if(EraseCmd == BLOCK_ERASE_64KB)
+	{
+		stu_Flash_Stat.Block64EraseNumber++;
+	}
+	else if(EraseCmd == BLOCK_ERASE_32KB)
+	{
+		stu_Flash_Stat.Block32EraseNumber++;
+	}
+	else
+	{
+		stu_Flash_Stat.SectorEraseNumber++;
+	}
+}
+
+/**
+  * @Brief	Erase the next part of the image writer region, move Image_EraseAddr past it
+  * @Param	None
+  * @Retval	None
+  */
+static void Mid_Flash_ImageErase(void)
+{
+	uint32_t Size;
+	
+	Size = Mid_Flash_ImageEraseSize();
+	
+	if(Size == FLASH_BLOCK_SIZE_64KB)
+	{
+		Mid_Flash_Erase(BLOCK_ERASE_64KB, Image_EraseAddr);
+	}
+	else if(Size == FLASH_BLOCK_SIZE_32KB)
+	{
+		Mid_Flash_Erase(BLOCK_ERASE_32KB, Image_EraseAddr);
+	}
+	else
+	{
+		Mid_Flash_Erase(SECTOR_ERASE_4KB, Image_EraseAddr);
+	}
+	
+	Image_EraseAddr += Size;
+}
+
+/**
+  * @Brief	Size of the next erase of the image writer region
+  * @Param	None
+  * @Retval	FLASH_BLOCK_SIZE_64KB / FLASH_BLOCK_SIZE_32KB / FLASH_SECTOR_SIZE
+  *	@Note	The largest Block aligned at Image_EraseAddr and not beyond the last Sector of the region
+  */
+static uint32_t Mid_Flash_ImageEraseSize(void)
+{
+	uint32_t RegionEnd;		// end of the last Sector of the region
+	
+	RegionEnd = ((Image_EndAddr + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE) * FLASH_SECTOR_SIZE;
+	
+	if(((Image_EraseAddr % FLASH_BLOCK_SIZE_64KB) == 0) && ((Image_EraseAddr + FLASH_BLOCK_SIZE_64KB) <= RegionEnd))
+	{
+		return FLASH_BLOCK_SIZE_64KB;
+	}
+	else if(((Image_EraseAddr % FLASH_BLOCK_SIZE_32KB) == 0) && ((Image_EraseAddr + FLASH_BLOCK_SIZE_32KB) <= RegionEnd))
+	{
+		return FLASH_BLOCK_SIZE_32KB;
+	}
+	
+	return FLASH_SECTOR_SIZE;
+}
+
 
 
 
@@ -1,6 +1,17 @@
 /****************************************************
   * @Name	Mid_MQTT.c
   * @Brief	Set parameters for connecting the MQTT server
+  *			Route the messages received to the handler of the subscribed topic
+  * @Instruction:
+  * --> Topic Route Table:
+  *		MQTT_ROUTE_SLOT_SUM slots indexed by the hash of the topic(FNV-1a, open addressing)
+  *		-------------------------------------------------------------------
+  *		Slot:	Hash(4 byte)	pTopic(subscribed topic string)		pHandler
+  *		-------------------------------------------------------------------
+  *			Mid_MQTT_TopicRegister	: add the route of a subscribed topic(handler updated if already routed)
+  *			Mid_MQTT_TopicRoute		: hash the topic of +MQTTSUBRECV, find the slot and call its handler,
+  *									  the topic string is compared only on a hash hit
+  *	@Note	Exact topics only(no '+' / '#' filters), the broker delivers the topic name of the subscription
   ***************************************************/
   
 /*-------------Header Files Include-----------------*/
@@ -9,7 +20,9 @@
 #include "md5.h"
 #include "device.h"
 #include "timestamp.h"
+#include "mid_clock.h"
 #include "os_system.h"
+#include "string.h"
 
 /*-------------Internal Functions Declaration------*/
 static void Mid_MQTT_SetClientID(uint8_t *pClientID);
@@ -19,10 +32,17 @@ static void Mid_MQTT_SetServerPort(uint8_t *pServerPort);
 static void Mid_MQTT_SetSubTopic(uint8_t *pSubTopic);
 static void Mid_MQTT_SetPubTopic(uint8_t *pPubTopic);
 static void Mid_MQTT_SetSubTopic_DateTime(uint8_t *pDateTimeTopic);
+static void Mid_MQTT_SetSubTopic_FirmwareUpdate(uint8_t *pFirmwareTopic);
+static uint32_t Mid_MQTT_TopicHash(uint8_t *pTopic, uint8_t TopicLen);
 
 /*-------------Module Variables Declaration--------*/
 stu_MQTT_Device_t  stu_MQTT_ESP8266;
 
+/* Topic route table */
+stu_MQTT_Route_t MQTT_Route[MQTT_ROUTE_SLOT_SUM];
+
+stu_MQTT_RouteStat_t stu_MQTT_RouteStat;
+
 
 /*---Module Call-Back function pointer Definition---*/
 
@@ -123,6 +143,23 @@ void Mid_MQTT_Init(void)
 	buf[34] = 'p';
 	buf[35] = '\0';
 	Mid_MQTT_SetPubTopic(&buf[1]);
+	
+	/* set the SubTopic_FirmwareUpdate: (<MCU-UID>_FirmwareDown\0) */
+	buf[25] = '_';
+	buf[26] = 'F';
+	buf[27] = 'i';
+	buf[28] = 'r';
+	buf[29] = 'm';
+	buf[30] = 'w';
+	buf[31] = 'a';
+	buf[32] = 'r';
+	buf[33] = 'e';
+	buf[34] = 'D';
+	buf[35] = 'o';
+	buf[36] = 'w';
+	buf[37] = 'n';
+	buf[38] = '\0';
+	Mid_MQTT_SetSubTopic_FirmwareUpdate(&buf[1]);
 
 	/* set the SubTopic_DateTime: ($SYS/brokers/emqx@127.0.0.1/datetime\0) */
 	buf[1] = '$';
@@ -166,6 +203,113 @@ void Mid_MQTT_Init(void)
 	
 	/* set the FirmwareUpdateFlag: */
 	Mid_MQTT_SetFirmwareUpdateFlag(MQTT_FIRMWARE_UPDATE_NONE);
+	
+	/* no topic routed until subscribed */
+	memset(&MQTT_Route[0], 0, sizeof(MQTT_Route));
+	memset(&stu_MQTT_RouteStat, 0, sizeof(stu_MQTT_RouteStat));
+}
+
+/**
+  * @Brief	Add the route of a subscribed topic
+  * @Param	pTopic	: point to the topic string(kept by the route, must stay valid)
+  *			pHandler: handler of the messages received on the topic
+  * @Retval	0->succeed, 0xFF->route table full
+  *	@Note	Registering a topic already routed only updates its handler
+  */
+uint8_t Mid_MQTT_TopicRegister(uint8_t *pTopic, MQTT_TopicHandler_t pHandler)
+{
+	uint32_t Hash;
+	uint8_t TopicLen;
+	uint8_t Slot;
+	uint8_t i;
+	
+	TopicLen = 0;
+	
+	while((pTopic[TopicLen] != 0) && (TopicLen < MQTT_TOPIC_SIZE))
+	{
+		TopicLen++;
+	}
+	
+	Hash = Mid_MQTT_TopicHash(pTopic, TopicLen);
+	Slot = Hash & (MQTT_ROUTE_SLOT_SUM - 1);
+	
+	for(i=0; i<MQTT_ROUTE_SLOT_SUM; i++)
+	{
+		if(MQTT_Route[Slot].pHandler == 0)
+		{
+			MQTT_Route[Slot].Hash = Hash;
+			MQTT_Route[Slot].pTopic = pTopic;
+			MQTT_Route[Slot].TopicLen = TopicLen;
+			MQTT_Route[Slot].pHandler = pHandler;
+			
+			stu_MQTT_RouteStat.RouteNumber++;
+			
+			return 0;
+		}
+		
+		if((MQTT_Route[Slot].Hash == Hash) && (MQTT_Route[Slot].pTopic == pTopic))
+		{
+			MQTT_Route[Slot].pHandler = pHandler;
+			
+			return 0;
+		}
+		
+		Slot = (Slot + 1) & (MQTT_ROUTE_SLOT_SUM - 1);
+	}
+	
+	return 0xFF;
+}
+
+/**
+  * @Brief	Call the handler of the topic the message was received on
+  * @Param	pTopic	: point to the topic of +MQTTSUBRECV(not terminated)
+  *			TopicLen: length of the topic
+  *			pData	: point to the message data
+  *			Len		: length of the message data
+  * @Retval	0->routed, 0xFF->topic not routed(message dropped)
+  */
+uint8_t Mid_MQTT_TopicRoute(uint8_t *pTopic, uint8_t TopicLen, uint8_t *pData, uint16_t Len)
+{
+	uint32_t Hash;
+	uint8_t Slot;
+	uint8_t i;
+	
+	Hash = Mid_MQTT_TopicHash(pTopic, TopicLen);
+	Slot = Hash & (MQTT_ROUTE_SLOT_SUM - 1);
+	
+	for(i=0; (i<MQTT_ROUTE_SLOT_SUM) && (MQTT_Route[Slot].pHandler != 0); i++)
+	{
+		if(MQTT_Route[Slot].Hash == Hash)
+		{
+			/* hash hit: confirm the topic(length first, the topic received may be longer than the one kept) */
+			if((MQTT_Route[Slot].TopicLen == TopicLen) && (memcmp(MQTT_Route[Slot].pTopic, pTopic, TopicLen) == 0))
+			{
+				stu_MQTT_RouteStat.MessageNumber++;
+				
+				MQTT_Route[Slot].pHandler(pData, Len);
+				
+				return 0;
+			}
+			
+			stu_MQTT_RouteStat.CollisionNumber++;
+		}
+		
+		Slot = (Slot + 1) & (MQTT_ROUTE_SLOT_SUM - 1);
+	}
+	
+	stu_MQTT_RouteStat.MissNumber++;
+	
+	return 0xFF;
+}
+
+/**
+  * @Brief	Get the statistics of the topic routes
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_MQTT_GetRouteStat(stu_MQTT_RouteStat_t *pStat)
+{
+	*pStat = stu_MQTT_RouteStat;
 }
 
 /**
@@ -192,12 +336,11 @@ uint8_t Mid_MQTT_GetFirmwareUpdateFlag(void)
 /**
   * @Brief	According to the UNIX TimeStamp received from server, calculate the Coordinate Universal Time(UTC)
   * @Param	pData		: point to the receieved time data(string) trimmed by Mid_WiFi_MQTTRxDataHandler
-  *			pDateTime	: point to the processed RealTime datetime data(string)
   * @Retval	None
   *	@Note	The EMQX server provide the TimeStamp with every 100 seconds(Realtime) into 1 overflow of @Second bits
 			the suffix <-04:00> means the UTC-4:00 time zone(!!!The timestamp provided by the server deduced this part on @Hour bits!!!)
   */
-void Mid_MQTT_SystemTimeProcess(uint8_t *pData, uint8_t *pDateTime)
+void Mid_MQTT_SystemTimeProcess(uint8_t *pData)
 {
 	uint8_t MonthIndex;
 	unsigned long UNIXCounter;
@@ -253,7 +396,8 @@ void Mid_MQTT_SystemTimeProcess(uint8_t *pData, uint8_t *pDateTime)
 
 	UNIXCounter += CounterBuff;
 	
-	TimeStamp_DateTime_Conversion(UNIXCounter, &pDateTime[0]);
+	/* correct the wall clock, SystemTime is formatted by the clock */
+	Mid_Clock_Sync(UNIXCounter);
 }
 
 
@@ -412,6 +556,47 @@ static void Mid_MQTT_SetSubTopic_DateTime(uint8_t *pDateTimeTopic)
 	}
 }
 
+/**
+  * @Brief	Set FirmwareUpdate subscription topic
+  * @Param	pFirmwareTopic: point to the FirmwareUpdate subscription topic string
+  * @Retval	None
+  */
+static void Mid_MQTT_SetSubTopic_FirmwareUpdate(uint8_t *pFirmwareTopic)
+{
+	uint8_t Index = 0;
+	
+	while(*pFirmwareTopic)
+	{
+		stu_MQTT_ESP8266.SubTopic_FirmwareUpdate[Index++] = *pFirmwareTopic;
+		
+		pFirmwareTopic++;
+		
+		if(Index == MQTT_TOPIC_SIZE)
+		{
+			break;
+		}
+	}
+}
+
+/**
+  * @Brief	Hash of the topic(FNV-1a 32 bit)
+  * @Param	pTopic	: point to the topic
+  *			TopicLen: length of the topic
+  * @Retval	Hash value
+  */
+static uint32_t Mid_MQTT_TopicHash(uint8_t *pTopic, uint8_t TopicLen)
+{
+	uint32_t Hash = 2166136261UL;
+	
+	while(TopicLen--)
+	{
+		Hash ^= *pTopic++;
+		Hash *= 16777619UL;
+	}
+	
+	return Hash;
+}
+
 
 /*-------------Interrupt Functions Definition--------*/
 
@@ -0,0 +1,723 @@
+/****************************************************
+  * @Name	Mid_Outbox.c
+  * @Brief	Persistent store-and-forward outbox of the terminal events(W25Q64 journal)
+  * @Instruction:
+  * --> DataStructure:
+  *		Records are appended back-to-back to the outbox sectors, the sectors are used as a ring,
+  *		so every sector is erased once per lap of the journal(wear spread over all OUTBOX_SECTOR_SUM sectors)
+  *		-------------------------------------------------------------------------------------
+  *		... | acked | acked | in-flight | in-flight | unread | unread | free | free | ...
+  *		              @AckIndex ^           @SendIndex ^          @WriteIndex ^
+  *		-------------------------------------------------------------------------------------
+  *		@AckIndex	: oldest record not accepted by the server yet
+  *		@SendIndex	: next record to read out for upload
+  *		@WriteIndex	: next free slot
+  *
+  * --> Outbox Process:
+  *			Mid_Outbox_Append	: program the record to @WriteIndex, erase the sector first when @WriteIndex enters a new sector
+  *										(pending records in that sector are dropped if the outbox is full)
+  *			Mid_Outbox_Read		: read out the record at @SendIndex
+  *			Mid_Outbox_Ack		: program the Ack byte of the in-flight records up to the mark, advance @AckIndex
+  *			Mid_Outbox_Rewind	: @SendIndex back to @AckIndex, the in-flight records are read out again(replay)
+  *			Mid_Outbox_Claim	: a live upload lane takes the record just appended, Mid_Outbox_Read stops in front of it
+  *			Mid_Outbox_Release	: the lane gives the oldest claims back, programs the Delivered byte if the server accepted them
+  *										(Mid_Outbox_Read skips delivered records, so they are not uploaded twice)
+  *	 (Poll) Mid_Outbox_Pro		: erase the next sector in advance, so that Mid_Outbox_Append does not wait for the sector erase
+  *			Mid_Outbox_Init		: rebuild the indexes from flash after power on(binary search in the head/tail sectors)
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include "stm32f10x.h"
+#include "mid_outbox.h"
+#include "mid_flash.h"
+#include "crc16.h"
+#include "os_system.h"
+
+
+/*-------------Internal Functions Declaration------*/
+static uint32_t Mid_Outbox_SlotAddr(uint16_t Index);
+static uint32_t Mid_Outbox_ReadSeq(uint16_t Index);
+static uint8_t 	Mid_Outbox_ReadAck(uint16_t Index);
+static uint8_t 	Mid_Outbox_CheckRecord(uint8_t *pBuff);
+static uint8_t 	Mid_Outbox_ClaimCheck(uint32_t Seq);
+static uint16_t Mid_Outbox_FindFree(uint16_t Sector);
+static uint16_t Mid_Outbox_FindUnacked(uint16_t Sector, uint16_t Number);
+static void 	Mid_Outbox_SectorPrepare(uint16_t Sector);
+static void 	Mid_Outbox_Mount(void);
+
+
+/*-------------Module Variables Declaration--------*/
+uint16_t Outbox_WriteIndex;			// next free slot
+uint16_t Outbox_AckIndex;			// oldest pending record
+uint16_t Outbox_SendIndex;			// next record to read out
+uint16_t Outbox_PendingNumber;		// records from @AckIndex to @WriteIndex
+uint16_t Outbox_InFlightNumber;		// records from @AckIndex to @SendIndex
+uint32_t Outbox_NextSeq;
+uint16_t Outbox_ErasedSector;		// sector erased in advance, 0xFFFF->none
+uint8_t  Outbox_MountFlag;			// 1->outbox usable
+
+/* Records claimed by a live upload lane, in the order claimed */
+uint16_t Outbox_ClaimSlot[OUTBOX_CLAIM_SUM];
+uint32_t Outbox_ClaimSeq[OUTBOX_CLAIM_SUM];
+uint8_t  Outbox_ClaimHead;
+uint8_t  Outbox_ClaimNumber;
+
+stu_Outbox_Stat_t stu_Outbox_Stat;
+
+
+/*-------------Module Functions Definition---------*/
+/**
+  * @Brief	Initialize Outbox module
+  * @Param	None
+  * @Retval	None
+  *	@Note	Flash driver must be initialized in advance
+  */
+void Mid_Outbox_Init(void)
+{
+	uint8_t *pStat;
+	uint8_t i;
+	
+	pStat = (uint8_t *)&stu_Outbox_Stat;
+	
+	for(i=0; i<sizeof(stu_Outbox_Stat); i++)
+	{
+		pStat[i] = 0;
+	}
+	
+	Mid_Outbox_Mount();
+}
+
+/**
+  * @Brief	Polling function, erase the next sector in advance when the current sector is half full
+  * @Param	None
+  * @Retval	None
+  *	@Note	The next sector is left to Mid_Outbox_Append if it still holds pending records(outbox full)
+  */
+void Mid_Outbox_Pro(void)
+{
+	uint16_t NextSector;
+	
+	if(!Outbox_MountFlag)
+	{
+		return;
+	}
+	
+	if((Outbox_WriteIndex % OUTBOX_RECORD_PER_SECTOR) < (OUTBOX_RECORD_PER_SECTOR / 2))
+	{
+		return;
+	}
+	
+	NextSector = ((Outbox_WriteIndex / OUTBOX_RECORD_PER_SECTOR) + 1) % OUTBOX_SECTOR_SUM;
+	
+	if(Outbox_ErasedSector == NextSector)
+	{
+		return;
+	}
+	
+	/* pending records from @AckIndex to @WriteIndex reach the next sector */
+	if(Outbox_PendingNumber && 
+	   (((Outbox_AckIndex / OUTBOX_RECORD_PER_SECTOR) == NextSector) || 
+	    (((NextSector * OUTBOX_RECORD_PER_SECTOR + OUTBOX_RECORD_SUM - Outbox_AckIndex) % OUTBOX_RECORD_SUM) < Outbox_PendingNumber)))
+	{
+		return;
+	}
+	
+	Mid_Flash_EraseSector(OUTBOX_SECTOR_BASE + NextSector);
+	
+	Outbox_ErasedSector = NextSector;
+	stu_Outbox_Stat.EraseNumber++;
+}
+
+/**
+  * @Brief	Append an event record to the outbox
+  * @Param	Event		: event index
+  *			Data		: message index
+  *			QueueInTick	: OS tick(low 16 bit) when the event was raised
+  *			pTime		: point to the SystemTime when the event was raised(OUTBOX_TIME_SIZE byte)
+  *			pSlot		: point to store the slot index of the record(to claim it), 0->not needed
+  * @Retval	0->succeed, 0xFF->outbox not usable
+  *	@Note	The oldest sector of pending records is dropped when the outbox is full
+  */
+uint8_t Mid_Outbox_Append(uint8_t Event, uint8_t Data, uint16_t QueueInTick, uint8_t *pTime, uint16_t *pSlot)
+{
+	uint8_t  Buff[OUTBOX_RECORD_SIZE];
+	uint16_t CRC16Value;
+	uint16_t Time;
+	uint32_t StartTick;
+	uint8_t  i;
+	
+	if(!Outbox_MountFlag)
+	{
+		return 0xFF;
+	}
+	
+	StartTick = OS_GetTickCount();
+	
+	if((Outbox_WriteIndex % OUTBOX_RECORD_PER_SECTOR) == 0)
+	{
+		Mid_Outbox_SectorPrepare(Outbox_WriteIndex / OUTBOX_RECORD_PER_SECTOR);
+	}
+	
+	for(i=0; i<OUTBOX_RECORD_SIZE; i++)
+	{
+		Buff[i] = 0xFF;
+	}
+	
+	Buff[OUTBOX_RECORD_OFFSET_SEQ] 	   = (Outbox_NextSeq >> 24) & 0xFF;
+	Buff[OUTBOX_RECORD_OFFSET_SEQ + 1] = (Outbox_NextSeq >> 16) & 0xFF;
+	Buff[OUTBOX_RECORD_OFFSET_SEQ + 2] = (Outbox_NextSeq >> 8) & 0xFF;
+	Buff[OUTBOX_RECORD_OFFSET_SEQ + 3] = Outbox_NextSeq & 0xFF;
+	
+	Buff[OUTBOX_RECORD_OFFSET_EVENT] = Event;
+	Buff[OUTBOX_RECORD_OFFSET_DATA]  = Data;
+	
+	Buff[OUTBOX_RECORD_OFFSET_TICK] 	= (QueueInTick >> 8) & 0xFF;
+	Buff[OUTBOX_RECORD_OFFSET_TICK + 1] = QueueInTick & 0xFF;
+	
+	for(i=0; i<OUTBOX_TIME_SIZE; i++)
+	{
+		Buff[OUTBOX_RECORD_OFFSET_TIME + i] = pTime[i];
+	}
+	
+	CRC16Value = Mid_CRC16_Modbus(&Buff[0], OUTBOX_RECORD_CRC_SIZE);
+	
+	Buff[OUTBOX_RECORD_OFFSET_CRC16] 	 = (CRC16Value >> 8) & 0xFF;
+	Buff[OUTBOX_RECORD_OFFSET_CRC16 + 1] = CRC16Value & 0xFF;
+	
+	Mid_Flash_WritePage(&Buff[0], Mid_Outbox_SlotAddr(Outbox_WriteIndex), OUTBOX_RECORD_SIZE);
+	
+	if(pSlot)
+	{
+		*pSlot = Outbox_WriteIndex;
+	}
+	
+	Outbox_WriteIndex = (Outbox_WriteIndex + 1) % OUTBOX_RECORD_SUM;
+	Outbox_PendingNumber++;
+	Outbox_NextSeq++;
+	
+	/* statistics */
+	stu_Outbox_Stat.AppendNumber++;
+	
+	Time = OS_GetTickCount() - StartTick;
+	
+	if(Time > stu_Outbox_Stat.AppendTimeMax)
+	{
+		stu_Outbox_Stat.AppendTimeMax = Time;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Read out the next unread record for upload
+  * @Param	pRecord: point to the struct to store the record
+  * @Retval	0->succeed, 0xFF->no unread record / next record claimed by a live lane
+  *	@Note	The record stays in-flight until Mid_Outbox_Ack / Mid_Outbox_Rewind,
+  *			records with CRC16 error / delivered through a live lane are skipped(and acked together with the in-flight records)
+  */
+uint8_t Mid_Outbox_Read(stu_Outbox_Record_t *pRecord)
+{
+	uint8_t Buff[OUTBOX_RECORD_SIZE];
+	uint8_t i;
+	
+	while(Outbox_InFlightNumber < Outbox_PendingNumber)
+	{
+		Mid_Flash_ReadData(&Buff[0], Mid_Outbox_SlotAddr(Outbox_SendIndex), OUTBOX_RECORD_SIZE);
+	
+		pRecord->Seq  = (uint32_t)Buff[OUTBOX_RECORD_OFFSET_SEQ] << 24;
+		pRecord->Seq |= (uint32_t)Buff[OUTBOX_RECORD_OFFSET_SEQ + 1] << 16;
+		pRecord->Seq |= (uint32_t)Buff[OUTBOX_RECORD_OFFSET_SEQ + 2] << 8;
+		pRecord->Seq |= Buff[OUTBOX_RECORD_OFFSET_SEQ + 3];
+	
+		/* the live lane has not got the server's answer yet, the replay waits for it(keeps the ack order) */
+		if(Mid_Outbox_ClaimCheck(pRecord->Seq))
+		{
+			return 0xFF;
+		}
+	
+		Outbox_SendIndex = (Outbox_SendIndex + 1) % OUTBOX_RECORD_SUM;
+		Outbox_InFlightNumber++;
+	
+		if(Mid_Outbox_CheckRecord(&Buff[0]))
+		{
+			stu_Outbox_Stat.CorruptNumber++;
+	
+			continue;
+		}
+	
+		if(Buff[OUTBOX_RECORD_OFFSET_DELIVERED] == 0x00)
+		{
+			if(Outbox_InFlightNumber == 1)	// nothing in flight in front of it, ack it in place
+			{
+				Mid_Outbox_Ack(Outbox_SendIndex);
+			}
+	
+			continue;
+		}
+	
+		pRecord->Event = Buff[OUTBOX_RECORD_OFFSET_EVENT];
+		pRecord->Data  = Buff[OUTBOX_RECORD_OFFSET_DATA];
+	
+		pRecord->QueueInTick = (Buff[OUTBOX_RECORD_OFFSET_TICK] << 8) | Buff[OUTBOX_RECORD_OFFSET_TICK + 1];
+	
+		for(i=0; i<OUTBOX_TIME_SIZE; i++)
+		{
+			pRecord->Time[i] = Buff[OUTBOX_RECORD_OFFSET_TIME + i];
+		}
+	
+		stu_Outbox_Stat.ReadNumber++;
+	
+		return 0;
+	}
+	
+	return 0xFF;
+}
+
+/**
+  * @Brief	Claim the record for a live upload lane, Mid_Outbox_Read stops in front of it until released
+  * @Param	Slot: slot index got by Mid_Outbox_Append
+  * @Retval	0->claimed, 0xFF->no free claim(the record is uploaded by the replay)
+  */
+uint8_t Mid_Outbox_Claim(uint16_t Slot)
+{
+	uint8_t Index;
+	
+	if(Outbox_ClaimNumber >= OUTBOX_CLAIM_SUM)
+	{
+		return 0xFF;
+	}
+	
+	Index = (Outbox_ClaimHead + Outbox_ClaimNumber) % OUTBOX_CLAIM_SUM;
+	
+	Outbox_ClaimSlot[Index] = Slot;
+	Outbox_ClaimSeq[Index] = Mid_Outbox_ReadSeq(Slot);
+	Outbox_ClaimNumber++;
+	
+	stu_Outbox_Stat.ClaimNumber++;
+	
+	return 0;
+}
+
+/**
+  * @Brief	Release the oldest claims
+  * @Param	Number	 : number of claims to release
+  *			Delivered: 1->the server accepted the records(program the Delivered byte), 0->upload failed(left to the replay)
+  * @Retval	None
+  *	@Note	Claims are released in the order claimed, a record dropped / overwritten since it was claimed is left untouched
+  */
+void Mid_Outbox_Release(uint8_t Number, uint8_t Delivered)
+{
+	uint8_t DeliveredByte = 0x00;
+	
+	while(Number-- && Outbox_ClaimNumber)
+	{
+		if(Delivered && (Mid_Outbox_ReadSeq(Outbox_ClaimSlot[Outbox_ClaimHead]) == Outbox_ClaimSeq[Outbox_ClaimHead]))
+		{
+			Mid_Flash_WritePage(&DeliveredByte, Mid_Outbox_SlotAddr(Outbox_ClaimSlot[Outbox_ClaimHead]) + OUTBOX_RECORD_OFFSET_DELIVERED, 1);
+	
+			stu_Outbox_Stat.DeliverNumber++;
+		}
+	
+		Outbox_ClaimHead = (Outbox_ClaimHead + 1) % OUTBOX_CLAIM_SUM;
+		Outbox_ClaimNumber--;
+	}
+}
+
+/**
+  * @Brief	Get the read mark(position after the last record read out)
+  * @Param	None
+  * @Retval	Read mark, pass it to Mid_Outbox_Ack when the records read out so far are accepted by the server
+  */
+uint16_t Mid_Outbox_GetReadMark(void)
+{
+	return Outbox_SendIndex;
+}
+
+/**
+  * @Brief	Acknowledge the in-flight records up to the read mark, they will not be replayed any more
+  * @Param	Mark: read mark got by Mid_Outbox_GetReadMark
+  * @Retval	None
+  *	@Note	Stale mark(records dropped / rewound since the mark was taken) is ignored
+  */
+void Mid_Outbox_Ack(uint16_t Mark)
+{
+	uint16_t Number;
+	uint8_t  AckByte = 0x00;
+	
+	Number = (Mark + OUTBOX_RECORD_SUM - Outbox_AckIndex) % OUTBOX_RECORD_SUM;
+	
+	if(Number > Outbox_InFlightNumber)
+	{
+		return;
+	}
+	
+	while(Number--)
+	{
+		Mid_Flash_WritePage(&AckByte, Mid_Outbox_SlotAddr(Outbox_AckIndex) + OUTBOX_RECORD_OFFSET_ACK, 1);
+	
+		Outbox_AckIndex = (Outbox_AckIndex + 1) % OUTBOX_RECORD_SUM;
+		Outbox_InFlightNumber--;
+		Outbox_PendingNumber--;
+	
+		stu_Outbox_Stat.AckNumber++;
+	}
+}
+
+/**
+  * @Brief	Give the in-flight records back, they will be read out again
+  * @Param	None
+  * @Retval	None
+  *	@Note	Called when the publish failed / the link dropped before the server accepted the records
+  */
+void Mid_Outbox_Rewind(void)
+{
+	if(Outbox_InFlightNumber)
+	{
+		stu_Outbox_Stat.RewindNumber += Outbox_InFlightNumber;
+	}
+	
+	Outbox_SendIndex = Outbox_AckIndex;
+	Outbox_InFlightNumber = 0;
+}
+
+/**
+  * @Brief	Get the number of records not accepted by the server yet
+  * @Param	None
+  * @Retval	Number of pending records
+  */
+uint32_t Mid_Outbox_GetPendingNumber(void)
+{
+	return Outbox_PendingNumber;
+}
+
+/**
+  * @Brief	Check whether there is any record to read out
+  * @Param	None
+  * @Retval	1->unread record exists, 0->none
+  */
+uint8_t Mid_Outbox_GetUnreadState(void)
+{
+	return (Outbox_InFlightNumber < Outbox_PendingNumber) ? 1 : 0;
+}
+
+/**
+  * @Brief	Get the statistics of Outbox
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_Outbox_GetStat(stu_Outbox_Stat_t *pStat)
+{
+	stu_Outbox_Stat.PendingNumber = Outbox_PendingNumber;
+	
+	*pStat = stu_Outbox_Stat;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Get the flash address of the record slot
+  * @Param	Index: slot index(0 -> OUTBOX_RECORD_SUM-1)
+  * @Retval	Flash address
+  */
+static uint32_t Mid_Outbox_SlotAddr(uint16_t Index)
+{
+	return ((uint32_t)OUTBOX_SECTOR_BASE * FLASH_SECTOR_SIZE) + ((uint32_t)Index * OUTBOX_RECORD_SIZE);
+}
+
+/**
+  * @Brief	Read the Seq of the record slot
+  * @Param	Index: slot index
+  * @Retval	Seq, 0xFFFFFFFF->free slot
+  */
+static uint32_t Mid_Outbox_ReadSeq(uint16_t Index)
+{
+	uint8_t Buff[4];
+	
+	Mid_Flash_ReadData(&Buff[0], Mid_Outbox_SlotAddr(Index) + OUTBOX_RECORD_OFFSET_SEQ, 4);
+	
+	return ((uint32_t)Buff[0] << 24) | ((uint32_t)Buff[1] << 16) | ((uint32_t)Buff[2] << 8) | Buff[3];
+}
+
+/**
+  * @Brief	Read the Ack byte of the record slot
+  * @Param	Index: slot index
+  * @Retval	0xFF->pending, 0x00->acked
+  */
+static uint8_t Mid_Outbox_ReadAck(uint16_t Index)
+{
+	uint8_t AckByte;
+	
+	Mid_Flash_ReadData(&AckByte, Mid_Outbox_SlotAddr(Index) + OUTBOX_RECORD_OFFSET_ACK, 1);
+	
+	return AckByte;
+}
+
+/**
+  * @Brief	Check the CRC16 of the record
+  * @Param	pBuff: point to the record(OUTBOX_RECORD_SIZE byte)
+  * @Retval	0->valid, 0xFF->corrupted
+  */
+static uint8_t Mid_Outbox_CheckRecord(uint8_t *pBuff)
+{
+	uint16_t CRC16Value;
+	
+	CRC16Value = Mid_CRC16_Modbus(pBuff, OUTBOX_RECORD_CRC_SIZE);
+	
+	if((pBuff[OUTBOX_RECORD_OFFSET_CRC16] == ((CRC16Value >> 8) & 0xFF)) &&
+	   (pBuff[OUTBOX_RECORD_OFFSET_CRC16 + 1] == (CRC16Value & 0xFF)))
+	{
+		return 0;
+	}
+	
+	return 0xFF;
+}
+
+/**
+  * @Brief	Check whether the record is claimed by a live upload lane
+  * @Param	Seq: Seq of the record
+  * @Retval	1->claimed, 0->not claimed
+  */
+static uint8_t Mid_Outbox_ClaimCheck(uint32_t Seq)
+{
+	uint8_t i;
+	
+	for(i=0; i<Outbox_ClaimNumber; i++)
+	{
+		if(Outbox_ClaimSeq[(Outbox_ClaimHead + i) % OUTBOX_CLAIM_SUM] == Seq)
+		{
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Find the first free slot of the sector(binary search, slots are programmed in order)
+  * @Param	Sector: outbox sector(0 -> OUTBOX_SECTOR_SUM-1)
+  * @Retval	Number of programmed slots(0 -> OUTBOX_RECORD_PER_SECTOR)
+  */
+static uint16_t Mid_Outbox_FindFree(uint16_t Sector)
+{
+	uint16_t Low = 0;
+	uint16_t High = OUTBOX_RECORD_PER_SECTOR;
+	uint16_t Mid;
+	
+	while(Low < High)
+	{
+		Mid = (Low + High) / 2;
+	
+		if(Mid_Outbox_ReadSeq(Sector * OUTBOX_RECORD_PER_SECTOR + Mid) == 0xFFFFFFFF)
+		{
+			High = Mid;
+		}
+		else
+		{
+			Low = Mid + 1;
+		}
+	}
+	
+	return Low;
+}
+
+/**
+  * @Brief	Find the first pending slot of the sector(binary search, slots are acked in order)
+  * @Param	Sector: outbox sector
+  *			Number: number of programmed slots in the sector
+  * @Retval	Number of acked slots(Number->all acked)
+  */
+static uint16_t Mid_Outbox_FindUnacked(uint16_t Sector, uint16_t Number)
+{
+	uint16_t Low = 0;
+	uint16_t High = Number;
+	uint16_t Mid;
+	
+	while(Low < High)
+	{
+		Mid = (Low + High) / 2;
+	
+		if(Mid_Outbox_ReadAck(Sector * OUTBOX_RECORD_PER_SECTOR + Mid) == 0xFF)
+		{
+			High = Mid;
+		}
+		else
+		{
+			Low = Mid + 1;
+		}
+	}
+	
+	return Low;
+}
+
+/**
+  * @Brief	Make the sector ready to take records(@WriteIndex enters the sector)
+  * @Param	Sector: outbox sector
+  * @Retval	None
+  *	@Note	Pending records in the sector are the oldest ones of a full outbox, they are dropped
+  */
+static void Mid_Outbox_SectorPrepare(uint16_t Sector)
+{
+	uint16_t DropNumber;
+	
+	if(Outbox_PendingNumber && ((Outbox_AckIndex / OUTBOX_RECORD_PER_SECTOR) == Sector))
+	{
+		DropNumber = OUTBOX_RECORD_PER_SECTOR - (Outbox_AckIndex % OUTBOX_RECORD_PER_SECTOR);
+	
+		Outbox_AckIndex = ((Sector + 1) % OUTBOX_SECTOR_SUM) * OUTBOX_RECORD_PER_SECTOR;
+		Outbox_PendingNumber -= DropNumber;
+	
+		if(Outbox_InFlightNumber > DropNumber)
+		{
+			Outbox_InFlightNumber -= DropNumber;
+		}
+		else
+		{
+			Outbox_InFlightNumber = 0;
+			Outbox_SendIndex = Outbox_AckIndex;
+		}
+	
+		stu_Outbox_Stat.DropNumber += DropNumber;
+	}
+	
+	if(Outbox_ErasedSector != Sector)
+	{
+		Mid_Flash_EraseSector(OUTBOX_SECTOR_BASE + Sector);
+	
+		stu_Outbox_Stat.EraseNumber++;
+	}
+	
+	Outbox_ErasedSector = 0xFFFF;
+}
+
+/**
+  * @Brief	Rebuild the indexes from the records in flash
+  * @Param	None
+  * @Retval	None
+  *	@Note	Head sector: the sector whose first record has the largest Seq(newest),
+  *			Tail sector: the sector whose first record has the smallest Seq(oldest),
+  *			sectors with an invalid first record(foreign data / torn write) are erased
+  */
+static void Mid_Outbox_Mount(void)
+{
+	uint8_t  Buff[OUTBOX_RECORD_SIZE];
+	uint16_t Sector;
+	uint16_t HeadSector = 0xFFFF;
+	uint16_t TailSector = 0xFFFF;
+	uint32_t HeadSeq = 0;
+	uint32_t TailSeq = 0xFFFFFFFF;
+	uint32_t Seq;
+	uint16_t Number;
+	uint16_t Acked;
+	
+	Outbox_MountFlag = 0;
+	Outbox_WriteIndex = 0;
+	Outbox_AckIndex = 0;
+	Outbox_SendIndex = 0;
+	Outbox_PendingNumber = 0;
+	Outbox_InFlightNumber = 0;
+	Outbox_NextSeq = 0;
+	Outbox_ErasedSector = 0xFFFF;
+	Outbox_ClaimHead = 0;
+	Outbox_ClaimNumber = 0;
+	
+	if(Mid_Flash_ReadManufacturerID() == 0xFFFF)	// no flash chip answered
+	{
+		return;
+	}
+	
+	for(Sector=0; Sector<OUTBOX_SECTOR_SUM; Sector++)
+	{
+		Mid_Flash_ReadData(&Buff[0], Mid_Outbox_SlotAddr(Sector * OUTBOX_RECORD_PER_SECTOR), OUTBOX_RECORD_SIZE);
+	
+		Seq = ((uint32_t)Buff[0] << 24) | ((uint32_t)Buff[1] << 16) | ((uint32_t)Buff[2] << 8) | Buff[3];
+	
+		if(Seq == 0xFFFFFFFF)	// free sector
+		{
+			continue;
+		}
+	
+		if(Mid_Outbox_CheckRecord(&Buff[0]))
+		{
+			Mid_Flash_EraseSector(OUTBOX_SECTOR_BASE + Sector);
+	
+			stu_Outbox_Stat.EraseNumber++;
+			stu_Outbox_Stat.CorruptNumber++;
+	
+			continue;
+		}
+	
+		if((HeadSector == 0xFFFF) || (Seq > HeadSeq))
+		{
+			HeadSector = Sector;
+			HeadSeq = Seq;
+		}
+	
+		if((TailSector == 0xFFFF) || (Seq < TailSeq))
+		{
+			TailSector = Sector;
+			TailSeq = Seq;
+		}
+	}
+	
+	Outbox_MountFlag = 1;
+	
+	if(HeadSector == 0xFFFF)	// empty outbox
+	{
+		return;
+	}
+	
+	/* @WriteIndex: first free slot after the head sector records */
+	Number = Mid_Outbox_FindFree(HeadSector);
+	
+	Outbox_NextSeq = Mid_Outbox_ReadSeq(HeadSector * OUTBOX_RECORD_PER_SECTOR + Number - 1) + 1;
+	Outbox_WriteIndex = (HeadSector * OUTBOX_RECORD_PER_SECTOR + Number) % OUTBOX_RECORD_SUM;
+	
+	/* @AckIndex: first pending record, walk from the tail sector to the head sector */
+	Sector = TailSector;
+	
+	while(1)
+	{
+		if(Sector == HeadSector)
+		{
+			Number = Mid_Outbox_FindFree(Sector);
+		}
+		else
+		{
+			Number = OUTBOX_RECORD_PER_SECTOR;
+		}
+	
+		Acked = Mid_Outbox_FindUnacked(Sector, Number);
+	
+		if(Acked < Number)
+		{
+			Outbox_AckIndex = Sector * OUTBOX_RECORD_PER_SECTOR + Acked;
+	
+			Outbox_PendingNumber = (Outbox_WriteIndex + OUTBOX_RECORD_SUM - Outbox_AckIndex) % OUTBOX_RECORD_SUM;
+	
+			if(Outbox_PendingNumber == 0)	// every slot pending
+			{
+				Outbox_PendingNumber = OUTBOX_RECORD_SUM;
+			}
+	
+			break;
+		}
+	
+		if(Sector == HeadSector)	// all acked
+		{
+			Outbox_AckIndex = Outbox_WriteIndex;
+	
+			break;
+		}
+	
+		Sector = (Sector + 1) % OUTBOX_SECTOR_SUM;
+	}
+	
+	Outbox_SendIndex = Outbox_AckIndex;
+}
+
+
+
+
+/*-------------Interrupt Functions Definition--------*/
+
+
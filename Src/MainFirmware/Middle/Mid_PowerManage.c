@@ -47,6 +47,27 @@ void Mid_PowerManage_Pro(void)
 	Mid_PowerManage_BatteryStateCheckHandler();
 }
 
+/**
+  * @Brief	Get the AC charger state
+  * @Param	None
+  * @Retval	1->AC charger connected, 0->battery supply
+  */
+uint8_t Mid_PowerManage_GetACState(void)
+{
+	return (ACLinkState == STA_AC_LINK) ? 1 : 0;
+}
+
+/**
+  * @Brief	Get the battery low state
+  * @Param	None
+  * @Retval	1->battery low, 0->battery normal
+  *	@Note	BatteryVoltageLevel is only tracked in battery supply mode
+  */
+uint8_t Mid_PowerManage_GetBatteryLow(void)
+{
+	return (BatteryVoltageLevel == LEVEL_LOW) ? 1 : 0;
+}
+
 /*-------------Internal Functions Definition--------*/
 /**
   * @Brief	Check AC state handler
@@ -63,13 +84,13 @@ static void Mid_PowerManage_ACStateCheckHandler(void)
 		if(ACLinkState == STA_AC_LINK)
 		{
 			/* queue-in EventUpload MQTT message */
-			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_AC_CONNECT, 0xFF);
+			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_AC_CONNECT, 0xFF, MQTT_EVENT_CLASS_NORMAL);
 		}
 		/* AC charger disconnected */
 		else
 		{
 			/* queue-in EventUpload MQTT message */
-			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_AC_DISCONN, 0xFF);
+			MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_AC_DISCONN, 0xFF, MQTT_EVENT_CLASS_NORMAL);
 		}
 	}
 }
@@ -92,7 +113,7 @@ static void Mid_PowerManage_BatteryStateCheckHandler(void)
 			if(BatteryVoltageLevel == LEVEL_LOW)
 			{
 				/* queue-in EventUpload MQTT message */
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_BATLOW, 0xFF);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_HOST_BATLOW, 0xFF, MQTT_EVENT_CLASS_NORMAL);
 			}
 		}
 	}
@@ -14,6 +14,7 @@
 #include "tftlcd_font.h"
 #include "tftlcd_icon.h"
 #include "mid_wifi.h"
+#include "string.h"
 
 /*-------------Internal Functions Declaration-------*/
 static void Mid_TFTLCD_DrawPoint(uint16_t x, uint16_t y, uint16_t Color);
@@ -22,6 +23,9 @@ static void Mid_TFTLCD_Delay(uint32_t x);
 /*-------------Module Variables Declaration---------*/
 uint8_t ColorBuff[640];
 
+/* SystemTime shown on the screen, cleared with the screen */
+uint8_t SystemTimeShown[17];
+
 /*-------------Module Functions Definition----------*/
 /**
   * @Brief	Initialize TFTLCD module
@@ -194,6 +198,8 @@ void Mid_TFTLCD_ColorFill(uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint1
 void Mid_TFTLCD_ScreenClear(void)
 {
 	Mid_TFTLCD_ColorFill(0, 0, LCD_W, LCD_H, LCD_BACK_COLOR);
+	
+	memset(&SystemTimeShown[0], 0, sizeof(SystemTimeShown));
 }
 
 /**
@@ -371,13 +377,33 @@ void Mid_TFTLCD_ShowImage_32x32Pixel(uint16_t x, uint16_t y, uint8_t ImageIndex,
 
 /**
   * @Brief	Display System time
-  * @Param	pSystemtime: point to the SystemTime provide
+  * @Param	pSystemtime: point to the SystemTime provide("YYYY-MM-DD\0HH:MM\0")
   * @Retval	None
+  *	@Note	Only the chars changed since the last display are drawn(all after Mid_TFTLCD_ScreenClear)
   */
 void Mid_TFTLCD_ShowSystemTime(uint8_t *pSystemtime)
 {	
-	Mid_TFTLCD_ShowString(20, 200, &pSystemtime[0], LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
-	Mid_TFTLCD_ShowString(160, 200, &pSystemtime[11], LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+	uint8_t i;
+	
+	for(i=0; (i<10) && (pSystemtime[i] != '\0'); i++)
+	{
+		if(pSystemtime[i] != SystemTimeShown[i])
+		{
+			SystemTimeShown[i] = pSystemtime[i];
+			
+			Mid_TFTLCD_ShowChar(20 + i * 12, 200, pSystemtime[i], LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+		}
+	}
+	
+	for(i=11; (i<16) && (pSystemtime[i] != '\0'); i++)
+	{
+		if(pSystemtime[i] != SystemTimeShown[i])
+		{
+			SystemTimeShown[i] = pSystemtime[i];
+			
+			Mid_TFTLCD_ShowChar(160 + (i - 11) * 12, 200, pSystemtime[i], LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+		}
+	}
 }
 
 /**
@@ -7,6 +7,8 @@
 #include "stm32f10x.h"
 #include "mid_task.h"
 #include "mid_flash.h"
+#include "mid_outbox.h"
+#include "mid_clock.h"
 #include "mid_tftlcd.h"
 #include "mid_lora.h"
 #include "mid_wifi.h"
@@ -24,6 +26,8 @@
 void Mid_Task_Init(void)
 {
 	Mid_Flash_Init();
+	Mid_Outbox_Init();
+	Mid_Clock_Init();
 	Mid_TFTLCD_Init();
 	Mid_Lora_Init();
 	Mid_WiFi_Init();
@@ -42,4 +46,6 @@ void Mid_Task_Pro(void)
 	Mid_Lora_Pro();
 	Mid_WiFi_Pro();
 	Mid_PowerManage_Pro();
+	Mid_Outbox_Pro();
+	Mid_Clock_Pro();
 }
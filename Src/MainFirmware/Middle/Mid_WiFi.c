@@ -4,31 +4,25 @@
   *  		Handle the AT-command ready-to-send to the ESP8266 WiFi-module
   * @Instruction: 
   * --> DataStructure: 
-  * 	@TxBuffer: 	@Length   indicate effective data length
-  *			   		@DataByte store byte data(Number up to WIFI_TX_BUFFSIZE_MAX)
+  * 	@TxEntry:	@Length   indicate effective data length(DataBytes only, up to WIFI_TX_CMD_SIZE_MAX)
+  *			   		@DataByte store byte data of one AT-command
   *		-------------------------------------------------------------------		   
-  *		Length		DataByte1	DataByte2	DateByte3	...		Databye200
+  *		Length		DataByte1	DataByte2	DateByte3	...		DatabyteN
   *		-------------------------------------------------------------------
   *		0xFF,0xFF	0xFF		0xFF		0xFF		...		0xFF
   *		2 byte		1 byte		1 byte		1 byte		...		1 byte
   *	
-  *		@TxBufferMatrix[][]:
+  *		@TxRing[]: TxEntries packed back-to-back, an entry may wrap around the end of the ring
   *		-------------------------------------------------------------------
-  *		Length		DataByte1	DataByte2	DateByte3	...		Databye200		<0>	<--	@TxQueueIndex: point to the <Index> of current using TxBuffer
-  *		Length		DataByte1	DataByte2	DateByte3	...		Databye200		<1>
-  *		Length		DataByte1	DataByte2	DateByte3	...		Databye200		<2>
-  *	 	 .				.			.			.					.
-  *	  	 .				.			.			.					.
-  *	  	 .				.			.			.					.
-  *		Length		DataByte1	DataByte2	DateByte3	...		Databye200		<200>
+  *		... | Length | DataBytes... | Length | DataBytes... | (free) ...
+  *		      ^ @TxRingHead: oldest entry              @TxRingTail: next free byte ^
   *		-------------------------------------------------------------------
-  *		(Matrix Row number up to TX_QUEUE_SUM)
+  *		(Ring size WIFI_TX_RING_SIZE, entry rejected and counted as overflow if it does not fit)
   *	
   * --> WiFi-Module AT-command Transmit Process:
-  *			Mid_WiFi_ATcmdQueueIn	: trim given @ATcmd and @Parameters and transfer to Mid_WiFi_TxDataQueueIn function
-  *			Mid_WiFi_TxDataQueueIn	: queue-in the preprocessed ATcmd to WiFi_TxBufferMatrix[][], and queue-in the corresponding <Index> to Queue_WiFiTxSequence
-  *	 (Poll) Mid_WiFi_TxDataHandler	: queue-out the <Index> from the Queue_WiFiTxSequence, and call Mid_WiFi_TxDataSend function to send the corresponding data in WiFi_TxBufferMatrix[][]
-  *			Mid_WiFi_TxDataSend		: use WiFi_USART(USART3) send the data to ESP8266 module
+  *			Mid_WiFi_ATcmdQueueIn	: measure given @ATcmd and @Parameters, reserve a TxEntry in WiFi_TxRing[] and pack the trimmed ATcmd into it
+  *	 (Poll) Mid_WiFi_TxDataHandler	: every 100ms call Mid_WiFi_TxDataSend function if there is any TxEntry in WiFi_TxRing[]
+  *			Mid_WiFi_TxDataSend		: queue-out the oldest TxEntry and use WiFi_USART(USART3) send the data to ESP8266 module
   *  
   * --> WiFi-Module AT-command Receive Process: 
   *			Mid_WiFi_RxDataQueueIn		: queue-in received data from module to Queue_WiFiRx(CBF of WiFi_USART)
@@ -37,6 +31,12 @@
   *			Mid_WiFi_ATResponseProcess	: according to different ATResponse, change @WorkState and @MQTTState
   *	 (Poll) Mid_WiFi_RxDataHandler		: queue-out data from Queue_WiFiRx, cast Mid_WiFi_ATResponseIdentitfy to identify the valid @ATResponse,
   *										  and process the data by casting Mid_WiFi_ATResponseProcess
+  *			Mid_MQTT_TopicRoute			: +MQTTSUBRECV dispatched to the handler of its topic(Mid_WiFi_Topic_MessageDown / _DateTime),
+  *										  the routes are registered when the topics are subscribed(Mid_WiFi_MQTT_Subscribe)
+  *
+  * --> WIFI_SIMULATOR_MODE:
+  *			Mid_WiFi_TxDataSend sends to Mid_WiFiSim_DataIn, Mid_WiFiSim_Pro queue-in the answers by Mid_WiFi_RxDataQueueIn,
+  *			WiFi_USART(USART3) is not used
   
   ***************************************************/
   
@@ -50,6 +50,7 @@
 #include "string.h"
 #include "stringprocess.h"
 #include "mqtt_protocol.h"
+#include "mid_wifisim.h"
 
 /*---------------------- ESP8266 AT Commands: ------------------------*/
 const unsigned char ESP8266_AT[ESP8266_AT_SUM][70] = 
@@ -72,6 +73,9 @@ const unsigned char ESP8266_AT[ESP8266_AT_SUM][70] =
 	"AT+MQTTSUB=0,\"",				// Subscribe to MQTT topic(1): <LinkID>=0, <"topic">, <qos>
 	"AT+MQTTSUB=0,\"",				// Subscribe to MQTT topic(2): <LinkID>=0, <"topic">, <qos>
 	"AT+MQTTCLEAN=0",					// Close the MQTT connection: <LinkID>=0
+	
+	"AT+CWJAP?",							// Query the connected AP: <ssid>, <bssid>, <channel>, <rssi>, ...
+	"AT+CWLAP",								// Scan all the APs: (<ecn>, <ssid>, <rssi>, <mac>, <channel>, ...)
 };
 
 /*------------------- ESP8266 AT Commands Response: -------------------*/
@@ -91,8 +95,7 @@ const unsigned char ESP8266_ATResponse[ESP8266_AT_RESPONSE_SUM][60]=
 	"+MQTTDISCONNECTED:0\0",
 	"+MQTTSUB=0,\"<UID>_MessageDown\",",
 	"+MQTTSUB=0,\"$SYS/brokers/emqx@127.0.0.1/datetime\",",
-	"+MQTTSUBRECV:0,\"<UID>_MessageDown\",\0",
-	"+MQTTSUBRECV:0,\"$SYS/brokers/emqx@127.0.0.1/datetime\",\0",
+	"+MQTTSUBRECV:0,\"\0",
 	
 	"OK\r\n\0",    
 	"ERROR\0", 	
@@ -106,18 +109,47 @@ static uint8_t 	Mid_WiFi_GetSSID(uint8_t *pData, uint8_t SSID[]);
 static void 	Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t ATResponse, uint16_t Len);
 static void 	Mid_WiFi_RxDataHandler(void);
 
-static void 	Mid_WiFi_TxDataQueueIn(uint8_t *pData);
-static void 	Mid_WiFi_TxDataSend(uint8_t *pData);
+static uint8_t 	Mid_WiFi_TxRingReserve(uint16_t Len);
+static void 	Mid_WiFi_TxRingPutByte(uint8_t Data);
+static void 	Mid_WiFi_TxRingEmpty(void);
+static void 	Mid_WiFi_TxDataSend(void);
+static void 	Mid_WiFi_TxWaitIn(uint8_t PubFlag);
+static void 	Mid_WiFi_TxWaitOut(uint8_t Result);
+static void 	Mid_WiFi_TxWaitAbort(void);
+static void 	Mid_WiFi_RxFlush(void);
 static void 	Mid_WiFi_TxDataHandler(void);
 
 static uint8_t 	Mid_WiFi_PowerManage(en_ESP8266_PowerState_t State);
 
 static uint8_t 	Mid_WiFi_MQTT_Pro(void);
-static uint8_t 	Mid_WiFi_MQTTRxDataHandler(uint8_t *pData, uint8_t *pReceiveData);
+static void 	Mid_WiFi_MQTT_Reconnect(void);
+
+static void 	Mid_WiFi_ReconnectDrop(en_WiFi_ReconnectLayer_t Layer);
+static uint16_t Mid_WiFi_ReconnectAttempt(en_WiFi_ReconnectLayer_t Layer);
+static void 	Mid_WiFi_ReconnectDone(en_WiFi_ReconnectLayer_t Layer);
+static void 	Mid_WiFi_ReconnectRestart(en_WiFi_ReconnectLayer_t Layer);
+static uint16_t Mid_WiFi_MQTTRxDataHandler(uint8_t *pData, uint16_t Len, uint8_t **ppReceiveData, uint8_t **ppTopic, uint8_t *pTopicLen);
+static uint8_t 	Mid_WiFi_MQTT_Subscribe(uint8_t *pTopic, en_ESP8266_AT_t ATcmd, MQTT_TopicHandler_t pHandler);
+static void 	Mid_WiFi_Topic_MessageDown(uint8_t *pData, uint16_t Len);
+static void 	Mid_WiFi_Topic_DateTime(uint8_t *pData, uint16_t Len);
+
+static uint8_t *Mid_WiFi_ParseQuoted(uint8_t *pData, uint8_t *pString, uint8_t Size);
+static uint8_t *Mid_WiFi_ParseNumber(uint8_t *pData, int16_t *pValue);
+static void 	Mid_WiFi_RSSISampleIn(int8_t RSSI, uint8_t Channel);
+static void 	Mid_WiFi_ScanAPIn(uint8_t *pData);
 
 /*-------------Module Variables Declaration--------*/
-uint8_t WiFi_TxQueueIndex;			// pointer of current ready-to-send queue
-uint8_t WiFi_TxBufferMatrix[WIFI_TX_QUEUE_SUM][WIFI_TX_BUFFER_SIZE];
+uint8_t  WiFi_TxRing[WIFI_TX_RING_SIZE];	// packed ready-to-send AT-commands
+uint16_t WiFi_TxRingHead;					// index of the oldest TxEntry
+uint16_t WiFi_TxRingTail;					// index of the next free byte
+stu_WiFi_TxRingStat_t stu_WiFi_TxRingStat;
+
+/* AT-commands sent out and waiting for "OK"/"ERROR"(the module answers in order): */
+uint32_t WiFi_TxWaitPubMask;				// bit n: 1->the n-th oldest waiting AT-command is AT+MQTTPUB
+uint8_t  WiFi_TxWaitNumber;
+uint16_t WiFi_TxWaitCounter;				// time the oldest AT-command has been waiting(unit: 10ms)
+uint8_t  WiFi_TxPubNumber;					// AT+MQTTPUB queued-in WiFi_TxRing, not sent out yet
+uint8_t  WiFi_TxPubStaleNumber;				// AT+MQTTPUB left in WiFi_TxRing after WIFI_MQTT_PUB_LOST, result not reported
 
 uint8_t WiFi_RxBuffer[WIFI_RX_BUFFER_SIZE];
 
@@ -127,8 +159,27 @@ en_ESP8266_State_t 		WiFi_WorkState;
 en_ESP8266_LinkState_t 	WiFi_LinkState;
 en_MQTT_State_t			WiFi_MQTTState;
 
+/* Reconnect: */
+uint8_t  WiFi_MQTTConfigFlag;								// 1->MQTT user config accepted by the module, reconnect can skip CLEAN/USERCFG
+uint8_t  WiFi_MQTTConnectRetry;								// MQTT connects since the last USERCFG/fast-reconnect
+uint8_t  WiFi_MQTTBrokerFlag;								// 1->"+MQTTCONNECTED" received for the AT+MQTTCONN in process
+uint16_t WiFi_ReconnectBackoff[WIFI_RECONNECT_LAYER_SUM];	// delay before the next attempt(unit: 10ms)
+uint32_t WiFi_ReconnectRandom;								// jitter generator, seeded by the unique device ID
+stu_WiFi_ReconnectStat_t stu_WiFi_ReconnectStat[WIFI_RECONNECT_LAYER_SUM];
+
+/* Link quality: */
+stu_WiFi_RSSISample_t 	WiFi_RSSISample[WIFI_RSSI_SAMPLE_SUM];	// ring of RSSI samples
+uint8_t 				WiFi_RSSISampleIndex;					// index of the next sample
+uint8_t 				WiFi_RSSISampleNumber;
+uint8_t 				WiFi_APChannel;
+
+/* AP scan cache: */
+stu_WiFi_APInfo_t 		WiFi_ScanAP[WIFI_SCAN_AP_SUM];
+uint8_t 				WiFi_ScanAPNumber;
+uint8_t 				WiFi_ScanRefresh;						// 1->scan requested, the next +CWLAP starts a new list
+uint32_t 				WiFi_ScanTick;							// OS tick of the cached scan
+
 volatile Queue1K Queue_WiFiRx;
-		 Queue16 Queue_WiFiTxSequence;	// Index(WiFi_TxQueuePos) of ready-to-send WiFi_Tx-dataframe
 
 /* System time from server: */
 uint8_t SystemTime[17];
@@ -138,7 +189,7 @@ uint8_t MQTT_PubDataTest[] = {0,6,0xAA,0x06,0x29,0x08,0x27,0x55};
 
 
 /*---Module Call-Back function pointer Definition---*/
-
+WiFi_MQTTPubCBF_t WiFi_MQTTPubCBF;
 
 
 /*-------------Module Functions Definition---------*/
@@ -149,26 +200,37 @@ uint8_t MQTT_PubDataTest[] = {0,6,0xAA,0x06,0x29,0x08,0x27,0x55};
   */
 void Mid_WiFi_Init(void)
 {
-	uint8_t i;
-	
 	QueueEmpty(Queue_WiFiRx);
-	QueueEmpty(Queue_WiFiTxSequence);
+	Mid_WiFi_TxRingEmpty();
 	
-	WiFi_TxQueueIndex = 0;
 	WiFi_WorkState = ESP8266_STA_MODULE_DETECT;
 	WiFi_LinkState = ESP8266_LINK_0_NOCONNECTION;
 	WiFi_MQTTState = MQTT_STA_IDLE;
 	
+	/* module restarted, all the cached configuration is lost */
+	WiFi_MQTTConfigFlag = 0;
+	WiFi_MQTTConnectRetry = 0;
+	WiFi_MQTTBrokerFlag = 0;
+	
+	WiFi_ReconnectRandom = *(volatile uint32_t *)WIFI_RECONNECT_SEED_ADDRESS ^
+						   *(volatile uint32_t *)(WIFI_RECONNECT_SEED_ADDRESS + 4) ^
+						   *(volatile uint32_t *)(WIFI_RECONNECT_SEED_ADDRESS + 8);
+	
+	Mid_WiFi_ReconnectRestart(WIFI_RECONNECT_LAYER_AP);
+	Mid_WiFi_ReconnectRestart(WIFI_RECONNECT_LAYER_MQTT);
+	
 	memset(&WiFi_RxBuffer[0], 0, WIFI_RX_BUFFER_SIZE);
 	memset(&WiFi_SSID[0], 0, WIFI_SSID_LENGTH_MAX);
 	
-	for(i=0; i<WIFI_TX_QUEUE_SUM; i++)
-	{
-		memset(&WiFi_TxBufferMatrix[i], 0, sizeof(WiFi_TxBufferMatrix[i]));
-	}
-	
 	/* register Mid_WiFi_RxDataQueueIn as the CBF for WiFi_USART(USART3) IRQHandler */
+	#ifndef WIFI_SIMULATOR_MODE
 	Hal_USART_WiFiRxCBFRegister(Mid_WiFi_RxDataQueueIn);
+	#endif
+	
+	/* Simulator Mode: Mid_WiFi_RxDataQueueIn receives the answers of the simulated module */
+	#ifdef WIFI_SIMULATOR_MODE
+	Mid_WiFiSim_Init(Mid_WiFi_RxDataQueueIn);
+	#endif
 }
 
 /**
@@ -178,6 +240,11 @@ void Mid_WiFi_Init(void)
   */
 void Mid_WiFi_Pro(void)
 {
+	/* Simulator Mode: */
+	#ifdef WIFI_SIMULATOR_MODE
+	Mid_WiFiSim_Pro();
+	#endif
+	
 	/* Debug Mode: */
 	#ifdef WIFI_Module_DEBUG_MODE
 	Mid_WiFi_RxDataHandler();
@@ -200,63 +267,89 @@ void Mid_WiFi_Pro(void)
   *			preprocess and queue-in the AT command
   * @Param	ATcmd: Corresponding AT command 
   *			pPara: AT command parameters, @0xFF indicates there is no parameters followed 
-  * @Retval	None
+  * @Retval	0->queue-in succeed, 0xFF->invalid ATcmd or WiFi_TxRing overflow(ATcmd dropped)
   */
-void Mid_WiFi_ATcmdQueueIn(en_ESP8266_AT_t ATcmd, uint8_t *pPara)
+uint8_t Mid_WiFi_ATcmdQueueIn(en_ESP8266_AT_t ATcmd, uint8_t *pPara)
 {
 	uint16_t i;
-	uint8_t DataBuff[WIFI_TX_BUFFER_SIZE];
+	uint16_t CmdLen;
+	uint16_t ParaLen;
+	uint8_t  ParaEnd;
+	
+	if(ATcmd >= ESP8266_AT_SUM)
+	{
+		return 0xFF;
+	}
+	
+	/* AT command content before "\0" */
+	CmdLen = 0;
+	
+	while((CmdLen < sizeof(ESP8266_AT[0])) && (ESP8266_AT[ATcmd][CmdLen] != 0))
+	{
+		CmdLen++;
+	}
 	
-	if(ATcmd < ESP8266_AT_SUM)
+	/* AT-parameters followed: SSID of CWLAP ends with 0xFF, others end with 0 */
+	ParaLen = 0;
+	
+	if(*pPara != 0xFF)
 	{
-		for(i=0; i<WIFI_TX_BUFFER_SIZE; i++)	// extract AT command content from ESP8266_AT[][] array
+		ParaEnd = (ATcmd == ESP8266_AT_CWLAP) ? 0xFF : 0;
+		
+		while(pPara[ParaLen] != ParaEnd)
 		{
-			if(ESP8266_AT[ATcmd][i] != 0)	// content before "\0"
-			{
-				// Dataframe first 2byte reserved for <Length>
-				DataBuff[i+2] = ESP8266_AT[ATcmd][i];
-			}
-			else	// examine if there is any AT-parameters followed
-			{
-				if(*pPara != 0xFF)
-				{
-					if(ATcmd == ESP8266_AT_CWLAP)	// provide specified SSID
-					{
-						while(*pPara != 0xFF)
-						{
-							DataBuff[i+2] = *pPara;
-							i++;
-							pPara++;
-						}
-						
-						DataBuff[i+2] = '"';
-						i++;
-					}
-					else
-					{
-						while(*pPara != 0)
-						{
-							DataBuff[i+2] = *pPara;
-							i++;
-							pPara++;
-						}
-					}
-				}
-				
-				DataBuff[i+2] = 0x0D;
-				i++;
-				DataBuff[i+2] = 0x0A;
-				i++;
-				
-				DataBuff[0] = ((i+2) >> 8) & 0xFF;	// Len highbyte
-				DataBuff[1] = (i+2) & 0xFF;					// Len lowbyte
-				
-				Mid_WiFi_TxDataQueueIn(DataBuff);
-				
-				break;
-			}
+			ParaLen++;
 		}
 	}
+	
+	if(Mid_WiFi_TxRingReserve(CmdLen + ParaLen + ((ATcmd == ESP8266_AT_CWLAP) && ParaLen ? 1 : 0) + 2))
+	{
+		return 0xFF;
+	}
+	
+	for(i=0; i<CmdLen; i++)
+	{
+		Mid_WiFi_TxRingPutByte(ESP8266_AT[ATcmd][i]);
+	}
+	
+	for(i=0; i<ParaLen; i++)
+	{
+		Mid_WiFi_TxRingPutByte(pPara[i]);
+	}
+	
+	if((ATcmd == ESP8266_AT_CWLAP) && ParaLen)	// provide specified SSID
+	{
+		Mid_WiFi_TxRingPutByte('"');
+	}
+	
+	Mid_WiFi_TxRingPutByte(0x0D);
+	Mid_WiFi_TxRingPutByte(0x0A);
+	
+	return 0;
+}
+
+/**
+  * @Brief	Get the statistics of WiFi_TxRing
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_WiFi_GetTxRingStat(stu_WiFi_TxRingStat_t *pStat)
+{
+	*pStat = stu_WiFi_TxRingStat;
+}
+
+/**
+  * @Brief	Get the reconnect statistics of specified layer
+  * @Param	Layer: reconnect layer(AP / MQTT)
+  *			pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_WiFi_GetReconnectStat(en_WiFi_ReconnectLayer_t Layer, stu_WiFi_ReconnectStat_t *pStat)
+{
+	if(Layer < WIFI_RECONNECT_LAYER_SUM)
+	{
+		*pStat = stu_WiFi_ReconnectStat[Layer];
+	}
 }
 
 /**
@@ -273,11 +366,17 @@ uint8_t Mid_WiFi_GetModuleWorkState(void)
   * @Brief	Change WiFi-Module to specific working state 
   * @Param	State: target working state(en_ESP8266_State_t)
   * @Retval	None
+  *	@Note	Same state(READY confirmed by the AT+CWSTATE? poll): Queue_WiFiRx kept, the answers behind are still matched
   */
 void Mid_WiFi_ChangeModuleWorkState(en_ESP8266_State_t State)
 {
+	if(State == WiFi_WorkState)
+	{
+		return;
+	}
+	
 	WiFi_WorkState = State;
-	QueueEmpty(Queue_WiFiRx);	// Clear the Queue_WiFiRx buffer after changing module working state
+	Mid_WiFi_RxFlush();		// Clear the Queue_WiFiRx buffer after changing module working state
 }
 
 /**
@@ -294,30 +393,42 @@ uint8_t Mid_WiFi_GetMQTTState(void)
   * @Brief	Change MQTT state
   * @Param	State: target MQTT state
   * @Retval	None
+  *	@Note	Queue_WiFiRx flushed only for the connecting states(the "OK"s step them), kept from MQTT_STA_READY on:
+  *			publish results / datetime pushes never drop the answers of the AT-commands waiting
   */
 void Mid_WiFi_ChangeMQTTState(en_MQTT_State_t State)
 {
 	WiFi_MQTTState = State;
 	
-	QueueEmpty(Queue_WiFiRx);
+	/* connecting again: wait for the answer of the next AT+MQTTCONN */
+	if(State == MQTT_STA_CONNECT)
+	{
+		WiFi_MQTTBrokerFlag = 0;
+	}
+	
+	if(State < MQTT_STA_READY)
+	{
+		Mid_WiFi_RxFlush();
+	}
 }
 
 /**
   * @Brief	Publish specified message to <PubTopic>
-  * @Param	pData: point to the ready-to-publish message string
-  * @Retval	None
+  * @Param	pData	: point to the ready-to-publish message string
+  *			Retain	: 1->retained by the broker(delivered to the later subscribers), 0->not retained
+  * @Retval	0->publish queued-in(result reported by the publish CBF), 0xFF->MQTT not ready / WiFi_TxRing full / data too long
 	@Note	"AT+MQTTPUB=0, <"topic">, <"data">, <qos>, <retain>"
 			<qos>	: 0, 1, 2, default 0
 			<retain>: retain flag
   */
-void Mid_WiFi_MQTT_PublishMessage(uint8_t *pData)
+uint8_t Mid_WiFi_MQTT_PublishMessage(uint8_t *pData, uint8_t Retain)
 {
 	uint8_t i;
-	uint8_t Index;
+	uint16_t Index;
 	uint8_t Char_H;
 	uint8_t Char_L;
 	uint16_t Len;
-	uint8_t MQTTDataBuff[WIFI_MQTT_TX_DATA_SIZE];
+	static uint8_t MQTTDataBuff[WIFI_MQTT_PUB_DATA_SIZE];
 	
 	if((Mid_WiFi_GetMQTTState() == MQTT_STA_READY) && 
 	   (Mid_WiFi_GetModuleWorkState() == ESP8266_STA_MODULE_READY))
@@ -352,21 +463,69 @@ void Mid_WiFi_MQTT_PublishMessage(uint8_t *pData)
 			MQTTDataBuff[Index++] = Char_L;
 			pData++;
 			
-			if(Index >= (WIFI_MQTT_TX_DATA_SIZE - 6))
+			if(Index >= (WIFI_MQTT_PUB_DATA_SIZE - 6))
 			{
+				/* data left: not published truncated(the publish result would ack a corrupt frame) */
+				if(Len)
+				{
+					return 0xFF;
+				}
 				break;
 			}
 		}
-			MQTTDataBuff[Index++] = '\"';
-			MQTTDataBuff[Index++] = ',';
-			MQTTDataBuff[Index++] = '2';
-			MQTTDataBuff[Index++] = ',';
-			MQTTDataBuff[Index++] = '0';
-			MQTTDataBuff[Index++] = '\0';
-			
-			Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTPUB, &MQTTDataBuff[0]);
+		MQTTDataBuff[Index++] = '\"';
+		MQTTDataBuff[Index++] = ',';
+		MQTTDataBuff[Index++] = '2';
+		MQTTDataBuff[Index++] = ',';
+		MQTTDataBuff[Index++] = Retain ? '1' : '0';
+		MQTTDataBuff[Index++] = '\0';
+		
+		if(Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTPUB, &MQTTDataBuff[0]) == 0)
+		{
+			WiFi_TxPubNumber++;
 			
+			return 0;
+		}
+	}
+	
+	return 0xFF;
+}
+
+/**
+  * @Brief	Register call-back function of MQTT publish result(API for upper layer)
+  * @Param	pCBF: point to the call-back function, called once per publish with en_WiFi_MQTTPubResult_t,
+  *				  WIFI_MQTT_PUB_LOST is reported once for all the unanswered publishes
+  * @Retval	None
+  */
+void Mid_WiFi_MQTT_PublishCBFRegister(WiFi_MQTTPubCBF_t pCBF)
+{
+	if(WiFi_MQTTPubCBF == 0)
+	{
+		WiFi_MQTTPubCBF = pCBF;
+	}
+}
+
+/**
+  * @Brief	Check whether a full-size publish message can be queued-in WiFi_TxRing now
+  * @Param	None
+  * @Retval	1->ready to publish, 0->MQTT not ready or WiFi_TxRing busy
+  *	@Note	Used by the uplink as back-pressure, so that a publish is never dropped by WiFi_TxRing overflow
+  */
+uint8_t Mid_WiFi_MQTT_PublishReady(void)
+{
+	if((Mid_WiFi_GetMQTTState() != MQTT_STA_READY) || 
+	   (Mid_WiFi_GetModuleWorkState() != ESP8266_STA_MODULE_READY))
+	{
+		return 0;
+	}
+	
+	/* Length header + "AT+MQTTPUB=0,\"" + parameters + "\r\n" */
+	if((WIFI_TX_RING_SIZE - stu_WiFi_TxRingStat.UsedBytes) < (2 + sizeof(ESP8266_AT[0]) + WIFI_MQTT_PUB_DATA_SIZE + 2))
+	{
+		return 0;
 	}
+	
+	return 1;
 }
 
 /**
@@ -381,10 +540,31 @@ void Mid_WiFi_MQTT_PublishMessage(uint8_t *pData)
   */
 uint8_t Mid_WiFi_GetSignalLevel(void)
 {
+	int8_t RSSI;
+	
 	if(WiFi_LinkState == ESP8266_LINK_2_CONNECTED_GETIPV4)
 	{
-		return 3;
+		if(WiFi_RSSISampleNumber == 0)	// not sampled yet
+		{
+			return 3;
+		}
+		
+		RSSI = WiFi_RSSISample[(WiFi_RSSISampleIndex + WIFI_RSSI_SAMPLE_SUM - 1) % WIFI_RSSI_SAMPLE_SUM].RSSI;
+		
+		if(RSSI >= -70)
+		{
+			return 3;
+		}
+		else if(RSSI >= -80)
+		{
+			return 2;
+		}
+		else if(RSSI >= -90)
+		{
+			return 1;
+		}
 		
+		return 0;
 	}
 	else
 	{
@@ -392,6 +572,143 @@ uint8_t Mid_WiFi_GetSignalLevel(void)
 	}
 }
 
+/**
+  * @Brief	Get the link quality(min/mean/max of the RSSI samples kept)
+  * @Param	pQuality: point to the struct to store the link quality
+  * @Retval	None
+  */
+void Mid_WiFi_GetLinkQuality(stu_WiFi_LinkQuality_t *pQuality)
+{
+	uint8_t i;
+	int16_t Sum;
+	int8_t RSSI;
+	
+	memset(pQuality, 0, sizeof(stu_WiFi_LinkQuality_t));
+	
+	pQuality->SampleNumber = WiFi_RSSISampleNumber;
+	pQuality->Channel = WiFi_APChannel;
+	
+	if(WiFi_RSSISampleNumber == 0)
+	{
+		return;
+	}
+	
+	pQuality->Last = WiFi_RSSISample[(WiFi_RSSISampleIndex + WIFI_RSSI_SAMPLE_SUM - 1) % WIFI_RSSI_SAMPLE_SUM].RSSI;
+	pQuality->Min = 0;
+	pQuality->Max = -128;
+	Sum = 0;
+	
+	for(i=0; i<WiFi_RSSISampleNumber; i++)
+	{
+		RSSI = WiFi_RSSISample[i].RSSI;
+		
+		Sum += RSSI;
+		
+		if(RSSI < pQuality->Min)
+		{
+			pQuality->Min = RSSI;
+		}
+		
+		if(RSSI > pQuality->Max)
+		{
+			pQuality->Max = RSSI;
+		}
+	}
+	
+	pQuality->Mean = Sum / WiFi_RSSISampleNumber;
+}
+
+/**
+  * @Brief	Get the RSSI samples kept, newest first
+  * @Param	pSample	: point to the array to store the samples
+  *			Number	: size of the array
+  * @Retval	Number of samples copied
+  */
+uint8_t Mid_WiFi_GetRSSIHistory(stu_WiFi_RSSISample_t *pSample, uint8_t Number)
+{
+	uint8_t i;
+	
+	if(Number > WiFi_RSSISampleNumber)
+	{
+		Number = WiFi_RSSISampleNumber;
+	}
+	
+	for(i=0; i<Number; i++)
+	{
+		pSample[i] = WiFi_RSSISample[(WiFi_RSSISampleIndex + WIFI_RSSI_SAMPLE_SUM - 1 - i) % WIFI_RSSI_SAMPLE_SUM];
+	}
+	
+	return Number;
+}
+
+/**
+  * @Brief	Request an AP scan, the result is kept in the scan cache
+  * @Param	None
+  * @Retval	0->cache is still valid / scan queued-in, 0xFF->module busy(not ready or MQTT in process)
+  *	@Note	The scan result arrives asynchronously, read it by Mid_WiFi_GetScanAPNumber/Mid_WiFi_GetScanAP,
+  *			no rescan is sent while the cache is younger than WIFI_SCAN_CACHE_TIME
+  */
+uint8_t Mid_WiFi_ScanRequest(void)
+{
+	uint8_t Para;
+	
+	if(WiFi_ScanAPNumber && ((OS_GetTickCount() - WiFi_ScanTick) < WIFI_SCAN_CACHE_TIME))
+	{
+		return 0;
+	}
+	
+	/* the "OK" of AT+CWLAP must not be taken by the MQTT state machine */
+	if((Mid_WiFi_GetModuleWorkState() != ESP8266_STA_MODULE_READY) || 
+	   (Mid_WiFi_GetMQTTState() != MQTT_STA_READY))
+	{
+		return 0xFF;
+	}
+	
+	if(WiFi_ScanRefresh)	// scan in process
+	{
+		return 0;
+	}
+	
+	Para = 0xFF;
+	
+	if(Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWLAPALL, &Para))
+	{
+		return 0xFF;
+	}
+	
+	WiFi_ScanRefresh = 1;
+	
+	return 0;
+}
+
+/**
+  * @Brief	Get the number of APs in the scan cache
+  * @Param	None
+  * @Retval	Number of APs
+  */
+uint8_t Mid_WiFi_GetScanAPNumber(void)
+{
+	return WiFi_ScanAPNumber;
+}
+
+/**
+  * @Brief	Get the AP info from the scan cache
+  * @Param	Index: index of AP(0 -> Number-1, in the order of the module report)
+  *			pAP	 : point to the struct to store the AP info
+  * @Retval	0->succeed, 0xFF->invalid index
+  */
+uint8_t Mid_WiFi_GetScanAP(uint8_t Index, stu_WiFi_APInfo_t *pAP)
+{
+	if(Index >= WiFi_ScanAPNumber)
+	{
+		return 0xFF;
+	}
+	
+	*pAP = WiFi_ScanAP[Index];
+	
+	return 0;
+}
+
 /*-------------Internal Functions Definition--------*/
 /**
   * @Brief	Queue-in the recevied data from WiFi-module to Queue_WiFiRx(handler of WiFi_USART_RxCBF)
@@ -476,9 +793,10 @@ static uint8_t Mid_WiFi_GetSSID(uint8_t *pData, uint8_t SSID[])
   */
 static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t ATResponse, uint16_t Len)
 {
-	static uint8_t MQTT_ReceiveDataLen;
-	static uint8_t DataBuff[WIFI_RX_BUFFER_SIZE];
-	static uint8_t HexDataBuff[WIFI_RX_BUFFER_SIZE];
+	uint16_t MQTT_ReceiveDataLen;
+	uint8_t *pReceiveData;
+	uint8_t *pTopic;
+	uint8_t TopicLen;
 	
 	switch((uint8_t)ATResponse)
 	{
@@ -486,7 +804,7 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 		{
 			if(Mid_WiFi_GetModuleWorkState() != ESP8266_STA_GET_SMART_WIFI_INFO)
 			{
-				Mid_WiFi_ChangeMQTTState(MQTT_STA_IDLE);
+				Mid_WiFi_MQTT_Reconnect();
 			}
 		}
 		break;
@@ -495,8 +813,11 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 		{
 			if(Mid_WiFi_GetModuleWorkState() != ESP8266_STA_NETPAIR_IN_PROCESS)
 			{
-				Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_MODULE_DETECT);
-				Mid_WiFi_ChangeMQTTState(MQTT_STA_IDLE);
+				/* module is alive and keeps CWMODE/CWAUTOCONN, only wait for the AP-link(auto-reconnect) */
+				Mid_WiFi_ReconnectDrop(WIFI_RECONNECT_LAYER_AP);
+				
+				Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_MODULE_STATE);
+				Mid_WiFi_MQTT_Reconnect();
 			}
 		}
 		break;
@@ -509,6 +830,8 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 			
 			if(WiFi_LinkState == ESP8266_LINK_2_CONNECTED_GETIPV4)	
 			{
+				Mid_WiFi_ReconnectDone(WIFI_RECONNECT_LAYER_AP);
+				
 				Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_MODULE_READY);
 			}
 			else
@@ -520,13 +843,33 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 		
 		case ESP8266_AT_RESPONSE_CWJAP:
 		{
-		
+			// +CWJAP:<"ssid">,<"bssid">,<channel>,<rssi>,...
+			int16_t Channel;
+			int16_t RSSI;
+			
+			while((*pData != ':') && (*pData != 0))
+			{
+				pData++;
+			}
+			
+			if(*pData == ':')
+			{
+				pData = Mid_WiFi_ParseQuoted(pData + 1, 0, 0);		// ssid
+				pData = Mid_WiFi_ParseQuoted(pData, 0, 0);		// bssid
+				pData = Mid_WiFi_ParseNumber(pData, &Channel);
+				pData = Mid_WiFi_ParseNumber(pData, &RSSI);
+				
+				if((RSSI < 0) && (RSSI >= -128))
+				{
+					Mid_WiFi_RSSISampleIn((int8_t)RSSI, (uint8_t)Channel);
+				}
+			}
 		}
 		break;
 		
 		case ESP8266_AT_RESPONSE_CWLAP:
 		{
-		
+			Mid_WiFi_ScanAPIn(pData);
 		}
 		break;
 		
@@ -548,36 +891,32 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 		}
 		break;
 		
-		case ESP8266_AT_RESPONSE_MQTTDISCONN:
+		case ESP8266_AT_RESPONSE_MQTTCONN:
 		{
-			Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_MODULE_DETECT);
-			Mid_WiFi_ChangeMQTTState(MQTT_STA_IDLE);
+			WiFi_MQTTBrokerFlag = 1;
 		}
 		break;
 		
-		case ESP8266_AT_RESPONSE_MQTTRECV_DOWN:
+		case ESP8266_AT_RESPONSE_MQTTDISCONN:
 		{
-			MQTT_ReceiveDataLen = Mid_WiFi_MQTTRxDataHandler(pData, &DataBuff[0]);
-			
-			ASCII_Hex_Conversion(&DataBuff[0], MQTT_ReceiveDataLen, &HexDataBuff[0]);
-			
-			MQTTProtocol_ReceiveDataHandler(PROTOCOL_COMM_TYPE_WIFI, &HexDataBuff[0], MQTT_ReceiveDataLen);
-			
+			/* AP-link is still up, only reconnect the MQTT broker */
+			Mid_WiFi_MQTT_Reconnect();
 		}
 		break;
-
-		case ESP8266_AT_RESPONSE_MQTTRECV_SYSTIME:
+		
+		case ESP8266_AT_RESPONSE_MQTTSUBRECV:
 		{
-			MQTT_ReceiveDataLen = Mid_WiFi_MQTTRxDataHandler(pData, &DataBuff[0]);
-
-			Mid_MQTT_SystemTimeProcess(&DataBuff[0], &SystemTime[0]);
-
-			Mid_WiFi_ChangeMQTTState(MQTT_STA_RECV_SYSTIME);
+			MQTT_ReceiveDataLen = Mid_WiFi_MQTTRxDataHandler(pData, Len, &pReceiveData, &pTopic, &TopicLen);
+			
+			/* handler of the subscribed topic: Mid_WiFi_Topic_MessageDown / Mid_WiFi_Topic_DateTime */
+			Mid_MQTT_TopicRoute(pTopic, TopicLen, pReceiveData, MQTT_ReceiveDataLen);
 		}
 		break;
 		
 		case ESP8266_AT_RESPONSE_OK:
 		{
+			Mid_WiFi_TxWaitOut(WIFI_MQTT_PUB_OK);
+			
 			if(Mid_WiFi_GetModuleWorkState() == ESP8266_STA_MODULE_DETECT)
 			{
 				Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_MODULE_INIT);
@@ -592,9 +931,15 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 					}
 					break;
 					
+					/* "OK" of AT+MQTTCONN only: the "OK" of an AT-command sent meanwhile(AT+CWSTATE?, AT+CWJAP?) comes without "+MQTTCONNECTED" */
 					case MQTT_STA_CONNECT:
 					{
-						Mid_WiFi_ChangeMQTTState(MQTT_STA_SUB);
+						if(WiFi_MQTTBrokerFlag)
+						{
+							WiFi_MQTTConfigFlag = 1;	// broker accepted the user config
+							
+							Mid_WiFi_ChangeMQTTState(MQTT_STA_SUB);
+						}
 					}
 					break;
 					
@@ -606,6 +951,17 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 
 					case MQTT_STA_SUB_DATETIME:
 					{
+						Mid_WiFi_ChangeMQTTState(MQTT_STA_SUB_FIRMWARE_UPDATE);
+					}
+					break;
+					
+					case MQTT_STA_SUB_FIRMWARE_UPDATE:
+					{
+						Mid_WiFi_ReconnectDone(WIFI_RECONNECT_LAYER_MQTT);
+						
+						/* (re)connected: publish the Terminal state snapshot first */
+						MQTTProtocol_StateSnapshot_Request();
+						
 						Mid_WiFi_ChangeMQTTState(MQTT_STA_READY);
 					}
 					break;
@@ -616,7 +972,7 @@ static void Mid_WiFi_ATResponseProcess(uint8_t *pData, en_ESP8266_ATResponse_t A
 		
 		case ESP8266_AT_RESPONSE_ERROR:
 		{
-		
+			Mid_WiFi_TxWaitOut(WIFI_MQTT_PUB_FAIL);
 		}
 		break;
 		
@@ -685,7 +1041,13 @@ static void Mid_WiFi_RxDataHandler(void)
 				QueueDataOut(Queue_WiFiRx, &RxData);
 			}
 			
-			if(RxBuffIndex > 2)	
+			/* message of a subscribed topic: routed by the topic, no scan of the table over the message data */
+			if((RxBuffIndex > 2) && 
+			   (memcmp(&WiFi_RxBuffer[0], ESP8266_ATResponse[ESP8266_AT_RESPONSE_MQTTSUBRECV], GetStringLen((uint8_t *)ESP8266_ATResponse[ESP8266_AT_RESPONSE_MQTTSUBRECV])) == 0))
+			{
+				Mid_WiFi_ATResponseProcess(&WiFi_RxBuffer[0], ESP8266_AT_RESPONSE_MQTTSUBRECV, RxBuffIndex);
+			}
+			else if(RxBuffIndex > 2)	
 			{
 				Flag = Mid_WiFi_ATResponseIdentitfy(&WiFi_RxBuffer[0],  (uint8_t*)&ATResponseIndex, &StartMatchIndex, RxBuffIndex);
 				
@@ -708,57 +1070,239 @@ static void Mid_WiFi_RxDataHandler(void)
 
 
 /**
-  * @Brief	Store the trimmed ATcmd dataframe to WiFi_TxBufferMatrix, 
-  *			and queue-in the corresponding WiFi_TxQueueIndex to Queue_WiFiTxSequence
-  * @Param	pData: point to the trimmed data
-  * @Retval	None
+  * @Brief	Reserve a TxEntry of @Len bytes in WiFi_TxRing and write its 2byte Length header
+  * @Param	Len: length of the AT-command(Length header excluded)
+  * @Retval	0->reserve succeed, 0xFF->WiFi_TxRing overflow
+  *	@Note	The TxEntry is rejected(never overwrite the queued ones) if there is not enough free space,
+  *			the oldest commands are usually the module/MQTT state transitions which must be kept in order
   */
-static void Mid_WiFi_TxDataQueueIn(uint8_t *pData)
+static uint8_t Mid_WiFi_TxRingReserve(uint16_t Len)
 {
-	uint16_t Len;
-	uint16_t i;
+	if((Len > WIFI_TX_CMD_SIZE_MAX) || 
+	   ((Len + 2) > (WIFI_TX_RING_SIZE - stu_WiFi_TxRingStat.UsedBytes)))
+	{
+		stu_WiFi_TxRingStat.OverflowNumber++;
+		
+		Hal_USART_DebugStringQueueIn("WiFi Tx overflow\r\n");
+		
+		return 0xFF;
+	}
 	
-	Len = ((pData[0] << 8) | (pData[1]));
+	Mid_WiFi_TxRingPutByte((Len >> 8) & 0xFF);	// Len highbyte
+	Mid_WiFi_TxRingPutByte(Len & 0xFF);			// Len lowbyte
 	
-	for(i=0; i<Len; i++)
+	stu_WiFi_TxRingStat.CmdNumber++;
+	
+	if((stu_WiFi_TxRingStat.UsedBytes + Len) > stu_WiFi_TxRingStat.PeakBytes)
 	{
-		WiFi_TxBufferMatrix[WiFi_TxQueueIndex][i] = pData[i];
+		stu_WiFi_TxRingStat.PeakBytes = stu_WiFi_TxRingStat.UsedBytes + Len;
 	}
 	
-	QueueDataIn(Queue_WiFiTxSequence, &WiFi_TxQueueIndex, 1);
-	WiFi_TxQueueIndex++;		// point to the next TxQueue
+	return 0;
+}
+
+/**
+  * @Brief	Put one byte to the tail of WiFi_TxRing
+  * @Param	Data: byte data ready for queue-in
+  * @Retval	None
+  *	@Note	Free space must be reserved by Mid_WiFi_TxRingReserve in advance
+  */
+static void Mid_WiFi_TxRingPutByte(uint8_t Data)
+{
+	WiFi_TxRing[WiFi_TxRingTail++] = Data;
 	
-	if(WiFi_TxQueueIndex >= WIFI_TX_QUEUE_SUM)
+	if(WiFi_TxRingTail >= WIFI_TX_RING_SIZE)
 	{
-		WiFi_TxQueueIndex = 0;	// roll-over to the position 0
+		WiFi_TxRingTail = 0;	// roll-over to the position 0
 	}
+	
+	stu_WiFi_TxRingStat.UsedBytes++;
 }
 
 /**
-  * @Brief	Send out the content of data(get rid of 2byte Length) through WiFi_USART to the ESP8266 module 
-  * @Param	pData: point to the datafrmae ready to send
+  * @Brief	Drop all the queued AT-commands in WiFi_TxRing
+  * @Param	None
   * @Retval	None
   */
-static void Mid_WiFi_TxDataSend(uint8_t *pData)
+static void Mid_WiFi_TxRingEmpty(void)
+{
+	WiFi_TxRingHead = 0;
+	WiFi_TxRingTail = 0;
+	
+	stu_WiFi_TxRingStat.UsedBytes = 0;
+	stu_WiFi_TxRingStat.CmdNumber = 0;
+	
+	Mid_WiFi_TxWaitAbort();
+	
+	WiFi_TxPubStaleNumber = 0;
+}
+
+/**
+  * @Brief	Queue-out the oldest TxEntry of WiFi_TxRing and send out the content of data(get rid of 2byte Length) 
+  *			through WiFi_USART to the ESP8266 module 
+  * @Param	None
+  * @Retval	None
+  *	@Note	An entry wrapped around the end of WiFi_TxRing is sent in 2 segments
+  */
+static void Mid_WiFi_TxDataSend(void)
 {
-	uint16_t i;
 	uint16_t Len;
-	uint8_t TxDataBuff[WIFI_TX_BUFFER_SIZE];
+	uint16_t SegmentLen;
+	uint8_t  PubFlag;
+	uint8_t  i;
+	
+	Len = WiFi_TxRing[WiFi_TxRingHead] << 8;
+	WiFi_TxRingHead = (WiFi_TxRingHead + 1) % WIFI_TX_RING_SIZE;
+	Len |= WiFi_TxRing[WiFi_TxRingHead];
+	WiFi_TxRingHead = (WiFi_TxRingHead + 1) % WIFI_TX_RING_SIZE;
 	
-	Len = ((pData[0] << 8) | (pData[1]));
+	stu_WiFi_TxRingStat.UsedBytes -= (Len + 2);
+	stu_WiFi_TxRingStat.CmdNumber--;
 	
-	Len -= 2;	// trim the first 2byte(length indicator)
+	/* AT+MQTTPUB: result reported to the upper layer when answered */
+	PubFlag = 1;
 	
-	for(i=0; i<Len; i++)
+	for(i=0; ESP8266_AT[ESP8266_AT_MQTTPUB][i] != '='; i++)
+	{
+		if((i >= Len) || (WiFi_TxRing[(WiFi_TxRingHead + i) % WIFI_TX_RING_SIZE] != ESP8266_AT[ESP8266_AT_MQTTPUB][i]))
+		{
+			PubFlag = 0;
+			break;
+		}
+	}
+	
+	if(PubFlag)
+	{
+		if(WiFi_TxPubStaleNumber)
+		{
+			WiFi_TxPubStaleNumber--;
+			PubFlag = 0;
+		}
+		else if(WiFi_TxPubNumber)
+		{
+			WiFi_TxPubNumber--;
+		}
+	}
+	
+	Mid_WiFi_TxWaitIn(PubFlag);
+	
+	SegmentLen = WIFI_TX_RING_SIZE - WiFi_TxRingHead;
+	
+	if(SegmentLen > Len)
+	{
+		SegmentLen = Len;
+	}
+	
+	#ifdef DEBUG_WIFI_TX
+	Hal_USART_DebugDataQueueIn(&WiFi_TxRing[WiFi_TxRingHead], SegmentLen);
+	#endif
+	
+	#ifndef WIFI_SIMULATOR_MODE
+	Hal_USART_WiFiDataTx(&WiFi_TxRing[WiFi_TxRingHead], SegmentLen);
+	#else
+	Mid_WiFiSim_DataIn(&WiFi_TxRing[WiFi_TxRingHead], SegmentLen);
+	#endif
+	
+	if(Len > SegmentLen)
 	{
-		TxDataBuff[i] = pData[i+2];
-		
 		#ifdef DEBUG_WIFI_TX
-		QueueDataIn(Queue_DebugTx, &TxDataBuff[i], 1);	
+		Hal_USART_DebugDataQueueIn(&WiFi_TxRing[0], Len - SegmentLen);
+		#endif
+		
+		#ifndef WIFI_SIMULATOR_MODE
+		Hal_USART_WiFiDataTx(&WiFi_TxRing[0], Len - SegmentLen);
+		#else
+		Mid_WiFiSim_DataIn(&WiFi_TxRing[0], Len - SegmentLen);
 		#endif
 	}
 	
-	Hal_USART_WiFiDataTx(&TxDataBuff[0], Len);
+	WiFi_TxRingHead = (WiFi_TxRingHead + Len) % WIFI_TX_RING_SIZE;
+}
+
+/**
+  * @Brief	Record an AT-command sent out, waiting for "OK"/"ERROR"
+  * @Param	PubFlag: 1->AT+MQTTPUB, 0->other AT-command
+  * @Retval	None
+  *	@Note	Up to 32 AT-commands are tracked, the oldest one is taken as failed to make room
+  */
+static void Mid_WiFi_TxWaitIn(uint8_t PubFlag)
+{
+	if(WiFi_TxWaitNumber >= 32)
+	{
+		Mid_WiFi_TxWaitOut(WIFI_MQTT_PUB_FAIL);
+	}
+	
+	if(WiFi_TxWaitNumber == 0)
+	{
+		WiFi_TxWaitCounter = 0;
+	}
+	
+	if(PubFlag)
+	{
+		WiFi_TxWaitPubMask |= (1UL << WiFi_TxWaitNumber);
+	}
+	
+	WiFi_TxWaitNumber++;
+}
+
+/**
+  * @Brief	Match "OK"/"ERROR" with the oldest AT-command waiting, report the result if it is AT+MQTTPUB
+  * @Param	Result: WIFI_MQTT_PUB_OK / WIFI_MQTT_PUB_FAIL
+  * @Retval	None
+  */
+static void Mid_WiFi_TxWaitOut(uint8_t Result)
+{
+	uint8_t PubFlag;
+	
+	if(WiFi_TxWaitNumber == 0)
+	{
+		return;
+	}
+	
+	PubFlag = WiFi_TxWaitPubMask & 0x01;
+	
+	WiFi_TxWaitPubMask >>= 1;
+	WiFi_TxWaitNumber--;
+	WiFi_TxWaitCounter = 0;
+	
+	if(PubFlag && WiFi_MQTTPubCBF)
+	{
+		WiFi_MQTTPubCBF(Result);
+	}
+}
+
+/**
+  * @Brief	Forget all the AT-commands waiting/queued-in, report WIFI_MQTT_PUB_LOST if any publish is among them
+  * @Param	None
+  * @Retval	None
+  *	@Note	Publishes still in WiFi_TxRing are marked stale, their results are not reported any more
+  */
+static void Mid_WiFi_TxWaitAbort(void)
+{
+	if((WiFi_TxWaitPubMask || WiFi_TxPubNumber) && WiFi_MQTTPubCBF)
+	{
+		WiFi_MQTTPubCBF(WIFI_MQTT_PUB_LOST);
+	}
+	
+	WiFi_TxWaitPubMask = 0;
+	WiFi_TxWaitNumber = 0;
+	
+	WiFi_TxPubStaleNumber += WiFi_TxPubNumber;
+	WiFi_TxPubNumber = 0;
+}
+
+/**
+  * @Brief	Drop the answers in Queue_WiFiRx not handled yet
+  * @Param	None
+  * @Retval	None
+  *	@Note	The dropped "OK"/"ERROR" would never be matched: the AT-commands waiting are forgotten too(Mid_WiFi_TxWaitAbort),
+  *			the answers of the commands sent after are matched in order again
+  */
+static void Mid_WiFi_RxFlush(void)
+{
+	QueueEmpty(Queue_WiFiRx);
+	
+	Mid_WiFi_TxWaitAbort();
 }
 
 /**
@@ -770,13 +1314,23 @@ static void Mid_WiFi_TxDataHandler(void)
 {
 	static uint32_t AT_IntervalCounter = 0;
 	static uint32_t FirmwareCounter = 0;
+	static uint32_t RSSICounter = 0;
+	static uint32_t TelemetryCounter = 0;
 	static uint32_t WorkCounter = 0;
-	static uint16_t ATResendCounter = 0;
 	
-	uint8_t Index;
 	uint8_t Para;
 	
-	if(QueueDataLen(Queue_WiFiTxSequence))
+	if(WiFi_TxWaitNumber)
+	{
+		WiFi_TxWaitCounter++;
+		
+		if(WiFi_TxWaitCounter > WIFI_TX_WAIT_TIME_MAX)	// no answer, take it as failed
+		{
+			Mid_WiFi_TxWaitOut(WIFI_MQTT_PUB_FAIL);
+		}
+	}
+	
+	if(stu_WiFi_TxRingStat.CmdNumber)
 	{
 		AT_IntervalCounter++;
 		
@@ -784,9 +1338,7 @@ static void Mid_WiFi_TxDataHandler(void)
 		{
 			AT_IntervalCounter = 0;
 			
-			QueueDataOut(Queue_WiFiTxSequence, &Index);				// get the index of ready-to-send queue
-			
-			Mid_WiFi_TxDataSend(&WiFi_TxBufferMatrix[Index][0]);	// send out the corresponding AT command through WiFi_USART to ESP8266
+			Mid_WiFi_TxDataSend();	// send out the oldest AT command through WiFi_USART to ESP8266
 		}
 	}
 	
@@ -861,14 +1413,10 @@ static void Mid_WiFi_TxDataHandler(void)
 		{
 			WorkCounter++;
 			
-			if(WorkCounter > 200)
+			if(WorkCounter > WiFi_ReconnectBackoff[WIFI_RECONNECT_LAYER_AP])	// poll AP-link with backoff
 			{
-				ATResendCounter++;
-				
-				if(ATResendCounter > 10)	// if no follew-up actions after sending 10 times "AT+CWSTATE?", reset WiFi-Module
+				if(stu_WiFi_ReconnectStat[WIFI_RECONNECT_LAYER_AP].AttemptNumber >= WIFI_RECONNECT_AP_ATTEMPT_MAX)	// if no follew-up actions after sending "AT+CWSTATE?", reset WiFi-Module
 				{
-					ATResendCounter = 0;
-					
 					Mid_WiFi_PowerManage(ESP8266_POWER_STATE_RESET);
 					
 					return;
@@ -877,6 +1425,8 @@ static void Mid_WiFi_TxDataHandler(void)
 				Para = 0xFF;
 				WorkCounter = 0;
 				
+				WiFi_ReconnectBackoff[WIFI_RECONNECT_LAYER_AP] = Mid_WiFi_ReconnectAttempt(WIFI_RECONNECT_LAYER_AP);
+				
 				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWSTATE, &Para);
 			}
 		}
@@ -886,7 +1436,7 @@ static void Mid_WiFi_TxDataHandler(void)
 		{
 			Para = 0xFF;
 			
-			QueueEmpty(Queue_WiFiTxSequence);
+			Mid_WiFi_TxRingEmpty();
 			
 			Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWSTOPSMART, &Para);	// stop SmartConfig to release ESP8266 RAM resource
 			Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWSTARTSMART, &Para);	// start SmartConfig
@@ -894,7 +1444,7 @@ static void Mid_WiFi_TxDataHandler(void)
 			Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_NETPAIR_IN_PROCESS);
 			
 			WorkCounter = 0;
-			ATResendCounter = 0;
+			Mid_WiFi_ReconnectRestart(WIFI_RECONNECT_LAYER_AP);
 		}
 		break;
 			
@@ -907,7 +1457,6 @@ static void Mid_WiFi_TxDataHandler(void)
 			if(WorkCounter > 30000)	// Netpairing 5mins no IP obtained, timeout
 			{
 				WorkCounter = 0;
-				ATResendCounter = 0;
 				
 				Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_GET_IP_TIMEOUT);
 			}
@@ -925,7 +1474,7 @@ static void Mid_WiFi_TxDataHandler(void)
 				WorkCounter = 0;
 				Para = 0xFF;
 				
-				QueueEmpty(Queue_WiFiTxSequence);
+				Mid_WiFi_TxRingEmpty();
 				
 				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWSTOPSMART, &Para);		// stop SmartConfig to release ESP8266 RAM resource
 				Mid_WiFi_ChangeModuleWorkState(ESP8266_STA_MODULE_DETECT);
@@ -941,11 +1490,32 @@ static void Mid_WiFi_TxDataHandler(void)
 			
 			if(FirmwareCounter == 6000)		// Check New Firmware every 30s
 			{
-				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_UPDATE_CHECK, 0);
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_UPDATE_CHECK, 0, MQTT_EVENT_CLASS_REQUEST);
 			
 				FirmwareCounter = 0;
 			}
 			
+			/* sample RSSI only in an idle slot between other AT transactions */
+			if(RSSICounter < WIFI_RSSI_SAMPLE_PERIOD)
+			{
+				RSSICounter++;
+			}
+			else if((stu_WiFi_TxRingStat.CmdNumber == 0) && (Mid_WiFi_GetMQTTState() == MQTT_STA_READY))
+			{
+				RSSICounter = 0;
+				
+				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWJAPQUERY, &Para);
+			}
+			
+			TelemetryCounter++;
+			
+			if(TelemetryCounter >= WIFI_LINK_TELEMETRY_PERIOD)	// report link quality every 5mins
+			{
+				TelemetryCounter = 0;
+				
+				MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_LINK_TELEMETRY, 0, MQTT_EVENT_CLASS_REQUEST);
+			}
+			
 			if(WorkCounter == 6000)	// Check the WiFi-connection every 60s
 			{
 				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_CWSTATE, &Para);
@@ -1044,7 +1614,6 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 	uint8_t i;
 	uint8_t MQTTDataBuff[WIFI_MQTT_TX_DATA_SIZE];
 	static uint32_t WorkCounter = 0;
-	static uint8_t ResendCounter = 0;
 	
 	memset(&MQTTDataBuff[0], 0, WIFI_MQTT_TX_DATA_SIZE);
 	
@@ -1063,6 +1632,8 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 				
 				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTCLEAN, &MQTTDataBuff[0]);
 				
+				WiFi_MQTTConfigFlag = 0;
+				
 				Mid_WiFi_ChangeMQTTState(MQTT_STA_CONFIG);
 				
 				return 0;
@@ -1142,7 +1713,7 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 				
 				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTUSERCFG, &MQTTDataBuff[0]);
 				
-				ResendCounter = 0;
+				WiFi_MQTTConnectRetry = 0;
 				
 				return 0;
 			}
@@ -1154,20 +1725,29 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 		{
 			WorkCounter++;
 			
-			if(WorkCounter > 200)
+			if(WorkCounter > WiFi_ReconnectBackoff[WIFI_RECONNECT_LAYER_MQTT])	// connect with backoff
 			{
 				WorkCounter = 0;
-				ResendCounter++;
 				
-				if(ResendCounter > 2)
+				if(WiFi_MQTTConnectRetry >= WIFI_RECONNECT_MQTT_ATTEMPT_MAX)
 				{
-					ResendCounter = 0;
+					WiFi_MQTTConnectRetry = 0;
 					
-					Mid_WiFi_PowerManage(ESP8266_POWER_STATE_RESET);
+					if(WiFi_MQTTConfigFlag)	// cached MQTT config failed, fall back to CLEAN/USERCFG with a new ClientID
+					{
+						Mid_WiFi_ChangeMQTTState(MQTT_STA_IDLE);
+					}
+					else
+					{
+						Mid_WiFi_PowerManage(ESP8266_POWER_STATE_RESET);
+					}
 					
 					return 0;
 				}
 				
+				WiFi_MQTTConnectRetry++;
+				WiFi_ReconnectBackoff[WIFI_RECONNECT_LAYER_MQTT] = Mid_WiFi_ReconnectAttempt(WIFI_RECONNECT_LAYER_MQTT);
+				
 				Index = 0;
 				i = 0;
 				
@@ -1198,6 +1778,8 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 				MQTTDataBuff[Index++] = '0';
 				MQTTDataBuff[Index++] = '\0';
 				
+				WiFi_MQTTBrokerFlag = 0;
+				
 				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTCONN, &MQTTDataBuff[0]);
 
 				return 0;
@@ -1214,29 +1796,10 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 			{
 				WorkCounter = 0;
 				
-				Index = 0;
-				i = 0;
-				
-				/* set SubTopic: */
-				while(stu_MQTT_ESP8266.SubTopic[i])
-				{
-					MQTTDataBuff[Index++] = stu_MQTT_ESP8266.SubTopic[i++];
-				
-					if(i == MQTT_TOPIC_SIZE)
-					{
-						break;
-					}
-				}
-				MQTTDataBuff[Index++] = '\"';
-				MQTTDataBuff[Index++] = ',';
-				MQTTDataBuff[Index++] = '0';
-				MQTTDataBuff[Index++] = '\0';
-				
-				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTSUB, &MQTTDataBuff[0]);
-				
-				return 0;
+				return Mid_WiFi_MQTT_Subscribe(&stu_MQTT_ESP8266.SubTopic[0], ESP8266_AT_MQTTSUB, Mid_WiFi_Topic_MessageDown);
 			}
 		}
+		break;
 
 		case MQTT_STA_SUB_DATETIME:
 		{
@@ -1246,58 +1809,47 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 			{
 				WorkCounter = 0;
 
-				Index = 0;
-				i = 0;
-				
-				/* set SubTopic_DateTime: */
-				while(stu_MQTT_ESP8266.SubTopic_DataTime[i])
-				{
-					MQTTDataBuff[Index++] = stu_MQTT_ESP8266.SubTopic_DataTime[i++];
-					
-					if(i == MQTT_TOPIC_SIZE)
-					{
-						break;
-					}
-				}
-				MQTTDataBuff[Index++] = '\"';
-				MQTTDataBuff[Index++] = ',';
-				MQTTDataBuff[Index++] = '0';
-				MQTTDataBuff[Index++] = '\0';
-				
-				Mid_WiFi_ATcmdQueueIn(ESP8266_AT_MQTTSUBDATETIME, &MQTTDataBuff[0]);
-
-				return 0;
+				return Mid_WiFi_MQTT_Subscribe(&stu_MQTT_ESP8266.SubTopic_DataTime[0], ESP8266_AT_MQTTSUBDATETIME, Mid_WiFi_Topic_DateTime);
 			}
 
 		}
 		break;
 		
-		case MQTT_STA_PUB:
+		/* OTA dataframes(0x22 / 0x25) published by the server on their own topic */
+		case MQTT_STA_SUB_FIRMWARE_UPDATE:
 		{
 			WorkCounter++;
 			
-			if(WorkCounter > 500)
+			if(WorkCounter > 200)
 			{
 				WorkCounter = 0;
 				
-				return 0;
+				return Mid_WiFi_MQTT_Subscribe(&stu_MQTT_ESP8266.SubTopic_FirmwareUpdate[0], ESP8266_AT_MQTTSUB, Mid_WiFi_Topic_MessageDown);
 			}
 		}
 		break;
 		
-		case MQTT_STA_READY:
+		case MQTT_STA_PUB:
 		{
 			WorkCounter++;
 			
-			if(WorkCounter > 200)
+			if(WorkCounter > 500)
 			{
 				WorkCounter = 0;
 				
-
-				MQTTProtocol_EventUpload_Pro(PROTOCOL_COMM_TYPE_WIFI);
+				return 0;
 			}
 		}
 		break;
+		
+		case MQTT_STA_READY:
+		{
+			WorkCounter = 0;
+			
+			/* EventUpload batches and paces the publishes itself */
+			MQTTProtocol_EventUpload_Pro(PROTOCOL_COMM_TYPE_WIFI);
+		}
+		break;
 
 		case MQTT_STA_RECV_SYSTIME:
 		{
@@ -1332,18 +1884,289 @@ static uint8_t Mid_WiFi_MQTT_Pro(void)
 	return 0xFF;
 }
 
+/**
+  * @Brief	MQTT broker link dropped, reconnect only the MQTT layer
+  * @Param	None
+  * @Retval	None
+  *	@Note	If the module still keeps the MQTT user config, skip CLEAN/USERCFG and connect directly,
+  *			the subscriptions are always renewed after connecting
+  */
+static void Mid_WiFi_MQTT_Reconnect(void)
+{
+	Mid_WiFi_ReconnectDrop(WIFI_RECONNECT_LAYER_MQTT);
+	
+	Mid_WiFi_TxWaitAbort();		// publishes in process will never be answered
+	
+	if(WiFi_MQTTConfigFlag)
+	{
+		WiFi_MQTTConnectRetry = 0;
+		
+		Mid_WiFi_ChangeMQTTState(MQTT_STA_CONNECT);
+	}
+	else
+	{
+		Mid_WiFi_ChangeMQTTState(MQTT_STA_IDLE);
+	}
+}
+
+/**
+  * @Brief	Record the link drop of specified layer
+  * @Param	Layer: reconnect layer(AP / MQTT)
+  * @Retval	None
+  */
+static void Mid_WiFi_ReconnectDrop(en_WiFi_ReconnectLayer_t Layer)
+{
+	if(!stu_WiFi_ReconnectStat[Layer].LinkDown)
+	{
+		stu_WiFi_ReconnectStat[Layer].LinkDown = 1;
+		stu_WiFi_ReconnectStat[Layer].DropNumber++;
+		stu_WiFi_ReconnectStat[Layer].DropTick = OS_GetTickCount();
+		
+		Mid_WiFi_ReconnectRestart(Layer);
+	}
+}
+
+/**
+  * @Brief	Record a reconnect attempt of specified layer and calculate the delay before the next attempt
+  * @Param	Layer: reconnect layer(AP / MQTT)
+  * @Retval	Delay before the next attempt(unit: 10ms)
+  *	@Note	Delay = min(BACKOFF_BASE * 2^Attempt, BACKOFF_MAX) + random jitter(0~50%)
+  */
+static uint16_t Mid_WiFi_ReconnectAttempt(en_WiFi_ReconnectLayer_t Layer)
+{
+	uint32_t Delay;
+	uint16_t Attempt;
+	
+	Attempt = stu_WiFi_ReconnectStat[Layer].AttemptNumber++;
+	stu_WiFi_ReconnectStat[Layer].AttemptTotal++;
+	
+	if(Attempt > 5)
+	{
+		Attempt = 5;
+	}
+	
+	Delay = (uint32_t)WIFI_RECONNECT_BACKOFF_BASE << Attempt;
+	
+	if(Delay > WIFI_RECONNECT_BACKOFF_MAX)
+	{
+		Delay = WIFI_RECONNECT_BACKOFF_MAX;
+	}
+	
+	/* jitter, so that the devices behind the same AP/broker do not retry in lockstep */
+	WiFi_ReconnectRandom = WiFi_ReconnectRandom * 1103515245 + 12345 + OS_GetTickCount();
+	
+	Delay += (WiFi_ReconnectRandom >> 16) % (Delay / 2 + 1);
+	
+	return (uint16_t)Delay;
+}
+
+/**
+  * @Brief	Link of specified layer is up, record the reconnect time and restart the backoff
+  * @Param	Layer: reconnect layer(AP / MQTT)
+  * @Retval	None
+  */
+static void Mid_WiFi_ReconnectDone(en_WiFi_ReconnectLayer_t Layer)
+{
+	if(stu_WiFi_ReconnectStat[Layer].LinkDown)
+	{
+		stu_WiFi_ReconnectStat[Layer].LinkDown = 0;
+		stu_WiFi_ReconnectStat[Layer].LastTime = OS_GetTickCount() - stu_WiFi_ReconnectStat[Layer].DropTick;
+		
+		if(stu_WiFi_ReconnectStat[Layer].LastTime > stu_WiFi_ReconnectStat[Layer].MaxTime)
+		{
+			stu_WiFi_ReconnectStat[Layer].MaxTime = stu_WiFi_ReconnectStat[Layer].LastTime;
+		}
+	}
+	
+	Mid_WiFi_ReconnectRestart(Layer);
+}
+
+/**
+  * @Brief	Restart the backoff of specified layer from the first attempt
+  * @Param	Layer: reconnect layer(AP / MQTT)
+  * @Retval	None
+  */
+static void Mid_WiFi_ReconnectRestart(en_WiFi_ReconnectLayer_t Layer)
+{
+	stu_WiFi_ReconnectStat[Layer].AttemptNumber = 0;
+	
+	WiFi_ReconnectBackoff[Layer] = WIFI_RECONNECT_BACKOFF_BASE;
+}
+
+/**
+  * @Brief	Parse a quoted string field of AT response
+  * @Param	pData	: point to the opening quote(leading ',' skipped)
+  *			pString	: store the string(0->skip the field), terminated by 0
+  *			Size	: size of pString
+  * @Retval	Point to the byte after the closing quote
+  *	@Note	The closing quote is the one followed by ',' / ')' / "\r", a quote inside SSID is kept
+  */
+static uint8_t *Mid_WiFi_ParseQuoted(uint8_t *pData, uint8_t *pString, uint8_t Size)
+{
+	uint8_t i = 0;
+	
+	while((*pData == ',') || (*pData == '('))
+	{
+		pData++;
+	}
+	
+	if(*pData != '"')
+	{
+		return pData;
+	}
+	
+	pData++;
+	
+	while(*pData != 0)
+	{
+		if((*pData == '"') && ((pData[1] == ',') || (pData[1] == ')') || (pData[1] == 0x0D)))
+		{
+			pData++;
+			break;
+		}
+		
+		if((pString != 0) && (i < (Size - 1)))
+		{
+			pString[i++] = *pData;
+		}
+		
+		pData++;
+	}
+	
+	if(pString != 0)
+	{
+		pString[i] = 0;
+	}
+	
+	return pData;
+}
+
+/**
+  * @Brief	Parse a decimal number field of AT response
+  * @Param	pData	: point to the field(leading ',' / '(' skipped)
+  *			pValue	: store the value
+  * @Retval	Point to the byte after the number
+  */
+static uint8_t *Mid_WiFi_ParseNumber(uint8_t *pData, int16_t *pValue)
+{
+	uint8_t Negative = 0;
+	
+	*pValue = 0;
+	
+	while((*pData == ',') || (*pData == '('))
+	{
+		pData++;
+	}
+	
+	if(*pData == '-')
+	{
+		Negative = 1;
+		pData++;
+	}
+	
+	while((*pData >= '0') && (*pData <= '9'))
+	{
+		*pValue = *pValue * 10 + (*pData - '0');
+		pData++;
+	}
+	
+	if(Negative)
+	{
+		*pValue = -*pValue;
+	}
+	
+	return pData;
+}
+
+/**
+  * @Brief	Store a RSSI sample to the ring of RSSI samples
+  * @Param	RSSI	: dBm
+  *			Channel	: channel of the connected AP
+  * @Retval	None
+  */
+static void Mid_WiFi_RSSISampleIn(int8_t RSSI, uint8_t Channel)
+{
+	WiFi_RSSISample[WiFi_RSSISampleIndex].Tick = OS_GetTickCount();
+	WiFi_RSSISample[WiFi_RSSISampleIndex].RSSI = RSSI;
+	
+	WiFi_RSSISampleIndex = (WiFi_RSSISampleIndex + 1) % WIFI_RSSI_SAMPLE_SUM;
+	
+	if(WiFi_RSSISampleNumber < WIFI_RSSI_SAMPLE_SUM)
+	{
+		WiFi_RSSISampleNumber++;
+	}
+	
+	WiFi_APChannel = Channel;
+}
+
+/**
+  * @Brief	Store one line of AP scan result to the scan cache
+  * @Param	pData: point to the AT response: +CWLAP:(<ecn>,<"ssid">,<rssi>,<"mac">,<channel>,...)
+  * @Retval	None
+  *	@Note	The first line after Mid_WiFi_ScanRequest replaces the whole cache
+  */
+static void Mid_WiFi_ScanAPIn(uint8_t *pData)
+{
+	stu_WiFi_APInfo_t *pAP;
+	int16_t Value;
+	
+	if(WiFi_ScanRefresh)
+	{
+		WiFi_ScanRefresh = 0;
+		WiFi_ScanAPNumber = 0;
+		WiFi_ScanTick = OS_GetTickCount();
+	}
+	
+	if(WiFi_ScanAPNumber >= WIFI_SCAN_AP_SUM)
+	{
+		return;
+	}
+	
+	while((*pData != ':') && (*pData != 0))
+	{
+		pData++;
+	}
+	
+	if(*pData == 0)
+	{
+		return;
+	}
+	
+	pAP = &WiFi_ScanAP[WiFi_ScanAPNumber];
+	
+	pData = Mid_WiFi_ParseNumber(pData + 1, &Value);
+	pAP->Ecn = (uint8_t)Value;
+	
+	pData = Mid_WiFi_ParseQuoted(pData, &pAP->SSID[0], WIFI_SSID_LENGTH_MAX);
+	
+	pData = Mid_WiFi_ParseNumber(pData, &Value);
+	pAP->RSSI = (int8_t)Value;
+	
+	pData = Mid_WiFi_ParseQuoted(pData, 0, 0);		// mac
+	
+	pData = Mid_WiFi_ParseNumber(pData, &Value);
+	pAP->Channel = (uint8_t)Value;
+	
+	WiFi_ScanAPNumber++;
+}
+
 /**
   * @Brief	Extract the ReceiveData from received MQTT Data 
-  * @Param	pData		: point to MQTTRxData string
-  *			pReceiveData: point to the extracted ReceiveData part 
-  * @Retval	Length of ReceiveData
+  * @Param	pData			: point to MQTTRxData string
+  *			Len				: length of MQTTRxData string
+  *			ppReceiveData	: point to the pointer of the ReceiveData part in MQTTRxData(not copied)
+  *			ppTopic			: point to the pointer of the Topic in MQTTRxData(not terminated)
+  *			pTopicLen		: point to the length of the Topic
+  * @Retval	Length of ReceiveData(cut to the MQTTRxData received)
   *	@Note	+MQTTSUBRECV:0,"rytwj01wwncy26A2",16,AA00072900123467
   */
-static uint8_t Mid_WiFi_MQTTRxDataHandler(uint8_t *pData, uint8_t *pReceiveData)
+static uint16_t Mid_WiFi_MQTTRxDataHandler(uint8_t *pData, uint16_t Len, uint8_t **ppReceiveData, uint8_t **ppTopic, uint8_t *pTopicLen)
 {
-	uint8_t i;
-	uint8_t Len;
-	uint8_t LenBuff = 0;
+	uint8_t  i;
+	uint8_t  *pEnd;
+	uint16_t DataLen;
+	
+	pEnd = pData + Len;
 	
 	while(*pData != '"')
 	{
@@ -1352,46 +2175,135 @@ static uint8_t Mid_WiFi_MQTTRxDataHandler(uint8_t *pData, uint8_t *pReceiveData)
 	
 	pData++;
 	
-	while(*pData != '"')
+	/* capture Topic */
+	*ppTopic = pData;
+	*pTopicLen = 0;
+	
+	while((*pData != '"') && (*pData != 0))
 	{
 		pData++;
+		
+		if(*pTopicLen < MQTT_TOPIC_SIZE)
+		{
+			(*pTopicLen)++;
+		}
 	}
 	
 	pData += 2;
 	
-	Len = 0;
+	DataLen = 0;
 	i = 0;
 	
 	/* capture ReceiveData_Length */
-	while(*pData != ',')
+	while((*pData != ',') && (pData < pEnd))
 	{
 		if((*pData >= '0') && (*pData <= '9'))
 		{
-			Len *= 10;
-			Len += *pData - '0';
+			DataLen *= 10;
+			DataLen += *pData - '0';
 		}
 		
 		pData++;
 		i++;
 		
-		if(i > 2)
+		if(i > 4)
 		{
 			break;
 		}
 	}
 	
 	pData++;
-	LenBuff = Len;
 	
-	while(Len--)
+	*ppReceiveData = pData;
+	
+	if(pData >= pEnd)
+	{
+		return 0;
+	}
+	
+	if(DataLen > (pEnd - pData))
+	{
+		DataLen = pEnd - pData;
+	}
+	
+	return DataLen;
+}
+
+/**
+  * @Brief	Route the topic to its handler and subscribe it
+  * @Param	pTopic	: point to the topic string(stu_MQTT_ESP8266)
+  *			ATcmd	: subscribe AT-command(the response is waited in the MQTT state of the topic)
+  *			pHandler: handler of the messages received on the topic
+  * @Retval	0->AT-command queued-in
+  *	@Note	"AT+MQTTSUB=0,\"", <"topic">, <qos>
+  */
+static uint8_t Mid_WiFi_MQTT_Subscribe(uint8_t *pTopic, en_ESP8266_AT_t ATcmd, MQTT_TopicHandler_t pHandler)
+{
+	uint8_t MQTTDataBuff[MQTT_TOPIC_SIZE + 4];
+	uint8_t Index;
+	
+	Mid_MQTT_TopicRegister(pTopic, pHandler);
+	
+	Index = 0;
+	
+	while((pTopic[Index] != 0) && (Index < MQTT_TOPIC_SIZE))
 	{
-		*pReceiveData = *pData;
+		MQTTDataBuff[Index] = pTopic[Index];
 		
-		pReceiveData++;
-		pData++;
+		Index++;
+	}
+	
+	MQTTDataBuff[Index++] = '\"';
+	MQTTDataBuff[Index++] = ',';
+	MQTTDataBuff[Index++] = '0';
+	MQTTDataBuff[Index++] = '\0';
+	
+	Mid_WiFi_ATcmdQueueIn(ATcmd, &MQTTDataBuff[0]);
+	
+	return 0;
+}
+
+/**
+  * @Brief	Handler of the MessageDown / FirmwareDown topic: server dataframes in hex string
+  * @Param	pData: point to the hex string
+  *			Len	 : length of the hex string
+  * @Retval	None
+  */
+static void Mid_WiFi_Topic_MessageDown(uint8_t *pData, uint16_t Len)
+{
+	static uint8_t HexDataBuff[WIFI_MQTT_RECV_DATA_SIZE / 2];
+	
+	if(Len > WIFI_MQTT_RECV_DATA_SIZE)
+	{
+		return;
+	}
+	
+	ASCII_Hex_Conversion(pData, Len, &HexDataBuff[0]);
+	
+	/* handled by the Downlink task, never block the Rx parser */
+	MQTTProtocol_DownlinkQueueIn(PROTOCOL_COMM_TYPE_WIFI, &HexDataBuff[0], Len / 2);
+}
+
+/**
+  * @Brief	Handler of the $SYS/brokers/.../datetime topic
+  * @Param	pData: point to the datetime string(1970-07-21T23:18:29.823975371-04:00)
+  *			Len	 : length of the datetime string
+  * @Retval	None
+  *	@Note	Also pushed by the broker while subscribing the other topics, the MQTT state is left as it is then
+  */
+static void Mid_WiFi_Topic_DateTime(uint8_t *pData, uint16_t Len)
+{
+	if(Len < 22)
+	{
+		return;
 	}
 	
-	return LenBuff;
+	Mid_MQTT_SystemTimeProcess(pData);
+	
+	if(Mid_WiFi_GetMQTTState() == MQTT_STA_READY)
+	{
+		Mid_WiFi_ChangeMQTTState(MQTT_STA_RECV_SYSTIME);
+	}
 }
 
 
@@ -0,0 +1,1046 @@
+/****************************************************
+  * @Name	Mid_WiFiSim.c
+  * @Brief	Scripted stand-in of the ESP8266 WiFi-module and the MQTT server(WIFI_SIMULATOR_MODE in mid_wifi.h)
+  * @Instruction:
+  * --> Simulated link:
+  *			Mid_WiFi_TxDataSend	--> Mid_WiFiSim_DataIn		: AT-commands, instead of WiFi_USART(USART3)
+  *	 (Poll) Mid_WiFiSim_Pro		--> Mid_WiFi_RxDataQueueIn	: answers once due, at the WiFi_USART rate(registered as the Rx CBF)
+  *
+  * --> AT dialect answered:
+  *			AT / ATE1 / AT+RST / AT+CWMODE / AT+CWAUTOCONN / AT+CWSTATE? / AT+CWSTARTSMART / AT+CWSTOPSMART /
+  *			AT+CWJAP? / AT+CWLAP / AT+MQTTUSERCFG / AT+MQTTCONN / AT+MQTTSUB / AT+MQTTPUB / AT+MQTTCLEAN
+  *			(AT+MQTTPUBRAW is not used by Mid_WiFi, it is answered "ERROR" as any unknown AT-command)
+  *
+  * --> Simulated server(dataframes published by the Terminal):
+  *			0x21 Check New Firmware	: answered by 0x22, WIFISIM_OTA_IMAGE_SIZE byte image of WIFISIM_OTA_PATTERN,
+  *									  PackageSize negotiated up to WIFISIM_OTA_PACKAGE_SIZE(legacy 0x21 without payload: 100 byte)
+  *			0x24 Request Package	: answered by 0x25, PackageSize byte per package,
+  *									  WIFISIM_OTA_LATENCY on the link, WIFISIM_OTA_LOSS % of the answers lost
+  *			(answers published on the FirmwareDown topic)
+  *			The CRC16 of the whole image is reported inverted, the download always ends in FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL
+  *			and the simulated image is never handed to the BootLoader.
+  *			Any other server dataframe can be delivered as +MQTTSUBRECV by Mid_WiFiSim_DownlinkIn.
+  *
+  * --> Script:
+  *			WiFiSim_Script[] injects "ERROR" / silence / AP drop / MQTT drop in a loop(held by Mid_WiFiSim_ScriptHold),
+  *			bring-up time, publish rate and OTA download time are measured in stu_WiFiSim_Stat_t
+  *			(host build: Tools/HostTest/WiFiSim_Bench.c runs Mid_WiFi on the simulated module, no target needed)
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include "stm32f10x.h"
+#include "mid_wifi.h"
+#include "mid_wifisim.h"
+#include "mqtt_protocol.h"
+#include "mid_mqtt.h"
+#include "os_system.h"
+#include "stringprocess.h"
+#include "crc16.h"
+#include "device.h"
+#include "string.h"
+
+#ifdef WIFI_SIMULATOR_MODE
+
+/*-------------Internal Functions Declaration------*/
+static void 	Mid_WiFiSim_LineHandler(void);
+static uint8_t 	Mid_WiFiSim_ATcmdMatch(void);
+static void 	Mid_WiFiSim_FaultIn(en_WiFiSim_Fault_t Fault);
+static void 	Mid_WiFiSim_ServerIn(uint8_t *pFrame, uint16_t Len);
+static void 	Mid_WiFiSim_OTAOut(stu_WiFiSim_Flight_t *pFlight);
+static void 	Mid_WiFiSim_FramePack(uint8_t Cmd, uint8_t *pPayload, uint16_t Len);
+static void 	Mid_WiFiSim_RecvIn(uint8_t *pTopic, uint8_t *pData, uint16_t Len);
+static void 	Mid_WiFiSim_PutRecv(uint8_t *pTopic);
+static void 	Mid_WiFiSim_Put(uint8_t *pString);
+static void 	Mid_WiFiSim_PutNumber(int16_t Value);
+static void 	Mid_WiFiSim_AnswerIn(uint16_t Delay);
+
+
+/*-------------Module Variables Declaration--------*/
+extern const unsigned char ESP8266_AT[ESP8266_AT_SUM][70];
+extern const unsigned char ESP8266_ATResponse[ESP8266_AT_RESPONSE_SUM][60];
+
+/* AT-command line being received */
+uint8_t  WiFiSim_Line[WIFISIM_LINE_SIZE];
+uint16_t WiFiSim_LineLen;
+
+/* answer line being packed, answer lines waiting: DueTick(2 byte), Length(2 byte), DataBytes per answer */
+uint8_t  WiFiSim_Answer[WIFISIM_ANSWER_SIZE];
+uint16_t WiFiSim_AnswerLen;
+uint8_t  WiFiSim_AnswerRing[WIFISIM_ANSWER_RING_SIZE];
+uint16_t WiFiSim_AnswerHead;
+uint16_t WiFiSim_AnswerUsed;
+uint16_t WiFiSim_AnswerOut;		// bytes of the answer line being sent still to send
+
+/* simulated module: AP joined, broker connected, AP join in progress since WiFiSim_JoinTick, topics subscribed */
+uint8_t  WiFiSim_APFlag;
+uint8_t  WiFiSim_MQTTFlag;
+uint8_t  WiFiSim_JoinFlag;
+uint32_t WiFiSim_JoinTick;
+uint8_t  WiFiSim_SubNumber;
+uint8_t  WiFiSim_RSSIStep;
+
+/* fault script */
+const stu_WiFiSim_Step_t WiFiSim_Script[] =
+{
+	{6000, 	WIFISIM_FAULT_ERROR},
+	{3000, 	WIFISIM_FAULT_MQTT_DROP},
+	{6000, 	WIFISIM_FAULT_SILENT},
+	{6000, 	WIFISIM_FAULT_AP_DROP},
+};
+
+uint8_t  			WiFiSim_ScriptIndex;
+uint32_t 			WiFiSim_ScriptTick;
+uint8_t  			WiFiSim_ScriptHoldFlag;		// kept over the module resets
+en_WiFiSim_Fault_t 	WiFiSim_PendingFault;		// "ERROR" / silence waiting for the next AT-command
+
+/* simulated server: CRC16 of the whole OTA image, package size and number negotiated by the update check */
+uint16_t WiFiSim_OTACRC16;
+uint16_t WiFiSim_OTAPackageSize;
+uint16_t WiFiSim_OTAPackageNumber;
+uint8_t  WiFiSim_OTANegotiated;
+
+/* simulated link of the firmware packages: answers on the link, packages served once, loss random seed */
+stu_WiFiSim_Flight_t WiFiSim_OTAFlight[WIFISIM_OTA_FLIGHT_SUM];
+uint8_t  WiFiSim_OTAServed[(WIFISIM_OTA_PACKAGE_NUMBER_MAX + 7) / 8];
+uint16_t WiFiSim_OTAServedNumber;
+uint32_t WiFiSim_OTARandom;
+
+/* received Data callback function pointer of Mid_WiFi */
+WiFiSim_RxCBF_t WiFiSim_RxCBF;
+
+stu_WiFiSim_Stat_t stu_WiFiSim_Stat;
+
+/*---Module Call-Back function pointer Definition---*/
+
+
+/*-------------Module Functions Definition---------*/
+/**
+  * @Brief	Initialize the simulated WiFi-module
+  * @Param	pCBF: point to the function receiving the answers(Mid_WiFi_RxDataQueueIn)
+  * @Retval	None
+  *	@Note	The simulated module keeps the AP config, the AP is joined WIFISIM_AP_JOIN_DELAY after power on
+  */
+void Mid_WiFiSim_Init(WiFiSim_RxCBF_t pCBF)
+{
+	uint8_t  DataBuff[WIFISIM_OTA_PACKAGE_SIZE_LEGACY];
+	uint32_t Offset;
+	uint16_t Len;
+	uint16_t i;
+	
+	WiFiSim_RxCBF = pCBF;
+	
+	WiFiSim_LineLen = 0;
+	WiFiSim_AnswerLen = 0;
+	WiFiSim_AnswerHead = 0;
+	WiFiSim_AnswerUsed = 0;
+	WiFiSim_AnswerOut = 0;
+	
+	WiFiSim_APFlag = 0;
+	WiFiSim_MQTTFlag = 0;
+	WiFiSim_JoinFlag = 1;
+	WiFiSim_JoinTick = OS_GetTickCount();
+	WiFiSim_SubNumber = 0;
+	WiFiSim_RSSIStep = 0;
+	
+	WiFiSim_ScriptIndex = 0;
+	WiFiSim_ScriptTick = OS_GetTickCount();
+	WiFiSim_PendingFault = WIFISIM_FAULT_NONE;
+	
+	memset(&stu_WiFiSim_Stat, 0, sizeof(stu_WiFiSim_Stat));
+	stu_WiFiSim_Stat.ResetTick = OS_GetTickCount();
+	
+	for(i=0; i<WIFISIM_OTA_FLIGHT_SUM; i++)
+	{
+		WiFiSim_OTAFlight[i].PackageIndex = 0xFFFF;
+	}
+	
+	memset(&WiFiSim_OTAServed[0], 0, sizeof(WiFiSim_OTAServed));
+	WiFiSim_OTAServedNumber = 0;
+	WiFiSim_OTARandom = 1;
+	
+	WiFiSim_OTAPackageSize = WIFISIM_OTA_PACKAGE_SIZE_LEGACY;
+	WiFiSim_OTAPackageNumber = WIFISIM_OTA_PACKAGE_NUMBER_MAX;
+	WiFiSim_OTANegotiated = 0;
+	
+	/* CRC16 of the whole image, combined the same way as Mid_Firmware_Download_Pro */
+	WiFiSim_OTACRC16 = 0xFFFF;
+	
+	for(Offset=0; Offset<WIFISIM_OTA_IMAGE_SIZE; Offset+=Len)
+	{
+		Len = ((WIFISIM_OTA_IMAGE_SIZE - Offset) > sizeof(DataBuff)) ? sizeof(DataBuff) : (WIFISIM_OTA_IMAGE_SIZE - Offset);
+	
+		for(i=0; i<Len; i++)
+		{
+			DataBuff[i] = WIFISIM_OTA_PATTERN(Offset + i);
+		}
+	
+		WiFiSim_OTACRC16 = Mid_CRC16_Modbus_Continuous(&DataBuff[0], Len, WiFiSim_OTACRC16);
+	}
+}
+
+/**
+  * @Brief	Polling function of the simulated WiFi-module
+  * @Param	None
+  * @Retval	None
+  *	@Note	WIFISIM_UART_BYTE_PER_TICK answer bytes per polling, Mid_WiFi_RxDataHandler handles one line per polling
+  */
+void Mid_WiFiSim_Pro(void)
+{
+	uint16_t DueTick;
+	uint16_t Len;
+	uint16_t i;
+	
+	/* AP joined */
+	if(WiFiSim_JoinFlag && ((OS_GetTickCount() - WiFiSim_JoinTick) >= WIFISIM_AP_JOIN_DELAY))
+	{
+		WiFiSim_JoinFlag = 0;
+		WiFiSim_APFlag = 1;
+	
+		Mid_WiFiSim_Put((uint8_t *)"WIFI CONNECTED\r\n");
+		Mid_WiFiSim_AnswerIn(0);
+	}
+	
+	/* fault script */
+	if(WiFiSim_ScriptHoldFlag)
+	{
+		WiFiSim_ScriptTick = OS_GetTickCount();
+	}
+	else if((OS_GetTickCount() - WiFiSim_ScriptTick) >= WiFiSim_Script[WiFiSim_ScriptIndex].Delay)
+	{
+		WiFiSim_ScriptTick = OS_GetTickCount();
+	
+		Mid_WiFiSim_FaultIn(WiFiSim_Script[WiFiSim_ScriptIndex].Fault);
+	
+		WiFiSim_ScriptIndex = (WiFiSim_ScriptIndex + 1) % (sizeof(WiFiSim_Script) / sizeof(WiFiSim_Script[0]));
+	}
+	
+	/* firmware package answer leaving the link, one per polling, held while the answer ring cannot take a full answer line */
+	for(i=0; (i<WIFISIM_OTA_FLIGHT_SUM) && ((WiFiSim_AnswerUsed + WIFISIM_ANSWER_SIZE + 4) <= WIFISIM_ANSWER_RING_SIZE); i++)
+	{
+		if((WiFiSim_OTAFlight[i].PackageIndex != 0xFFFF) && ((int32_t)(OS_GetTickCount() - WiFiSim_OTAFlight[i].DueTick) >= 0))
+		{
+			Mid_WiFiSim_OTAOut(&WiFiSim_OTAFlight[i]);
+	
+			WiFiSim_OTAFlight[i].PackageIndex = 0xFFFF;
+	
+			break;
+		}
+	}
+	
+	/* oldest answer line once due */
+	if((WiFiSim_AnswerOut == 0) && WiFiSim_AnswerUsed)
+	{
+		DueTick = WiFiSim_AnswerRing[WiFiSim_AnswerHead] << 8;
+		DueTick |= WiFiSim_AnswerRing[(WiFiSim_AnswerHead + 1) % WIFISIM_ANSWER_RING_SIZE];
+	
+		if((int16_t)((OS_GetTickCount() & 0xFFFF) - DueTick) >= 0)
+		{
+			Len = WiFiSim_AnswerRing[(WiFiSim_AnswerHead + 2) % WIFISIM_ANSWER_RING_SIZE] << 8;
+			Len |= WiFiSim_AnswerRing[(WiFiSim_AnswerHead + 3) % WIFISIM_ANSWER_RING_SIZE];
+	
+			WiFiSim_AnswerHead = (WiFiSim_AnswerHead + 4) % WIFISIM_ANSWER_RING_SIZE;
+			WiFiSim_AnswerUsed -= 4;
+			WiFiSim_AnswerOut = Len;
+		}
+	}
+	
+	/* answer line sent at the WiFi_USART rate */
+	for(i=0; (i<WIFISIM_UART_BYTE_PER_TICK) && WiFiSim_AnswerOut; i++)
+	{
+		WiFiSim_RxCBF(WiFiSim_AnswerRing[WiFiSim_AnswerHead]);
+	
+		WiFiSim_AnswerHead = (WiFiSim_AnswerHead + 1) % WIFISIM_ANSWER_RING_SIZE;
+		WiFiSim_AnswerUsed--;
+		WiFiSim_AnswerOut--;
+	}
+}
+
+/**
+  * @Brief	Data sent to the simulated WiFi-module(replace Hal_USART_WiFiDataTx)
+  * @Param	pData	: point to the data
+  *			Len		: data length
+  * @Retval	None
+  *	@Note	An AT-command may come in several segments, it is handled when its "\r\n" is received
+  */
+void Mid_WiFiSim_DataIn(uint8_t *pData, uint16_t Len)
+{
+	while(Len--)
+	{
+		if(WiFiSim_LineLen < (WIFISIM_LINE_SIZE - 1))
+		{
+			WiFiSim_Line[WiFiSim_LineLen++] = *pData;
+		}
+	
+		if(*pData == 0x0A)
+		{
+			WiFiSim_Line[WiFiSim_LineLen] = 0;
+	
+			Mid_WiFiSim_LineHandler();
+	
+			WiFiSim_LineLen = 0;
+		}
+	
+		pData++;
+	}
+}
+
+/**
+  * @Brief	Deliver a server dataframe to the Terminal as +MQTTSUBRECV of the MessageDown topic
+  * @Param	pData	: point to the server dataframe
+  *			Len		: dataframe length(up to WIFI_MQTT_RECV_DATA_SIZE / 2 byte)
+  * @Retval	None
+  */
+void Mid_WiFiSim_DownlinkIn(uint8_t *pData, uint16_t Len)
+{
+	Mid_WiFiSim_RecvIn(&stu_MQTT_ESP8266.SubTopic[0], pData, Len);
+}
+
+/**
+  * @Brief	Hold / run the fault script
+  * @Param	Hold: 1->no fault injected(a fault waiting for the next AT-command dropped), 0->script run again
+  * @Retval	None
+  *	@Note	The step held is injected its full Delay after the script runs again
+  */
+void Mid_WiFiSim_ScriptHold(uint8_t Hold)
+{
+	WiFiSim_ScriptHoldFlag = Hold;
+	
+	if(Hold)
+	{
+		WiFiSim_PendingFault = WIFISIM_FAULT_NONE;
+	}
+}
+
+/**
+  * @Brief	Get the statistics of the simulated WiFi-module
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void Mid_WiFiSim_GetStat(stu_WiFiSim_Stat_t *pStat)
+{
+	*pStat = stu_WiFiSim_Stat;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Deliver a server dataframe to the Terminal as +MQTTSUBRECV of the topic
+  * @Param	pTopic	: point to the topic string
+  *			pData	: point to the server dataframe
+  *			Len		: dataframe length
+  * @Retval	None
+  */
+static void Mid_WiFiSim_RecvIn(uint8_t *pTopic, uint8_t *pData, uint16_t Len)
+{
+	uint8_t Char_H;
+	uint8_t Char_L;
+	uint16_t i;
+	
+	Mid_WiFiSim_PutRecv(pTopic);
+	Mid_WiFiSim_PutNumber(Len * 2);
+	Mid_WiFiSim_Put((uint8_t *)",");
+	
+	for(i=0; (i<Len) && ((WiFiSim_AnswerLen + 2) < WIFISIM_ANSWER_SIZE); i++)
+	{
+		Hex_ASCII_Conversion_Segment(pData[i], &Char_H, &Char_L);
+	
+		WiFiSim_Answer[WiFiSim_AnswerLen++] = Char_H;
+		WiFiSim_Answer[WiFiSim_AnswerLen++] = Char_L;
+	}
+	
+	Mid_WiFiSim_Put((uint8_t *)"\r\n");
+	Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+	
+	stu_WiFiSim_Stat.RecvNumber++;
+}
+
+/**
+  * @Brief	Answer the AT-command received
+  * @Param	None
+  * @Retval	None
+  */
+static void Mid_WiFiSim_LineHandler(void)
+{
+	static uint8_t FrameBuff[WIFI_MQTT_PUB_DATA_SIZE / 2];
+	uint8_t *pData;
+	uint16_t Len;
+	uint8_t i;
+	
+	stu_WiFiSim_Stat.CmdNumber++;
+	
+	/* fault waiting for this AT-command */
+	if(WiFiSim_PendingFault == WIFISIM_FAULT_SILENT)
+	{
+		WiFiSim_PendingFault = WIFISIM_FAULT_NONE;
+		stu_WiFiSim_Stat.SilentNumber++;
+	
+		return;
+	}
+	
+	if(WiFiSim_PendingFault == WIFISIM_FAULT_ERROR)
+	{
+		WiFiSim_PendingFault = WIFISIM_FAULT_NONE;
+		stu_WiFiSim_Stat.ErrorNumber++;
+	
+		Mid_WiFiSim_Put((uint8_t *)"ERROR\r\n");
+		Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+	
+		return;
+	}
+	
+	switch(Mid_WiFiSim_ATcmdMatch())
+	{
+		case ESP8266_AT_RESET:
+		{
+			WiFiSim_APFlag = 0;
+			WiFiSim_MQTTFlag = 0;
+			WiFiSim_SubNumber = 0;
+			WiFiSim_JoinFlag = 1;
+			WiFiSim_JoinTick = OS_GetTickCount();
+	
+			stu_WiFiSim_Stat.ResetTick = OS_GetTickCount();
+			stu_WiFiSim_Stat.BringUpTime = 0;
+	
+			Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+		}
+		break;
+	
+		case ESP8266_AT_AT:
+	
+		case ESP8266_AT_ATE1:
+	
+		case ESP8266_AT_CWMODE:
+	
+		case ESP8266_AT_CWAUTOCONN:
+	
+		case ESP8266_AT_CWSTOPSMART:
+	
+		case ESP8266_AT_MQTTUSERCFG:
+		{
+			Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+		}
+		break;
+	
+		case ESP8266_AT_GETWIFILIST:
+	
+		case ESP8266_AT_CWSTATE:
+		{
+			// +CWSTATE:<state>,<"ssid">, "OK" right behind it as the module sends them
+			stu_WiFiSim_Stat.CWStateNumber++;
+	
+			Mid_WiFiSim_Put(WiFiSim_APFlag ? (uint8_t *)"+CWSTATE:2,\"SimAP\"\r\n" : (uint8_t *)"+CWSTATE:0,\"\"\r\n");
+			Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+		}
+		break;
+	
+		case ESP8266_AT_CWSTARTSMART:
+		{
+			WiFiSim_APFlag = 0;
+			WiFiSim_MQTTFlag = 0;
+			WiFiSim_JoinFlag = 1;
+			WiFiSim_JoinTick = OS_GetTickCount();
+	
+			Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+	
+			Mid_WiFiSim_Put((uint8_t *)"Smart get wifi info\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_AP_JOIN_DELAY / 2);
+	
+			Mid_WiFiSim_Put((uint8_t *)"smartconfig connected wifi\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_AP_JOIN_DELAY);
+		}
+		break;
+	
+		case ESP8266_AT_CWJAPQUERY:
+		{
+			if(WiFiSim_APFlag)
+			{
+				// +CWJAP:<"ssid">,<"bssid">,<channel>,<rssi>,...(RSSI swept -45 -> -74dBm)
+				Mid_WiFiSim_Put((uint8_t *)"+CWJAP:\"SimAP\",\"02:00:00:00:00:01\",6,");
+				Mid_WiFiSim_PutNumber(-45 - (WiFiSim_RSSIStep++ % 30));
+				Mid_WiFiSim_Put((uint8_t *)",0\r\n");
+				Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+	
+				Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			}
+			else
+			{
+				stu_WiFiSim_Stat.ErrorNumber++;
+	
+				Mid_WiFiSim_Put((uint8_t *)"ERROR\r\n");
+			}
+	
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+		}
+		break;
+	
+		case ESP8266_AT_CWLAP:
+	
+		case ESP8266_AT_CWLAPALL:
+		{
+			// +CWLAP:(<ecn>,<"ssid">,<rssi>,<"mac">,<channel>)
+			Mid_WiFiSim_Put((uint8_t *)"+CWLAP:(3,\"SimAP\",-52,\"02:00:00:00:00:01\",6)\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY * 10);
+	
+			Mid_WiFiSim_Put((uint8_t *)"+CWLAP:(4,\"SimAP-Guest\",-71,\"02:00:00:00:00:02\",11)\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY * 10);
+	
+			Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY * 10);
+		}
+		break;
+	
+		case ESP8266_AT_MQTTCONN:
+		{
+			if(WiFiSim_APFlag)
+			{
+				WiFiSim_MQTTFlag = 1;
+				WiFiSim_SubNumber = 0;
+	
+				Mid_WiFiSim_Put((uint8_t *)"+MQTTCONNECTED:0,1,\"simulator\",\"1883\",\"\",1\r\n");
+				Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+	
+				Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			}
+			else
+			{
+				stu_WiFiSim_Stat.ErrorNumber++;
+	
+				Mid_WiFiSim_Put((uint8_t *)"ERROR\r\n");
+			}
+	
+			Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+		}
+		break;
+	
+		case ESP8266_AT_MQTTSUB:
+	
+		case ESP8266_AT_MQTTSUBDATETIME:
+		{
+			if(WiFiSim_MQTTFlag)
+			{
+				Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+				Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+	
+				WiFiSim_SubNumber++;
+	
+				/* MessageDown, datetime and FirmwareDown topics subscribed: MQTT ready */
+				if((WiFiSim_SubNumber == 3) && (stu_WiFiSim_Stat.BringUpTime == 0))
+				{
+					stu_WiFiSim_Stat.BringUpTime = OS_GetTickCount() - stu_WiFiSim_Stat.ResetTick + WIFISIM_BROKER_DELAY;
+				}
+	
+				/* the broker publishes its datetime to the new subscriber */
+				if(StringMatch(&WiFiSim_Line[0], (uint8_t *)"datetime", WiFiSim_LineLen) != 0xFF)
+				{
+					Mid_WiFiSim_PutRecv(&stu_MQTT_ESP8266.SubTopic_DataTime[0]);
+					Mid_WiFiSim_PutNumber(GetStringLen((uint8_t *)WIFISIM_DATETIME));
+					Mid_WiFiSim_Put((uint8_t *)",");
+					Mid_WiFiSim_Put((uint8_t *)WIFISIM_DATETIME);
+					Mid_WiFiSim_Put((uint8_t *)"\r\n");
+					Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY * 2);
+	
+					stu_WiFiSim_Stat.RecvNumber++;
+				}
+			}
+			else
+			{
+				stu_WiFiSim_Stat.ErrorNumber++;
+	
+				Mid_WiFiSim_Put((uint8_t *)"ERROR\r\n");
+				Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+			}
+		}
+		break;
+	
+		case ESP8266_AT_MQTTPUB:
+		{
+			if(WiFiSim_MQTTFlag)
+			{
+				// AT+MQTTPUB=0,"topic","hex data",qos,retain
+				pData = &WiFiSim_Line[0];
+	
+				for(i=0; (i<3) && (*pData != 0); pData++)
+				{
+					if(*pData == '"')
+					{
+						i++;
+					}
+				}
+	
+				Len = 0;
+	
+				while((pData[Len] != 0) && (pData[Len] != '"') && (Len < WIFI_MQTT_PUB_DATA_SIZE))
+				{
+					Len++;
+				}
+	
+				ASCII_Hex_Conversion(pData, Len, &FrameBuff[0]);
+	
+				Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+				Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+	
+				stu_WiFiSim_Stat.PubNumber++;
+				stu_WiFiSim_Stat.PubByteNumber += Len / 2;
+	
+				Mid_WiFiSim_ServerIn(&FrameBuff[0], Len / 2);
+			}
+			else
+			{
+				stu_WiFiSim_Stat.ErrorNumber++;
+	
+				Mid_WiFiSim_Put((uint8_t *)"ERROR\r\n");
+				Mid_WiFiSim_AnswerIn(WIFISIM_BROKER_DELAY);
+			}
+		}
+		break;
+	
+		case ESP8266_AT_MQTTCLEAN:
+		{
+			WiFiSim_MQTTFlag = 0;
+			WiFiSim_SubNumber = 0;
+	
+			Mid_WiFiSim_Put((uint8_t *)"OK\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+		}
+		break;
+	
+		default:
+		{
+			stu_WiFiSim_Stat.ErrorNumber++;
+	
+			Mid_WiFiSim_Put((uint8_t *)"ERROR\r\n");
+			Mid_WiFiSim_AnswerIn(WIFISIM_ANSWER_DELAY);
+		}
+		break;
+	}
+}
+
+/**
+  * @Brief	Find the AT-command of the line received
+  * @Param	None
+  * @Retval	en_ESP8266_AT_t of the longest match, ESP8266_AT_SUM->unknown AT-command
+  *	@Note	AT-commands with parameters match up to their '"', the others must match the whole line
+  */
+static uint8_t Mid_WiFiSim_ATcmdMatch(void)
+{
+	uint8_t ATcmd;
+	uint8_t MatchLen;
+	uint8_t i, j;
+	
+	ATcmd = ESP8266_AT_SUM;
+	MatchLen = 0;
+	
+	for(i=0; i<ESP8266_AT_SUM; i++)
+	{
+		for(j=0; (j<sizeof(ESP8266_AT[0])) && (ESP8266_AT[i][j] != 0); j++)
+		{
+			if(WiFiSim_Line[j] != ESP8266_AT[i][j])
+			{
+				break;
+			}
+		}
+	
+		if((j == 0) || (j <= MatchLen) || ((j < sizeof(ESP8266_AT[0])) && (ESP8266_AT[i][j] != 0)))
+		{
+			continue;
+		}
+	
+		if((ESP8266_AT[i][j - 1] == '"') || (WiFiSim_Line[j] == 0x0D))
+		{
+			ATcmd = i;
+			MatchLen = j;
+		}
+	}
+	
+	return ATcmd;
+}
+
+/**
+  * @Brief	Inject the fault of the script
+  * @Param	Fault: fault to inject
+  * @Retval	None
+  */
+static void Mid_WiFiSim_FaultIn(en_WiFiSim_Fault_t Fault)
+{
+	switch(Fault)
+	{
+		case WIFISIM_FAULT_ERROR:
+	
+		case WIFISIM_FAULT_SILENT:
+		{
+			WiFiSim_PendingFault = Fault;
+		}
+		break;
+	
+		case WIFISIM_FAULT_AP_DROP:
+		{
+			if(WiFiSim_APFlag)
+			{
+				WiFiSim_APFlag = 0;
+				WiFiSim_MQTTFlag = 0;
+				WiFiSim_JoinFlag = 1;
+				WiFiSim_JoinTick = OS_GetTickCount();
+	
+				stu_WiFiSim_Stat.DropNumber++;
+	
+				Mid_WiFiSim_Put((uint8_t *)"WIFI DISCONNECT\r\n");
+				Mid_WiFiSim_AnswerIn(0);
+			}
+		}
+		break;
+	
+		case WIFISIM_FAULT_MQTT_DROP:
+		{
+			if(WiFiSim_MQTTFlag)
+			{
+				WiFiSim_MQTTFlag = 0;
+	
+				stu_WiFiSim_Stat.DropNumber++;
+	
+				Mid_WiFiSim_Put((uint8_t *)"+MQTTDISCONNECTED:0\r\n");
+				Mid_WiFiSim_AnswerIn(0);
+			}
+		}
+		break;
+	
+		default:
+		break;
+	}
+}
+
+/**
+  * @Brief	Simulated server: answer the dataframe published by the Terminal
+  * @Param	pFrame	: point to the dataframe published
+  *			Len		: dataframe length
+  * @Retval	None
+  */
+static void Mid_WiFiSim_ServerIn(uint8_t *pFrame, uint16_t Len)
+{
+	uint8_t  Payload[13];
+	uint16_t PackageIndex;
+	uint16_t CRC16;
+	uint8_t  i;
+	
+	if((Len < 6) || (pFrame[0] != 0xAA) || (WIFISIM_OTA_IMAGE_SIZE == 0))
+	{
+		return;
+	}
+	
+	switch(pFrame[3])
+	{
+		case PROTOCOL_TERMINAL_REQUEST_UPDATE_CHECK:
+		{
+			// AA 00 0A 21 00 05 PackageSize(2) ImageAccepted(1) Version(2) XOR 55: largest PackageSize accepted by the Terminal
+			// (the simulated server offers the whole image only)
+			if(Len >= 10)
+			{
+				WiFiSim_OTAPackageSize = (pFrame[6] << 8) | pFrame[7];
+				WiFiSim_OTANegotiated = 1;
+	
+				if((WiFiSim_OTAPackageSize > WIFISIM_OTA_PACKAGE_SIZE) || (WiFiSim_OTAPackageSize == 0))
+				{
+					WiFiSim_OTAPackageSize = WIFISIM_OTA_PACKAGE_SIZE;
+				}
+			}
+			else
+			{
+				WiFiSim_OTAPackageSize = WIFISIM_OTA_PACKAGE_SIZE_LEGACY;
+				WiFiSim_OTANegotiated = 0;
+			}
+	
+			WiFiSim_OTAPackageNumber = (WIFISIM_OTA_IMAGE_SIZE + WiFiSim_OTAPackageSize - 1) / WiFiSim_OTAPackageSize;
+	
+			// DataFrameID, Version(2), FirmwareSize(4, little-endian), PackageNumber(2, little-endian), CRC16(2), PackageSize(2, negotiated)
+			Payload[0] = 0x00;		// DataFrameID(the update check carries none)
+	
+			PackageIndex = ((Device_Get_SystemPara_FirmwareVersion(0) << 8) | Device_Get_SystemPara_FirmwareVersion(1)) + 1;
+	
+			Payload[1] = (PackageIndex >> 8) & 0xFF;
+			Payload[2] = PackageIndex & 0xFF;
+	
+			Payload[3] = WIFISIM_OTA_IMAGE_SIZE & 0xFF;
+			Payload[4] = (WIFISIM_OTA_IMAGE_SIZE >> 8) & 0xFF;
+			Payload[5] = ((uint32_t)WIFISIM_OTA_IMAGE_SIZE >> 16) & 0xFF;
+			Payload[6] = ((uint32_t)WIFISIM_OTA_IMAGE_SIZE >> 24) & 0xFF;
+	
+			Payload[7] = WiFiSim_OTAPackageNumber & 0xFF;
+			Payload[8] = (WiFiSim_OTAPackageNumber >> 8) & 0xFF;
+	
+			CRC16 = WiFiSim_OTACRC16 ^ 0xFFFF;		// never matches, the image is not installed
+	
+			Payload[9] = (CRC16 >> 8) & 0xFF;
+			Payload[10] = CRC16 & 0xFF;
+	
+			Payload[11] = (WiFiSim_OTAPackageSize >> 8) & 0xFF;
+			Payload[12] = WiFiSim_OTAPackageSize & 0xFF;
+	
+			Mid_WiFiSim_FramePack(PROTOCOL_SERVER_RESPONSE_UPDATE_CHECK, &Payload[0], WiFiSim_OTANegotiated ? 13 : 11);
+		}
+		break;
+	
+		case PROTOCOL_TERMINAL_REQUEST_UPDATE_FIRMWARE:
+		{
+			// AA 00 0A 24 00 05 FrameID Version(2) PackageIndex(2) XOR 55
+			if(Len < 13)
+			{
+				return;
+			}
+	
+			PackageIndex = (pFrame[9] << 8) | pFrame[10];
+	
+			if(PackageIndex >= WiFiSim_OTAPackageNumber)
+			{
+				return;
+			}
+	
+			/* statistics: a new download starts with package 0(not the resend of a lost package 0) */
+			if((PackageIndex == 0) && ((WiFiSim_OTAServed[0] & 0x01) || (WiFiSim_OTAServedNumber == 0)))
+			{
+				memset(&WiFiSim_OTAServed[0], 0, sizeof(WiFiSim_OTAServed));
+				WiFiSim_OTAServedNumber = 0;
+	
+				stu_WiFiSim_Stat.OTAStartTick = OS_GetTickCount();
+				stu_WiFiSim_Stat.OTATime = 0;
+				stu_WiFiSim_Stat.OTAPackageNumber = 0;
+				stu_WiFiSim_Stat.OTALossNumber = 0;
+			}
+	
+			/* answer lost on the link */
+			WiFiSim_OTARandom = WiFiSim_OTARandom * 1103515245 + 12345;
+	
+			if(((WiFiSim_OTARandom >> 16) % 100) < WIFISIM_OTA_LOSS)
+			{
+				stu_WiFiSim_Stat.OTALossNumber++;
+	
+				return;
+			}
+	
+			for(i=0; i<WIFISIM_OTA_FLIGHT_SUM; i++)
+			{
+				if(WiFiSim_OTAFlight[i].PackageIndex == 0xFFFF)
+				{
+					WiFiSim_OTAFlight[i].DueTick = OS_GetTickCount() + WIFISIM_OTA_LATENCY;
+					WiFiSim_OTAFlight[i].PackageIndex = PackageIndex;
+					WiFiSim_OTAFlight[i].RequestHead[0] = pFrame[6];
+					WiFiSim_OTAFlight[i].RequestHead[1] = pFrame[7];
+					WiFiSim_OTAFlight[i].RequestHead[2] = pFrame[8];
+	
+					return;
+				}
+			}
+	
+			/* link full */
+			stu_WiFiSim_Stat.OTALossNumber++;
+		}
+		break;
+	}
+}
+
+/**
+  * @Brief	Simulated server: answer of the firmware package request leaving the link
+  * @Param	pFlight: point to the answer on the link
+  * @Retval	None
+  */
+static void Mid_WiFiSim_OTAOut(stu_WiFiSim_Flight_t *pFlight)
+{
+	static uint8_t Payload[WIFISIM_OTA_PACKAGE_SIZE + 9];
+	uint16_t PackageIndex;
+	uint16_t CRC16;
+	uint32_t Offset;
+	uint16_t DataLen;
+	uint16_t Index;
+	uint16_t i;
+	
+	PackageIndex = pFlight->PackageIndex;
+	
+	Offset = (uint32_t)PackageIndex * WiFiSim_OTAPackageSize;
+	DataLen = ((WIFISIM_OTA_IMAGE_SIZE - Offset) > WiFiSim_OTAPackageSize) ? WiFiSim_OTAPackageSize : (WIFISIM_OTA_IMAGE_SIZE - Offset);
+	
+	// DataID, Version(2), PackageIndex(2), DataLen(2, negotiated / 1), Data(DataLen), CRC16(2)
+	Index = 0;
+	
+	Payload[Index++] = pFlight->RequestHead[0];
+	Payload[Index++] = pFlight->RequestHead[1];
+	Payload[Index++] = pFlight->RequestHead[2];
+	Payload[Index++] = (PackageIndex >> 8) & 0xFF;
+	Payload[Index++] = PackageIndex & 0xFF;
+	
+	if(WiFiSim_OTANegotiated)
+	{
+		Payload[Index++] = (DataLen >> 8) & 0xFF;
+	}
+	
+	Payload[Index++] = DataLen & 0xFF;
+	
+	for(i=0; i<DataLen; i++)
+	{
+		Payload[Index + i] = WIFISIM_OTA_PATTERN(Offset + i);
+	}
+	
+	CRC16 = Mid_CRC16_Modbus(&Payload[Index], DataLen);
+	
+	Index += DataLen;
+	
+	Payload[Index++] = (CRC16 >> 8) & 0xFF;
+	Payload[Index++] = CRC16 & 0xFF;
+	
+	Mid_WiFiSim_FramePack(PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE, &Payload[0], Index);
+	
+	/* statistics */
+	stu_WiFiSim_Stat.OTAPackageNumber++;
+	
+	if(!(WiFiSim_OTAServed[PackageIndex >> 3] & (1 << (PackageIndex & 0x07))))
+	{
+		WiFiSim_OTAServed[PackageIndex >> 3] |= (1 << (PackageIndex & 0x07));
+		WiFiSim_OTAServedNumber++;
+	
+		if(WiFiSim_OTAServedNumber == WiFiSim_OTAPackageNumber)
+		{
+			stu_WiFiSim_Stat.OTATime = OS_GetTickCount() - stu_WiFiSim_Stat.OTAStartTick + WIFISIM_BROKER_DELAY;
+		}
+	}
+}
+
+/**
+  * @Brief	Pack the server dataframe(Header, DataLength, CheckValue, Tail) and deliver it to the Terminal
+  * @Param	Cmd		: Command
+  *			pPayload: point to the payload
+  *			Len		: payload length
+  * @Retval	None
+  */
+static void Mid_WiFiSim_FramePack(uint8_t Cmd, uint8_t *pPayload, uint16_t Len)
+{
+	static uint8_t FrameBuff[WIFISIM_OTA_PACKAGE_SIZE + 16];	// Firmware package dataframe the largest
+	uint8_t XORCheck;
+	uint16_t Index;
+	uint16_t i;
+	
+	Index = 0;
+	
+	FrameBuff[Index++] = 0xAA;
+	FrameBuff[Index++] = ((Len + 3) >> 8) & 0xFF;
+	FrameBuff[Index++] = (Len + 3) & 0xFF;
+	FrameBuff[Index++] = Cmd;
+	
+	for(i=0; i<Len; i++)
+	{
+		FrameBuff[Index++] = pPayload[i];
+	}
+	
+	XORCheck = 0;
+	
+	for(i=1; i<Index; i++)
+	{
+		XORCheck ^= FrameBuff[i];
+	}
+	
+	FrameBuff[Index++] = XORCheck;
+	FrameBuff[Index++] = 0x55;
+	
+	Mid_WiFiSim_RecvIn(&stu_MQTT_ESP8266.SubTopic_FirmwareUpdate[0], &FrameBuff[0], Index);
+}
+
+/**
+  * @Brief	Append a string to the answer line being packed
+  * @Param	pString: point to the string
+  * @Retval	None
+  */
+static void Mid_WiFiSim_Put(uint8_t *pString)
+{
+	while((*pString != 0) && (WiFiSim_AnswerLen < WIFISIM_ANSWER_SIZE))
+	{
+		WiFiSim_Answer[WiFiSim_AnswerLen++] = *pString++;
+	}
+}
+
+/**
+  * @Brief	Append the +MQTTSUBRECV header of the topic to the answer line being packed
+  * @Param	pTopic: point to the topic string
+  * @Retval	None
+  *	@Note	+MQTTSUBRECV:0,<"topic">,
+  */
+static void Mid_WiFiSim_PutRecv(uint8_t *pTopic)
+{
+	Mid_WiFiSim_Put((uint8_t *)ESP8266_ATResponse[ESP8266_AT_RESPONSE_MQTTSUBRECV]);
+	Mid_WiFiSim_Put(pTopic);
+	Mid_WiFiSim_Put((uint8_t *)"\",");
+}
+
+/**
+  * @Brief	Append a decimal number to the answer line being packed
+  * @Param	Value: number
+  * @Retval	None
+  */
+static void Mid_WiFiSim_PutNumber(int16_t Value)
+{
+	uint8_t DataBuff[7];
+	uint8_t i;
+	
+	i = sizeof(DataBuff) - 1;
+	DataBuff[i] = 0;
+	
+	if(Value < 0)
+	{
+		Mid_WiFiSim_Put((uint8_t *)"-");
+	
+		Value = -Value;
+	}
+	
+	do
+	{
+		DataBuff[--i] = '0' + (Value % 10);
+		Value /= 10;
+	
+	}while(Value);
+	
+	Mid_WiFiSim_Put(&DataBuff[i]);
+}
+
+/**
+  * @Brief	Queue-in the answer line packed, sent to Mid_WiFi after the delay
+  * @Param	Delay: delay from now(unit: 10ms)
+  * @Retval	None
+  *	@Note	Answer lines are sent in the order queued-in
+  */
+static void Mid_WiFiSim_AnswerIn(uint16_t Delay)
+{
+	uint16_t Tail;
+	uint16_t DueTick;
+	uint16_t i;
+	
+	if((WiFiSim_AnswerUsed + WiFiSim_AnswerLen + 4) > WIFISIM_ANSWER_RING_SIZE)
+	{
+		stu_WiFiSim_Stat.OverflowNumber++;
+	
+		WiFiSim_AnswerLen = 0;
+	
+		return;
+	}
+	
+	Tail = (WiFiSim_AnswerHead + WiFiSim_AnswerUsed) % WIFISIM_ANSWER_RING_SIZE;
+	DueTick = (OS_GetTickCount() + Delay) & 0xFFFF;
+	
+	WiFiSim_AnswerRing[Tail] = (DueTick >> 8) & 0xFF;
+	WiFiSim_AnswerRing[(Tail + 1) % WIFISIM_ANSWER_RING_SIZE] = DueTick & 0xFF;
+	WiFiSim_AnswerRing[(Tail + 2) % WIFISIM_ANSWER_RING_SIZE] = (WiFiSim_AnswerLen >> 8) & 0xFF;
+	WiFiSim_AnswerRing[(Tail + 3) % WIFISIM_ANSWER_RING_SIZE] = WiFiSim_AnswerLen & 0xFF;
+	
+	for(i=0; i<WiFiSim_AnswerLen; i++)
+	{
+		WiFiSim_AnswerRing[(Tail + 4 + i) % WIFISIM_ANSWER_RING_SIZE] = WiFiSim_Answer[i];
+	}
+	
+	WiFiSim_AnswerUsed += WiFiSim_AnswerLen + 4;
+	WiFiSim_AnswerLen = 0;
+}
+
+#endif
+
+
+/*-------------Interrupt Functions Definition--------*/
+
+
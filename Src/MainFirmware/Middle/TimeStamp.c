@@ -2,7 +2,15 @@
   * @Name	TimeStamp.c
   * @Brief	
   *			TimeStamp_DateTime_Conversion: 
-  *			Convert the given UNIX Timestamp to UTC datetime
+  *			Convert the given UNIX Timestamp to local datetime(UTC_OFFSET_4)
+  *			TimeStamp_DateTime_Update:
+  *			Rewrite only the changed digits of a converted datetime
+  *			TimeStamp_Days_ToCivil:
+  *			Convert the days since 1970 to year/month/day in constant time
+  *			TimeStamp_DateTime_ToTimeStamp:
+  *			Convert the local datetime string back to the UNIX Timestamp
+  *			TimeStamp_Local_ToTimeStamp:
+  *			Convert the local datetime fields to the UNIX Timestamp
   *	@Note	Define the UTC Timezone offset in the .h file when location changes
   ***************************************************/
   
@@ -10,12 +18,10 @@
 #include "timestamp.h"
 
 /*-------------Internal Functions Declaration------*/
+static void TimeStamp_Digit_Update(unsigned char *pDigit, unsigned int Value);
 
 
 /*-------------Module Variables Declaration--------*/
-const unsigned int Month_Days[] = {
-	31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
-};
 
 /*---Module Call-Back function pointer Definition---*/
 
@@ -34,96 +40,177 @@ unsigned int LeapYear(unsigned int year)
 /**
   * @Brief	Convert the TimeStamp to Datetime
   * @Param	TimeStamp: input UNIX TimeStamp
-  *			pDateTime: point to the result string
+  *			pDateTime: point to the result string("YYYY-MM-DD\0HH:MM\0", local time of UTC_OFFSET_4)
   * @Retval	None
+  *	@Note	Constant time, the date is calculated in closed form(TimeStamp_Days_ToCivil)
   */
 void TimeStamp_DateTime_Conversion(unsigned long TimeStamp, unsigned char *pDateTime)
 {
-	unsigned int second, minute, hour, day, month, year;
-	unsigned int m_days[12];
-	unsigned int i;
+	unsigned int year, month, day;
+	unsigned long second;
 	
-	day = TimeStamp / 86400;
+	/* local time */
+	TimeStamp = (TimeStamp > UTC_OFFSET_4) ? (TimeStamp - UTC_OFFSET_4) : 0;
+	
+	TimeStamp_Days_ToCivil(TimeStamp / 86400, &year, &month, &day);
 	second = TimeStamp % 86400;
-	year = 1970;
 	
-	/* calculate the year since 1970 */
-	while(1)
+	pDateTime[0] = (year / 1000) + '0';
+	pDateTime[1] = ((year % 1000) / 100) + '0';
+	pDateTime[2] = ((year % 100) / 10) + '0';
+	pDateTime[3] = ((year % 10)) + '0';
+	pDateTime[4] = '-';
+	pDateTime[5] = (month / 10) + '0';
+	pDateTime[6] = (month % 10) + '0';
+	pDateTime[7] = '-';
+	pDateTime[8] = (day / 10) + '0';
+	pDateTime[9] = (day % 10) + '0';
+	pDateTime[10] = '\0';
+
+	pDateTime[11] = (second / 36000) + '0';
+	pDateTime[12] = ((second / 3600) % 10) + '0';
+	pDateTime[13] = ':';
+	pDateTime[14] = ((second % 3600) / 600) + '0';
+	pDateTime[15] = (((second % 3600) / 60) % 10) + '0';
+	pDateTime[16] = '\0';
+}
+
+/**
+  * @Brief	Update the Datetime string of the last TimeStamp to the new TimeStamp
+  * @Param	TimeStamp	 : new UNIX TimeStamp
+  *			LastTimeStamp: UNIX TimeStamp the string was converted from(0->string not valid)
+  *			pDateTime	 : point to the string to update("YYYY-MM-DD\0HH:MM\0")
+  * @Retval	None
+  *	@Note	Only the digits changed are written, the date is recalculated only when the day changed
+  */
+void TimeStamp_DateTime_Update(unsigned long TimeStamp, unsigned long LastTimeStamp, unsigned char *pDateTime)
+{
+	unsigned long second;
+	
+	/* local time */
+	TimeStamp = (TimeStamp > UTC_OFFSET_4) ? (TimeStamp - UTC_OFFSET_4) : 0;
+	LastTimeStamp = (LastTimeStamp > UTC_OFFSET_4) ? (LastTimeStamp - UTC_OFFSET_4) : 0;
+	
+	if((LastTimeStamp == 0) || ((TimeStamp / 86400) != (LastTimeStamp / 86400)))
 	{
-		unsigned int year_days = LeapYear(year) ? 366 : 365;
+		TimeStamp_DateTime_Conversion(TimeStamp + UTC_OFFSET_4, pDateTime);
 		
-		if(day >= year_days)
-		{
-			day -= year_days;
-			year++;
-		}
-		else
-		{
-			break;
-		}
+		return;
 	}
 	
-	/* calculate the month and date */
+	second = TimeStamp % 86400;
 	
-	for(i=0; i<12; i++)
-	{
-		m_days[i] = Month_Days[i];
-	}
+	TimeStamp_Digit_Update(&pDateTime[11], second / 36000);
+	TimeStamp_Digit_Update(&pDateTime[12], (second / 3600) % 10);
+	TimeStamp_Digit_Update(&pDateTime[14], (second % 3600) / 600);
+	TimeStamp_Digit_Update(&pDateTime[15], ((second % 3600) / 60) % 10);
+}
+
+/**
+  * @Brief	Convert the days since 1970-01-01 to the civil date
+  * @Param	Days  : days since 1970-01-01
+  *			pYear : point to the result year
+  *			pMonth: point to the result month(1 -> 12)
+  *			pDay  : point to the result day(1 -> 31)
+  * @Retval	None
+  *	@Note	Closed form, years start from March(leap day at the end of the year), 400-year era of 146097 days
+  */
+void TimeStamp_Days_ToCivil(unsigned long Days, unsigned int *pYear, unsigned int *pMonth, unsigned int *pDay)
+{
+	unsigned long era, doe;
+	unsigned int yoe, doy, mp;
 	
-	if(LeapYear(year))
-	{
-		m_days[1] = 29;
-	}
+	Days += 719468;													// days from 0000-03-01
 	
-	for(month=0; month<12; month++)
+	era = Days / 146097;
+	doe = Days - era * 146097;										// day of era [0, 146096]
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;	// year of era [0, 399]
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);					// day of year [0, 365]
+	mp  = (5 * doy + 2) / 153;										// month from March [0, 11]
+	
+	*pDay = doy - (153 * mp + 2) / 5 + 1;
+	*pMonth = (mp < 10) ? (mp + 3) : (mp - 9);
+	*pYear = yoe + era * 400 + ((*pMonth <= 2) ? 1 : 0);
+}
+
+/**
+  * @Brief	Convert the local Datetime to TimeStamp
+  * @Param	pDateTime: point to the datetime string("YYYY-MM-DD HH:MM", local time of UTC_OFFSET_4)
+  * @Retval	UNIX TimeStamp(seconds), 0->datetime not valid(SystemTime not received yet)
+  */
+unsigned long TimeStamp_DateTime_ToTimeStamp(unsigned char *pDateTime)
+{
+	unsigned int year, month, day, hour, minute;
+	unsigned char i;
+	
+	for(i=0; i<16; i++)
 	{
-		if(day < m_days[month])
+		if(((i == 4) || (i == 7) || (i == 10) || (i == 13)))	// separators
 		{
-			break;
+			continue;
 		}
 		
-		day -= m_days[month];
+		if((pDateTime[i] < '0') || (pDateTime[i] > '9'))
+		{
+			return 0;
+		}
 	}
 	
-	day = day + 1;
-	month = month + 1;
+	year   = (pDateTime[0] - '0') * 1000 + (pDateTime[1] - '0') * 100 + (pDateTime[2] - '0') * 10 + (pDateTime[3] - '0');
+	month  = (pDateTime[5] - '0') * 10 + (pDateTime[6] - '0');
+	day    = (pDateTime[8] - '0') * 10 + (pDateTime[9] - '0');
+	hour   = (pDateTime[11] - '0') * 10 + (pDateTime[12] - '0');
+	minute = (pDateTime[14] - '0') * 10 + (pDateTime[15] - '0');
 	
-	/* calculate the hour, minue, second */
-	if(second >= UTC_OFFSET_4)
+	return TimeStamp_Local_ToTimeStamp(year, month, day, hour, minute, 0);
+}
+
+/**
+  * @Brief	Convert the local Datetime fields to TimeStamp
+  * @Param	year, month, day, hour, minute, second: local time of UTC_OFFSET_4
+  * @Retval	UNIX TimeStamp(seconds), 0->datetime not valid
+  *	@Note	Days since 1970-01-01 are counted in closed form(years start from March, leap day at the end of the year)
+  */
+unsigned long TimeStamp_Local_ToTimeStamp(unsigned int year, unsigned int month, unsigned int day, unsigned int hour, unsigned int minute, unsigned int second)
+{
+	unsigned int era, yoe, doy;
+	unsigned long days;
+	
+	if((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31) || (hour > 23) || (minute > 59) || (second > 59))
 	{
-		hour = (second - UTC_OFFSET_4) / 3600;
+		return 0;
 	}
-	else
+	
+	/* year of March-based calendar, 400-year era */
+	if(month <= 2)
 	{
-		hour = (second - UTC_OFFSET_4 + 86400) / 3600;
-		day -= 1;
+		year -= 1;
 	}
 	
-	second %= 3600;
-	minute = second / 60;
-	second = second % 60;
+	era = year / 400;
+	yoe = year - era * 400;											// year of era [0, 399]
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;	// day of year [0, 365]
 	
-	pDateTime[0] = (year / 1000) + '0';
-	pDateTime[1] = ((year % 1000) / 100) + '0';
-	pDateTime[2] = ((year % 100) / 10) + '0';
-	pDateTime[3] = ((year % 10)) + '0';
-	pDateTime[4] = '-';
-	pDateTime[5] = (month / 10) + '0';
-	pDateTime[6] = (month % 10) + '0';
-	pDateTime[7] = '-';
-	pDateTime[8] = (day / 10) + '0';
-	pDateTime[9] = (day % 10) + '0';
-	pDateTime[10] = '\0';
-
-	pDateTime[11] = (hour / 10) + '0';
-	pDateTime[12] = (hour % 10) + '0';
-	pDateTime[13] = ':';
-	pDateTime[14] = (minute / 10) + '0';
-	pDateTime[15] = (minute % 10) + '0';
-	pDateTime[16] = '\0';
+	days = (unsigned long)era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	days -= 719468;													// days from 0000-03-01 to 1970-01-01
+	
+	return (days * 86400) + ((unsigned long)hour * 3600) + ((unsigned long)minute * 60) + second + UTC_OFFSET_4;
 }
 
 /*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Write the digit only if it changed
+  * @Param	pDigit: point to the digit in the string
+  *			Value : digit value(0 -> 9)
+  * @Retval	None
+  */
+static void TimeStamp_Digit_Update(unsigned char *pDigit, unsigned int Value)
+{
+	if(*pDigit != (Value + '0'))
+	{
+		*pDigit = Value + '0';
+	}
+}
 
 
 /*-------------Interrupt Functions Definition--------*/
@@ -1,7 +1,34 @@
 #ifndef __CRC16_H_
 #define __CRC16_H_
 
+/* CRC16(Modbus) lookup method macro(uncomment the target method, or define it on the compiler command line) */
+/* Every method gives the same value:
+	NIBBLE	-> 16 entries(32 byte), 2 lookups per byte
+	BYTE	-> 256 entries(512 byte), 1 lookup per byte
+	SLICE4	-> 4 * 256 entries(2 KB), 4 lookups per 4 bytes
+*/
+#if !defined(CRC16_MODBUS_NIBBLE) && !defined(CRC16_MODBUS_BYTE) && !defined(CRC16_MODBUS_SLICE4)
+//#define CRC16_MODBUS_NIBBLE
+//#define CRC16_MODBUS_BYTE
+#define CRC16_MODBUS_SLICE4
+#endif
+
+#if defined(CRC16_MODBUS_SLICE4)
+#define CRC16_MODBUS_TABLE_NUMBER	4
+#else
+#define CRC16_MODBUS_TABLE_NUMBER	1
+#endif
+
+/* Streaming State to start with */
+#define CRC16_MODBUS_INIT			0xFFFF
+#define CRC32_INIT					0xFFFFFFFF
+
+
 unsigned short Mid_CRC16_Modbus(unsigned char *ptr, unsigned int len);
 unsigned short Mid_CRC16_Modbus_Continuous(unsigned char *ptr, unsigned int len, unsigned short crc16);
+unsigned short Mid_CRC16_ModbusUpdate(unsigned char *ptr, unsigned int len, unsigned short State);
+unsigned short Mid_CRC16_ModbusResult(unsigned short State);
+
+unsigned int   Mid_CRC32_Update(unsigned char *ptr, unsigned int len, unsigned int State);
 
 #endif
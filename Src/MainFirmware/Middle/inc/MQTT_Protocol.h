@@ -5,6 +5,63 @@
 /* highest bit: 1->negative, 0->positive */
 #define SYSTETIME_UTC_ZONE	0x8004
 
+/** Comment this macro to enable <Working Mode> of MQTTProtocol_EventUpload_Pro
+  * Uncomment this macro to enable <Debug Mode> of MQTTProtocol_EventUpload_Pro(inject synthetic event bursts)	*/ 
+//#define	MQTT_EVENT_BATCH_DEBUG_MODE
+
+/** Comment this macro to enable <Working Mode> of MQTTProtocol_Downlink_Pro
+  * Uncomment this macro to enable <Debug Mode> of MQTTProtocol_Downlink_Pro(feed a split / concatenated / corrupted stream to the frame decoder)	*/ 
+//#define	MQTT_FRAME_DECODE_DEBUG_MODE
+
+/* EventUpload batch: maximum delay of the oldest event in a batch before publishing(unit: 10ms) */
+#define MQTT_EVENT_BATCH_DELAY_MAX		50
+/* EventUpload batch: maximum size of the batch payload(RecordNumber + RecordLength/Record pairs) */
+#define MQTT_EVENT_BATCH_SIZE_MAX		240
+/* EventUpload batch: maximum number of records in a batch */
+#define MQTT_EVENT_BATCH_RECORD_MAX		8
+/* EventUpload record maximum size: SystemTime(17) + SensorName(16) + Message(18) */
+#define MQTT_EVENT_RECORD_SIZE_MAX		51
+
+/* Compact EventUpload(Command 0x54): version of the record layout, format used after power on */
+#define MQTT_EVENT_COMPACT_VERSION		1
+#define MQTT_EVENT_FORMAT_DEFAULT		MQTT_EVENT_FORMAT_COMPACT
+/* Compact EventUpload record flags: SensorType byte follows the fixed fields */
+#define MQTT_EVENT_COMPACT_FLAG_SENSOR_TYPE		0x01
+
+/* EventUpload lanes: record size(Event, Data, QueueIn-Tick, Outbox slot), 
+   a waiting lane is served once after being passed over MQTT_EVENT_LANE_STARVE_MAX times by the higher lanes */
+#define MQTT_EVENT_LANE_RECORD_SIZE		6
+#define MQTT_EVENT_LANE_STARVE_MAX		8
+
+/* Terminal state(Command 0x55 / 0x56): version of the layout, state fields(WorkMode, Power, one per Sensor), 
+   period of the delta check, fields unchanged for so long after a delta before the retained snapshot is brought up to date(unit: 10ms) */
+#define MQTT_STATE_VERSION				1
+#define MQTT_STATE_FIELD_SUM			(MQTT_STATE_FIELD_SENSOR + SENSOR_NUMBER_MAX)
+#define MQTT_STATE_CHECK_PERIOD			100
+#define MQTT_STATE_RETAIN_DELAY			1000
+
+/* Publishes waiting for the broker's answer: tracked at most, allowed before the EventUpload holds back */
+#define MQTT_PUB_INFLIGHT_SUM			8
+#define MQTT_PUB_INFLIGHT_MAX			4
+
+/* Maximum size of the payload buffer packed by MQTTProtocol_DataPack(Length + Command + Payload) */
+#define MQTT_PROTOCOL_DATA_SIZE_MAX		(MQTT_EVENT_BATCH_SIZE_MAX + 5)
+
+/* Device info record: SensorID + SensorType + SensorName(16) + SensorArmType, records per "all devices" dataframe */
+#define MQTT_DEVICE_INFO_SIZE			19
+#define MQTT_DEVICE_INFO_PER_FRAME		((MQTT_PROTOCOL_DATA_SIZE_MAX - 5 - 2) / MQTT_DEVICE_INFO_SIZE)
+
+/* Downlink message queue: number of queued server dataframes, maximum size of a dataframe(Firmware package of 1024 byte) */
+#define MQTT_DOWNLINK_QUEUE_SUM			4
+#define MQTT_DOWNLINK_FRAME_SIZE_MAX	1040
+
+/* Firmware package dataframe besides the effective data: Header, DataLength(2), Command, DataID, Version(2), PackageIndex(2),
+ * DataLen(2), CRC16(2), CheckValue, Tail */
+#define MQTT_FIRMWARE_PACKAGE_OVERHEAD	15
+
+/* Frame decoder: a partial dataframe waiting longer than this is resynchronized(unit: 10ms) */
+#define MQTT_FRAME_DECODE_TIMEOUT		300
+
 /* SystemTime Macro Define: */
 #define Set_SystemTime_Year(x)		(stu_SystemTime.year=x)
 #define Set_SystemTime_Month(x)		(stu_SystemTime.month=x)
@@ -38,6 +95,11 @@ typedef enum
 	PROTOCOL_TERMINAL_REQUEST_UPDATE_CHECK 		= 0x21,		// check update information request
 	PROTOCOL_TERMINAL_REQUEST_UPDATE_FIRMWARE 	= 0x24,		// request Firmware package
 	PROTOCOL_TERMINAL_RESPONSE					= 0x51, 	// response of server command / terminal eventupload
+	PROTOCOL_TERMINAL_EVENT_BATCH				= 0x52, 	// terminal eventupload, several event records in one dataframe
+	PROTOCOL_TERMINAL_LINK_TELEMETRY			= 0x53, 	// terminal WiFi link quality report
+	PROTOCOL_TERMINAL_EVENT_COMPACT				= 0x54, 	// terminal eventupload, binary event records
+	PROTOCOL_TERMINAL_STATE_SNAPSHOT			= 0x55, 	// terminal full state(retained), published on every MQTT connect
+	PROTOCOL_TERMINAL_STATE_DELTA				= 0x56, 	// terminal state fields changed since the last snapshot / delta
 	
 	PROTOCOL_SERVER_RESPONSE_GET_SYSTIME		= 0x2A,		// server response of systemtime request
 	PROTOCOL_SERVER_RESPONSE_UPDATE_CHECK		= 0x22,		// server response of update information request
@@ -78,11 +140,28 @@ typedef enum
 	PROTOCOL_SERVER_REQUEST_SET_WORKMODE_DISARM,	// change Terminal WorkMode to Disarm
 	PROTOCOL_SERVER_REQUEST_SET_WORKMODE_ALARM,		// change Terminal WorkMode to Alarm
 	
+	PROTOCOL_SERVER_REQUEST_ALL_DEVICE_INFO,		// request attribute info of all paired Devices(argument: start Device index)
+	PROTOCOL_SERVER_REQUEST_SET_EVENT_FORMAT,		// select the EventUpload format(argument: 0->text, 1->compact)
+	PROTOCOL_SERVER_REQUEST_STATE_SNAPSHOT,			// request the Terminal state snapshot(answered by Command 0x55)
+	
 	PROTOCOL_SERVER_REQUEST_ERROR = 0xFF,			// invalid server request / corrupted dataframe
 	
 	PROTOCOL_SERVER_REQUEST_SUM,
 }en_Protocol_ServerRequestCode_t;
 
+/* Server request responder: pack the response payload, return the payload length(0->answered by another dataframe)
+   Index: RequestCode - FirstCode of the descriptor, Arg: argument byte following the RequestCode */
+typedef unsigned short (*MQTTServerRequest_Response_t)(unsigned char *pPayload, unsigned char Index, unsigned char Arg);
+
+/* Server request descriptor: request codes FirstCode -> LastCode are answered by pResponse */
+typedef struct
+{
+	unsigned char FirstCode;
+	unsigned char LastCode;
+	MQTTServerRequest_Response_t pResponse;
+	
+}stu_MQTTServerRequest_t;
+
 /* Terminal UpEvent define: */
 typedef enum
 {
@@ -113,10 +192,40 @@ typedef enum
 	TERMINAL_UPEVENT_DISARM_BY_HOST,     	// Disarm by Host, Remote, Server
 	TERMINAL_UPEVENT_DISARM_BY_REMOTE,   
 	TERMINAL_UPEVENT_DISARM_BY_SERVER,      	
+	
+	TERMINAL_UPEVENT_LINK_TELEMETRY,		// WiFi link quality report
 		
 	TERMINAL_UPEVENT_SUM,
 }en_Terminal_UpEvent_t;
 
+/* Terminal UpEvent priority class(one EventUpload lane per class, drained highest-first): */
+typedef enum
+{
+	MQTT_EVENT_CLASS_ALARM = 0,		// alarm events, uploaded ahead of the outbox backlog(still journaled until accepted)
+	MQTT_EVENT_CLASS_NORMAL,		// terminal events, journaled events of this class are uploaded in the order of the outbox
+	MQTT_EVENT_CLASS_REQUEST,		// requests / reports to the server(update check, link telemetry)
+	
+	MQTT_EVENT_CLASS_SUM,
+}en_MQTTEventClass_t;
+
+/* EventUpload format: */
+typedef enum
+{
+	MQTT_EVENT_FORMAT_TEXT = 0,		// text records(SystemTime + SensorName + Message), Command 0x51 / 0x52
+	MQTT_EVENT_FORMAT_COMPACT,		// binary records(Epoch + EventCode + Zone), Command 0x54
+	
+	MQTT_EVENT_FORMAT_SUM,
+}en_MQTTEventFormat_t;
+
+/* Terminal state field index(FieldID of the state delta): */
+typedef enum
+{
+	MQTT_STATE_FIELD_WORKMODE = 0,	// Terminal WorkMode
+	MQTT_STATE_FIELD_POWER,			// bit0: AC charger connected, bit1: battery low
+	MQTT_STATE_FIELD_SENSOR,		// Sensor 1 -> SENSOR_NUMBER_MAX: bit0 paired, bit1 online, bit2-3 ArmType, bit4-7 SensorType
+	
+}en_MQTTStateField_t;
+
 /* MQTT server Endpoint define */
 typedef enum
 {
@@ -133,6 +242,69 @@ typedef struct
 	
 }stu_MQTTEventUpload_t;
 
+/* EventUpload statistics of a priority class */
+typedef struct
+{
+	unsigned long EventNumber;		// events of the class uploaded(requests published directly included)
+	unsigned long LatencySum;		// sum of queue-in to publish latency(unit: 10ms)
+	unsigned short LatencyMax;		// maximum queue-in to publish latency(unit: 10ms)
+	unsigned long StarveNumber;		// events picked ahead of the higher lanes by the starvation protection
+	unsigned long DropNumber;		// events dropped because the lane was full
+	
+}stu_MQTTEventClassStat_t;
+
+/* EventUpload batch statistics */
+typedef struct
+{
+	unsigned long StartTick;		// OS tick when the statistics started(events/s = EventNumber * 100 / elapsed ticks)
+	unsigned long EventNumber;		// events uploaded
+	unsigned long FrameNumber;		// dataframes published for the events uploaded
+	unsigned long AlarmFlushNumber;	// batches published immediately because of an alarm-class event
+	unsigned long LatencySum;		// sum of queue-in to publish latency of all events(unit: 10ms)
+	unsigned short LatencyMax;		// maximum queue-in to publish latency(unit: 10ms)
+	stu_MQTTEventClassStat_t Class[MQTT_EVENT_CLASS_SUM];	// per priority class
+	
+}stu_MQTTEventBatchStat_t;
+
+/* Downlink message(decoded server dataframe) */
+typedef struct
+{
+	en_Protocol_CommType_t CommType;
+	unsigned short QueueInTick;		// OS tick(low 16 bit) when the dataframe was queued-in
+	unsigned short Len;
+	unsigned char Data[MQTT_DOWNLINK_FRAME_SIZE_MAX];
+	
+}stu_MQTTDownlinkMsg_t;
+
+/* Downlink message queue statistics */
+typedef struct
+{
+	unsigned long QueueInNumber;		// dataframes queued-in by the Rx parser
+	unsigned long DispatchNumber;		// dataframes handled by MQTTProtocol_Downlink_Pro
+	unsigned long DropFullNumber;		// dataframes dropped because the queue was full
+	unsigned long DropOversizeNumber;	// dataframes dropped because longer than MQTT_DOWNLINK_FRAME_SIZE_MAX
+	unsigned char PeakNumber;			// high-water mark of queued dataframes
+	unsigned short WaitTickMax;			// longest queue-in to dispatch delay(unit: 10ms)
+	
+	unsigned long DecodeByteNumber;		// bytes fed to the frame decoder
+	unsigned long DecodeFrameNumber;	// valid dataframes decoded and handled
+	unsigned long GarbageNumber;		// bytes skipped while searching the Header
+	unsigned long LengthErrorNumber;	// Headers dropped because of an invalid DataLength
+	unsigned long CheckErrorNumber;		// Headers dropped because of a wrong Tail / CheckValue
+	unsigned long TimeoutNumber;		// partial dataframes resynchronized after MQTT_FRAME_DECODE_TIMEOUT
+	
+}stu_MQTTDownlinkStat_t;
+
+/* Frame decoder: stream bytes not consumed yet are kept in Buff[Start] -> Buff[Start + Number - 1] */
+typedef struct
+{
+	unsigned short Start;
+	unsigned short Number;
+	unsigned short InputTick;		// OS tick(low 16 bit) of the last input
+	unsigned char Buff[MQTT_DOWNLINK_FRAME_SIZE_MAX];
+	
+}stu_MQTTFrameDecoder_t;
+
 /* SystemTime */
 typedef struct 
 {
@@ -151,12 +323,22 @@ extern stu_SystemTime_t	stu_SystemTime;
 void MQTTProtocol_Init(void);
 void MQTTProtocol_Pro(en_Protocol_CommType_t CommType);
 
-void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned char Len);
-void MQTTProtocol_EventUpQueueIn(unsigned char Event, unsigned char Data);
+void MQTTProtocol_ReceiveDataHandler(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned short Len);
+void MQTTProtocol_FrameDecode(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned short Len);
+unsigned char MQTTProtocol_DownlinkQueueIn(en_Protocol_CommType_t CommType, unsigned char *pData, unsigned short Len);
+void MQTTProtocol_Downlink_Pro(void);
+void MQTTProtocol_GetDownlinkStat(stu_MQTTDownlinkStat_t *pStat);
+void MQTTProtocol_EventUpQueueIn(unsigned char Event, unsigned char Data, en_MQTTEventClass_t Class);
 void MQTTProtocol_EventUpload_Pro(en_Protocol_CommType_t CommType);
+void MQTTProtocol_GetEventBatchStat(stu_MQTTEventBatchStat_t *pStat);
+void MQTTProtocol_ClearEventBatchStat(void);
+void MQTTProtocol_SetEventFormat(en_MQTTEventFormat_t Format);
+en_MQTTEventFormat_t MQTTProtocol_GetEventFormat(void);
+void MQTTProtocol_StateSnapshot_Request(void);
 void MQTTProtocol_EventUpload_DataPack(en_Protocol_CommType_t CommType, unsigned char ZoneNo, en_Terminal_UpEvent_t EventType, unsigned short Endpoint);
-void MQTTProtocol_ServerRequestResponse_DataPack(en_Protocol_CommType_t CommType, en_Protocol_ServerRequestCode_t ServerRequestCode);
+void MQTTProtocol_ServerRequestResponse_DataPack(en_Protocol_CommType_t CommType, en_Protocol_ServerRequestCode_t ServerRequestCode, unsigned char RequestArg);
 void MQTTProtocol_NewFirmwareCheck_DataPack(unsigned char CommType);
+void MQTTProtocol_LinkTelemetry_DataPack(unsigned char CommType);
 void MQTTProtocol_GetNewFirmware_DataPack(unsigned char CommType, unsigned short PackageIndex, unsigned char *pVersion);
 
 
@@ -0,0 +1,48 @@
+#ifndef __MID_CLOCK_H_
+#define __MID_CLOCK_H_
+
+/* OS tick per second(OS tick: 10ms) */
+#define CLOCK_TICK_PER_SECOND		100
+
+/* Correction taken at most once per period, the datetime pushes in between are dropped(unit: 10ms) */
+#define CLOCK_SYNC_PERIOD			60000		// 10mins
+/* No correction for this long while MQTT is ready: request the SystemTime from server(unit: 10ms) */
+#define CLOCK_SYNC_TIMEOUT			2160000		// 6h
+
+/* Drift measured across corrections CLOCK_DRIFT_INTERVAL_MIN -> CLOCK_DRIFT_INTERVAL_MAX apart(unit: second)
+ * (server time resolution 1 second: 6h -> ~46ppm per measurement, smoothed over the measurements) */
+#define CLOCK_DRIFT_INTERVAL_MIN	21600
+#define CLOCK_DRIFT_INTERVAL_MAX	2592000
+/* Drift beyond this is taken as a server time step, not measured(unit: ppm) */
+#define CLOCK_DRIFT_PPM_MAX			500
+
+/* Server behind the clock up to this much: the clock holds until caught up(monotonic), beyond: step back(unit: second) */
+#define CLOCK_HOLD_MAX				120
+
+/* Elapsed ticks folded into the base every period, keeps the drift product in 32 bit(unit: 10ms) */
+#define CLOCK_REBASE_PERIOD			360000		// 1h
+
+/* Clock statistics */
+typedef struct
+{
+	uint32_t SyncNumber;		// corrections taken
+	uint32_t DropNumber;		// datetime pushes dropped(within CLOCK_SYNC_PERIOD)
+	uint32_t RequestNumber;		// SystemTime requested from server(CLOCK_SYNC_TIMEOUT)
+	uint32_t StepNumber;		// corrections stepped the clock back(beyond CLOCK_HOLD_MAX)
+	int32_t  LastOffset;		// server - clock at the last correction(unit: second)
+	int32_t  DriftPPM;			// drift compensated(+: OS tick fast)
+	uint32_t FormatNumber;		// SystemTime[] reformatted
+	
+}stu_Clock_Stat_t;
+
+
+void Mid_Clock_Init(void);
+void Mid_Clock_Pro(void);
+
+void Mid_Clock_Sync(unsigned long TimeStamp);
+uint8_t Mid_Clock_IsSynced(void);
+unsigned long Mid_Clock_GetTimeStamp(void);
+uint8_t *Mid_Clock_GetDateTime(void);
+void Mid_Clock_GetStat(stu_Clock_Stat_t *pStat);
+
+#endif
@@ -5,6 +5,81 @@
 #define FIRMWARE_NEW_VERSION_FLAG		0xAA	// new Firmware version detected, is ready to download from ExternalFlash 
 #define FIRMWARE_NEW_VERSION_READY		0xBB	// new Firmware is ready in EmbeddedFlash
 #define FIRMWARE_NEW_VERSION_DEFAULT	0xCC
+#define FIRMWARE_NEW_DELTA_FLAG			0xAD	// delta patch of the running Firmware is ready in ExternalFlash, applied by the BootLoader
+#define FIRMWARE_NEW_DELTA_APPLIED		0xAE	// new Firmware rebuilt from the patch at FIRMWARE_DELTA_TARGET_ADDRESS, checked
+#define FIRMWARE_NEW_LZ_FLAG			0xAC	// compressed Firmware is ready in ExternalFlash, decompressed by the BootLoader into EmbeddedFlash
+#define FIRMWARE_RECOVERY_FLAG			0xAF	// Firmware to be sent over the Debug_USART(serial recovery of the BootLoader)
+
+/* Largest image: EmbeddedFlash(256KB) - BootLoader(0x0800C800 - 0x08000000) */
+#define FIRMWARE_IMAGE_SIZE_MAX			206848
+#define FIRMWARE_APP_BASE_ADDRESS		0x0800C800
+
+/* Image downloaded(update check answer): the whole Firmware, a delta patch against the running Firmware, the whole Firmware compressed */
+#define FIRMWARE_IMAGE_TYPE_FULL		0
+#define FIRMWARE_IMAGE_TYPE_DELTA		1
+#define FIRMWARE_IMAGE_TYPE_LZ			2
+/* Images accepted(update check): bit set->ImageType the BootLoader can install */
+#define FIRMWARE_IMAGE_ACCEPT_DELTA		0x01
+#define FIRMWARE_IMAGE_ACCEPT_LZ		0x02
+
+/* ExternalFlash area the BootLoader rebuilds the new Firmware in from the delta patch(Sector aligned, beyond the checkpoint) */
+#define FIRMWARE_DELTA_TARGET_ADDRESS	0x50000
+
+/* Delta patch: header, then commands until FIRMWARE_DELTA_CMD_END(sizes and offsets little-endian)
+ *		COPY	: Cmd, SourceOffset(3), Len(2)	-> Len bytes of the running Firmware
+ *		INSERT	: Cmd, Len(2), data(Len)		-> Len bytes of the patch
+ * CRC16: Mid_CRC16_Modbus of the whole image as one run */
+#define FIRMWARE_DELTA_MAGIC_0			0x44	// 'D'
+#define FIRMWARE_DELTA_MAGIC_1			0x50	// 'P'
+#define FIRMWARE_DELTA_CMD_END			0x00
+#define FIRMWARE_DELTA_CMD_COPY			0x01
+#define FIRMWARE_DELTA_CMD_INSERT		0x02
+
+/* Compressed Firmware(LZ4 block format): header, then sequences until the raw size is reached(sizes and offsets little-endian)
+ *		Token(literal length << 4 | match length - FIRMWARE_LZ_MATCH_MIN), literals, Offset(2),
+ *		a length nibble of 15 continued by bytes added until one below 255, the last sequence has literals only
+ * Offset: back from the next byte into the Firmware decompressed so far(1 -> 65535) */
+#define FIRMWARE_LZ_MAGIC_0				0x4C	// 'L'
+#define FIRMWARE_LZ_MAGIC_1				0x5A	// 'Z'
+#define FIRMWARE_LZ_MATCH_MIN			4
+
+/* Boot record in ExternalFlash(Sector beyond the delta target area): Firmware installed in EmbeddedFlash, checked by the BootLoader at every start
+ *		Mark | Size(4) | CRC16(2) | Version(2) | Confirm | Trial(FIRMWARE_TRIAL_BOOT_MAX)
+ * Trial: one byte programmed to 0x00 per start of a Firmware not confirmed, rolled back once all of them are spent */
+#define FIRMWARE_BOOT_RECORD_ADDRESS	0x8F000
+#define FIRMWARE_BOOT_RECORD_MARK		0xA5
+#define FIRMWARE_BOOT_CONFIRMED			0x00	// Confirm programmed by the Firmware once it has run healthy(0xFF->on trial)
+#define FIRMWARE_TRIAL_BOOT_MAX			3
+
+/* Backup of the last Firmware confirmed(rolled back to by the BootLoader): header Sector(boot record Mark -> Version), then the image */
+#define FIRMWARE_BACKUP_ADDRESS			0x90000
+#define FIRMWARE_BACKUP_IMAGE_ADDRESS	(FIRMWARE_BACKUP_ADDRESS + 4096)
+
+/* Effective data per package: server not negotiating the package size, largest size offered in the update check
+ * (the offer is further limited by the transport, MQTTProtocol_NewFirmwareCheck_DataPack) */
+#define FIRMWARE_PACKAGE_SIZE_DEFAULT	100
+#define FIRMWARE_PACKAGE_SIZE_MAX		1024
+#define FIRMWARE_PACKAGE_NUMBER_MAX		((FIRMWARE_IMAGE_SIZE_MAX + FIRMWARE_PACKAGE_SIZE_DEFAULT - 1) / FIRMWARE_PACKAGE_SIZE_DEFAULT)
+
+/* Package requests in flight at a time(1->the next package requested only after the previous one received),
+ * other windows are built by the host benchmark(Tools/HostTest) */
+#ifndef FIRMWARE_DOWNLOAD_WINDOW
+#define FIRMWARE_DOWNLOAD_WINDOW		4
+#endif
+/* Package request resent if not answered within(unit: 10ms), download fails after FIRMWARE_DOWNLOAD_RESEND_MAX resends of a package */
+#define FIRMWARE_DOWNLOAD_TIMEOUT		300
+#define FIRMWARE_DOWNLOAD_RESEND_MAX	20
+/* Bytes read back from Flash at a time, to chain the CRC16 over the packages received ahead of order */
+#define FIRMWARE_READBACK_SIZE			64
+
+/* Download checkpoint in ExternalFlash(Sector beyond the largest image), resumed by Mid_Firmware_StartDownload
+ * after a reboot / failed download of the same image */
+#define FIRMWARE_CHECKPOINT_SECTOR		64
+#define FIRMWARE_CHECKPOINT_ADDRESS		((uint32_t)FIRMWARE_CHECKPOINT_SECTOR * 4096)
+#define FIRMWARE_CHECKPOINT_MARK		0xA5	// checkpoint valid, programmed to 0x00 once the download ended
+/* Running CRC16 records in the checkpoint: one every (PackageNumber / FIRMWARE_CHECKPOINT_RECORD_SUM + 1) packages combined */
+#define FIRMWARE_CHECKPOINT_RECORD_SUM	416
+#define FIRMWARE_CHECKPOINT_RECORD_SIZE	8
 
 /* Flash Address offset of FirmwareInfo define */
 typedef enum
@@ -23,6 +98,60 @@ typedef enum
 	
 }en_FlashAddress_FirmwareInfo_t;
 
+/* Offset of the delta patch header fields(from FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS) */
+typedef enum
+{
+	DELTA_OFFSET_MAGIC 			= 0,	// 2 byte: FIRMWARE_DELTA_MAGIC_0, FIRMWARE_DELTA_MAGIC_1
+	DELTA_OFFSET_SOURCE_SIZE 	= 2,	// 4 byte: size of the running Firmware the patch is made against
+	DELTA_OFFSET_SOURCE_CRC16 	= 6,	// 2 byte
+	DELTA_OFFSET_TARGET_SIZE 	= 8,	// 4 byte: size of the new Firmware
+	DELTA_OFFSET_TARGET_CRC16 	= 12,	// 2 byte
+	DELTA_OFFSET_CMD 			= 14,	// commands
+	
+}en_DeltaPatch_Offset_t;
+
+/* Offset of the compressed Firmware header fields(from FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS) */
+typedef enum
+{
+	LZ_OFFSET_MAGIC 		= 0,	// 2 byte: FIRMWARE_LZ_MAGIC_0, FIRMWARE_LZ_MAGIC_1
+	LZ_OFFSET_RAW_SIZE 		= 2,	// 4 byte: size of the Firmware decompressed
+	LZ_OFFSET_RAW_CRC16 	= 6,	// 2 byte: Mid_CRC16_Modbus of the Firmware decompressed
+	LZ_OFFSET_DATA 			= 8,	// sequences
+	
+}en_LZImage_Offset_t;
+
+/* Offset of the boot record fields(from FIRMWARE_BOOT_RECORD_ADDRESS, backup header from FIRMWARE_BACKUP_ADDRESS) */
+typedef enum
+{
+	BOOT_RECORD_OFFSET_MARK 	= 0,	// FIRMWARE_BOOT_RECORD_MARK
+	BOOT_RECORD_OFFSET_SIZE 	= 1,	// 4 byte: size of the Firmware(little-endian)
+	BOOT_RECORD_OFFSET_CRC16 	= 5,	// 2 byte: Mid_CRC16_Modbus of the Firmware
+	BOOT_RECORD_OFFSET_VERSION 	= 7,	// 2 byte
+	BOOT_RECORD_OFFSET_CONFIRM 	= 9,	// FIRMWARE_BOOT_CONFIRMED / 0xFF(boot record only)
+	BOOT_RECORD_OFFSET_TRIAL 	= 16,	// FIRMWARE_TRIAL_BOOT_MAX byte(boot record only)
+	
+}en_BootRecord_Offset_t;
+
+/* Offset of the download checkpoint fields(from FIRMWARE_CHECKPOINT_ADDRESS) */
+typedef enum
+{
+	CHECKPOINT_OFFSET_MARK 		= 0,	// FIRMWARE_CHECKPOINT_MARK
+	CHECKPOINT_OFFSET_INFO 		= 1,	// 14 byte: NewVersion(2), FirmwareSize(4), PackageNumber(2), CRC16(2), PackageSize(2), NegotiatedFlag(1), ImageType(1)
+	CHECKPOINT_OFFSET_BITMAP 	= 256,	// bit cleared(programmed over 0xFF)->package written to Flash
+	CHECKPOINT_OFFSET_RECORD 	= 768,	// ChainIndex(2), CRC16 state(2), inverted copy(4), FIRMWARE_CHECKPOINT_RECORD_SUM records
+	
+}en_Checkpoint_Offset_t;
+
+/* Offset of the Firmware package fields(Server Response 0x25, from DataID) */
+typedef enum
+{
+	DOWNLOAD_DATA_OFFSET_DATA_ID 		= 0,	//
+	DOWNLOAD_DATA_OFFSET_VERSION 		= 1,	// 2 byte
+	DOWNLOAD_DATA_OFFSET_PACKAGE_INDEX 	= 3,	// 2 byte
+	DOWNLOAD_DATA_OFFSET_DATA_LEN 		= 5,	// 2 byte(package size negotiated) / 1 byte(server not negotiating)
+												// effective data(DataLen) + CRC16(2): CRC16 value of current package
+}en_DownloadData_Offset_t;
+
 /* FirmwareUpdate State define */
 typedef enum
 {
@@ -62,23 +191,34 @@ typedef struct
 	un_FirmwareSize_t 			FirmwareSize;			// size of New Firmware (byte)
 	un_PackageNumber_t 			PackageNumber;			// number of Packages
 	unsigned char 				CRC16[2];				// CRC16 check value of the whole file, grab from Server info
+	unsigned short 				PackageSize;			// effective data per package(all but the last)
+	unsigned char 				NegotiatedFlag;			// 1->PackageSize negotiated(2-byte DataLen), 0->server not negotiating(1-byte DataLen)
+	unsigned char 				ImageType;				// FIRMWARE_IMAGE_TYPE_FULL / FIRMWARE_IMAGE_TYPE_DELTA / FIRMWARE_IMAGE_TYPE_LZ
 	unsigned short 				DownloadPackageNumber;	// number of already downloaded packages
 	unsigned int				DownloadByteNumber;		// number of already downloaded bytes
 	
 }stu_Firmware_t;
 
-/* Firmware Downloading Data structure define */
+/* Package request in flight */
+typedef struct
+{
+	unsigned short 	PackageIndex;		// package requested(0xFFFF->slot free)
+	unsigned int	RequestTick;		// OS tick of the last request
+	unsigned char	ResendCounter;		// resends of this package
+	
+}stu_DownloadSlot_t;
+
+/* Firmware download statistics */
 typedef struct
 {
-	unsigned char 	DataID;
-//	unsigned char	UpType;
-	un_Verion_t 	DownloadVersion;	// FirmwareVersion downloading
-//	unsigned char 	State;
-	unsigned char 	PackageIndex[2];	// index of Package(0->PackageNumber-1)
-	unsigned char 	DataLen;			// effective data length
-	unsigned char 	DataBuff[102];		// effective data(100) + CRC16(2): CRC16 value of current package
+	unsigned int 	RequestNumber;		// packages requested(first request)
+	unsigned int 	ResendNumber;		// requests resent after FIRMWARE_DOWNLOAD_TIMEOUT
+	unsigned int 	OutOfOrderNumber;	// packages received ahead of a missing one
+	unsigned int 	DuplicateNumber;	// packages received again(answer of a resent request)
+	unsigned int 	RejectNumber;		// packages dropped: CRC16 / length check fail
+	unsigned int 	ResumeNumber;		// packages taken from the checkpoint(not downloaded again)
 	
-}stu_DownloadData_t;
+}stu_Firmware_DownloadStat_t;
 
 
 extern stu_Firmware_t stu_Firmware;
@@ -92,9 +232,11 @@ void 	 Mid_Firmware_SetCurrentVersion(uint8_t ByteIndex, uint8_t Value);
 uint8_t  Mid_Firmware_GetUpdateState(void);
 void 	 Mid_Firmware_SetUpdateState(en_FirmwareUpdateState_t State);
 
-void 	 Mid_Firmware_StartDownload(void);
-uint8_t  Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pData);
+void 	 Mid_Firmware_StartDownload(void (*pFlashWriteStart)(uint32_t Addr, uint32_t Size, uint32_t WrittenAddr), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashEraseSector)(uint32_t SectorNo));
+uint8_t  Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pData);
 uint16_t Mid_Firmware_DownloadProgress_Pro(uint8_t CommType, void (*pGetNewFirmware_DataPack)(uint8_t CommType, uint16_t PackageIdnex, uint8_t *pVersion));
+void 	 Mid_Firmware_GetDownloadStat(stu_Firmware_DownloadStat_t *pStat);
+uint8_t  Mid_Firmware_BootConfirm(void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pVersion);
 
 
 #endif
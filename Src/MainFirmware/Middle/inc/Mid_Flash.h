@@ -11,6 +11,8 @@
 #define DUMMY						      0xFF       // Dummy value
 #define FLASH_SECTOR_SIZE			4096       // 4*1024 byte per Sector
 #define FLASH_PAGE_SIZE				256	       // 256 byte per Page
+#define FLASH_BLOCK_SIZE_32KB		32768      // 32 KB half Block
+#define FLASH_BLOCK_SIZE_64KB		65536      // 64 KB Block
 
 /* Instructions of W25Q64-Standard SPI Instruction */
 #define	WRITE_ENABLE				      0x06
@@ -57,6 +59,17 @@
 #define ENABLE_RESET				      0x66
 #define RESET_DEVICE				      0x99
 
+/* Flash statistics */
+typedef struct
+{
+	uint32_t SectorEraseNumber;		// 4 KB Sector erases
+	uint32_t Block32EraseNumber;	// 32 KB Block erases
+	uint32_t Block64EraseNumber;	// 64 KB Block erases
+	uint32_t PageProgramNumber;		// Page programs
+	uint32_t ProgramByteNumber;		// bytes programmed
+	
+}stu_Flash_Stat_t;
+
 
 void Mid_Flash_Init(void);
 
@@ -69,4 +82,9 @@ void Mid_Flash_EraseSector(uint32_t Addr);
 void Mid_Flash_ReadData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
 void Mid_Flash_WriteData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
 
+void Mid_Flash_ImageWriteStart(uint32_t Addr, uint32_t Size, uint32_t WrittenAddr);
+void Mid_Flash_ImageWrite(uint8_t *pBuffer, uint32_t Addr, uint16_t Num);
+
+void Mid_Flash_GetStat(stu_Flash_Stat_t *pStat);
+
 #endif
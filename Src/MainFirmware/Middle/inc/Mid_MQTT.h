@@ -13,6 +13,9 @@
 #define MQTT_SERVER_PORT_SIZE 	10
 #define MQTT_TOPIC_SIZE         40
 
+/* Topic route slots(power of 2, more than the topics subscribed keeps the probing short) */
+#define MQTT_ROUTE_SLOT_SUM		8
+
 
 typedef struct
 {
@@ -47,9 +50,36 @@ typedef struct
 
 extern stu_MQTT_Device_t  stu_MQTT_ESP8266;
 
+/* Handler of the messages received on a topic: pData->message data(not terminated), Len->data length */
+typedef void (*MQTT_TopicHandler_t)(uint8_t *pData, uint16_t Len);
+
+/* Topic route */
+typedef struct
+{
+	uint32_t Hash;						// hash of the topic
+	uint8_t *pTopic;					// subscribed topic
+	uint8_t TopicLen;					// length of the topic(up to MQTT_TOPIC_SIZE)
+	MQTT_TopicHandler_t pHandler;		// 0->free slot
+	
+}stu_MQTT_Route_t;
+
+/* Topic route statistics */
+typedef struct
+{
+	uint32_t RouteNumber;		// topics routed
+	uint32_t MessageNumber;		// messages routed to a handler
+	uint32_t MissNumber;		// messages on a topic not routed(dropped)
+	uint32_t CollisionNumber;	// hash hits on another topic
+	
+}stu_MQTT_RouteStat_t;
+
 void Mid_MQTT_Init(void);
 void Mid_MQTT_SetFirmwareUpdateFlag(en_MQTT_FirmwareUpdateFlag_t Flag);
 uint8_t Mid_MQTT_GetFirmwareUpdateFlag(void);
-void Mid_MQTT_SystemTimeProcess(uint8_t *pData, uint8_t *pDateTime);
+void Mid_MQTT_SystemTimeProcess(uint8_t *pData);
+
+uint8_t Mid_MQTT_TopicRegister(uint8_t *pTopic, MQTT_TopicHandler_t pHandler);
+uint8_t Mid_MQTT_TopicRoute(uint8_t *pTopic, uint8_t TopicLen, uint8_t *pData, uint16_t Len);
+void Mid_MQTT_GetRouteStat(stu_MQTT_RouteStat_t *pStat);
 
 #endif
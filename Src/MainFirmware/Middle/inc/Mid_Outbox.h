@@ -0,0 +1,90 @@
+#ifndef __MID_OUTBOX_H_
+#define __MID_OUTBOX_H_
+
+/** Outbox area in W25Q64:
+  *		Sector 1792 -> 1823(0x700000 -> 0x71FFFF), 128 KB, out of the Firmware download area
+  *		32 byte per record, 128 records per sector
+  */
+#define OUTBOX_SECTOR_BASE			1792
+#define OUTBOX_SECTOR_SUM			32
+#define OUTBOX_RECORD_SIZE			32
+#define OUTBOX_RECORD_PER_SECTOR	(FLASH_SECTOR_SIZE / OUTBOX_RECORD_SIZE)
+#define OUTBOX_RECORD_SUM			(OUTBOX_SECTOR_SUM * OUTBOX_RECORD_PER_SECTOR)
+
+/* SystemTime bytes kept per record("YYYY-MM-DD-HH:MM") */
+#define OUTBOX_TIME_SIZE			16
+/* Bytes of the record covered by the CRC16(Seq -> Time) */
+#define OUTBOX_RECORD_CRC_SIZE		(8 + OUTBOX_TIME_SIZE)
+
+/* Records claimed by a live upload lane at most(the replay does not read past a claimed record) */
+#define OUTBOX_CLAIM_SUM			4
+
+/** Record layout in flash:
+  *	---------------------------------------------------------------------------------------------
+  *	|	Seq		|	Event	|	Data	|	QueueInTick	|	Time	|	Reserved	|	Delivered	|	CRC16	|	Ack		|
+  *	-----------------------------------------------------------------------------------------------------------
+  *		4 byte		1 byte		1 byte		2 byte			16 byte		4 byte(0xFF)	1 byte			2 byte		1 byte
+  *
+  *	-> Seq		: sequence number of the record, 0xFFFFFFFF->free slot
+  *	-> Delivered: 0xFF->not uploaded yet, 0x00->accepted by the server through a live lane(skipped by the replay)
+  *	-> CRC16	: CRC16(Modbus) of Seq -> Time
+  *	-> Ack		: 0xFF->pending, 0x00->accepted by the server(programmed in place, no erase needed)
+  */
+typedef enum
+{
+	OUTBOX_RECORD_OFFSET_SEQ 	= 0,
+	OUTBOX_RECORD_OFFSET_EVENT 	= 4,
+	OUTBOX_RECORD_OFFSET_DATA 	= 5,
+	OUTBOX_RECORD_OFFSET_TICK 	= 6,
+	OUTBOX_RECORD_OFFSET_TIME 	= 8,
+	OUTBOX_RECORD_OFFSET_DELIVERED = 28,
+	OUTBOX_RECORD_OFFSET_CRC16 	= 29,
+	OUTBOX_RECORD_OFFSET_ACK 	= 31,
+	
+}en_Outbox_RecordOffset_t;
+
+/* Outbox record */
+typedef struct
+{
+	uint32_t Seq;
+	uint8_t  Event;
+	uint8_t  Data;
+	uint16_t QueueInTick;					// OS tick(low 16 bit) when the event was raised
+	uint8_t  Time[OUTBOX_TIME_SIZE];		// SystemTime when the event was raised
+	
+}stu_Outbox_Record_t;
+
+/* Outbox statistics */
+typedef struct
+{
+	uint32_t PendingNumber;		// records not accepted by the server yet
+	uint32_t AppendNumber;		// records appended
+	uint32_t ReadNumber;		// records read out for upload(replays included)
+	uint32_t AckNumber;			// records accepted by the server
+	uint32_t RewindNumber;		// in-flight records given back for replay(publish failed / link dropped)
+	uint32_t DropNumber;		// pending records overwritten because the outbox was full
+	uint32_t CorruptNumber;		// records skipped by CRC16 error
+	uint32_t ClaimNumber;		// records claimed by a live upload lane
+	uint32_t DeliverNumber;		// claimed records accepted by the server(skipped by the replay)
+	uint32_t EraseNumber;		// sector erases since power on
+	uint16_t AppendTimeMax;		// longest append, sector erase included(unit: 10ms)
+	
+}stu_Outbox_Stat_t;
+
+
+void 	 Mid_Outbox_Init(void);
+void 	 Mid_Outbox_Pro(void);
+
+uint8_t  Mid_Outbox_Append(uint8_t Event, uint8_t Data, uint16_t QueueInTick, uint8_t *pTime, uint16_t *pSlot);
+uint8_t  Mid_Outbox_Read(stu_Outbox_Record_t *pRecord);
+uint8_t  Mid_Outbox_Claim(uint16_t Slot);
+void 	 Mid_Outbox_Release(uint8_t Number, uint8_t Delivered);
+uint16_t Mid_Outbox_GetReadMark(void);
+void 	 Mid_Outbox_Ack(uint16_t Mark);
+void 	 Mid_Outbox_Rewind(void);
+
+uint32_t Mid_Outbox_GetPendingNumber(void);
+uint8_t  Mid_Outbox_GetUnreadState(void);
+void 	 Mid_Outbox_GetStat(stu_Outbox_Stat_t *pStat);
+
+#endif
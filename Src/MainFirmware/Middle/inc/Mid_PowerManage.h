@@ -4,5 +4,8 @@
 void Mid_PowerManage_Init(void);
 void Mid_PowerManage_Pro(void);
 
+uint8_t Mid_PowerManage_GetACState(void);
+uint8_t Mid_PowerManage_GetBatteryLow(void);
+
 
 #endif
@@ -13,20 +13,52 @@
   * Uncomment this macro to enable <Debug Mode> of Mid_WiFi_TxDataHandler 				*/ 
 //#define	WIFI_TX_DEBUG_MODE
 
+/** Comment this macro to enable <Working Mode> of WiFi_USART(USART3)
+  * Uncomment this macro to replace the ESP8266 module and the MQTT server with Mid_WiFiSim 	*/ 
+//#define	WIFI_SIMULATOR_MODE
 
-/* Tx_Queue Number */
-#define WIFI_TX_QUEUE_SUM		10	
-/* Tx_Buffer Size */
-#define WIFI_TX_BUFFER_SIZE		200	
 
-/* Rx_Buffer Size */
-#define WIFI_RX_BUFFER_SIZE		800	
+/* Tx_Ring Size(packed AT-command ring, 2-byte Length header + command bytes per entry) */
+#define WIFI_TX_RING_SIZE		1024
+/* Tx_Command maximum size(single AT-command, Length header excluded) */
+#define WIFI_TX_CMD_SIZE_MAX	(WIFI_TX_RING_SIZE - 2)
+
+/* Maximum time waiting for "OK"/"ERROR" of an AT-command sent out(unit: 10ms) */
+#define WIFI_TX_WAIT_TIME_MAX	1000
+
+/* MQTT ReceiveData Size(hex string of a message received, Firmware package of 1024 byte,
+ * the MQTT buffer of the module firmware must hold it) */
+#define WIFI_MQTT_RECV_DATA_SIZE	2080
+
+/* Rx_Buffer Size(+MQTTSUBRECV:0,<"topic">,<length>, + ReceiveData + "\r\n") */
+#define WIFI_RX_BUFFER_SIZE		(WIFI_MQTT_RECV_DATA_SIZE + 80)
+
+/* Reconnect backoff: delay of the first retry, maximum delay(unit: 10ms, jitter +0~50% added) */
+#define WIFI_RECONNECT_BACKOFF_BASE		200
+#define WIFI_RECONNECT_BACKOFF_MAX		6000
+/* Reconnect attempts: AP-link polls before resetting the module, MQTT connects before dropping the cached MQTT config */
+#define WIFI_RECONNECT_AP_ATTEMPT_MAX	10
+#define WIFI_RECONNECT_MQTT_ATTEMPT_MAX	3
+/* Jitter seed: 96-bit unique device ID of the MCU(3 words), devices behind the same AP start apart */
+#define WIFI_RECONNECT_SEED_ADDRESS		0x1FFFF7E8
 
 /* SSID Length */
 #define WIFI_SSID_LENGTH_MAX	20
 
-/* MQTT TxData Size */
-#define WIFI_MQTT_TX_DATA_SIZE	(WIFI_TX_BUFFER_SIZE - 2)
+/* Link quality: RSSI samples kept, sampling period, link telemetry period(unit: 10ms) */
+#define WIFI_RSSI_SAMPLE_SUM		16
+#define WIFI_RSSI_SAMPLE_PERIOD		1000
+#define WIFI_LINK_TELEMETRY_PERIOD	30000
+
+/* AP scan cache: APs kept, cache valid time(unit: 10ms) */
+#define WIFI_SCAN_AP_SUM			8
+#define WIFI_SCAN_CACHE_TIME		3000
+
+/* MQTT TxData Size(AT-command parameters of MQTT config/connect/subscribe) */
+#define WIFI_MQTT_TX_DATA_SIZE	198
+
+/* MQTT PublishData Size(AT-command parameters of MQTT publish: <"topic">,<"hex data">,<qos>,<retain>) */
+#define WIFI_MQTT_PUB_DATA_SIZE	600
 
 /* ESP8266 AT-Command */
 typedef enum
@@ -50,6 +82,9 @@ typedef enum
 	ESP8266_AT_MQTTSUBDATETIME,	// "AT+MQTTSUB=0,\"" 
 	ESP8266_AT_MQTTCLEAN,				// "AT+MQTTCLEAN=0" 
  	
+	ESP8266_AT_CWJAPQUERY,			// "AT+CWJAP?"
+	ESP8266_AT_CWLAPALL,				// "AT+CWLAP"
+	
 	ESP8266_AT_SUM
 }en_ESP8266_AT_t;
 
@@ -70,8 +105,7 @@ typedef enum
 	ESP8266_AT_RESPONSE_MQTTDISCONN,
 	ESP8266_AT_RESPONSE_MQTTSUB_MESSAGEDOWN_SUCCESS,
 	ESP8266_AT_RESPONSE_MQTTSUB_SYSTIME_SUCCESS,
-	ESP8266_AT_RESPONSE_MQTTRECV_DOWN,
-	ESP8266_AT_RESPONSE_MQTTRECV_SYSTIME,
+	ESP8266_AT_RESPONSE_MQTTSUBRECV,				// message of a subscribed topic, dispatched by the topic route(Mid_MQTT_TopicRoute)
 	
 	ESP8266_AT_RESPONSE_OK,
 	ESP8266_AT_RESPONSE_ERROR,
@@ -126,7 +160,7 @@ typedef enum
 	MQTT_STA_CONNECT,							// connect MQTT server
 	MQTT_STA_SUB,									// subscribe topic
 	MQTT_STA_SUB_DATETIME,				// subscribe $SYS/brokers/.../datetime topic
-	MQTT_STA_SUB_FIRMWARE_UPDATE,
+	MQTT_STA_SUB_FIRMWARE_UPDATE,		// subscribe <UID>_FirmwareDown topic
 	MQTT_STA_READY,								// MQTT ready
 	MQTT_STA_PUB,									// publish message
 	MQTT_STA_RECV_SYSTIME,				// receive Systemtime from server
@@ -135,13 +169,90 @@ typedef enum
 }en_MQTT_State_t;
 
 
+/* WiFi reconnect layer */
+typedef enum
+{
+	WIFI_RECONNECT_LAYER_AP,			// WiFi-Module <-> Access_Point
+	WIFI_RECONNECT_LAYER_MQTT,			// WiFi-Module <-> MQTT broker
+	
+	WIFI_RECONNECT_LAYER_SUM,
+}en_WiFi_ReconnectLayer_t;
+
+/* WiFi reconnect statistics(per layer) */
+typedef struct
+{
+	uint8_t  LinkDown;			// 1->link dropped, reconnecting
+	uint16_t AttemptNumber;		// attempts of the current/last reconnection
+	uint32_t AttemptTotal;		// attempts of all reconnections
+	uint32_t DropNumber;		// link drops detected
+	uint32_t DropTick;			// OS tick when the link dropped
+	uint32_t LastTime;			// duration of the last reconnection(unit: 10ms)
+	uint32_t MaxTime;			// longest reconnection(unit: 10ms)
+	
+}stu_WiFi_ReconnectStat_t;
+
+/* RSSI sample */
+typedef struct
+{
+	uint32_t Tick;				// OS tick when sampled
+	int8_t	 RSSI;				// dBm
+	
+}stu_WiFi_RSSISample_t;
+
+/* Link quality over the RSSI samples kept */
+typedef struct
+{
+	uint8_t  SampleNumber;		// 0->no sample yet
+	int8_t   Last;				// latest RSSI(dBm)
+	int8_t   Min;
+	int8_t   Mean;
+	int8_t   Max;
+	uint8_t  Channel;			// channel of the connected AP
+	
+}stu_WiFi_LinkQuality_t;
+
+/* AP info of the cached scan */
+typedef struct
+{
+	uint8_t  SSID[WIFI_SSID_LENGTH_MAX];
+	int8_t   RSSI;				// dBm
+	uint8_t  Ecn;				// encryption: 0->open, 1->WEP, 2->WPA_PSK, 3->WPA2_PSK, 4->WPA_WPA2_PSK ...
+	uint8_t  Channel;
+	
+}stu_WiFi_APInfo_t;
+
+/* MQTT publish result(reported by the MQTT publish call-back function) */
+typedef enum
+{
+	WIFI_MQTT_PUB_OK = 0,			// "OK" of AT+MQTTPUB received, accepted by the broker
+	WIFI_MQTT_PUB_FAIL,				// "ERROR" of AT+MQTTPUB received
+	WIFI_MQTT_PUB_LOST,				// link dropped / Tx_Ring emptied, results of all the unanswered publishes are lost
+	
+}en_WiFi_MQTTPubResult_t;
+
+/* MQTT publish result call-back function typedef */
+typedef void (*WiFi_MQTTPubCBF_t)(uint8_t Result);
+
+/* WiFi Tx_Ring statistics */
+typedef struct
+{
+	uint16_t UsedBytes;			// bytes currently queued(Length headers included)
+	uint16_t PeakBytes;			// high-water mark of UsedBytes
+	uint16_t CmdNumber;			// AT-commands currently queued
+	uint32_t OverflowNumber;	// AT-commands rejected because the ring was full
+	
+}stu_WiFi_TxRingStat_t;
+
+
 extern uint8_t SystemTime[17];
 
 
 void Mid_WiFi_Init(void);
 void Mid_WiFi_Pro(void);
 
-void 	Mid_WiFi_ATcmdQueueIn(en_ESP8266_AT_t ATcmd, uint8_t *pPara);
+uint8_t Mid_WiFi_ATcmdQueueIn(en_ESP8266_AT_t ATcmd, uint8_t *pPara);
+void 	Mid_WiFi_GetTxRingStat(stu_WiFi_TxRingStat_t *pStat);
+void 	Mid_WiFi_GetReconnectStat(en_WiFi_ReconnectLayer_t Layer, stu_WiFi_ReconnectStat_t *pStat);
 
 uint8_t Mid_WiFi_GetModuleWorkState(void);
 void 	Mid_WiFi_ChangeModuleWorkState(en_ESP8266_State_t State);
@@ -149,8 +260,16 @@ void 	Mid_WiFi_ChangeModuleWorkState(en_ESP8266_State_t State);
 uint8_t Mid_WiFi_GetMQTTState(void);
 void 	Mid_WiFi_ChangeMQTTState(en_MQTT_State_t State);
 
-void 	Mid_WiFi_MQTT_PublishMessage(uint8_t *pData);
+uint8_t Mid_WiFi_MQTT_PublishMessage(uint8_t *pData, uint8_t Retain);
+uint8_t Mid_WiFi_MQTT_PublishReady(void);
+void 	Mid_WiFi_MQTT_PublishCBFRegister(WiFi_MQTTPubCBF_t pCBF);
 
 uint8_t Mid_WiFi_GetSignalLevel(void);
+void 	Mid_WiFi_GetLinkQuality(stu_WiFi_LinkQuality_t *pQuality);
+uint8_t Mid_WiFi_GetRSSIHistory(stu_WiFi_RSSISample_t *pSample, uint8_t Number);
+
+uint8_t Mid_WiFi_ScanRequest(void);
+uint8_t Mid_WiFi_GetScanAPNumber(void);
+uint8_t Mid_WiFi_GetScanAP(uint8_t Index, stu_WiFi_APInfo_t *pAP);
 
 #endif
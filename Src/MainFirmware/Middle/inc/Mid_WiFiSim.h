@@ -0,0 +1,109 @@
+#ifndef __MID_WIFISIM_H_
+#define __MID_WIFISIM_H_
+
+/* Simulated module timing: AT-command answer, AP joined after reset/SmartConfig/drop, broker answer(unit: 10ms) */
+#define WIFISIM_ANSWER_DELAY		2
+#define WIFISIM_AP_JOIN_DELAY		300
+#define WIFISIM_BROKER_DELAY		10
+
+/* Simulated module buffers: AT-command line received, answer line, answers waiting to be sent to Mid_WiFi */
+#define WIFISIM_LINE_SIZE			(WIFI_MQTT_PUB_DATA_SIZE + 32)
+#define WIFISIM_ANSWER_SIZE			WIFI_RX_BUFFER_SIZE
+#define WIFISIM_ANSWER_RING_SIZE	6144
+
+/* Simulated WiFi_USART(USART3): 115200bps, 10 bit per byte(unit: byte per 10ms) */
+#define WIFISIM_UART_BYTE_PER_TICK	115
+
+/* Simulated server: OTA image offered to the update check(0->no update),
+ * effective data per firmware package: largest size offered, size for the update check not negotiating;
+ * other images / sizes are built by the host benchmark(Tools/HostTest) */
+#ifndef WIFISIM_OTA_IMAGE_SIZE
+#define WIFISIM_OTA_IMAGE_SIZE			16000
+#endif
+#ifndef WIFISIM_OTA_PACKAGE_SIZE
+#define WIFISIM_OTA_PACKAGE_SIZE		1024
+#endif
+#define WIFISIM_OTA_PACKAGE_SIZE_LEGACY	100
+#define WIFISIM_OTA_PACKAGE_NUMBER_MAX	((WIFISIM_OTA_IMAGE_SIZE + WIFISIM_OTA_PACKAGE_SIZE_LEGACY - 1) / WIFISIM_OTA_PACKAGE_SIZE_LEGACY)
+
+/* Simulated link of the firmware packages: latency added to the broker delay(unit: 10ms), package answers lost(unit: %),
+ * answers on the link at a time(beyond: lost); other links as above */
+#ifndef WIFISIM_OTA_LATENCY
+#define WIFISIM_OTA_LATENCY			50
+#endif
+#ifndef WIFISIM_OTA_LOSS
+#define WIFISIM_OTA_LOSS			5
+#endif
+#define WIFISIM_OTA_FLIGHT_SUM		16
+
+/* Simulated broker datetime published to the new subscriber of the datetime topic */
+#define WIFISIM_DATETIME			"2025-07-21T15:10:00.000000000-04:00"
+
+/* Simulated OTA image content */
+#define WIFISIM_OTA_PATTERN(x)		((uint8_t)((x) * 13 + 0x5A))
+
+/* Fault injected by the script */
+typedef enum
+{
+	WIFISIM_FAULT_NONE = 0,
+	WIFISIM_FAULT_ERROR,			// next AT-command answered "ERROR"
+	WIFISIM_FAULT_SILENT,			// next AT-command not answered
+	WIFISIM_FAULT_AP_DROP,			// "WIFI DISCONNECT", AP joined again after WIFISIM_AP_JOIN_DELAY
+	WIFISIM_FAULT_MQTT_DROP,		// "+MQTTDISCONNECTED:0"
+	
+	WIFISIM_FAULT_SUM,
+}en_WiFiSim_Fault_t;
+
+/* Script step: fault injected Delay after the previous step(unit: 10ms), the script restarts after the last step */
+typedef struct
+{
+	uint16_t Delay;
+	en_WiFiSim_Fault_t Fault;
+	
+}stu_WiFiSim_Step_t;
+
+/* Firmware package answer on the simulated link */
+typedef struct
+{
+	uint32_t DueTick;			// OS tick the answer leaves the link
+	uint16_t PackageIndex;		// 0xFFFF->slot free
+	uint8_t  RequestHead[3];	// FrameID, Version(2) of the request
+	
+}stu_WiFiSim_Flight_t;
+
+/* Simulated module statistics */
+typedef struct
+{
+	uint32_t CmdNumber;			// AT-commands received
+	uint32_t ErrorNumber;		// AT-commands answered "ERROR"(rejected / injected)
+	uint32_t SilentNumber;		// AT-commands left unanswered by the script
+	uint32_t DropNumber;		// AP / MQTT drops injected by the script
+	uint32_t OverflowNumber;	// answers dropped because the answer ring was full
+	
+	uint32_t PubNumber;			// AT+MQTTPUB accepted
+	uint32_t PubByteNumber;		// dataframe bytes published(publish rate = PubNumber * 100 / elapsed ticks)
+	uint32_t RecvNumber;		// +MQTTSUBRECV sent to Mid_WiFi
+	uint32_t CWStateNumber;		// AT+CWSTATE? answered(AP-link polls)
+	
+	uint32_t ResetTick;			// OS tick of the last AT+RST / simulator start
+	uint32_t BringUpTime;		// reset -> both topics subscribed(unit: 10ms, 0->not up yet)
+	
+	uint16_t OTAPackageNumber;	// firmware packages served(resent packages included)
+	uint16_t OTALossNumber;		// firmware package answers lost on the link
+	uint32_t OTAStartTick;		// OS tick of the request of package 0
+	uint32_t OTATime;			// package 0 request -> every package served once(unit: 10ms, 0->not complete yet)
+	
+}stu_WiFiSim_Stat_t;
+
+typedef void (*WiFiSim_RxCBF_t)(uint8_t Data);
+
+
+void Mid_WiFiSim_Init(WiFiSim_RxCBF_t pCBF);
+void Mid_WiFiSim_Pro(void);
+
+void Mid_WiFiSim_DataIn(uint8_t *pData, uint16_t Len);
+void Mid_WiFiSim_DownlinkIn(uint8_t *pData, uint16_t Len);
+void Mid_WiFiSim_ScriptHold(uint8_t Hold);
+void Mid_WiFiSim_GetStat(stu_WiFiSim_Stat_t *pStat);
+
+#endif
@@ -6,6 +6,10 @@
 
 unsigned int LeapYear(unsigned int year);
 void TimeStamp_DateTime_Conversion(unsigned long TimeStamp, unsigned char *pDateTime);
+void TimeStamp_DateTime_Update(unsigned long TimeStamp, unsigned long LastTimeStamp, unsigned char *pDateTime);
+void TimeStamp_Days_ToCivil(unsigned long Days, unsigned int *pYear, unsigned int *pMonth, unsigned int *pDay);
+unsigned long TimeStamp_DateTime_ToTimeStamp(unsigned char *pDateTime);
+unsigned long TimeStamp_Local_ToTimeStamp(unsigned int year, unsigned int month, unsigned int day, unsigned int hour, unsigned int minute, unsigned int second);
 
 
 #endif
@@ -12,6 +12,7 @@
 
 /*-------------Module Variables Declaration---------*/
 volatile OS_TaskTypeDef OS_Task[OS_TASK_SUM];
+volatile unsigned long OS_TickCount;	// Systick counter since power-on(unit: 10ms)
 
 
 /*-----Module Call-Back function pointer Declaration----*/
@@ -76,6 +77,9 @@ void OS_CreatTask(unsigned char ID, void (*proc)(void), unsigned short Period, O
 void OS_ClockInterruptHandle(void)
 {
 	unsigned char i;
+	
+	OS_TickCount++;
+	
 	for(i=0; i<OS_TASK_SUM; i++)	
 	{
 		if(OS_Task[i].task)	
@@ -92,6 +96,16 @@ void OS_ClockInterruptHandle(void)
 	
 }
 
+/********************************************************************************************************
+	@Name		: OS_GetTickCount						                                                           
+	@Function	: Get the number of Systick Interrupts since power-on(unit: 10ms, wrap-around after 2^32)
+	@Retval		: Systick counter
+********************************************************************************************************/
+unsigned long OS_GetTickCount(void)
+{
+	return OS_TickCount;
+}
+
 /*******************************************************************************
 	@Name		: OS_Start
 	@Function	: Start task
@@ -101,6 +101,7 @@ typedef struct
 /*******************************************************************************/
 void OS_CPUInterruptCBSRegister(CPUInterrupt_CallBack_t pCPUInterruptCtrlCBS);
 void OS_ClockInterruptHandle(void);
+unsigned long OS_GetTickCount(void);
 void OS_TaskInit(void);
 void OS_CreatTask(unsigned char ID, void (*proc)(void), unsigned short Period, OS_TaskStatusTypeDef flag);
 void OS_Start(void);
@@ -14,6 +14,7 @@
 #include "mid_task.h"
 #include "app.h"
 #include "device.h"
+#include "mqtt_protocol.h"
 
 int main(void)
 {
@@ -43,6 +44,8 @@ int main(void)
 	OS_CreatTask(OS_TASK2, Mid_Task_Pro, 1, OS_RUN);	// Middle layer operation
 	
 	OS_CreatTask(OS_TASK3, App_Pro, 1, OS_RUN);			// Application operation
+	
+	OS_CreatTask(OS_TASK4, MQTTProtocol_Downlink_Pro, 1, OS_RUN);	// MQTT server dataframe dispatch
 
 	/* ----------Start Scheduler------------- */
 	OS_Start();
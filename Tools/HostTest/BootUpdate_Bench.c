@@ -0,0 +1,904 @@
+/****************************************************
+  * @Name	BootUpdate_Bench.c
+  * @Brief	Host benchmark of the BootLoader update: APP/App.c + Middle/Mid_EmbeddedFlash.c + Mid_Flash.c
+  *			on the file-backed W25Q64(W25Q64_Emu.c) and an EmbeddedFlash mapped at EMBEDDED_FLASH_Address_Base
+  * @Instruction:
+  *			The BootLoader sources are linked as they are, the Hal functions they call are stubbed here:
+  *			- EmbeddedFlash	: 256 KB at 0x08000000, page erase BENCH_PAGE_ERASE_TIME, halfword BENCH_HALFWORD_TIME,
+  *							  a halfword programmed over one not erased is counted as a fault
+  *			- SPI2 DMA		: Hal_DMA_SPI2Rx_* clocks the bytes through the emulator, the CPU not held until
+  *							  Hal_DMA_SPI2Rx_IsComplete waits for them
+  *			- TFTLCD		: BENCH_LCD_STRING_TIME per string shown
+  *			- OS			: App_Pro polled at once when woken(OS_TaskGetUp), at the next 10ms tick otherwise
+  *			Runs(running Firmware of FIRMWARE_IMAGE_SIZE_MAX in EmbeddedFlash, no boot record: backup taken first):
+  *			1. former	: each 256 byte read programmed by Mid_EmbeddedFlash_WriteHalfWord(page read / erased / rewritten)
+  *			2. new		: new Firmware(FIRMWARE_NEW_VERSION_FLAG) installed by App_Init / App_Pro
+  *			3. same		: the Firmware in EmbeddedFlash installed again
+  *			4. lz		: the new Firmware compressed(FIRMWARE_NEW_LZ_FLAG, LZ4 block format of App.h)
+  *			5. delta	: patch(FIRMWARE_NEW_DELTA_FLAG, COPY / INSERT of App.h) of the new Firmware against a former version
+  *						  running in EmbeddedFlash(code added / removed / changed), rebuilt by App_DeltaApply and installed
+  *			6. corrupt	: the patch of 5 with one byte of the inserted data flipped
+  *			7. source	: the patch of 5 on the running Firmware of 1 -> 4(not the version it was made against)
+  *			-------------------------------------------------------------------
+  *			Time is the SPI2 bus + chip busy time of the emulator and the EmbeddedFlash / LCD time above.
+  *			The EmbeddedFlash is compared with the new Firmware(5: CRC16 of the patch header too), the BootLoader area
+  *			checked untouched; 6 / 7 must be rejected: the Firmware running left as it is and started.
+  *			Exit code 1 on any check failing
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include "stm32f10x.h"
+#include "app.h"
+#include "hal_dma.h"
+#include "hal_embeddedflash.h"
+#include "hal_jumptoapp.h"
+#include "hal_key.h"
+#include "hal_spi.h"
+#include "hal_timer.h"
+#include "hal_usart.h"
+#include "mid_flash.h"
+#include "mid_embeddedflash.h"
+#include "mid_tftlcd.h"
+#include "crc16.h"
+#include "os_system.h"
+#include "W25Q64_Emu.h"
+
+#define BENCH_FILE					"Build/W25Q64_BootUpdate_Bench.bin"
+
+/* EmbeddedFlash timings(us): page erase, halfword program(datasheet typical values) */
+#define BENCH_PAGE_ERASE_TIME		20000.0
+#define BENCH_HALFWORD_TIME			52.5
+/* TFTLCD string of the progress(us) */
+#define BENCH_LCD_STRING_TIME		3000.0
+
+/* new Firmware size, polls of App_Pro at most */
+#define BENCH_IMAGE_SIZE			87831
+#define BENCH_POLL_MAX				1000000
+
+/* compressor: hash table of the 4 byte sequences */
+#define BENCH_LZ_HASH_BITS			12
+
+/* patch builder: hash table of the BENCH_DELTA_MATCH_MIN byte sequences of the former version, shortest COPY */
+#define BENCH_DELTA_HASH_BITS		16
+#define BENCH_DELTA_MATCH_MIN		16
+
+/* former version of the new Firmware: code added / removed(offset, size), halfwords changed, table rewritten(offset, size) */
+#define BENCH_DELTA_ADD_OFFSET		30000
+#define BENCH_DELTA_ADD_SIZE		700
+#define BENCH_DELTA_REMOVE_OFFSET	60000
+#define BENCH_DELTA_REMOVE_SIZE		300
+#define BENCH_DELTA_CHANGE_NUMBER	40
+#define BENCH_DELTA_TABLE_OFFSET	80000
+#define BENCH_DELTA_TABLE_SIZE		2048
+#define BENCH_PREVIOUS_SIZE			(BENCH_IMAGE_SIZE - BENCH_DELTA_ADD_SIZE + BENCH_DELTA_REMOVE_SIZE)
+
+/*-------------Internal Functions Declaration------*/
+static double 	Bench_Time(void);
+static void 	Bench_ImageMake(uint8_t *pImage, uint32_t Size, uint32_t Seed);
+static uint32_t Bench_LZCompress(const uint8_t *pIn, uint32_t Len, uint8_t *pOut);
+static uint8_t 	*Bench_LZLength(uint8_t *pOut, uint32_t Len);
+static void 	Bench_PreviousMake(void);
+static uint32_t Bench_DeltaMake(const uint8_t *pSource, uint32_t SourceSize, const uint8_t *pTarget, uint32_t TargetSize, uint8_t *pOut);
+static uint8_t 	*Bench_DeltaInsert(uint8_t *pOut, const uint8_t *pData, uint32_t Len);
+static void 	Bench_Prepare(uint8_t Flag, const uint8_t *pFile, uint32_t FileSize);
+static void 	Bench_Former(void);
+static void 	Bench_Install(void);
+static void 	Bench_Report(const char *pName);
+static void 	Bench_Reject(const char *pName, const uint8_t *pRunning, uint32_t Size);
+static void 	Bench_Check(const char *pName, uint8_t Result);
+
+
+/*-------------Module Variables Declaration--------*/
+uint8_t  *pBench_EmbeddedFlash;
+uint8_t  Bench_Running[FIRMWARE_IMAGE_SIZE_MAX];	// running Firmware
+uint8_t  Bench_Image[BENCH_IMAGE_SIZE];				// new Firmware
+uint8_t  Bench_LZImage[BENCH_IMAGE_SIZE * 2];
+uint8_t  Bench_Previous[BENCH_PREVIOUS_SIZE];		// former version the patch is made against
+uint8_t  Bench_Patch[BENCH_IMAGE_SIZE * 2];
+uint32_t Bench_PatchDataOffset;						// first byte inserted by the patch(0->none)
+
+/* time of the harness(us): EmbeddedFlash / LCD / waits, SPI2 bytes clocked by the DMA behind the CPU */
+double 	 Bench_CPUTime;
+double 	 Bench_DMAHiddenTime;
+double 	 Bench_DMADoneTime;
+double 	 Bench_StartTime;
+
+uint32_t Bench_PageEraseNumber;
+uint32_t Bench_HalfWordNumber;
+uint32_t Bench_ProgramFaultNumber;
+uint32_t Bench_LCDNumber;
+uint32_t Bench_PollNumber;
+uint8_t  Bench_WokenFlag;
+jmp_buf  Bench_Jump;
+
+uint8_t  Bench_Fail;
+
+/* App.c state a reset clears(.bss), left by the run before */
+extern uint8_t LZ_State;
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	uint32_t LZSize;
+	uint32_t PatchSize;
+	uint16_t CRC16;
+	
+	pBench_EmbeddedFlash = mmap((void *)EMBEDDED_FLASH_Address_Base, EMBEDDED_FLASH_SIZE * 1024, PROT_READ | PROT_WRITE,
+								MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	
+	if(pBench_EmbeddedFlash == MAP_FAILED)
+	{
+		perror("mmap EMBEDDED_FLASH_Address_Base");
+		exit(2);
+	}
+	
+	Bench_ImageMake(&Bench_Running[0], sizeof(Bench_Running), 1);
+	Bench_ImageMake(&Bench_Image[0], sizeof(Bench_Image), 2);
+	
+	W25Q64_Emu_Open(BENCH_FILE, 1);
+	
+	/* 1. former */
+	Bench_Prepare(FIRMWARE_NEW_VERSION_FLAG, &Bench_Image[0], BENCH_IMAGE_SIZE);
+	Bench_Former();
+	Bench_Report("former, WriteHalfWord");
+	
+	/* 2. new */
+	Bench_Prepare(FIRMWARE_NEW_VERSION_FLAG, &Bench_Image[0], BENCH_IMAGE_SIZE);
+	Bench_Install();
+	Bench_Report("new Firmware");
+	
+	/* 3. same */
+	Bench_Prepare(FIRMWARE_NEW_VERSION_FLAG, &Bench_Image[0], BENCH_IMAGE_SIZE);
+	memcpy(&pBench_EmbeddedFlash[EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base], &Bench_Image[0], BENCH_IMAGE_SIZE);
+	Bench_Install();
+	Bench_Report("same Firmware again");
+	
+	/* 4. lz */
+	LZSize = Bench_LZCompress(&Bench_Image[0], BENCH_IMAGE_SIZE, &Bench_LZImage[0]);
+	
+	Bench_Prepare(FIRMWARE_NEW_LZ_FLAG, &Bench_LZImage[0], LZSize);
+	Bench_Install();
+	Bench_Report("compressed Firmware");
+	
+	printf("  (compressed Firmware: %u byte of %u)\n", LZSize, BENCH_IMAGE_SIZE);
+	
+	/* 5. delta */
+	Bench_PreviousMake();
+	PatchSize = Bench_DeltaMake(&Bench_Previous[0], BENCH_PREVIOUS_SIZE, &Bench_Image[0], BENCH_IMAGE_SIZE, &Bench_Patch[0]);
+	
+	Bench_Prepare(FIRMWARE_NEW_DELTA_FLAG, &Bench_Patch[0], PatchSize);
+	memcpy(&pBench_EmbeddedFlash[EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base], &Bench_Previous[0], BENCH_PREVIOUS_SIZE);
+	Bench_Install();
+	Bench_Report("delta patch");
+	
+	CRC16 = Mid_CRC16_Modbus(&pBench_EmbeddedFlash[EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base], BENCH_IMAGE_SIZE);
+	
+	Bench_Check("  CRC16 of the patch header", CRC16 == ((Bench_Patch[DELTA_OFFSET_TARGET_CRC16] << 8) | Bench_Patch[DELTA_OFFSET_TARGET_CRC16 + 1]));
+	
+	printf("  (delta patch: %u byte of %u, former version %u byte)\n", PatchSize, BENCH_IMAGE_SIZE, BENCH_PREVIOUS_SIZE);
+	
+	/* 6. corrupt */
+	Bench_Check("patch inserts data", Bench_PatchDataOffset != 0);
+	
+	Bench_Patch[Bench_PatchDataOffset] ^= 0x01;
+	
+	Bench_Prepare(FIRMWARE_NEW_DELTA_FLAG, &Bench_Patch[0], PatchSize);
+	memcpy(&pBench_EmbeddedFlash[EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base], &Bench_Previous[0], BENCH_PREVIOUS_SIZE);
+	Bench_Install();
+	Bench_Reject("delta patch corrupted", &Bench_Previous[0], BENCH_PREVIOUS_SIZE);
+	
+	Bench_Patch[Bench_PatchDataOffset] ^= 0x01;
+	
+	/* 7. source */
+	Bench_Prepare(FIRMWARE_NEW_DELTA_FLAG, &Bench_Patch[0], PatchSize);
+	Bench_Install();
+	Bench_Reject("delta, other source", &Bench_Running[0], FIRMWARE_IMAGE_SIZE_MAX);
+	
+	W25Q64_Emu_Close();
+	
+	return Bench_Fail;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Get the time of the harness
+  * @Param	None
+  * @Retval	time(us)
+  */
+static double Bench_Time(void)
+{
+	stu_W25Q64_Emu_Stat_t stu_Emu_Stat;
+	
+	W25Q64_Emu_GetStat(&stu_Emu_Stat);
+	
+	return stu_Emu_Stat.Time - Bench_DMAHiddenTime + Bench_CPUTime;
+}
+
+/**
+  * @Brief	Make a Firmware image: Thumb-like halfwords of a small dictionary, literal tables, zero runs
+  * @Param	pImage: point to the image
+  *			Size  : image size
+  *			Seed  : seed of the content
+  * @Retval	None
+  *	@Note	First word the stack top(__initial_sp in SRAM: 0x2000xxxx, checked by Hal_JumpToApp_Jump), as a Firmware starts
+  */
+static void Bench_ImageMake(uint8_t *pImage, uint32_t Size, uint32_t Seed)
+{
+	uint16_t Dictionary[256];
+	uint32_t i, Run;
+	
+	srand(Seed);
+	
+	for(i=0; i<256; i++)
+	{
+		Dictionary[i] = rand();
+	}
+	
+	for(i=0; i<Size; i+=2)
+	{
+		Run = rand() % 100;
+	
+		if(Run < 70)
+		{
+			pImage[i] = Dictionary[rand() & 0xFF] & 0xFF;
+			pImage[i + 1] = Dictionary[rand() & 0xFF] >> 8;
+		}
+		else if(Run < 95)
+		{
+			pImage[i] = rand();
+			pImage[i + 1] = rand();
+		}
+		else
+		{
+			for(Run=rand() % 64; Run && (i + 1 < Size); Run--, i+=2)
+			{
+				pImage[i] = 0;
+				pImage[i + 1] = 0;
+			}
+		}
+	}
+	
+	pImage[0] = 0x00;
+	pImage[1] = 0x30;
+	pImage[2] = 0x00;
+	pImage[3] = 0x20;
+}
+
+/**
+  * @Brief	Compress an image: header of App.h, greedy LZ4 sequences(match of 4 byte or more, offset 1 -> 65535)
+  * @Param	pIn	: point to the image
+  *			Len	: image size
+  *			pOut: point to the compressed image
+  * @Retval	compressed image size
+  */
+static uint32_t Bench_LZCompress(const uint8_t *pIn, uint32_t Len, uint8_t *pOut)
+{
+	static uint32_t Hash[1 << BENCH_LZ_HASH_BITS];
+	uint8_t  *pStart = pOut;
+	uint8_t  *pToken;
+	uint32_t Pos = 0;
+	uint32_t Anchor = 0;
+	uint32_t Ref, Match, LitLen, Key;
+	uint16_t CRC16;
+	
+	memset(Hash, 0xFF, sizeof(Hash));
+	
+	CRC16 = Mid_CRC16_Modbus((uint8_t *)pIn, Len);
+	
+	*pOut++ = FIRMWARE_LZ_MAGIC_0;
+	*pOut++ = FIRMWARE_LZ_MAGIC_1;
+	*pOut++ = Len & 0xFF;
+	*pOut++ = (Len >> 8) & 0xFF;
+	*pOut++ = (Len >> 16) & 0xFF;
+	*pOut++ = (Len >> 24) & 0xFF;
+	*pOut++ = CRC16 >> 8;
+	*pOut++ = CRC16 & 0xFF;
+	
+	while(Pos + FIRMWARE_LZ_MATCH_MIN <= Len)
+	{
+		memcpy(&Key, &pIn[Pos], 4);
+		Key = (Key * 2654435761U) >> (32 - BENCH_LZ_HASH_BITS);
+	
+		Ref = Hash[Key];
+		Hash[Key] = Pos;
+	
+		if((Ref == 0xFFFFFFFF) || (Pos - Ref > 0xFFFF) || (memcmp(&pIn[Ref], &pIn[Pos], FIRMWARE_LZ_MATCH_MIN) != 0))
+		{
+			Pos++;
+			continue;
+		}
+	
+		for(Match=FIRMWARE_LZ_MATCH_MIN; (Pos + Match < Len) && (pIn[Ref + Match] == pIn[Pos + Match]); Match++);
+	
+		LitLen = Pos - Anchor;
+	
+		pToken = pOut++;
+		*pToken = ((LitLen < 15) ? LitLen : 15) << 4;
+		*pToken |= ((Match - FIRMWARE_LZ_MATCH_MIN) < 15) ? (Match - FIRMWARE_LZ_MATCH_MIN) : 15;
+	
+		if(LitLen >= 15)
+		{
+			pOut = Bench_LZLength(pOut, LitLen - 15);
+		}
+	
+		memcpy(pOut, &pIn[Anchor], LitLen);
+		pOut += LitLen;
+	
+		*pOut++ = (Pos - Ref) & 0xFF;
+		*pOut++ = (Pos - Ref) >> 8;
+	
+		if((Match - FIRMWARE_LZ_MATCH_MIN) >= 15)
+		{
+			pOut = Bench_LZLength(pOut, Match - FIRMWARE_LZ_MATCH_MIN - 15);
+		}
+	
+		Pos += Match;
+		Anchor = Pos;
+	}
+	
+	/* last sequence: literals only */
+	LitLen = Len - Anchor;
+	
+	*pOut++ = ((LitLen < 15) ? LitLen : 15) << 4;
+	
+	if(LitLen >= 15)
+	{
+		pOut = Bench_LZLength(pOut, LitLen - 15);
+	}
+	
+	memcpy(pOut, &pIn[Anchor], LitLen);
+	pOut += LitLen;
+	
+	return pOut - pStart;
+}
+
+/**
+  * @Brief	Continue a length nibble of 15: bytes of 255, then the rest
+  * @Param	pOut: point to the compressed image
+  *			Len	: length beyond 15
+  * @Retval	point after the length
+  */
+static uint8_t *Bench_LZLength(uint8_t *pOut, uint32_t Len)
+{
+	while(Len >= 255)
+	{
+		*pOut++ = 255;
+		Len -= 255;
+	}
+	
+	*pOut++ = Len;
+	
+	return pOut;
+}
+
+/**
+  * @Brief	Make the former version of the new Firmware: the code added in the new one left out, code removed since kept,
+  *			halfwords changed, a table rewritten
+  * @Param	None
+  * @Retval	None
+  *	@Note	First word(stack top) kept
+  */
+static void Bench_PreviousMake(void)
+{
+	uint32_t Offset;
+	uint32_t Len;
+	uint32_t i;
+	
+	srand(3);
+	
+	/* up to the code added */
+	Len = BENCH_DELTA_ADD_OFFSET;
+	memcpy(&Bench_Previous[0], &Bench_Image[0], Len);
+	
+	/* up to the code removed, then the code removed */
+	memcpy(&Bench_Previous[Len], &Bench_Image[BENCH_DELTA_ADD_OFFSET + BENCH_DELTA_ADD_SIZE], BENCH_DELTA_REMOVE_OFFSET - BENCH_DELTA_ADD_OFFSET - BENCH_DELTA_ADD_SIZE);
+	Len += BENCH_DELTA_REMOVE_OFFSET - BENCH_DELTA_ADD_OFFSET - BENCH_DELTA_ADD_SIZE;
+	
+	for(i=0; i<BENCH_DELTA_REMOVE_SIZE; i++)
+	{
+		Bench_Previous[Len++] = rand();
+	}
+	
+	/* the rest */
+	memcpy(&Bench_Previous[Len], &Bench_Image[BENCH_DELTA_REMOVE_OFFSET], BENCH_IMAGE_SIZE - BENCH_DELTA_REMOVE_OFFSET);
+	
+	for(i=0; i<BENCH_DELTA_CHANGE_NUMBER; i++)
+	{
+		Offset = 4 + (rand() % (BENCH_PREVIOUS_SIZE - 6)) / 2 * 2;
+	
+		Bench_Previous[Offset] ^= 0x5A;
+		Bench_Previous[Offset + 1] ^= 0xA5;
+	}
+	
+	Offset = BENCH_DELTA_TABLE_OFFSET - BENCH_DELTA_ADD_SIZE + BENCH_DELTA_REMOVE_SIZE;
+	
+	for(i=0; i<BENCH_DELTA_TABLE_SIZE; i++)
+	{
+		Bench_Previous[Offset + i] = rand();
+	}
+}
+
+/**
+  * @Brief	Make the delta patch of a Firmware against the former version: header of App.h, greedy COPY of the longest match found
+  *			(the source following the last COPY tried first, then the hash table), INSERT of the bytes between
+  * @Param	pSource		: point to the former version
+  *			SourceSize	: former version size
+  *			pTarget		: point to the new Firmware
+  *			TargetSize	: new Firmware size
+  *			pOut		: point to the patch
+  * @Retval	patch size
+  */
+static uint32_t Bench_DeltaMake(const uint8_t *pSource, uint32_t SourceSize, const uint8_t *pTarget, uint32_t TargetSize, uint8_t *pOut)
+{
+	static uint32_t Hash[1 << BENCH_DELTA_HASH_BITS];
+	uint8_t  *pStart = pOut;
+	uint32_t Pos = 0;
+	uint32_t Anchor = 0;
+	uint32_t Next = 0;		// source following the last COPY
+	uint32_t Ref, Match, Best, BestRef, Key;
+	uint32_t i;
+	uint16_t CRC16;
+	
+	memset(Hash, 0xFF, sizeof(Hash));
+	
+	for(i=0; i+BENCH_DELTA_MATCH_MIN<=SourceSize; i++)
+	{
+		memcpy(&Key, &pSource[i], 4);
+		Key = ((Key ^ (pSource[i + BENCH_DELTA_MATCH_MIN - 1] << 7)) * 2654435761U) >> (32 - BENCH_DELTA_HASH_BITS);
+	
+		if(Hash[Key] == 0xFFFFFFFF)
+		{
+			Hash[Key] = i;
+		}
+	}
+	
+	*pOut++ = FIRMWARE_DELTA_MAGIC_0;
+	*pOut++ = FIRMWARE_DELTA_MAGIC_1;
+	
+	CRC16 = Mid_CRC16_Modbus((uint8_t *)pSource, SourceSize);
+	
+	*pOut++ = SourceSize & 0xFF;
+	*pOut++ = (SourceSize >> 8) & 0xFF;
+	*pOut++ = (SourceSize >> 16) & 0xFF;
+	*pOut++ = (SourceSize >> 24) & 0xFF;
+	*pOut++ = CRC16 >> 8;
+	*pOut++ = CRC16 & 0xFF;
+	
+	CRC16 = Mid_CRC16_Modbus((uint8_t *)pTarget, TargetSize);
+	
+	*pOut++ = TargetSize & 0xFF;
+	*pOut++ = (TargetSize >> 8) & 0xFF;
+	*pOut++ = (TargetSize >> 16) & 0xFF;
+	*pOut++ = (TargetSize >> 24) & 0xFF;
+	*pOut++ = CRC16 >> 8;
+	*pOut++ = CRC16 & 0xFF;
+	
+	Bench_PatchDataOffset = 0;
+	
+	while(Pos + BENCH_DELTA_MATCH_MIN <= TargetSize)
+	{
+		Best = 0;
+		BestRef = 0;
+	
+		/* the source following the last COPY(bytes changed in place skipped), then the hash table */
+		for(i=0; i<2; i++)
+		{
+			if(i == 0)
+			{
+				Ref = Next + (Pos - Anchor);
+			}
+			else
+			{
+				memcpy(&Key, &pTarget[Pos], 4);
+				Key = ((Key ^ (pTarget[Pos + BENCH_DELTA_MATCH_MIN - 1] << 7)) * 2654435761U) >> (32 - BENCH_DELTA_HASH_BITS);
+				Ref = Hash[Key];
+			}
+	
+			if((Ref == 0xFFFFFFFF) || (Ref + BENCH_DELTA_MATCH_MIN > SourceSize))
+			{
+				continue;
+			}
+	
+			for(Match=0; (Pos + Match < TargetSize) && (Ref + Match < SourceSize) && (Match < 0xFFFF) && (pSource[Ref + Match] == pTarget[Pos + Match]); Match++);
+	
+			if(Match > Best)
+			{
+				Best = Match;
+				BestRef = Ref;
+			}
+		}
+	
+		if(Best < BENCH_DELTA_MATCH_MIN)
+		{
+			Pos++;
+			continue;
+		}
+	
+		pOut = Bench_DeltaInsert(pOut, &pTarget[Anchor], Pos - Anchor);
+	
+		*pOut++ = FIRMWARE_DELTA_CMD_COPY;
+		*pOut++ = BestRef & 0xFF;
+		*pOut++ = (BestRef >> 8) & 0xFF;
+		*pOut++ = (BestRef >> 16) & 0xFF;
+		*pOut++ = Best & 0xFF;
+		*pOut++ = (Best >> 8) & 0xFF;
+	
+		Pos += Best;
+		Anchor = Pos;
+		Next = BestRef + Best;
+	}
+	
+	/* the rest, end */
+	pOut = Bench_DeltaInsert(pOut, &pTarget[Anchor], TargetSize - Anchor);
+	
+	*pOut++ = FIRMWARE_DELTA_CMD_END;
+	
+	return pOut - pStart;
+}
+
+/**
+  * @Brief	Append INSERT commands of the data(65535 byte at most each)
+  * @Param	pOut : point to the patch
+  *			pData: point to the data
+  *			Len	 : data length
+  * @Retval	point after the commands
+  *	@Note	The first byte inserted in the patch is noted in Bench_PatchDataOffset(offset from the patch start)
+  */
+static uint8_t *Bench_DeltaInsert(uint8_t *pOut, const uint8_t *pData, uint32_t Len)
+{
+	uint32_t Num;
+	
+	while(Len)
+	{
+		Num = (Len > 0xFFFF) ? 0xFFFF : Len;
+	
+		*pOut++ = FIRMWARE_DELTA_CMD_INSERT;
+		*pOut++ = Num & 0xFF;
+		*pOut++ = (Num >> 8) & 0xFF;
+	
+		if(Bench_PatchDataOffset == 0)
+		{
+			Bench_PatchDataOffset = pOut - &Bench_Patch[0];
+		}
+	
+		memcpy(pOut, pData, Num);
+		pOut += Num;
+		pData += Num;
+		Len -= Num;
+	}
+	
+	return pOut;
+}
+
+/**
+  * @Brief	Start a run: ExternalFlash erased, FirmwareInfo and the file written, the running Firmware in EmbeddedFlash
+  * @Param	Flag	: NewVersionFlag of the FirmwareInfo
+  *			pFile	: point to the file downloaded
+  *			FileSize: file size
+  * @Retval	None
+  */
+static void Bench_Prepare(uint8_t Flag, const uint8_t *pFile, uint32_t FileSize)
+{
+	uint8_t  *pMemory;
+	uint16_t CRC16;
+	uint32_t i;
+	
+	pMemory = W25Q64_Emu_GetMemory();
+	
+	memset(pMemory, 0xFF, FIRMWARE_BACKUP_IMAGE_ADDRESS + FIRMWARE_IMAGE_SIZE_MAX);
+	
+	CRC16 = Mid_CRC16_Modbus((uint8_t *)pFile, FileSize);
+	
+	pMemory[FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG] = Flag;
+	pMemory[FLASH_ADDRESS_FIRMWARE_CURRENTVERSION] = 0x01;
+	pMemory[FLASH_ADDRESS_FIRMWARE_CURRENTVERSION + 1] = 0x00;
+	pMemory[FLASH_ADDRESS_FIRMWARE_NEWVERSION] = 0x01;
+	pMemory[FLASH_ADDRESS_FIRMWARE_NEWVERSION + 1] = 0x01;
+	pMemory[FLASH_ADDRESS_FIRMWARE_BYTE_SIZE] = FileSize & 0xFF;
+	pMemory[FLASH_ADDRESS_FIRMWARE_BYTE_SIZE + 1] = (FileSize >> 8) & 0xFF;
+	pMemory[FLASH_ADDRESS_FIRMWARE_BYTE_SIZE + 2] = (FileSize >> 16) & 0xFF;
+	pMemory[FLASH_ADDRESS_FIRMWARE_BYTE_SIZE + 3] = (FileSize >> 24) & 0xFF;
+	pMemory[FLASH_ADDRESS_FIRMWARE_CRC16_CHECKVALUE] = CRC16 >> 8;
+	pMemory[FLASH_ADDRESS_FIRMWARE_CRC16_CHECKVALUE + 1] = CRC16 & 0xFF;
+	
+	memcpy(&pMemory[FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS], pFile, FileSize);
+	
+	/* BootLoader area: pattern checked untouched, App area: the running Firmware */
+	for(i=0; i<EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base; i++)
+	{
+		pBench_EmbeddedFlash[i] = i * 7 + 3;
+	}
+	
+	memcpy(&pBench_EmbeddedFlash[i], &Bench_Running[0], FIRMWARE_IMAGE_SIZE_MAX);
+	
+	W25Q64_Emu_ClearStat();
+	
+	LZ_State = APP_LZ_STA_IDLE;
+	
+	Bench_CPUTime = 0;
+	Bench_DMAHiddenTime = 0;
+	Bench_DMADoneTime = 0;
+	Bench_StartTime = 0;
+	Bench_PageEraseNumber = 0;
+	Bench_HalfWordNumber = 0;
+	Bench_ProgramFaultNumber = 0;
+	Bench_LCDNumber = 0;
+	Bench_PollNumber = 0;
+}
+
+/**
+  * @Brief	Former programming of the new Firmware: 256 byte read, programmed by Mid_EmbeddedFlash_WriteHalfWord
+  * @Param	None
+  * @Retval	None
+  */
+static void Bench_Former(void)
+{
+	uint16_t HalfWordBuff[FLASH_PAGE_SIZE / 2];
+	uint8_t  DataBuff[FLASH_PAGE_SIZE];
+	uint32_t Offset;
+	uint16_t Len;
+	uint16_t i;
+	uint8_t  Flag;
+	
+	Mid_TFTLCD_ScreenClear();
+	Mid_TFTLCD_ShowString(60, 60, (uint8_t *)"Firmware Updating...", LCD_FONT_COLOR, LCD_BACK_COLOR, 24, 0);
+	
+	for(Offset=0; Offset<BENCH_IMAGE_SIZE; Offset+=Len)
+	{
+		Len = ((BENCH_IMAGE_SIZE - Offset) > FLASH_PAGE_SIZE) ? FLASH_PAGE_SIZE : (BENCH_IMAGE_SIZE - Offset);
+	
+		Mid_Flash_ReadData(&DataBuff[0], FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + Offset, Len);
+	
+		if(Len % 2)
+		{
+			DataBuff[Len] = 0xFF;
+		}
+	
+		for(i=0; i<((Len + 1) / 2); i++)
+		{
+			HalfWordBuff[i] = (DataBuff[i*2 + 1] << 8) | DataBuff[i*2];
+		}
+	
+		Mid_EmbeddedFlash_WriteHalfWord(EMBEDDED_FLASH_Address_APP_BASE + Offset, &HalfWordBuff[0], (Len + 1) / 2);
+	}
+	
+	Flag = FIRMWARE_NEW_VERSION_READY;
+	Mid_Flash_WriteData(&Flag, FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG, 1);
+	
+	Mid_TFTLCD_ShowString(0, 120, (uint8_t *)"Update Successfully", LCD_FONT_COLOR, LCD_BACK_COLOR, 32, 0);
+}
+
+/**
+  * @Brief	Install as the BootLoader does: App_Init, App_Pro polled until the new Firmware started(Hal_JumpToApp_Jump)
+  * @Param	None
+  * @Retval	None
+  */
+static void Bench_Install(void)
+{
+	double Time;
+	
+	if(setjmp(Bench_Jump) != 0)
+	{
+		return;
+	}
+	
+	App_Init();
+	
+	Bench_StartTime = Bench_Time();
+	
+	while(Bench_PollNumber < BENCH_POLL_MAX)
+	{
+		Bench_WokenFlag = 0;
+	
+		App_Pro();
+		Bench_PollNumber++;
+	
+		/* not woken: next poll on the next 10ms tick */
+		if(!Bench_WokenFlag)
+		{
+			Time = Bench_Time();
+			Bench_CPUTime += 10000.0 - ((uint64_t)Time % 10000);
+		}
+	}
+}
+
+/**
+  * @Brief	Report a run and check the new Firmware in EmbeddedFlash
+  * @Param	pName: name of the run
+  * @Retval	None
+  */
+static void Bench_Report(const char *pName)
+{
+	uint32_t i;
+	uint8_t  Pass = 1;
+	
+	for(i=0; i<EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base; i++)
+	{
+		if(pBench_EmbeddedFlash[i] != (uint8_t)(i * 7 + 3))
+		{
+			Pass = 0;
+		}
+	}
+	
+	printf("%-22s: %6.2f s(start %5.2f s, install %5.2f s), %3u page erases, %6u halfwords, %3u LCD strings, %5u polls\n",
+		   pName, Bench_Time() / 1e6, Bench_StartTime / 1e6, (Bench_Time() - Bench_StartTime) / 1e6,
+		   Bench_PageEraseNumber, Bench_HalfWordNumber, Bench_LCDNumber, Bench_PollNumber);
+	
+	Bench_Check("  new Firmware in EmbeddedFlash, started",
+				(memcmp(&pBench_EmbeddedFlash[i], &Bench_Image[0], BENCH_IMAGE_SIZE) == 0) &&
+				(W25Q64_Emu_GetMemory()[FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG] == FIRMWARE_NEW_VERSION_READY));
+	Bench_Check("  BootLoader untouched, no program over 0", Pass && (Bench_ProgramFaultNumber == 0));
+}
+
+/**
+  * @Brief	Report a run the new Firmware must be rejected in: the Firmware running left as it is and started
+  * @Param	pName	 : name of the run
+  *			pRunning : point to the Firmware running
+  *			Size	 : size of the Firmware running
+  * @Retval	None
+  */
+static void Bench_Reject(const char *pName, const uint8_t *pRunning, uint32_t Size)
+{
+	uint32_t i;
+	uint8_t  Pass = 1;
+	
+	for(i=0; i<EMBEDDED_FLASH_Address_APP_BASE - EMBEDDED_FLASH_Address_Base; i++)
+	{
+		if(pBench_EmbeddedFlash[i] != (uint8_t)(i * 7 + 3))
+		{
+			Pass = 0;
+		}
+	}
+	
+	printf("%-22s: %6.2f s, %3u page erases, %6u halfwords, %3u LCD strings, %5u polls\n",
+		   pName, Bench_Time() / 1e6, Bench_PageEraseNumber, Bench_HalfWordNumber, Bench_LCDNumber, Bench_PollNumber);
+	
+	Bench_Check("  rejected, the Firmware running started",
+				(memcmp(&pBench_EmbeddedFlash[i], pRunning, Size) == 0) && (Bench_PollNumber == 0) &&
+				(W25Q64_Emu_GetMemory()[FLASH_ADDRESS_FIRMWARE_NEW_VERSION_FLAG] == FIRMWARE_NEW_VERSION_DEFAULT));
+	Bench_Check("  BootLoader untouched, no program over 0", Pass && (Bench_ProgramFaultNumber == 0));
+}
+
+/**
+  * @Brief	Report a check
+  * @Param	pName : check
+  *			Result: 1->pass, 0->fail
+  * @Retval	None
+  */
+static void Bench_Check(const char *pName, uint8_t Result)
+{
+	printf("  %-45s: %s\n", pName, Result ? "pass" : "FAIL");
+	
+	if(!Result)
+	{
+		Bench_Fail = 1;
+	}
+}
+
+
+/*-------------Stub Functions Definition-----------*/
+void Hal_DMA_SPI2Rx_Start(uint8_t *pBuffer, uint16_t Len)
+{
+	uint16_t i;
+	
+	for(i=0; i<Len; i++)
+	{
+		pBuffer[i] = Hal_SPI2_ReadWriteByte(DUMMY);
+	}
+	
+	/* bytes on the bus behind the CPU until waited for */
+	Bench_DMAHiddenTime += Len * W25Q64_EMU_BYTE_TIME;
+	Bench_DMADoneTime = Bench_Time() + Len * W25Q64_EMU_BYTE_TIME;
+}
+
+uint8_t Hal_DMA_SPI2Rx_IsComplete(void)
+{
+	if(Bench_Time() < Bench_DMADoneTime)
+	{
+		Bench_CPUTime += Bench_DMADoneTime - Bench_Time();
+	}
+	
+	return 1;
+}
+
+void Hal_DMA_SPI2Rx_Stop(void)
+{
+}
+
+void Hal_EmbeddedFlash_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+	uint16_t *pHalfWord = (uint16_t *)(uintptr_t)Address;
+	
+	if((*pHalfWord & Data) != Data)
+	{
+		Bench_ProgramFaultNumber++;
+	}
+	
+	*pHalfWord &= Data;
+	
+	Bench_HalfWordNumber++;
+	Bench_CPUTime += BENCH_HALFWORD_TIME;
+}
+
+void Hal_EmbeddedFlash_EarsePage(uint32_t PageAddress)
+{
+	memset((void *)(uintptr_t)(PageAddress & ~(uint32_t)(EMBEDDED_FLASH_SECTOR_SIZE - 1)), 0xFF, EMBEDDED_FLASH_SECTOR_SIZE);
+	
+	Bench_PageEraseNumber++;
+	Bench_CPUTime += BENCH_PAGE_ERASE_TIME;
+}
+
+void Hal_EmbeddedFlash_Lock(void)
+{
+}
+
+void Hal_EmbeddedFlash_Unlock(void)
+{
+}
+
+void Hal_JumpToApp_Jump(void)
+{
+	longjmp(Bench_Jump, 1);
+}
+
+uint8_t Hal_Key_GetValue(void)
+{
+	return KEY_VALUE_NONE;
+}
+
+void Hal_Timer_Creat(en_Timer_ID_t ID, void (*proc)(void), unsigned short Period, en_Timer_State_t State)
+{
+}
+
+en_Timer_Result_t Hal_Timer_Reset(en_Timer_ID_t ID, en_Timer_State_t State)
+{
+	return T_SUCCESS;
+}
+
+en_Timer_Result_t Hal_Timer_Delete(en_Timer_ID_t ID)
+{
+	return T_SUCCESS;
+}
+
+void Hal_USART_DebugStart(uint32_t BaudRate)
+{
+}
+
+uint16_t Hal_USART_DebugRxLen(void)
+{
+	return 0;
+}
+
+void Hal_USART_DebugRxData(uint8_t *pData, uint16_t Len)
+{
+}
+
+void Hal_USART_DebugRxFlush(void)
+{
+}
+
+void Hal_USART_DebugDataTx(uint8_t *pData, uint16_t Len)
+{
+}
+
+void Mid_TFTLCD_ScreenClear(void)
+{
+}
+
+void Mid_TFTLCD_ShowString(uint16_t x, uint16_t y, const uint8_t *pString, uint16_t FontColor, uint16_t BackColor, uint8_t FontSize, uint8_t Mode)
+{
+	Bench_LCDNumber++;
+	Bench_CPUTime += BENCH_LCD_STRING_TIME;
+}
+
+void OS_TaskGetUp(OS_TaskIDTypeDef taskID)
+{
+	Bench_WokenFlag = 1;
+}
@@ -0,0 +1,290 @@
+/****************************************************
+  * @Name	CRC16_Test.c
+  * @Brief	Host check and benchmark of Middle/CRC16.c(built once per CRC16_MODBUS_xxx method)
+  * @Instruction:
+  *			Every result checked against a bitwise reference:
+  *			- CRC16(Modbus): random lengths, alignments, pieces fed through Mid_CRC16_ModbusUpdate,
+  *			  Mid_CRC16_Modbus_Continuous from a random State, one run over 64 KB(16bit index of the former code)
+  *			- CRC32: bit-serial model of the STM32 CRC unit(CRC_ResetDR, CRC_CalcCRC per word), words cut short
+  *			- CRC16(XModem, CRC16_TEST_XMODEM: BootLoader copy)
+  *			-------------------------------------------------------------------
+  *			Throughput over the largest Firmware image(FIRMWARE_IMAGE_SIZE_MAX of the BootLoader),
+  *			exit code 1 on any mismatch
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stm32f10x.h"
+#include "crc16.h"
+
+#if defined(CRC16_MODBUS_NIBBLE)
+#define CRC16_TEST_METHOD		"NIBBLE"
+#elif defined(CRC16_MODBUS_BYTE)
+#define CRC16_TEST_METHOD		"BYTE"
+#else
+#define CRC16_TEST_METHOD		"SLICE4"
+#endif
+
+#define CRC16_TEST_IMAGE_SIZE	206848
+#define CRC16_TEST_CASE_SUM		20000
+#define CRC16_TEST_REPEAT		100
+
+/*-------------Internal Functions Declaration------*/
+static uint16_t Test_CRC16_ModbusBitwise(const uint8_t *pData, uint32_t Len, uint16_t State);
+static uint32_t Test_CRC32_Bitwise(const uint8_t *pData, uint32_t Len, uint32_t State);
+#ifdef CRC16_TEST_XMODEM
+static uint16_t Test_CRC16_XModemBitwise(const uint8_t *pData, uint32_t Len);
+#endif
+static double 	Test_Time(void);
+
+
+/*-------------Module Variables Declaration--------*/
+uint8_t Test_Buff[CRC16_TEST_IMAGE_SIZE + 8];
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	volatile uint32_t Sink = 0;
+	uint32_t Fail = 0;
+	uint32_t Len, Pos, Piece;
+	uint32_t CRC32State;
+	uint16_t State, Seed;
+	uint8_t  *pData;
+	double   Time[3];
+	uint32_t i, j;
+	
+	srand(1);
+	
+	for(i=0; i<sizeof(Test_Buff); i++)
+	{
+		Test_Buff[i] = rand();
+	}
+	
+	/* check values of "123456789": Modbus 0x4B37(byte swapped 0x374B), CRC unit over the words padded 0xFF */
+	if(Mid_CRC16_Modbus((uint8_t *)"123456789", 9) != 0x374B)
+	{
+		Fail++;
+	}
+	
+	if(Mid_CRC32_Update((uint8_t *)"123456789", 9, CRC32_INIT) != Test_CRC32_Bitwise((uint8_t *)"123456789", 9, CRC32_INIT))
+	{
+		Fail++;
+	}
+	
+	#ifdef CRC16_TEST_XMODEM
+	if(Mid_CRC16_XModem((uint8_t *)"123456789", 9) != 0x31C3)
+	{
+		Fail++;
+	}
+	#endif
+	
+	for(i=0; i<CRC16_TEST_CASE_SUM; i++)
+	{
+		pData = &Test_Buff[rand() % 8];
+		Len = rand() % ((i < CRC16_TEST_CASE_SUM - 1000) ? 3000 : 70000);
+	
+		/* one run */
+		if(Mid_CRC16_Modbus(pData, Len) != Mid_CRC16_ModbusResult(Test_CRC16_ModbusBitwise(pData, Len, CRC16_MODBUS_INIT)))
+		{
+			Fail++;
+		}
+	
+		/* pieces */
+		State = CRC16_MODBUS_INIT;
+		CRC32State = CRC32_INIT;
+	
+		for(Pos=0; Pos<Len; Pos+=Piece)
+		{
+			Piece = rand() % 300;
+	
+			if(Piece > Len - Pos)
+			{
+				Piece = Len - Pos;
+			}
+	
+			State = Mid_CRC16_ModbusUpdate(pData + Pos, Piece, State);
+		}
+	
+		if(Mid_CRC16_ModbusResult(State) != Mid_CRC16_Modbus(pData, Len))
+		{
+			Fail++;
+		}
+	
+		/* from a State */
+		Seed = rand();
+	
+		if(Mid_CRC16_Modbus_Continuous(pData, Len, Seed) != Mid_CRC16_ModbusResult(Test_CRC16_ModbusBitwise(pData, Len, Seed)))
+		{
+			Fail++;
+		}
+	
+		/* CRC32: pieces of whole words, the last one cut short */
+		for(Pos=0; Pos<Len; Pos+=Piece)
+		{
+			Piece = (rand() % 80) * 4;
+	
+			if(Piece > Len - Pos)
+			{
+				Piece = Len - Pos;
+			}
+	
+			CRC32State = Mid_CRC32_Update(pData + Pos, Piece, CRC32State);
+		}
+	
+		if(CRC32State != Test_CRC32_Bitwise(pData, Len, CRC32_INIT))
+		{
+			Fail++;
+		}
+	
+		#ifdef CRC16_TEST_XMODEM
+		if(Mid_CRC16_XModem(pData, Len) != Test_CRC16_XModemBitwise(pData, Len))
+		{
+			Fail++;
+		}
+		#endif
+	}
+	
+	/* whole image in one call */
+	if(Mid_CRC16_Modbus(&Test_Buff[0], CRC16_TEST_IMAGE_SIZE) !=
+	   Mid_CRC16_ModbusResult(Test_CRC16_ModbusBitwise(&Test_Buff[0], CRC16_TEST_IMAGE_SIZE, CRC16_MODBUS_INIT)))
+	{
+		Fail++;
+	}
+	
+	printf("CRC16_MODBUS_%s: %u cases, %u mismatches\n", CRC16_TEST_METHOD, CRC16_TEST_CASE_SUM, Fail);
+	
+	/* throughput */
+	Time[0] = Test_Time();
+	
+	for(j=0; j<CRC16_TEST_REPEAT; j++)
+	{
+		Sink += Mid_CRC16_ModbusUpdate(&Test_Buff[0], CRC16_TEST_IMAGE_SIZE, CRC16_MODBUS_INIT);
+	}
+	
+	Time[0] = Test_Time() - Time[0];
+	Time[1] = Test_Time();
+	
+	for(j=0; j<CRC16_TEST_REPEAT; j++)
+	{
+		Sink += Mid_CRC32_Update(&Test_Buff[0], CRC16_TEST_IMAGE_SIZE, CRC32_INIT);
+	}
+	
+	Time[1] = Test_Time() - Time[1];
+	Time[2] = Test_Time();
+	
+	for(j=0; j<CRC16_TEST_REPEAT / 10; j++)
+	{
+		Sink += Test_CRC16_ModbusBitwise(&Test_Buff[0], CRC16_TEST_IMAGE_SIZE, CRC16_MODBUS_INIT);
+	}
+	
+	Time[2] = (Test_Time() - Time[2]) * 10;
+	
+	printf("  CRC16 Modbus %-8s: %7.1f MB/s\n", CRC16_TEST_METHOD, (double)CRC16_TEST_IMAGE_SIZE * CRC16_TEST_REPEAT / Time[0] / 1e6);
+	printf("  CRC32 table          : %7.1f MB/s\n", (double)CRC16_TEST_IMAGE_SIZE * CRC16_TEST_REPEAT / Time[1] / 1e6);
+	printf("  CRC16 Modbus bitwise : %7.1f MB/s\n", (double)CRC16_TEST_IMAGE_SIZE * CRC16_TEST_REPEAT / Time[2] / 1e6);
+	
+	return (Fail != 0);
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	CRC16(Modbus) bit by bit: polynomial 0xA001(reflected 0x8005), LSB first
+  * @Param	pData: point to the data
+  *			Len	 : data length
+  *			State: CRC16_MODBUS_INIT / State before the data
+  * @Retval	State after the data(not byte swapped)
+  */
+static uint16_t Test_CRC16_ModbusBitwise(const uint8_t *pData, uint32_t Len, uint16_t State)
+{
+	uint8_t i;
+	
+	while(Len--)
+	{
+		State ^= *pData++;
+	
+		for(i=0; i<8; i++)
+		{
+			State = (State & 1) ? ((State >> 1) ^ 0xA001) : (State >> 1);
+		}
+	}
+	
+	return State;
+}
+
+/**
+  * @Brief	STM32 CRC unit bit by bit: a 32bit word(little-endian in memory) per CRC_CalcCRC, MSB first, polynomial 0x04C11DB7
+  * @Param	pData: point to the data
+  *			Len	 : data length(a last word cut short filled up with 0xFF)
+  *			State: CRC32_INIT / State before the data
+  * @Retval	State after the data
+  */
+static uint32_t Test_CRC32_Bitwise(const uint8_t *pData, uint32_t Len, uint32_t State)
+{
+	uint32_t Word;
+	uint32_t i;
+	uint8_t  j;
+	
+	for(i=0; i<Len; i+=4)
+	{
+		Word = 0;
+	
+		for(j=0; j<4; j++)
+		{
+			Word |= (uint32_t)((i + j < Len) ? pData[i + j] : 0xFF) << (8 * j);
+		}
+	
+		State ^= Word;
+	
+		for(j=0; j<32; j++)
+		{
+			State = (State & 0x80000000) ? ((State << 1) ^ 0x04C11DB7) : (State << 1);
+		}
+	}
+	
+	return State;
+}
+
+#ifdef CRC16_TEST_XMODEM
+/**
+  * @Brief	CRC16(XModem) bit by bit: polynomial 0x1021, MSB first, init 0
+  * @Param	pData: point to the data
+  *			Len	 : data length
+  * @Retval	CRC16
+  */
+static uint16_t Test_CRC16_XModemBitwise(const uint8_t *pData, uint32_t Len)
+{
+	uint16_t CRC16 = 0;
+	uint8_t  i;
+	
+	while(Len--)
+	{
+		CRC16 ^= (uint16_t)(*pData++) << 8;
+	
+		for(i=0; i<8; i++)
+		{
+			CRC16 = (CRC16 & 0x8000) ? ((CRC16 << 1) ^ 0x1021) : (CRC16 << 1);
+		}
+	}
+	
+	return CRC16;
+}
+#endif
+
+/**
+  * @Brief	Monotonic time
+  * @Param	None
+  * @Retval	time(s)
+  */
+static double Test_Time(void)
+{
+	struct timespec Time;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	
+	return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
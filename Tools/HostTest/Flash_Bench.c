@@ -0,0 +1,140 @@
+/****************************************************
+  * @Name	Flash_Bench.c
+  * @Brief	Host benchmark of the OTA image write: MainFirmware Middle/Mid_Flash.c on the file-backed W25Q64(W25Q64_Emu.c)
+  * @Instruction:
+  *			A 100 KB Firmware written package by package behind the 13 byte info block(FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS),
+  *			the info block last, as the download does it:
+  *			- Mid_Flash_WriteData	: read-erase-rewrite of the Sector per package(the former download)
+  *			- Mid_Flash_ImageWrite	: image writer, region erased ahead once, page-programmed
+  *			100 / 1024 byte packages, in order / every pair of packages swapped(answers out of order)
+  *			-------------------------------------------------------------------
+  *			Time(SPI2 bus + chip busy), Sector erases(most on one Sector), pages programmed,
+  *			the image read back and compared, programs over bits not erased counted;
+  *			exit code 1 on any image not matching
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f10x.h"
+#include "mid_flash.h"
+#include "W25Q64_Emu.h"
+
+#define BENCH_INFO_SIZE			13
+#define BENCH_IMAGE_SIZE		102400
+#define BENCH_FILE				"Build/W25Q64_Flash_Bench.bin"
+
+/*-------------Internal Functions Declaration------*/
+static uint8_t Bench_Run(uint16_t PackageSize, uint8_t ImageWriterFlag, uint8_t SwapFlag);
+
+
+/*-------------Module Variables Declaration--------*/
+uint8_t Bench_Image[BENCH_INFO_SIZE + BENCH_IMAGE_SIZE];
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	uint16_t PackageSize[2] = {100, 1024};
+	uint8_t  Fail = 0;
+	uint32_t i;
+	
+	srand(1);
+	
+	for(i=0; i<sizeof(Bench_Image); i++)
+	{
+		Bench_Image[i] = rand();
+	}
+	
+	W25Q64_Emu_Open(BENCH_FILE, 1);
+	
+	for(i=0; i<2; i++)
+	{
+		Fail |= Bench_Run(PackageSize[i], 0, 0);
+		Fail |= Bench_Run(PackageSize[i], 1, 0);
+		Fail |= Bench_Run(PackageSize[i], 1, 1);
+	}
+	
+	W25Q64_Emu_Close();
+	
+	return Fail;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Write the Firmware once and report
+  * @Param	PackageSize		: bytes per package
+  *			ImageWriterFlag	: 1->Mid_Flash_ImageWrite, 0->Mid_Flash_WriteData
+  *			SwapFlag		: 1->every pair of packages written the second first
+  * @Retval	0->image read back matches, 1->not
+  */
+static uint8_t Bench_Run(uint16_t PackageSize, uint8_t ImageWriterFlag, uint8_t SwapFlag)
+{
+	stu_W25Q64_Emu_Stat_t stu_Emu_Stat;
+	stu_Flash_Stat_t stu_Flash_Stat;
+	uint32_t PackageNumber;
+	uint32_t Package;
+	uint32_t Offset;
+	uint16_t Len;
+	uint32_t i;
+	uint8_t  Pass;
+	
+	PackageNumber = (BENCH_IMAGE_SIZE + PackageSize - 1) / PackageSize;
+	
+	/* the image of the download before left in place: erased first, not counted */
+	memset(W25Q64_Emu_GetMemory(), 0xFF, 2 * FLASH_BLOCK_SIZE_64KB);
+	
+	Mid_Flash_Init();
+	W25Q64_Emu_ClearStat();
+	
+	if(ImageWriterFlag)
+	{
+		Mid_Flash_ImageWriteStart(0, BENCH_INFO_SIZE + BENCH_IMAGE_SIZE, 0);
+	}
+	
+	for(i=0; i<PackageNumber; i++)
+	{
+		Package = i;
+	
+		if(SwapFlag && ((i ^ 1) < PackageNumber))
+		{
+			Package = i ^ 1;
+		}
+	
+		Offset = Package * PackageSize;
+		Len = ((BENCH_IMAGE_SIZE - Offset) > PackageSize) ? PackageSize : (BENCH_IMAGE_SIZE - Offset);
+	
+		if(ImageWriterFlag)
+		{
+			Mid_Flash_ImageWrite(&Bench_Image[BENCH_INFO_SIZE + Offset], BENCH_INFO_SIZE + Offset, Len);
+		}
+		else
+		{
+			Mid_Flash_WriteData(&Bench_Image[BENCH_INFO_SIZE + Offset], BENCH_INFO_SIZE + Offset, Len);
+		}
+	}
+	
+	/* info block last */
+	if(ImageWriterFlag)
+	{
+		Mid_Flash_ImageWrite(&Bench_Image[0], 0, BENCH_INFO_SIZE);
+	}
+	else
+	{
+		Mid_Flash_WriteData(&Bench_Image[0], 0, BENCH_INFO_SIZE);
+	}
+	
+	W25Q64_Emu_GetStat(&stu_Emu_Stat);
+	Mid_Flash_GetStat(&stu_Flash_Stat);
+	
+	Pass = (memcmp(W25Q64_Emu_GetMemory(), Bench_Image, sizeof(Bench_Image)) == 0) && (stu_Emu_Stat.ProgramFaultNumber == 0);
+	
+	printf("%-10s %4u B packages %-9s: %8.1f ms, %4u Sector erases(max %2u per Sector), %5u pages, image %s\n",
+		   ImageWriterFlag ? "ImageWrite" : "WriteData", PackageSize, SwapFlag ? "swapped" : "in order",
+		   stu_Emu_Stat.Time / 1000, stu_Emu_Stat.EraseNumber, stu_Emu_Stat.SectorEraseMax,
+		   stu_Flash_Stat.PageProgramNumber, Pass ? "ok" : "BAD");
+	
+	return !Pass;
+}
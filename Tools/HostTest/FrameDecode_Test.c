@@ -0,0 +1,667 @@
+/****************************************************
+  * @Name	FrameDecode_Test.c
+  * @Brief	Host fuzz target / benchmark of the server dataframe decoder(MQTTProtocol_FrameDecode, MainFirmware Middle/MQTT_Protocol.c)
+  * @Instruction:
+  *			MQTT_Protocol.c is linked as it is, the modules around it are stubbed here.
+  *			Dataframes of Command 0x25(Firmware package) are caught by the Mid_Firmware_Download_Pro stub(length and hash kept),
+  *			the other Commands go through MQTTProtocol_ReceiveDataHandler as on the target.
+  *
+  * --> Fuzz(default, built with AddressSanitizer / UndefinedBehaviorSanitizer):
+  *			FrameDecode_FuzzOne: the input fed in chunks of random size, the dataframes handled and the
+  *			Garbage / LengthError / CheckError counts compared with a reference scan of the whole input
+  *			(the result must not depend on how the stream is cut), exit code 1 on any difference.
+  *			Inputs: the known stream of MQTT_FRAME_DECODE_DEBUG_MODE, random streams of dataframes / corrupted dataframes /
+  *			garbage, random bytes. LLVMFuzzerTestOneInput is the same target for libFuzzer(-DFRAME_DECODE_LIBFUZZER, clang).
+  *
+  * --> Benchmark(-DFRAME_DECODE_BENCH):
+  *			throughput of MQTTProtocol_FrameDecode over streams of valid dataframes, fed in MQTT message sized chunks
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stm32f10x.h"
+#include "mqtt_protocol.h"
+#include "mid_wifi.h"
+#include "mid_firmware.h"
+#include "mid_flash.h"
+#include "mid_outbox.h"
+#include "device.h"
+#include "app.h"
+#include "mid_powermanage.h"
+#include "mid_clock.h"
+
+#define FRAME_DECODE_STREAM_SIZE_MAX	8192
+#define FRAME_DECODE_FRAME_SUM_MAX		(FRAME_DECODE_STREAM_SIZE_MAX / 6 + 1)
+#define FRAME_DECODE_FUZZ_NUMBER		20000
+
+/* Dataframe found: length and FNV-1a hash of the bytes */
+typedef struct
+{
+	unsigned long  Hash;
+	unsigned short Len;
+	
+}stu_FrameDecode_Frame_t;
+
+/* Result of a decode: dataframes of Command 0x25 handled, counters */
+typedef struct
+{
+	stu_FrameDecode_Frame_t Frame[FRAME_DECODE_FRAME_SUM_MAX];
+	unsigned short FrameNumber;
+	unsigned long  DecodeFrameNumber;
+	unsigned long  GarbageNumber;
+	unsigned long  LengthErrorNumber;
+	unsigned long  CheckErrorNumber;
+	
+}stu_FrameDecode_Result_t;
+
+/*-------------Internal Functions Declaration------*/
+static unsigned long FrameDecode_Hash(const unsigned char *pData, unsigned short Len);
+static void 	FrameDecode_Reference(const unsigned char *pData, unsigned short Len, stu_FrameDecode_Result_t *pResult);
+static unsigned char FrameDecode_FuzzOne(const unsigned char *pData, unsigned short Len, unsigned int Seed);
+#ifndef FRAME_DECODE_LIBFUZZER
+static unsigned short FrameDecode_FramePut(unsigned char *pBuff, unsigned char Command, unsigned short PayloadLen);
+#endif
+#if !defined(FRAME_DECODE_BENCH) && !defined(FRAME_DECODE_LIBFUZZER)
+static unsigned short FrameDecode_StreamBuild(unsigned char *pBuff);
+#endif
+
+
+/*-------------Module Variables Declaration--------*/
+/* modules around MQTT_Protocol.c */
+stu_TerminalMode_t 	stu_TerminalMode;
+stu_TerminalMode_t 	*pTerminalMode = &stu_TerminalMode;
+stu_Sensor_t 		stu_Sensor[SENSOR_NUMBER_MAX];
+stu_SystemPara_t 	stu_SystemPara;
+unsigned char 		STM32_UID[12];
+
+/* dataframes caught by the Mid_Firmware_Download_Pro stub */
+stu_FrameDecode_Result_t stu_FrameDecode_Result;
+unsigned char 		FrameDecode_CatchFlag;
+unsigned char 		FrameDecode_CatchError;
+
+unsigned char 		FrameDecode_Stream[FRAME_DECODE_STREAM_SIZE_MAX];
+unsigned char 		FrameDecode_Feed[FRAME_DECODE_STREAM_SIZE_MAX];
+
+
+/*-------------Module Functions Definition---------*/
+#ifndef FRAME_DECODE_LIBFUZZER
+#ifndef FRAME_DECODE_BENCH
+int main(void)
+{
+	/* garbage, HostInfo request cut in two, WorkMode request with wrong CheckValue, WorkMode request(MQTT_FRAME_DECODE_DEBUG_MODE) */
+	static unsigned char DebugStream[] =
+	{
+		0x00, 0xAA, 0x55, 0x12,
+		0xAA, 0x00, 0x06, 0x50, 0x00, 0x01, 0x00, 0x57, 0x55,
+		0xAA, 0x00, 0x06, 0x50, 0x00, 0x01, 0x01, 0x00, 0x55,
+		0xAA, 0x00, 0x06, 0x50, 0x00, 0x01, 0x01, 0x56, 0x55,
+	};
+	stu_MQTTDownlinkStat_t stu_Stat;
+	unsigned long Fail = 0;
+	unsigned long Byte = 0;
+	unsigned short Len;
+	unsigned short j;
+	unsigned int i;
+	
+	srand(1);
+	
+	/* known stream: 2 dataframes, 1 DataLength error, 1 CheckValue error */
+	MQTTProtocol_Init();
+	MQTTProtocol_FrameDecode(PROTOCOL_COMM_TYPE_WIFI, &DebugStream[0], 8);
+	MQTTProtocol_FrameDecode(PROTOCOL_COMM_TYPE_WIFI, &DebugStream[8], sizeof(DebugStream) - 8);
+	MQTTProtocol_GetDownlinkStat(&stu_Stat);
+	
+	printf("debug stream   : %lu dataframes, %lu garbage, %lu DataLength errors, %lu CheckValue errors\n",
+		   stu_Stat.DecodeFrameNumber, stu_Stat.GarbageNumber, stu_Stat.LengthErrorNumber, stu_Stat.CheckErrorNumber);
+	
+	if((stu_Stat.DecodeFrameNumber != 2) || (stu_Stat.LengthErrorNumber != 1) || (stu_Stat.CheckErrorNumber != 1))
+	{
+		Fail++;
+	}
+	
+	Fail += FrameDecode_FuzzOne(DebugStream, sizeof(DebugStream), 1);
+	
+	/* streams of dataframes / corrupted dataframes / garbage */
+	for(i=0; i<FRAME_DECODE_FUZZ_NUMBER; i++)
+	{
+		Len = FrameDecode_StreamBuild(FrameDecode_Stream);
+		Byte += Len;
+	
+		Fail += FrameDecode_FuzzOne(FrameDecode_Stream, Len, rand());
+	}
+	
+	/* random bytes, Header frequent */
+	for(i=0; i<FRAME_DECODE_FUZZ_NUMBER; i++)
+	{
+		Len = rand() % 2048;
+		Byte += Len;
+	
+		for(j=0; j<Len; j++)
+		{
+			FrameDecode_Stream[j] = (rand() % 8) ? rand() : 0xAA;
+		}
+	
+		Fail += FrameDecode_FuzzOne(FrameDecode_Stream, Len, rand());
+	}
+	
+	printf("fuzz           : %u inputs, %lu bytes, %lu differences from the reference scan\n", FRAME_DECODE_FUZZ_NUMBER * 2 + 1, Byte, Fail);
+	
+	return Fail ? 1 : 0;
+}
+
+#else
+int main(void)
+{
+	unsigned short PayloadLen[3] = {16, 256, 1024};
+	unsigned short ChunkLen[2] = {64, 1024};
+	stu_MQTTDownlinkStat_t stu_Stat;
+	unsigned long FrameNumber;
+	unsigned long ErrorNumber;
+	unsigned short Len;
+	unsigned short Offset;
+	unsigned short Chunk;
+	unsigned long Round;
+	unsigned char i, j;
+	double Time;
+	clock_t Start;
+	
+	srand(1);
+	
+	for(i=0; i<3; i++)
+	{
+		/* back-to-back dataframes of Command 0x25 */
+		for(Len=0; (Len + PayloadLen[i] + 6) <= sizeof(FrameDecode_Stream); )
+		{
+			Len += FrameDecode_FramePut(&FrameDecode_Stream[Len], PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE, PayloadLen[i]);
+		}
+	
+		for(j=0; j<2; j++)
+		{
+			MQTTProtocol_Init();
+			MQTTProtocol_GetDownlinkStat(&stu_Stat);
+	
+			FrameNumber = stu_Stat.DecodeFrameNumber;
+			ErrorNumber = stu_Stat.GarbageNumber + stu_Stat.LengthErrorNumber + stu_Stat.CheckErrorNumber;
+	
+			Round = 0;
+			Start = clock();
+	
+			do
+			{
+				for(Offset=0; Offset<Len; Offset+=Chunk)
+				{
+					Chunk = ((Len - Offset) > ChunkLen[j]) ? ChunkLen[j] : (Len - Offset);
+	
+					MQTTProtocol_FrameDecode(PROTOCOL_COMM_TYPE_WIFI, &FrameDecode_Stream[Offset], Chunk);
+				}
+	
+				Round++;
+				Time = (double)(clock() - Start) / CLOCKS_PER_SEC;
+	
+			}while(Time < 0.5);
+	
+			MQTTProtocol_GetDownlinkStat(&stu_Stat);
+	
+			FrameNumber = stu_Stat.DecodeFrameNumber - FrameNumber;
+			ErrorNumber = stu_Stat.GarbageNumber + stu_Stat.LengthErrorNumber + stu_Stat.CheckErrorNumber - ErrorNumber;
+	
+			printf("payload %4u B, chunk %4u B: %7.1f MB/s, %8.0f dataframes/s, %lu errors\n",
+				   PayloadLen[i], ChunkLen[j], Round * Len / Time / 1e6, FrameNumber / Time, ErrorNumber);
+		}
+	}
+	
+	return 0;
+}
+
+#endif
+#endif
+
+/**
+  * @Brief	Fuzz target for libFuzzer
+  * @Param	pData: input
+  *			Size : input size
+  * @Retval	0
+  *	@Note	A difference from the reference scan aborts
+  */
+int LLVMFuzzerTestOneInput(const unsigned char *pData, size_t Size)
+{
+	if(Size > FRAME_DECODE_STREAM_SIZE_MAX)
+	{
+		return 0;
+	}
+	
+	if(FrameDecode_FuzzOne(pData, Size, Size))
+	{
+		abort();
+	}
+	
+	return 0;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Feed the input to the decoder in chunks of random size, compare with the reference scan
+  * @Param	pData: input
+  *			Len	 : input length
+  *			Seed : seed of the chunk sizes
+  * @Retval	0->same result, 1->difference
+  */
+static unsigned char FrameDecode_FuzzOne(const unsigned char *pData, unsigned short Len, unsigned int Seed)
+{
+	static stu_FrameDecode_Result_t stu_Reference;
+	stu_MQTTDownlinkStat_t stu_Stat;
+	unsigned short Offset;
+	unsigned short Chunk;
+	unsigned short i;
+	
+	FrameDecode_Reference(pData, Len, &stu_Reference);
+	
+	/* the input is kept for the reference, the decoder is fed from a copy */
+	memcpy(FrameDecode_Feed, pData, Len);
+	
+	memset(&stu_FrameDecode_Result, 0, sizeof(stu_FrameDecode_Result));
+	FrameDecode_CatchFlag = 1;
+	FrameDecode_CatchError = 0;
+	
+	MQTTProtocol_Init();
+	MQTTProtocol_GetDownlinkStat(&stu_Stat);
+	
+	stu_FrameDecode_Result.DecodeFrameNumber = stu_Stat.DecodeFrameNumber;
+	stu_FrameDecode_Result.GarbageNumber = stu_Stat.GarbageNumber;
+	stu_FrameDecode_Result.LengthErrorNumber = stu_Stat.LengthErrorNumber;
+	stu_FrameDecode_Result.CheckErrorNumber = stu_Stat.CheckErrorNumber;
+	
+	for(Offset=0; Offset<Len; Offset+=Chunk)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		Chunk = 1 + ((Seed >> 16) % ((Seed & 0x100) ? 16 : 1100));
+	
+		if(Chunk > (Len - Offset))
+		{
+			Chunk = Len - Offset;
+		}
+	
+		MQTTProtocol_FrameDecode(PROTOCOL_COMM_TYPE_WIFI, &FrameDecode_Feed[Offset], Chunk);
+	}
+	
+	FrameDecode_CatchFlag = 0;
+	
+	MQTTProtocol_GetDownlinkStat(&stu_Stat);
+	
+	stu_FrameDecode_Result.DecodeFrameNumber = stu_Stat.DecodeFrameNumber - stu_FrameDecode_Result.DecodeFrameNumber;
+	stu_FrameDecode_Result.GarbageNumber = stu_Stat.GarbageNumber - stu_FrameDecode_Result.GarbageNumber;
+	stu_FrameDecode_Result.LengthErrorNumber = stu_Stat.LengthErrorNumber - stu_FrameDecode_Result.LengthErrorNumber;
+	stu_FrameDecode_Result.CheckErrorNumber = stu_Stat.CheckErrorNumber - stu_FrameDecode_Result.CheckErrorNumber;
+	
+	for(i=0; (i<stu_Reference.FrameNumber) && (i<stu_FrameDecode_Result.FrameNumber); i++)
+	{
+		if((stu_FrameDecode_Result.Frame[i].Len != stu_Reference.Frame[i].Len) ||
+		   (stu_FrameDecode_Result.Frame[i].Hash != stu_Reference.Frame[i].Hash))
+		{
+			FrameDecode_CatchError = 1;
+		}
+	}
+	
+	if(FrameDecode_CatchError ||
+	   (stu_FrameDecode_Result.FrameNumber != stu_Reference.FrameNumber) ||
+	   (stu_FrameDecode_Result.DecodeFrameNumber != stu_Reference.DecodeFrameNumber) ||
+	   (stu_FrameDecode_Result.GarbageNumber != stu_Reference.GarbageNumber) ||
+	   (stu_FrameDecode_Result.LengthErrorNumber != stu_Reference.LengthErrorNumber) ||
+	   (stu_FrameDecode_Result.CheckErrorNumber != stu_Reference.CheckErrorNumber))
+	{
+		printf("  difference, %u byte input: dataframes %lu/%lu(0x25: %u/%u), garbage %lu/%lu, DataLength errors %lu/%lu, CheckValue errors %lu/%lu\n",
+			   Len, stu_FrameDecode_Result.DecodeFrameNumber, stu_Reference.DecodeFrameNumber,
+			   stu_FrameDecode_Result.FrameNumber, stu_Reference.FrameNumber,
+			   stu_FrameDecode_Result.GarbageNumber, stu_Reference.GarbageNumber,
+			   stu_FrameDecode_Result.LengthErrorNumber, stu_Reference.LengthErrorNumber,
+			   stu_FrameDecode_Result.CheckErrorNumber, stu_Reference.CheckErrorNumber);
+	
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+  * @Brief	Reference scan of the whole input(rules of the dataframe, no chunk / buffer handling)
+  * @Param	pData	: input
+  *			Len		: input length
+  *			pResult	: point to the struct to store the result
+  * @Retval	None
+  *	@Note	A partial dataframe at the end stays unhandled, as in the decoder waiting for more data
+  */
+static void FrameDecode_Reference(const unsigned char *pData, unsigned short Len, stu_FrameDecode_Result_t *pResult)
+{
+	unsigned short Offset = 0;
+	unsigned short DataLen;
+	unsigned char XORCheck;
+	unsigned short i;
+	
+	memset(pResult, 0, sizeof(stu_FrameDecode_Result_t));
+	
+	while(Offset < Len)
+	{
+		if(pData[Offset] != 0xAA)
+		{
+			pResult->GarbageNumber++;
+			Offset++;
+	
+			continue;
+		}
+	
+		if((Len - Offset) < 3)
+		{
+			return;
+		}
+	
+		DataLen = (pData[Offset + 1] << 8) | pData[Offset + 2];
+	
+		if((DataLen < 3) || ((DataLen + 3) > MQTT_DOWNLINK_FRAME_SIZE_MAX))
+		{
+			pResult->LengthErrorNumber++;
+			Offset++;
+	
+			continue;
+		}
+	
+		if((Len - Offset) < (DataLen + 3))
+		{
+			return;
+		}
+	
+		XORCheck = 0;
+	
+		for(i=1; i<(DataLen + 1); i++)
+		{
+			XORCheck ^= pData[Offset + i];
+		}
+	
+		if((pData[Offset + DataLen + 2] != 0x55) || (pData[Offset + DataLen + 1] != XORCheck))
+		{
+			pResult->CheckErrorNumber++;
+			Offset++;
+	
+			continue;
+		}
+	
+		pResult->DecodeFrameNumber++;
+	
+		if(pData[Offset + 3] == PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE)
+		{
+			pResult->Frame[pResult->FrameNumber].Hash = FrameDecode_Hash(&pData[Offset], DataLen + 3);
+			pResult->Frame[pResult->FrameNumber].Len = DataLen + 3;
+			pResult->FrameNumber++;
+		}
+	
+		Offset += DataLen + 3;
+	}
+}
+
+/**
+  * @Brief	FNV-1a hash of the dataframe
+  * @Param	pData: dataframe
+  *			Len	 : dataframe length
+  * @Retval	hash
+  */
+static unsigned long FrameDecode_Hash(const unsigned char *pData, unsigned short Len)
+{
+	unsigned long Hash = 2166136261UL;
+	
+	while(Len--)
+	{
+		Hash = ((Hash ^ *pData++) * 16777619UL) & 0xFFFFFFFF;
+	}
+	
+	return Hash;
+}
+
+#ifndef FRAME_DECODE_LIBFUZZER
+/**
+  * @Brief	Put a valid dataframe
+  * @Param	pBuff		: point to the buffer
+  *			Command		: Command
+  *			PayloadLen	: DataPayload length
+  * @Retval	dataframe length
+  */
+static unsigned short FrameDecode_FramePut(unsigned char *pBuff, unsigned char Command, unsigned short PayloadLen)
+{
+	unsigned short DataLen = PayloadLen + 3;
+	unsigned char XORCheck = 0;
+	unsigned short i;
+	
+	pBuff[0] = 0xAA;
+	pBuff[1] = DataLen >> 8;
+	pBuff[2] = DataLen & 0xFF;
+	pBuff[3] = Command;
+	
+	for(i=0; i<PayloadLen; i++)
+	{
+		pBuff[4 + i] = rand();
+	}
+	
+	for(i=1; i<(DataLen + 1); i++)
+	{
+		XORCheck ^= pBuff[i];
+	}
+	
+	pBuff[DataLen + 1] = XORCheck;
+	pBuff[DataLen + 2] = 0x55;
+	
+	return DataLen + 3;
+}
+#endif
+
+#if !defined(FRAME_DECODE_BENCH) && !defined(FRAME_DECODE_LIBFUZZER)
+/**
+  * @Brief	Build a random stream of dataframes / corrupted dataframes / garbage
+  * @Param	pBuff: point to the buffer(FRAME_DECODE_STREAM_SIZE_MAX byte)
+  * @Retval	stream length
+  */
+static unsigned short FrameDecode_StreamBuild(unsigned char *pBuff)
+{
+	static const unsigned char Command[] =
+	{
+		PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE, PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE,
+		PROTOCOL_SERVER_RESPONSE_UPDATE_FIRMWARE, PROTOCOL_SERVER_RESPONSE_GET_SYSTIME,
+		PROTOCOL_SERVER_RESPONSE_UPDATE_CHECK, PROTOCOL_SERVER_COMMAND, 0x00, 0xAA,
+	};
+	unsigned short Target;
+	unsigned short Len = 0;
+	unsigned short PayloadLen;
+	unsigned short FrameLen;
+	unsigned short i;
+	
+	Target = rand() % FRAME_DECODE_STREAM_SIZE_MAX;
+	
+	while(Len < Target)
+	{
+		PayloadLen = (rand() % 4) ? (rand() % 32) : (rand() % (MQTT_DOWNLINK_FRAME_SIZE_MAX - 5));
+	
+		if((Len + PayloadLen + 6) > FRAME_DECODE_STREAM_SIZE_MAX)
+		{
+			break;
+		}
+	
+		switch(rand() % 8)
+		{
+			case 0:		// garbage
+			{
+				for(i=rand() % 16; i && (Len < FRAME_DECODE_STREAM_SIZE_MAX); i--)
+				{
+					pBuff[Len++] = rand();
+				}
+			}
+			break;
+	
+			case 1:		// dataframe with a byte damaged
+			{
+				FrameLen = FrameDecode_FramePut(&pBuff[Len], Command[rand() % sizeof(Command)], PayloadLen);
+				pBuff[Len + rand() % FrameLen] ^= 1 << (rand() % 8);
+				Len += FrameLen;
+			}
+			break;
+	
+			case 2:		// dataframe cut short
+			{
+				FrameLen = FrameDecode_FramePut(&pBuff[Len], Command[rand() % sizeof(Command)], PayloadLen);
+				Len += rand() % FrameLen;
+			}
+			break;
+	
+			case 3:		// dataframe with DataLength too large
+			{
+				FrameLen = FrameDecode_FramePut(&pBuff[Len], Command[rand() % sizeof(Command)], PayloadLen);
+				pBuff[Len + 1] |= 0x80;
+				Len += FrameLen;
+			}
+			break;
+	
+			default:	// valid dataframe
+			{
+				Len += FrameDecode_FramePut(&pBuff[Len], Command[rand() % sizeof(Command)], PayloadLen);
+			}
+			break;
+		}
+	}
+	
+	return Len;
+}
+#endif
+
+
+/*-------------Stub Functions Definition-----------*/
+/* Firmware package dataframe handled: the dataframe starts 4 bytes in front of the DataPayload */
+uint8_t Mid_Firmware_Download_Pro(void (*pFlashWriteData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashReadData)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), void (*pFlashProgram)(uint8_t *pBuffer, uint32_t Addr, uint16_t Num), uint8_t *pData)
+{
+	unsigned char *pFrame = pData - 4;
+	unsigned short Len;
+	
+	if(!FrameDecode_CatchFlag)
+	{
+		return 0;
+	}
+	
+	if(stu_FrameDecode_Result.FrameNumber >= FRAME_DECODE_FRAME_SUM_MAX)
+	{
+		FrameDecode_CatchError = 1;
+	
+		return 0;
+	}
+	
+	Len = ((pFrame[1] << 8) | pFrame[2]) + 3;
+	
+	stu_FrameDecode_Result.Frame[stu_FrameDecode_Result.FrameNumber].Hash = FrameDecode_Hash(pFrame, Len);
+	stu_FrameDecode_Result.Frame[stu_FrameDecode_Result.FrameNumber].Len = Len;
+	stu_FrameDecode_Result.FrameNumber++;
+	
+	return 0;
+}
+
+void Mid_Firmware_InfoUpdate(stu_Firmware_t FirmwarePara)
+{
+}
+
+void App_Terminal_ModeChange(uint8_t Zone, en_Terminal_WorkMode_t WorkMode, en_Terminal_CMDSource_t CMDSource)
+{
+	pTerminalMode->WorkMode = WorkMode;
+}
+
+uint8_t *Mid_Clock_GetDateTime(void)
+{
+	static uint8_t DateTime[] = "2026-10-19-12:00 ";
+	
+	return DateTime;
+}
+
+void Mid_Clock_Sync(unsigned long TimeStamp)
+{
+}
+
+void Mid_Flash_ImageWrite(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
+{
+}
+
+void Mid_Flash_ReadData(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
+{
+	memset(pBuffer, 0xFF, Num);
+}
+
+void Mid_Flash_WriteSector(uint8_t *pBuffer, uint32_t Addr, uint16_t Num)
+{
+}
+
+uint8_t Mid_Outbox_Append(uint8_t Event, uint8_t Data, uint16_t QueueInTick, uint8_t *pTime, uint16_t *pSlot)
+{
+	return 0xFF;
+}
+
+uint8_t Mid_Outbox_Read(stu_Outbox_Record_t *pRecord)
+{
+	return 0xFF;
+}
+
+uint8_t Mid_Outbox_Claim(uint16_t Slot)
+{
+	return 0xFF;
+}
+
+void Mid_Outbox_Release(uint8_t Number, uint8_t Delivered)
+{
+}
+
+uint16_t Mid_Outbox_GetReadMark(void)
+{
+	return 0;
+}
+
+void Mid_Outbox_Ack(uint16_t Mark)
+{
+}
+
+void Mid_Outbox_Rewind(void)
+{
+}
+
+uint8_t Mid_Outbox_GetUnreadState(void)
+{
+	return 0;
+}
+
+uint8_t Mid_PowerManage_GetACState(void)
+{
+	return 1;
+}
+
+uint8_t Mid_PowerManage_GetBatteryLow(void)
+{
+	return 0;
+}
+
+void Mid_WiFi_GetLinkQuality(stu_WiFi_LinkQuality_t *pQuality)
+{
+	memset(pQuality, 0, sizeof(stu_WiFi_LinkQuality_t));
+}
+
+void Mid_WiFi_GetReconnectStat(en_WiFi_ReconnectLayer_t Layer, stu_WiFi_ReconnectStat_t *pStat)
+{
+	memset(pStat, 0, sizeof(stu_WiFi_ReconnectStat_t));
+}
+
+void Mid_WiFi_MQTT_PublishCBFRegister(WiFi_MQTTPubCBF_t pCBF)
+{
+}
+
+/* responses to the server requests: publish accepted, nothing sent */
+uint8_t Mid_WiFi_MQTT_PublishMessage(uint8_t *pData, uint8_t Retain)
+{
+	return 0;
+}
+
+uint8_t Mid_WiFi_MQTT_PublishReady(void)
+{
+	return 1;
+}
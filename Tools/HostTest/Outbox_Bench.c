@@ -0,0 +1,262 @@
+/****************************************************
+  * @Name	Outbox_Bench.c
+  * @Brief	Host benchmark of the event outbox: MainFirmware Middle/Mid_Outbox.c + Mid_Flash.c on the file-backed W25Q64(W25Q64_Emu.c)
+  * @Instruction:
+  *			1. outage	: events appended while the link is down(Mid_Outbox_Pro polled between them, as the task loop does)
+  *			2. reboot	: image file closed / opened again, the indexes rebuilt by Mid_Outbox_Init
+  *			3. replay	: batches of OUTBOX_BENCH_BATCH records read out, acked by the read mark after the publish
+  *			4. link drop: every 4th batch rewound instead of acked(publish failed), replayed
+  *			5. overflow	: more events than the outbox holds, the oldest sector dropped
+  *			-------------------------------------------------------------------
+  *			Time is the SPI2 bus + chip busy time of the emulator, OS_GetTickCount runs on it(10ms tick).
+  *			Every record read out is checked against the event appended(counter in the Time field),
+  *			the replay must come in order with no gap / duplicate; exit code 1 on any failure
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f10x.h"
+#include "mid_flash.h"
+#include "mid_outbox.h"
+#include "os_system.h"
+#include "W25Q64_Emu.h"
+
+#define OUTBOX_BENCH_FILE		"Build/W25Q64_Outbox_Bench.bin"
+
+/* records per publish(MQTT_EVENT_BATCH_RECORD_MAX) */
+#define OUTBOX_BENCH_BATCH		8
+
+#define OUTBOX_BENCH_OUTAGE		3000
+
+/*-------------Internal Functions Declaration------*/
+static double 	Bench_Time(void);
+static void 	Bench_Append(uint32_t Number);
+static uint8_t 	Bench_Replay(const char *pName, uint32_t Expect, uint8_t DropFlag);
+static void 	Bench_Check(const char *pName, uint8_t Result);
+
+
+/*-------------Module Variables Declaration--------*/
+uint32_t Bench_AppendCounter;		// events appended so far, kept in the Time field of the record
+uint32_t Bench_ReplayCounter;		// next event expected from the replay
+uint8_t  Bench_Fail;
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	stu_Outbox_Stat_t stu_Stat;
+	stu_W25Q64_Emu_Stat_t stu_Emu_Stat;
+	uint32_t Pending;
+	double 	 Time;
+	
+	W25Q64_Emu_Open(OUTBOX_BENCH_FILE, 1);
+	
+	Mid_Flash_Init();
+	Mid_Outbox_Init();
+	
+	/* 1. outage */
+	Time = Bench_Time();
+	Bench_Append(OUTBOX_BENCH_OUTAGE);
+	Time = Bench_Time() - Time;
+	
+	Mid_Outbox_GetStat(&stu_Stat);
+	W25Q64_Emu_GetStat(&stu_Emu_Stat);
+	
+	printf("outage   : %u events appended in %.2f s(%.2f ms each, longest %u ms), %u sector erases\n",
+		   OUTBOX_BENCH_OUTAGE, Time / 1e6, Time / 1e3 / OUTBOX_BENCH_OUTAGE, stu_Stat.AppendTimeMax * 10, stu_Stat.EraseNumber);
+	
+	Bench_Check("outage, all events pending", stu_Stat.PendingNumber == OUTBOX_BENCH_OUTAGE);
+	
+	/* 2. reboot */
+	Pending = Mid_Outbox_GetPendingNumber();
+	
+	W25Q64_Emu_Close();
+	W25Q64_Emu_Open(OUTBOX_BENCH_FILE, 0);
+	
+	Time = Bench_Time();
+	Mid_Flash_Init();
+	Mid_Outbox_Init();
+	Time = Bench_Time() - Time;
+	
+	printf("reboot   : indexes rebuilt in %.2f ms, %u events pending\n", Time / 1e3, Mid_Outbox_GetPendingNumber());
+	
+	Bench_Check("reboot, pending events kept", Mid_Outbox_GetPendingNumber() == Pending);
+	
+	/* 3. replay */
+	Bench_Check("replay in order", Bench_Replay("replay   ", OUTBOX_BENCH_OUTAGE, 0));
+	
+	/* 4. link drop */
+	Bench_Append(OUTBOX_BENCH_OUTAGE);
+	Bench_Check("replay with link drops in order", Bench_Replay("link drop", OUTBOX_BENCH_OUTAGE, 1));
+	
+	/* 5. overflow */
+	Mid_Outbox_GetStat(&stu_Stat);
+	Pending = stu_Stat.DropNumber;
+	
+	W25Q64_Emu_ClearStat();
+	Bench_Append(OUTBOX_RECORD_SUM + 500);
+	
+	Mid_Outbox_GetStat(&stu_Stat);
+	W25Q64_Emu_GetStat(&stu_Emu_Stat);
+	
+	printf("overflow : %u events appended, %u dropped, %u pending, sector erased %u times at most(%u erases / %u sectors)\n",
+		   OUTBOX_RECORD_SUM + 500, stu_Stat.DropNumber - Pending, stu_Stat.PendingNumber,
+		   stu_Emu_Stat.SectorEraseMax, stu_Emu_Stat.EraseNumber, OUTBOX_SECTOR_SUM);
+	
+	/* the oldest events dropped, the replay starts at the oldest one kept */
+	Bench_ReplayCounter = Bench_AppendCounter - stu_Stat.PendingNumber;
+	
+	Bench_Check("overflow, outbox full of the newest events",
+				(stu_Stat.PendingNumber > OUTBOX_RECORD_SUM - OUTBOX_RECORD_PER_SECTOR) && (stu_Stat.PendingNumber <= OUTBOX_RECORD_SUM));
+	Bench_Check("overflow, newest events replayed in order", Bench_Replay("overflow ", stu_Stat.PendingNumber, 0));
+	
+	Mid_Outbox_GetStat(&stu_Stat);
+	
+	Bench_Check("no corrupted record", stu_Stat.CorruptNumber == 0);
+	
+	W25Q64_Emu_Close();
+	
+	return Bench_Fail;
+}
+
+/**
+  * @Brief	OS tick of the harness: the emulator time, 10ms per tick
+  * @Param	None
+  * @Retval	tick count
+  */
+unsigned long OS_GetTickCount(void)
+{
+	return (unsigned long)(Bench_Time() / 10000);
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Get the emulator time
+  * @Param	None
+  * @Retval	time(us)
+  */
+static double Bench_Time(void)
+{
+	stu_W25Q64_Emu_Stat_t stu_Emu_Stat;
+	
+	W25Q64_Emu_GetStat(&stu_Emu_Stat);
+	
+	return stu_Emu_Stat.Time;
+}
+
+/**
+  * @Brief	Append events, the counter of the event in the Time field
+  * @Param	Number: events to append
+  * @Retval	None
+  */
+static void Bench_Append(uint32_t Number)
+{
+	uint8_t Time[OUTBOX_TIME_SIZE + 1];
+	
+	while(Number--)
+	{
+		snprintf((char *)Time, sizeof(Time), "%016u", Bench_AppendCounter);
+	
+		Mid_Outbox_Append(Bench_AppendCounter & 0xFF, (Bench_AppendCounter >> 8) & 0xFF, 0, &Time[0], 0);
+		Mid_Outbox_Pro();
+	
+		Bench_AppendCounter++;
+	}
+}
+
+/**
+  * @Brief	Replay the outbox until empty, check every record read out
+  * @Param	pName	: name of the run
+  *			Expect	: events expected
+  *			DropFlag: 1->every 4th batch rewound(publish failed)
+  * @Retval	1->every event accepted once in order, 0->not
+  */
+static uint8_t Bench_Replay(const char *pName, uint32_t Expect, uint8_t DropFlag)
+{
+	stu_Outbox_Record_t stu_Record;
+	stu_Outbox_Stat_t stu_Stat;
+	uint32_t BatchNumber = 0;
+	uint32_t ReadNumber;
+	uint32_t AckNumber;
+	uint32_t Counter;
+	uint32_t Accepted = 0;
+	uint32_t Read = 0;
+	uint8_t  Number;
+	uint8_t  Pass = 1;
+	double 	 Time;
+	char 	 Text[OUTBOX_TIME_SIZE + 1];
+	
+	Mid_Outbox_GetStat(&stu_Stat);
+	ReadNumber = stu_Stat.ReadNumber;
+	AckNumber = stu_Stat.AckNumber;
+	
+	Time = Bench_Time();
+	
+	while(Mid_Outbox_GetUnreadState())
+	{
+		Counter = Bench_ReplayCounter;
+	
+		for(Number=0; Number<OUTBOX_BENCH_BATCH; Number++)
+		{
+			if(Mid_Outbox_Read(&stu_Record))
+			{
+				break;
+			}
+	
+			memcpy(Text, stu_Record.Time, OUTBOX_TIME_SIZE);
+			Text[OUTBOX_TIME_SIZE] = 0;
+	
+			if(((uint32_t)strtoul(Text, 0, 10) != Counter) ||
+			   (stu_Record.Event != (Counter & 0xFF)) || (stu_Record.Data != ((Counter >> 8) & 0xFF)))
+			{
+				Pass = 0;
+			}
+	
+			Counter++;
+			Read++;
+		}
+	
+		BatchNumber++;
+	
+		if(DropFlag && ((BatchNumber % 4) == 0))
+		{
+			Mid_Outbox_Rewind();
+		}
+		else
+		{
+			Mid_Outbox_Ack(Mid_Outbox_GetReadMark());
+	
+			Accepted += Number;
+			Bench_ReplayCounter = Counter;
+		}
+	}
+	
+	Time = Bench_Time() - Time;
+	
+	Mid_Outbox_GetStat(&stu_Stat);
+	
+	printf("%s: %u events accepted in %.2f s(%.0f events/s), %u read out(%u replayed), %u batches\n",
+		   pName, Accepted, Time / 1e6, Accepted / (Time / 1e6), Read, Read - Accepted, BatchNumber);
+	
+	return Pass && (Accepted == Expect) && (stu_Stat.PendingNumber == 0) &&
+		   ((stu_Stat.ReadNumber - ReadNumber) == Read) && ((stu_Stat.AckNumber - AckNumber) == Accepted);
+}
+
+/**
+  * @Brief	Report a check
+  * @Param	pName : check
+  *			Result: 1->pass, 0->fail
+  * @Retval	None
+  */
+static void Bench_Check(const char *pName, uint8_t Result)
+{
+	printf("  %-45s: %s\n", pName, Result ? "pass" : "FAIL");
+	
+	if(!Result)
+	{
+		Bench_Fail = 1;
+	}
+}
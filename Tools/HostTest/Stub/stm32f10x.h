@@ -0,0 +1,16 @@
+/****************************************************
+  * @Name	stm32f10x.h
+  * @Brief	Host stand-in of the device header: the fixed-width types the modules use,
+  *			no peripheral(the harness provides the Hal functions a module calls)
+  ***************************************************/
+
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+
+#endif
@@ -0,0 +1,144 @@
+/****************************************************
+  * @Name	TimeStamp_Test.c
+  * @Brief	Host check and benchmark of Middle/TimeStamp.c
+  * @Instruction:
+  *			Every result checked against gmtime of the C library(TimeStamp - UTC_OFFSET_4):
+  *			- TimeStamp_DateTime_Conversion: 1970 -> 2100 every TIMESTAMP_TEST_STEP seconds, string and terminators
+  *			- TimeStamp_Local_ToTimeStamp / TimeStamp_DateTime_ToTimeStamp: back to the TimeStamp(the string to the minute)
+  *			- TimeStamp_DateTime_Update: minute by minute(steps of 60..66s) over 3 years from the string of the step before,
+  *			  against the full conversion
+  *			-------------------------------------------------------------------
+  *			Time per conversion / per update of the clock minute(Mid_Clock_Pro between corrections),
+  *			exit code 1 on any mismatch
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stm32f10x.h"
+#include "timestamp.h"
+
+/* 1970-01-01 -> 2100-01-01 */
+#define TIMESTAMP_TEST_END			4102444800UL
+#define TIMESTAMP_TEST_STEP			977
+
+/* update run: from 2023-11-14, 3 years */
+#define TIMESTAMP_TEST_UPDATE_START	1700000000UL
+#define TIMESTAMP_TEST_UPDATE_TIME	(3UL * 366 * 86400)
+
+#define TIMESTAMP_TEST_REPEAT		2000000
+
+/*-------------Internal Functions Declaration------*/
+static double 	Test_Time(void);
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	volatile uint32_t Sink = 0;
+	uint32_t Fail = 0;
+	uint32_t Number = 0;
+	unsigned long TimeStamp, LastTimeStamp;
+	unsigned char DateTime[17];
+	unsigned char Update[17];
+	char 	 Ref[32];
+	time_t 	 Local;
+	struct tm stu_Tm;
+	double 	 Time[2];
+	uint32_t i;
+	
+	/* full conversion and back */
+	for(TimeStamp=UTC_OFFSET_4; TimeStamp<TIMESTAMP_TEST_END; TimeStamp+=TIMESTAMP_TEST_STEP)
+	{
+		Local = (time_t)(TimeStamp - UTC_OFFSET_4);
+		gmtime_r(&Local, &stu_Tm);
+	
+		TimeStamp_DateTime_Conversion(TimeStamp, DateTime);
+	
+		snprintf(Ref, sizeof(Ref), "%04d-%02d-%02d", stu_Tm.tm_year + 1900, stu_Tm.tm_mon + 1, stu_Tm.tm_mday);
+		snprintf(Ref + 11, sizeof(Ref) - 11, "%02d:%02d", stu_Tm.tm_hour, stu_Tm.tm_min);
+		Ref[10] = 0;
+	
+		if(memcmp(DateTime, Ref, 17) != 0)
+		{
+			Fail++;
+		}
+	
+		if(TimeStamp_Local_ToTimeStamp(stu_Tm.tm_year + 1900, stu_Tm.tm_mon + 1, stu_Tm.tm_mday,
+									   stu_Tm.tm_hour, stu_Tm.tm_min, stu_Tm.tm_sec) != TimeStamp)
+		{
+			Fail++;
+		}
+	
+		if(TimeStamp_DateTime_ToTimeStamp(DateTime) != TimeStamp - (Local % 60))
+		{
+			Fail++;
+		}
+	
+		Number++;
+	}
+	
+	/* clock minute updated in place */
+	TimeStamp_DateTime_Conversion(TIMESTAMP_TEST_UPDATE_START, Update);
+	LastTimeStamp = TIMESTAMP_TEST_UPDATE_START;
+	
+	for(TimeStamp=TIMESTAMP_TEST_UPDATE_START; TimeStamp<TIMESTAMP_TEST_UPDATE_START + TIMESTAMP_TEST_UPDATE_TIME; TimeStamp+=60 + (TimeStamp % 7))
+	{
+		TimeStamp_DateTime_Update(TimeStamp, LastTimeStamp, Update);
+		TimeStamp_DateTime_Conversion(TimeStamp, DateTime);
+	
+		if(memcmp(DateTime, Update, 17) != 0)
+		{
+			Fail++;
+		}
+	
+		LastTimeStamp = TimeStamp;
+		Number++;
+	}
+	
+	printf("TimeStamp: %u cases, %u mismatches\n", Number, Fail);
+	
+	/* time */
+	Time[0] = Test_Time();
+	
+	for(i=0; i<TIMESTAMP_TEST_REPEAT; i++)
+	{
+		TimeStamp_DateTime_Conversion(TIMESTAMP_TEST_UPDATE_START + i * 60, DateTime);
+		Sink += DateTime[15];
+	}
+	
+	Time[0] = Test_Time() - Time[0];
+	
+	TimeStamp_DateTime_Conversion(TIMESTAMP_TEST_UPDATE_START, DateTime);
+	Time[1] = Test_Time();
+	
+	for(i=1; i<=TIMESTAMP_TEST_REPEAT; i++)
+	{
+		TimeStamp_DateTime_Update(TIMESTAMP_TEST_UPDATE_START + i * 60, TIMESTAMP_TEST_UPDATE_START + (i - 1) * 60, DateTime);
+		Sink += DateTime[15];
+	}
+	
+	Time[1] = Test_Time() - Time[1];
+	
+	printf("  TimeStamp_DateTime_Conversion : %6.1f ns\n", Time[0] / TIMESTAMP_TEST_REPEAT * 1e9);
+	printf("  TimeStamp_DateTime_Update     : %6.1f ns\n", Time[1] / TIMESTAMP_TEST_REPEAT * 1e9);
+	
+	return (Fail != 0);
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Get the monotonic time
+  * @Param	None
+  * @Retval	time(s)
+  */
+static double Test_Time(void)
+{
+	struct timespec Time;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	
+	return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
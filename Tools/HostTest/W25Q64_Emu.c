@@ -0,0 +1,284 @@
+/****************************************************
+  * @Name	W25Q64_Emu.c
+  * @Brief	File-backed W25Q64 behind the SPI2 byte interface(Hal_SPI2_CSDriver / Hal_SPI2_ReadWriteByte)
+  * @Instruction:
+  *			The 8 MB array is a file mapped into memory: its content is kept across runs(reset, reboot of the Terminal)
+  *			Instructions: WRITE_ENABLE, READ_DATA, PAGE_PROGRAM(wraps in the page), SECTOR_ERASE_4KB,
+  *						  BLOCK_ERASE_32KB / 64KB, CHIP_ERASE, READ_STATUS_REGISTER_1(always idle, busy time counted),
+  *						  MANUFACTURER_ID(0xEF16, Winbond W25Q64)
+  *			-------------------------------------------------------------------
+  *			A program only clears bits(AND), a byte needing a bit set again is counted as a fault.
+  *			Erase / program without WRITE_ENABLE ignored, as the chip does
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "stm32f10x.h"
+#include "mid_flash.h"
+#include "W25Q64_Emu.h"
+
+/*-------------Internal Functions Declaration------*/
+static void W25Q64_Emu_Erase(uint32_t Addr, uint32_t Size, double Time);
+
+
+/*-------------Module Variables Declaration--------*/
+int 	 Emu_File = -1;
+uint8_t  *pEmu_Memory;
+
+uint8_t  Emu_Cmd;
+uint8_t  Emu_WriteEnable;
+uint32_t Emu_ByteCount;				// bytes of the instruction since CS low
+uint32_t Emu_Addr;
+uint8_t  Emu_PageBuff[FLASH_PAGE_SIZE];
+uint16_t Emu_PageLen;
+
+uint32_t Emu_SectorErase[W25Q64_EMU_SECTOR_SUM];
+stu_W25Q64_Emu_Stat_t stu_Emu_Stat;
+
+
+/*-------------Module Functions Definition---------*/
+/**
+  * @Brief	Open the chip image file(created erased if missing)
+  * @Param	pFileName: image file
+  *			Erase	 : 1->whole chip erased(0xFF), 0->content kept
+  * @Retval	None
+  */
+void W25Q64_Emu_Open(const char *pFileName, uint8_t Erase)
+{
+	Emu_File = open(pFileName, O_RDWR | O_CREAT, 0644);
+	
+	if((Emu_File < 0) || (ftruncate(Emu_File, W25Q64_EMU_SIZE) != 0))
+	{
+		perror(pFileName);
+		exit(2);
+	}
+	
+	pEmu_Memory = mmap(0, W25Q64_EMU_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, Emu_File, 0);
+	
+	if(pEmu_Memory == MAP_FAILED)
+	{
+		perror("mmap");
+		exit(2);
+	}
+	
+	if(Erase)
+	{
+		memset(pEmu_Memory, 0xFF, W25Q64_EMU_SIZE);
+	}
+	
+	Emu_WriteEnable = 0;
+	
+	W25Q64_Emu_ClearStat();
+}
+
+/**
+  * @Brief	Close the chip image file(content written back)
+  * @Param	None
+  * @Retval	None
+  */
+void W25Q64_Emu_Close(void)
+{
+	munmap(pEmu_Memory, W25Q64_EMU_SIZE);
+	close(Emu_File);
+	
+	Emu_File = -1;
+}
+
+/**
+  * @Brief	Get the memory array(checks of the harness, not counted)
+  * @Param	None
+  * @Retval	point to the 8 MB array
+  */
+uint8_t *W25Q64_Emu_GetMemory(void)
+{
+	return pEmu_Memory;
+}
+
+/**
+  * @Brief	Clear the statistics(time, erase counts)
+  * @Param	None
+  * @Retval	None
+  */
+void W25Q64_Emu_ClearStat(void)
+{
+	memset(&stu_Emu_Stat, 0, sizeof(stu_Emu_Stat));
+	memset(Emu_SectorErase, 0, sizeof(Emu_SectorErase));
+}
+
+/**
+  * @Brief	Get the statistics
+  * @Param	pStat: point to the struct to store the statistics
+  * @Retval	None
+  */
+void W25Q64_Emu_GetStat(stu_W25Q64_Emu_Stat_t *pStat)
+{
+	*pStat = stu_Emu_Stat;
+}
+
+/**
+  * @Brief	CS driven: low starts an instruction, high ends it(program / erase done then)
+  * @Param	state: CS level
+  * @Retval	None
+  */
+void Hal_SPI2_CSDriver(uint8_t state)
+{
+	uint32_t Addr;
+	uint16_t i;
+	
+	if(state == 0)
+	{
+		Emu_ByteCount = 0;
+		Emu_PageLen = 0;
+	
+		return;
+	}
+	
+	if(Emu_WriteEnable && (Emu_ByteCount >= 4))
+	{
+		switch(Emu_Cmd)
+		{
+			case PAGE_PROGRAM:
+			{
+				for(i=0; i<Emu_PageLen; i++)
+				{
+					/* address wraps at the end of the page */
+					Addr = (Emu_Addr & ~(uint32_t)(FLASH_PAGE_SIZE - 1)) | ((Emu_Addr + i) & (FLASH_PAGE_SIZE - 1));
+	
+					if((pEmu_Memory[Addr] & Emu_PageBuff[i]) != Emu_PageBuff[i])
+					{
+						stu_Emu_Stat.ProgramFaultNumber++;
+					}
+	
+					pEmu_Memory[Addr] &= Emu_PageBuff[i];
+				}
+	
+				stu_Emu_Stat.Time += W25Q64_EMU_PAGE_TIME;
+				Emu_WriteEnable = 0;
+			}
+			break;
+	
+			case SECTOR_ERASE_4KB:
+			{
+				W25Q64_Emu_Erase(Emu_Addr, FLASH_SECTOR_SIZE, W25Q64_EMU_SECTOR_TIME);
+			}
+			break;
+	
+			case BLOCK_ERASE_32KB:
+			{
+				W25Q64_Emu_Erase(Emu_Addr, FLASH_BLOCK_SIZE_32KB, W25Q64_EMU_BLOCK32_TIME);
+			}
+			break;
+	
+			case BLOCK_ERASE_64KB:
+			{
+				W25Q64_Emu_Erase(Emu_Addr, FLASH_BLOCK_SIZE_64KB, W25Q64_EMU_BLOCK64_TIME);
+			}
+			break;
+	
+		}
+	}
+	
+	if(Emu_WriteEnable && (Emu_ByteCount == 1) && (Emu_Cmd == CHIP_ERASE))
+	{
+		W25Q64_Emu_Erase(0, W25Q64_EMU_SIZE, W25Q64_EMU_CHIP_TIME);
+	}
+}
+
+/**
+  * @Brief	A byte exchanged on the SPI2 bus
+  * @Param	TxData: byte from the MCU
+  * @Retval	byte from the chip
+  */
+uint8_t Hal_SPI2_ReadWriteByte(uint8_t TxData)
+{
+	uint8_t RxData = 0xFF;
+	
+	stu_Emu_Stat.Time += W25Q64_EMU_BYTE_TIME;
+	
+	if(Emu_ByteCount == 0)
+	{
+		Emu_Cmd = TxData;
+	
+		if(Emu_Cmd == WRITE_ENABLE)
+		{
+			Emu_WriteEnable = 1;
+		}
+		else if(Emu_Cmd == WRITE_DISABLE)
+		{
+			Emu_WriteEnable = 0;
+		}
+	}
+	else if(Emu_ByteCount <= 3)
+	{
+		/* 24bit address, high byte first */
+		Emu_Addr = (Emu_ByteCount == 1) ? ((uint32_t)TxData << 16) : (Emu_Addr | ((uint32_t)TxData << ((3 - Emu_ByteCount) * 8)));
+	
+		if(Emu_Cmd == READ_STATUS_REGISTER_1)
+		{
+			RxData = 0x00;
+		}
+	}
+	else if(Emu_Cmd == READ_DATA)
+	{
+		RxData = pEmu_Memory[(Emu_Addr + Emu_ByteCount - 4) % W25Q64_EMU_SIZE];
+	}
+	else if(Emu_Cmd == PAGE_PROGRAM)
+	{
+		/* the last 256 bytes sent are programmed */
+		Emu_PageBuff[Emu_PageLen % FLASH_PAGE_SIZE] = TxData;
+	
+		if(Emu_PageLen < FLASH_PAGE_SIZE)
+		{
+			Emu_PageLen++;
+		}
+	}
+	else if(Emu_Cmd == READ_STATUS_REGISTER_1)
+	{
+		RxData = 0x00;
+	}
+	else if(Emu_Cmd == MANUFACTURER_ID)
+	{
+		RxData = (Emu_ByteCount == 4) ? 0xEF : 0x16;
+	}
+	
+	Emu_ByteCount++;
+	
+	return RxData;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Erase the Sector / Block holding Addr
+  * @Param	Addr: address inside
+  *			Size: Sector / Block size
+  *			Time: busy time(us)
+  * @Retval	None
+  */
+static void W25Q64_Emu_Erase(uint32_t Addr, uint32_t Size, double Time)
+{
+	uint32_t Sector;
+	
+	Addr &= ~(Size - 1);
+	
+	memset(&pEmu_Memory[Addr], 0xFF, Size);
+	
+	for(Sector=Addr / W25Q64_EMU_SECTOR_SIZE; Sector<(Addr + Size) / W25Q64_EMU_SECTOR_SIZE; Sector++)
+	{
+		Emu_SectorErase[Sector]++;
+		stu_Emu_Stat.EraseNumber++;
+	
+		if(Emu_SectorErase[Sector] > stu_Emu_Stat.SectorEraseMax)
+		{
+			stu_Emu_Stat.SectorEraseMax = Emu_SectorErase[Sector];
+		}
+	}
+	
+	stu_Emu_Stat.Time += Time;
+	Emu_WriteEnable = 0;
+}
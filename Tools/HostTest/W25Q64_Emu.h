@@ -0,0 +1,34 @@
+#ifndef __W25Q64_EMU_H_
+#define __W25Q64_EMU_H_
+
+/* W25Q64: 8 MB, 4 KB Sector */
+#define W25Q64_EMU_SIZE				(8UL << 20)
+#define W25Q64_EMU_SECTOR_SIZE		4096
+#define W25Q64_EMU_SECTOR_SUM		(W25Q64_EMU_SIZE / W25Q64_EMU_SECTOR_SIZE)
+
+/* Timings(us): SPI2 at 18MHz, datasheet typical values of the W25Q64JV */
+#define W25Q64_EMU_BYTE_TIME		(8.0 / 18.0)
+#define W25Q64_EMU_PAGE_TIME		400.0
+#define W25Q64_EMU_SECTOR_TIME		45000.0
+#define W25Q64_EMU_BLOCK32_TIME		120000.0
+#define W25Q64_EMU_BLOCK64_TIME		150000.0
+#define W25Q64_EMU_CHIP_TIME		20000000.0
+
+/* Emulator statistics */
+typedef struct
+{
+	double 	 Time;						// bus and busy time(us)
+	uint32_t EraseNumber;				// Sectors erased(a Block counts its Sectors)
+	uint32_t SectorEraseMax;			// erases of the Sector erased most
+	uint32_t ProgramFaultNumber;		// bytes programmed over a bit not erased(0 -> 1 needed)
+	
+}stu_W25Q64_Emu_Stat_t;
+
+
+void 	 W25Q64_Emu_Open(const char *pFileName, uint8_t Erase);
+void 	 W25Q64_Emu_Close(void);
+uint8_t  *W25Q64_Emu_GetMemory(void);
+void 	 W25Q64_Emu_ClearStat(void);
+void 	 W25Q64_Emu_GetStat(stu_W25Q64_Emu_Stat_t *pStat);
+
+#endif
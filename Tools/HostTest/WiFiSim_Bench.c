@@ -0,0 +1,559 @@
+/****************************************************
+  * @Name	WiFiSim_Bench.c
+  * @Brief	Host benchmark of the WiFi link: MainFirmware Mid_WiFi.c on the simulated ESP8266 and MQTT server(Mid_WiFiSim.c, WIFI_SIMULATOR_MODE)
+  * @Instruction:
+  *			Mid_WiFi.c, Mid_WiFiSim.c, MQTT_Protocol.c, Mid_MQTT.c, Mid_Firmware.c, Mid_Outbox.c, Mid_Flash.c are linked as they are,
+  *			the W25Q64 is the file-backed emulator(W25Q64_Emu.c), the App / Hal functions they call are stubbed here.
+  *			The AT-commands go to the simulated module instead of WiFi_USART(USART3), the answers come back
+  *			at the 115200bps rate of the UART(Mid_WiFiSim_Pro), time is the OS tick(10ms) run by the harness,
+  *			the busy time of the W25Q64(emulator) adding the ticks the Systick counts while the tasks wait on it:
+  *			1. bring-up	: power on -> AP joined, broker connected, both topics subscribed
+  *			2. OTA		: update check(queued at once, Mid_WiFi queues it every 60s), download of the WIFISIM_OTA_IMAGE_SIZE image
+  *						  on the lossy link, the image read back from the W25Q64 and compared with WIFISIM_OTA_PATTERN
+  *			3. publish	: WIFISIM_BENCH_PUB_RATE NORMAL-class events offered per tick for WIFISIM_BENCH_PUB_TIME, drained
+  *			4. soak		: WIFISIM_BENCH_SOAK_TIME with one event per second under the fault script(ERROR / silence / AP / MQTT drop)
+  *			5. poll		: fault script held, one event every WIFISIM_BENCH_POLL_PERIOD over the AT+CWSTATE? polls of the READY module
+  *						  ("OK" right behind "+CWSTATE"), every publish accepted by the broker must be reported OK
+  *						  (publish results counted by Bench_PubResult in front of MQTTProtocol_PublishResult)
+  *			-------------------------------------------------------------------
+  *			The simulated server reports the CRC16 of the image inverted: the download ends in FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL
+  *			by design, the image written is checked instead. Exit code 1 on any check failing.
+  *			WIFISIM_BENCH_OTA_ONLY: run 1 and 2 only(OTA_Bench_* builds of the Makefile: download window, package size, link)
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "stm32f10x.h"
+#include "mid_wifi.h"
+#include "mid_wifisim.h"
+#include "mqtt_protocol.h"
+#include "mid_mqtt.h"
+#include "mid_firmware.h"
+#include "mid_flash.h"
+#include "mid_outbox.h"
+#include "mid_clock.h"
+#include "mid_powermanage.h"
+#include "hal_gpio.h"
+#include "hal_usart.h"
+#include "device.h"
+#include "app.h"
+#include "os_system.h"
+#include "W25Q64_Emu.h"
+
+#define WIFISIM_BENCH_FILE			"Build/W25Q64_WiFiSim_Bench.bin"
+
+/* publish run: events offered per tick, ticks offered */
+#define WIFISIM_BENCH_PUB_RATE		2
+#define WIFISIM_BENCH_PUB_TIME		1000
+
+/* soak run: ticks under the fault script, ticks given to drain the outbox after it */
+#define WIFISIM_BENCH_SOAK_TIME		60000
+#define WIFISIM_BENCH_DRAIN_TIME	12000
+
+/* poll run: ticks(AT+CWSTATE? every 60s), ticks between the events offered */
+#define WIFISIM_BENCH_POLL_TIME		13000
+#define WIFISIM_BENCH_POLL_PERIOD	10
+
+/*-------------Internal Functions Declaration------*/
+static void 	 Bench_UIDMap(void);
+static void 	 Bench_Tick(void);
+static uint32_t  Bench_RunUntil(uint8_t (*pDone)(void), uint32_t TickMax);
+static uint8_t 	 Bench_MQTTReady(void);
+static uint8_t 	 Bench_NewVersion(void);
+static uint8_t 	 Bench_OTAEnd(void);
+static void 	 Bench_PubResult(uint8_t Result);
+static void 	 Bench_Check(const char *pName, uint8_t Result);
+#ifndef WIFISIM_BENCH_OTA_ONLY
+static void 	 Bench_Publish(void);
+static void 	 Bench_Soak(void);
+static void 	 Bench_Poll(void);
+static uint8_t 	 Bench_OutboxEmpty(void);
+static void 	 Bench_Offer(uint32_t Number);
+#endif
+
+
+/*-------------Module Variables Declaration--------*/
+/* modules around Mid_WiFi.c / MQTT_Protocol.c */
+stu_TerminalMode_t 	stu_TerminalMode;
+stu_TerminalMode_t 	*pTerminalMode = &stu_TerminalMode;
+stu_Sensor_t 		stu_Sensor[SENSOR_NUMBER_MAX];
+stu_SystemPara_t 	stu_SystemPara;
+unsigned char 		STM32_UID[12];
+
+/* App step of the harness: download driven while Bench_OTAFlag */
+uint8_t  Bench_OTAFlag;
+uint16_t Bench_OTAPercentage;
+
+/* publish result CBF of Mid_WiFi(MQTTProtocol_PublishResult), results reported so far(en_WiFi_MQTTPubResult_t) */
+extern WiFi_MQTTPubCBF_t WiFi_MQTTPubCBF;
+WiFi_MQTTPubCBF_t Bench_PubCBF;
+uint32_t Bench_PubResultNumber[WIFI_MQTT_PUB_LOST + 1];
+
+uint32_t Bench_OfferNumber;		// events offered so far
+double 	 Bench_FlashTime;		// busy time of the W25Q64 turned into ticks so far(us)
+uint8_t  Bench_Fail;
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	stu_WiFiSim_Stat_t stu_Sim_Stat;
+	stu_Firmware_DownloadStat_t stu_Download_Stat;
+	uint32_t Tick;
+	uint32_t Addr;
+	uint32_t Error;
+	uint8_t  *pMemory;
+	clock_t  Clock;
+	
+	Clock = clock();
+	
+	Bench_UIDMap();
+	W25Q64_Emu_Open(WIFISIM_BENCH_FILE, 1);
+	
+	Mid_Flash_Init();
+	Mid_Outbox_Init();
+	Mid_Clock_Init();
+	Mid_WiFi_Init();
+	Mid_MQTT_Init();
+	MQTTProtocol_Init();
+	Mid_Firmware_Init();
+	
+	Bench_PubCBF = WiFi_MQTTPubCBF;
+	WiFi_MQTTPubCBF = &Bench_PubResult;
+	
+	/* 1. bring-up */
+	Tick = Bench_RunUntil(&Bench_MQTTReady, 6000);
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	
+	printf("bring-up : MQTT ready after %.2f s, topics subscribed %.2f s after reset(%u AT-commands)\n",
+		   Tick / 100.0, stu_Sim_Stat.BringUpTime / 100.0, stu_Sim_Stat.CmdNumber);
+	
+	Bench_Check("bring-up, MQTT ready", Bench_MQTTReady() && (stu_Sim_Stat.BringUpTime != 0));
+	
+	/* 2. OTA */
+	MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_UPDATE_CHECK, 0, MQTT_EVENT_CLASS_REQUEST);
+	
+	Bench_Check("update check answered", Bench_RunUntil(&Bench_NewVersion, 500) < 500);
+	
+	Bench_OTAFlag = 1;
+	
+	Tick = Bench_RunUntil(&Bench_OTAEnd, 60000);
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Firmware_GetDownloadStat(&stu_Download_Stat);
+	
+	printf("OTA      : %u B in %.2f s(%.1f KB/s), %u packages served(%u answers lost, %u resent), %.2f s in the App\n",
+		   WIFISIM_OTA_IMAGE_SIZE, stu_Sim_Stat.OTATime / 100.0,
+		   stu_Sim_Stat.OTATime ? WIFISIM_OTA_IMAGE_SIZE / 1024.0 * 100 / stu_Sim_Stat.OTATime : 0,
+		   stu_Sim_Stat.OTAPackageNumber, stu_Sim_Stat.OTALossNumber, stu_Download_Stat.ResendNumber, Tick / 100.0);
+	
+	pMemory = W25Q64_Emu_GetMemory();
+	Error = 0;
+	
+	for(Addr=0; Addr<WIFISIM_OTA_IMAGE_SIZE; Addr++)
+	{
+		if(pMemory[FLASH_ADDRESS_FIRMWARE_BASE_ADDRESS + Addr] != WIFISIM_OTA_PATTERN(Addr))
+		{
+			Error++;
+		}
+	}
+	
+	Bench_Check("OTA, every package served", stu_Sim_Stat.OTATime != 0);
+	Bench_Check("OTA, image written matches", Error == 0);
+	Bench_Check("OTA, inverted image CRC16 rejected", Mid_Firmware_GetUpdateState() == FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL);
+	
+	Bench_OTAFlag = 0;
+	Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_IDLE);
+	
+#ifndef WIFISIM_BENCH_OTA_ONLY
+	Bench_Publish();
+	Bench_Soak();
+	Bench_Poll();
+#endif
+	
+	printf("%.0f s simulated in %.2f s\n", OS_GetTickCount() / 100.0, (double)(clock() - Clock) / CLOCKS_PER_SEC);
+	
+	W25Q64_Emu_Close();
+	
+	return Bench_Fail;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Map the Unique device ID register(STM32_UID_ADDR) read by Mid_WiFi_Init as the seed of the reconnect back-off
+  * @Param	None
+  * @Retval	None
+  */
+static void Bench_UIDMap(void)
+{
+	uint8_t *pPage;
+	uint8_t i;
+	
+	pPage = mmap((void *)(STM32_UID_ADDR & ~0xFFFUL), 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	
+	if(pPage == MAP_FAILED)
+	{
+		perror("mmap STM32_UID_ADDR");
+		exit(2);
+	}
+	
+	for(i=0; i<sizeof(STM32_UID); i++)
+	{
+		STM32_UID[i] = 0x30 + i * 7;
+		pPage[(STM32_UID_ADDR & 0xFFF) + i] = STM32_UID[i];
+	}
+}
+
+/**
+  * @Brief	One OS tick: the Systick, the tasks of the WiFi link(Mid_Task_Pro / MQTTProtocol_Downlink_Pro) and the App step
+  * @Param	None
+  * @Retval	None
+  *	@Note	App step: the download started on a new version and driven as App.c does it while Bench_OTAFlag,
+  *			every 10ms the W25Q64 kept the tasks busy is one more Systick
+  */
+static void Bench_Tick(void)
+{
+	stu_W25Q64_Emu_Stat_t stu_Emu_Stat;
+	
+	OS_ClockInterruptHandle();
+	
+	Mid_WiFi_Pro();
+	Mid_Outbox_Pro();
+	Mid_Clock_Pro();
+	MQTTProtocol_Downlink_Pro();
+	
+	if(Bench_OTAFlag)
+	{
+		if(Mid_Firmware_GetUpdateState() == FIRMWARE_UPDATE_STA_NEW_VERSION)
+		{
+			Mid_Firmware_StartDownload(&Mid_Flash_ImageWriteStart, &Mid_Flash_ReadData, &Mid_Flash_WriteSector, &Mid_Flash_EraseSector);
+		}
+		else if((Mid_Firmware_GetUpdateState() == FIRMWARE_UPDATE_STA_DOWNLOAD_START) && (Mid_WiFi_GetMQTTState() == MQTT_STA_READY))
+		{
+			Bench_OTAPercentage = Mid_Firmware_DownloadProgress_Pro(PROTOCOL_COMM_TYPE_WIFI, &MQTTProtocol_GetNewFirmware_DataPack);
+	
+			if(Bench_OTAPercentage == 0xFFFF)
+			{
+				Mid_Firmware_SetUpdateState(FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL);
+			}
+		}
+	}
+	
+	W25Q64_Emu_GetStat(&stu_Emu_Stat);
+	
+	while((stu_Emu_Stat.Time - Bench_FlashTime) >= 10000)
+	{
+		OS_ClockInterruptHandle();
+		Bench_FlashTime += 10000;
+	}
+}
+
+/**
+  * @Brief	Run ticks until a condition holds
+  * @Param	pDone	: condition
+  *			TickMax	: ticks at most
+  * @Retval	ticks run
+  */
+static uint32_t Bench_RunUntil(uint8_t (*pDone)(void), uint32_t TickMax)
+{
+	uint32_t Tick = 0;
+	
+	while(!pDone() && (Tick < TickMax))
+	{
+		Bench_Tick();
+		Tick++;
+	}
+	
+	return Tick;
+}
+
+/**
+  * @Brief	Conditions of Bench_RunUntil: MQTT ready / new version offered / download ended
+  * @Param	None
+  * @Retval	1->condition holds, 0->not
+  */
+static uint8_t Bench_MQTTReady(void)
+{
+	return Mid_WiFi_GetMQTTState() == MQTT_STA_READY;
+}
+
+static uint8_t Bench_NewVersion(void)
+{
+	return Mid_Firmware_GetUpdateState() == FIRMWARE_UPDATE_STA_NEW_VERSION;
+}
+
+static uint8_t Bench_OTAEnd(void)
+{
+	return (Mid_Firmware_GetUpdateState() == FIRMWARE_UPDATE_STA_DOWNLOAD_FAIL) || (Mid_Firmware_GetUpdateState() == FIRMWARE_UPDATE_STA_SUCCESS);
+}
+
+/**
+  * @Brief	Count the publish result and hand it on to MQTTProtocol_PublishResult
+  * @Param	Result: en_WiFi_MQTTPubResult_t
+  * @Retval	None
+  */
+static void Bench_PubResult(uint8_t Result)
+{
+	if(Result <= WIFI_MQTT_PUB_LOST)
+	{
+		Bench_PubResultNumber[Result]++;
+	}
+	
+	Bench_PubCBF(Result);
+}
+
+/**
+  * @Brief	Report a check
+  * @Param	pName : check
+  *			Result: 1->pass, 0->fail
+  * @Retval	None
+  */
+static void Bench_Check(const char *pName, uint8_t Result)
+{
+	printf("  %-45s: %s\n", pName, Result ? "pass" : "FAIL");
+	
+	if(!Result)
+	{
+		Bench_Fail = 1;
+	}
+}
+
+#ifndef WIFISIM_BENCH_OTA_ONLY
+/**
+  * @Brief	3. publish: WIFISIM_BENCH_PUB_RATE events offered per tick for WIFISIM_BENCH_PUB_TIME, drained
+  * @Param	None
+  * @Retval	None
+  */
+static void Bench_Publish(void)
+{
+	stu_WiFiSim_Stat_t stu_Sim_Stat;
+	stu_Outbox_Stat_t stu_Outbox_Stat;
+	stu_MQTTEventBatchStat_t stu_Batch_Stat;
+	uint32_t PubNumber;
+	uint32_t PubByteNumber;
+	uint32_t AckNumber;
+	uint32_t Offer;
+	uint32_t Tick;
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Outbox_GetStat(&stu_Outbox_Stat);
+	
+	PubNumber = stu_Sim_Stat.PubNumber;
+	PubByteNumber = stu_Sim_Stat.PubByteNumber;
+	AckNumber = stu_Outbox_Stat.AckNumber;
+	Offer = Bench_OfferNumber;
+	
+	MQTTProtocol_ClearEventBatchStat();
+	
+	for(Tick=0; Tick<WIFISIM_BENCH_PUB_TIME; Tick++)
+	{
+		Bench_Offer(WIFISIM_BENCH_PUB_RATE);
+		Bench_Tick();
+	}
+	
+	Tick += Bench_RunUntil(&Bench_OutboxEmpty, 6000);
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Outbox_GetStat(&stu_Outbox_Stat);
+	MQTTProtocol_GetEventBatchStat(&stu_Batch_Stat);
+	
+	printf("publish  : %u events in %.2f s(%.0f events/s), %u publishes(%.1f /s, %.0f B/s), latency avg %.2f s max %.2f s\n",
+		   stu_Outbox_Stat.AckNumber - AckNumber, Tick / 100.0, (stu_Outbox_Stat.AckNumber - AckNumber) * 100.0 / Tick,
+		   stu_Sim_Stat.PubNumber - PubNumber, (stu_Sim_Stat.PubNumber - PubNumber) * 100.0 / Tick,
+		   (stu_Sim_Stat.PubByteNumber - PubByteNumber) * 100.0 / Tick,
+		   stu_Batch_Stat.EventNumber ? stu_Batch_Stat.LatencySum / 100.0 / stu_Batch_Stat.EventNumber : 0,
+		   stu_Batch_Stat.LatencyMax / 100.0);
+	
+	Bench_Check("publish, every event accepted", (stu_Outbox_Stat.AckNumber - AckNumber) == (Bench_OfferNumber - Offer));
+}
+
+/**
+  * @Brief	4. soak: one event per second for WIFISIM_BENCH_SOAK_TIME under the fault script, drained
+  * @Param	None
+  * @Retval	None
+  */
+static void Bench_Soak(void)
+{
+	stu_WiFiSim_Stat_t stu_Sim_Stat;
+	stu_Outbox_Stat_t stu_Outbox_Stat;
+	stu_WiFi_ReconnectStat_t stu_AP_Stat;
+	stu_WiFi_ReconnectStat_t stu_MQTT_Stat;
+	uint32_t AckNumber;
+	uint32_t Offer;
+	uint32_t Error;
+	uint32_t Tick;
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Outbox_GetStat(&stu_Outbox_Stat);
+	
+	Error = stu_Sim_Stat.DropNumber;
+	AckNumber = stu_Outbox_Stat.AckNumber;
+	Offer = Bench_OfferNumber;
+	
+	for(Tick=0; Tick<WIFISIM_BENCH_SOAK_TIME; Tick++)
+	{
+		if((Tick % 100) == 0)
+		{
+			Bench_Offer(1);
+		}
+	
+		Bench_Tick();
+	}
+	
+	Bench_RunUntil(&Bench_OutboxEmpty, WIFISIM_BENCH_DRAIN_TIME);
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Outbox_GetStat(&stu_Outbox_Stat);
+	Mid_WiFi_GetReconnectStat(WIFI_RECONNECT_LAYER_AP, &stu_AP_Stat);
+	Mid_WiFi_GetReconnectStat(WIFI_RECONNECT_LAYER_MQTT, &stu_MQTT_Stat);
+	
+	printf("soak     : %.0f s, %u drops injected, %u ERROR / %u silent answers, AP reconnects %u(max %.2f s), MQTT reconnects %u(max %.2f s)\n",
+		   WIFISIM_BENCH_SOAK_TIME / 100.0, stu_Sim_Stat.DropNumber - Error, stu_Sim_Stat.ErrorNumber, stu_Sim_Stat.SilentNumber,
+		   stu_AP_Stat.DropNumber, stu_AP_Stat.MaxTime / 100.0, stu_MQTT_Stat.DropNumber, stu_MQTT_Stat.MaxTime / 100.0);
+	printf("           %u events offered, %u accepted, %u replayed after a drop\n",
+		   Bench_OfferNumber - Offer, stu_Outbox_Stat.AckNumber - AckNumber, stu_Outbox_Stat.RewindNumber);
+	
+	Bench_Check("soak, faults injected", (stu_Sim_Stat.DropNumber - Error) != 0);
+	Bench_Check("soak, MQTT ready again", Bench_MQTTReady());
+	Bench_Check("soak, every event accepted", (stu_Outbox_Stat.AckNumber - AckNumber) == (Bench_OfferNumber - Offer));
+	Bench_Check("no corrupted record", stu_Outbox_Stat.CorruptNumber == 0);
+}
+
+/**
+  * @Brief	5. poll: one event every WIFISIM_BENCH_POLL_PERIOD for WIFISIM_BENCH_POLL_TIME without fault, drained
+  * @Param	None
+  * @Retval	None
+  *	@Note	Every publish is accepted by the simulated broker: as many publishes reported OK, none failed / lost
+  */
+static void Bench_Poll(void)
+{
+	stu_WiFiSim_Stat_t stu_Sim_Stat;
+	stu_Outbox_Stat_t stu_Outbox_Stat;
+	uint32_t ResultNumber[WIFI_MQTT_PUB_LOST + 1];
+	uint32_t CWStateNumber;
+	uint32_t PubNumber;
+	uint32_t AckNumber;
+	uint32_t RewindNumber;
+	uint32_t Offer;
+	uint32_t Tick;
+	
+	Mid_WiFiSim_ScriptHold(1);
+	
+	Bench_RunUntil(&Bench_MQTTReady, 6000);
+	Bench_RunUntil(&Bench_OutboxEmpty, WIFISIM_BENCH_DRAIN_TIME);
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Outbox_GetStat(&stu_Outbox_Stat);
+	
+	memcpy(ResultNumber, Bench_PubResultNumber, sizeof(ResultNumber));
+	CWStateNumber = stu_Sim_Stat.CWStateNumber;
+	PubNumber = stu_Sim_Stat.PubNumber;
+	AckNumber = stu_Outbox_Stat.AckNumber;
+	RewindNumber = stu_Outbox_Stat.RewindNumber;
+	Offer = Bench_OfferNumber;
+	
+	for(Tick=0; Tick<WIFISIM_BENCH_POLL_TIME; Tick++)
+	{
+		if((Tick % WIFISIM_BENCH_POLL_PERIOD) == 0)
+		{
+			Bench_Offer(1);
+		}
+	
+		Bench_Tick();
+	}
+	
+	/* idle: AT-commands left waiting are taken as failed */
+	for(Tick=0; Tick<WIFISIM_BENCH_DRAIN_TIME; Tick++)
+	{
+		Bench_Tick();
+	}
+	
+	Bench_RunUntil(&Bench_OutboxEmpty, WIFISIM_BENCH_DRAIN_TIME);
+	
+	Mid_WiFiSim_GetStat(&stu_Sim_Stat);
+	Mid_Outbox_GetStat(&stu_Outbox_Stat);
+	
+	for(Tick=0; Tick<=WIFI_MQTT_PUB_LOST; Tick++)
+	{
+		ResultNumber[Tick] = Bench_PubResultNumber[Tick] - ResultNumber[Tick];
+	}
+	
+	printf("poll     : %u AT+CWSTATE? polls, %u publishes accepted, reported %u OK / %u FAIL / %u LOST\n",
+		   stu_Sim_Stat.CWStateNumber - CWStateNumber, stu_Sim_Stat.PubNumber - PubNumber,
+		   ResultNumber[WIFI_MQTT_PUB_OK], ResultNumber[WIFI_MQTT_PUB_FAIL], ResultNumber[WIFI_MQTT_PUB_LOST]);
+	printf("           %u events offered, %u accepted, %u replayed\n",
+		   Bench_OfferNumber - Offer, stu_Outbox_Stat.AckNumber - AckNumber, stu_Outbox_Stat.RewindNumber - RewindNumber);
+	
+	Bench_Check("poll, AP-link polled", (stu_Sim_Stat.CWStateNumber - CWStateNumber) != 0);
+	Bench_Check("poll, every publish reported OK", (ResultNumber[WIFI_MQTT_PUB_OK] == (stu_Sim_Stat.PubNumber - PubNumber)) &&
+												   (ResultNumber[WIFI_MQTT_PUB_FAIL] == 0) && (ResultNumber[WIFI_MQTT_PUB_LOST] == 0));
+	Bench_Check("poll, every event accepted", (stu_Outbox_Stat.AckNumber - AckNumber) == (Bench_OfferNumber - Offer));
+	
+	Mid_WiFiSim_ScriptHold(0);
+}
+
+/**
+  * @Brief	Condition of Bench_RunUntil: outbox empty
+  * @Param	None
+  * @Retval	1->condition holds, 0->not
+  */
+static uint8_t Bench_OutboxEmpty(void)
+{
+	return Mid_Outbox_GetPendingNumber() == 0;
+}
+
+/**
+  * @Brief	Offer NORMAL-class events(journaled in the outbox, replayed in order)
+  * @Param	Number: events to offer
+  * @Retval	None
+  */
+static void Bench_Offer(uint32_t Number)
+{
+	while(Number--)
+	{
+		MQTTProtocol_EventUpQueueIn(TERMINAL_UPEVENT_DOOR_OPEN + (Bench_OfferNumber & 1), Bench_OfferNumber % SENSOR_NUMBER_MAX, MQTT_EVENT_CLASS_NORMAL);
+	
+		Bench_OfferNumber++;
+	}
+}
+#endif
+
+
+/*-------------Stub Functions Definition-----------*/
+void App_Terminal_ModeChange(uint8_t Zone, en_Terminal_WorkMode_t WorkMode, en_Terminal_CMDSource_t CMDSource)
+{
+	pTerminalMode->WorkMode = WorkMode;
+}
+
+en_ACLinkSta_t Hal_GPIO_ACStateCheck(void)
+{
+	return (en_ACLinkSta_t)0;
+}
+
+void Hal_GPIO_WiFiPower_Enable(void)
+{
+}
+
+void Hal_GPIO_WiFiPower_Disable(void)
+{
+}
+
+void Hal_USART_DebugStringQueueIn(const char pData[])
+{
+}
+
+uint8_t Mid_PowerManage_GetACState(void)
+{
+	return 1;
+}
+
+uint8_t Mid_PowerManage_GetBatteryLow(void)
+{
+	return 0;
+}
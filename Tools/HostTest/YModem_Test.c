@@ -0,0 +1,515 @@
+/****************************************************
+  * @Name	YModem_Test.c
+  * @Brief	Host model of the serial recovery: BootLoader Middle/Mid_YModem.c against a YMODEM-1K sender
+  * @Instruction:
+  *			Line		: 10 bit per byte at APP_RECOVERY_BAUDRATE(72MHz / 16 / 4.875 -> 923077 bps) both ways,
+  *						  bytes received kept in the DMA ring(BUFFER_DEBUG_RX_SIZE, overflow fails the run)
+  *			Sender		: YMODEM-1K batch as lrzsz "sb -k" sends it(header, 1K blocks, EOT twice, empty header)
+  *			Receiver	: Mid_YModem_Pro polled, each block programmed as App_RecoveryPro does it
+  *						  (EmbeddedFlash page erase 20ms per 2 KB page, 52.5us per halfword)
+  *			Timer		: T_YMODEM on the 50us matrix tick
+  *			-------------------------------------------------------------------
+  *			Cases: image sizes, a block damaged on the line, an ACK lost, the transfer cancelled by the sender.
+  *			The image programmed is compared with the file sent, exit code 1 on any case failing
+  ***************************************************/
+
+/*-------------Header Files Include-----------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f10x.h"
+#include "hal_usart.h"
+#include "hal_timer.h"
+#include "mid_ymodem.h"
+#include "crc16.h"
+
+#define TEST_BYTE_TIME			(10.0 / 923077.0)
+#define TEST_RX_RING_SIZE		4096
+#define TEST_LINE_SIZE			(1 << 20)
+#define TEST_POLL_TIME			2e-6
+#define TEST_PAGE_SIZE			2048
+#define TEST_PAGE_ERASE_TIME	0.020
+#define TEST_HALFWORD_TIME		52.5e-6
+#define TEST_IMAGE_SIZE_MAX		206848
+
+/* Sender state */
+typedef enum
+{
+	SENDER_WAIT_C = 0,		// 'C' -> file header
+	SENDER_WAIT_HEADER_ACK,
+	SENDER_WAIT_DATA_C,		// 'C' -> first data block
+	SENDER_DATA,
+	SENDER_EOT,
+	SENDER_WAIT_END_C,		// 'C' -> empty header
+	SENDER_WAIT_END_ACK,
+	SENDER_DONE,
+	
+}en_Sender_State_t;
+
+/* Case */
+typedef struct
+{
+	const char *pName;
+	uint32_t FileSize;
+	int32_t  DamagedBlock;		// block damaged once on the line(-1: none)
+	int32_t  LostAck;			// ACK number lost on the line(-1: none)
+	int32_t  CancelBlock;		// sender cancels instead of this block(-1: none)
+	uint8_t  ResultExpected;	// YMODEM_EVT_END / YMODEM_EVT_ABORT
+	
+}stu_Test_Case_t;
+
+/*-------------Internal Functions Declaration------*/
+static uint8_t 	Test_Run(const stu_Test_Case_t *pCase);
+static void 	Test_LinePut(uint8_t Data);
+static void 	Test_SenderBlock(uint8_t Seq, const uint8_t *pData, uint16_t Len);
+static void 	Test_SenderHeader(uint8_t Empty);
+static void 	Test_SenderData(void);
+static void 	Test_SenderPro(void);
+static void 	Test_TimerPro(void);
+
+
+/*-------------Module Variables Declaration--------*/
+double Sim_Time;
+
+/* sender -> receiver: bytes and their arrival time */
+uint8_t  Line_Data[TEST_LINE_SIZE];
+double 	 Line_Time[TEST_LINE_SIZE];
+uint32_t Line_Write;
+uint32_t Line_Read;
+double 	 Line_Free;			// line busy until
+double 	 Sender_Time;		// time the sender answers at(the byte it answers in + turnaround)
+
+/* receiver -> sender */
+uint8_t  Back_Data[TEST_LINE_SIZE];
+double 	 Back_Time[TEST_LINE_SIZE];
+uint32_t Back_Write;
+uint32_t Back_Read;
+uint32_t Back_AckNumber;
+
+/* T_YMODEM */
+void 	 (*Timer_Proc[T_SUM])(void);
+double 	 Timer_Start[T_SUM];
+uint16_t Timer_Period[T_SUM];
+uint8_t  Timer_State[T_SUM];
+
+const stu_Test_Case_t *pTest_Case;
+uint8_t  *pSender_File;
+uint8_t  Sender_State;
+uint32_t Sender_Block;
+uint8_t  Sender_DamagedFlag;
+uint8_t  Test_RingOverflowFlag;
+
+uint8_t  Test_Image[TEST_IMAGE_SIZE_MAX];
+
+const stu_Test_Case_t Test_Case[] =
+{
+	{"88 KB image",				90112,					-1, -1, -1, YMODEM_EVT_END},
+	{"largest image",			TEST_IMAGE_SIZE_MAX,	-1, -1, -1, YMODEM_EVT_END},
+	{"last block padded(STX)",	60001,					-1, -1, -1, YMODEM_EVT_END},
+	{"last block padded(SOH)",	61500,					-1, -1, -1, YMODEM_EVT_END},
+	{"block 17 damaged",		90112,					17, -1, -1, YMODEM_EVT_END},
+	{"ACK of block 40 lost",	90112,					-1, 41, -1, YMODEM_EVT_END},
+	{"cancelled at block 30",	90112,					-1, -1, 30, YMODEM_EVT_ABORT},
+};
+
+
+/*-------------Module Functions Definition---------*/
+int main(void)
+{
+	uint8_t Fail = 0;
+	uint8_t i;
+	
+	for(i=0; i<sizeof(Test_Case) / sizeof(Test_Case[0]); i++)
+	{
+		Fail |= Test_Run(&Test_Case[i]);
+	}
+	
+	return Fail;
+}
+
+/* Hal_USART Debug_USART as Mid_YModem takes it */
+uint16_t Hal_USART_DebugRxLen(void)
+{
+	uint32_t Len = 0;
+	
+	while((Line_Read + Len < Line_Write) && (Line_Time[Line_Read + Len] <= Sim_Time))
+	{
+		Len++;
+	}
+	
+	if(Len > TEST_RX_RING_SIZE)
+	{
+		Test_RingOverflowFlag = 1;
+	}
+	
+	return Len;
+}
+
+void Hal_USART_DebugRxData(uint8_t *pData, uint16_t Len)
+{
+	while(Len--)
+	{
+		*pData++ = Line_Data[Line_Read++];
+	}
+}
+
+void Hal_USART_DebugRxFlush(void)
+{
+	Line_Read += Hal_USART_DebugRxLen();
+}
+
+void Hal_USART_DebugDataTx(uint8_t *pData, uint16_t Len)
+{
+	while(Len--)
+	{
+		Sim_Time += TEST_BYTE_TIME;
+	
+		/* ACK lost on the line */
+		if((*pData == YMODEM_ACK) && (++Back_AckNumber == (uint32_t)pTest_Case->LostAck))
+		{
+			pData++;
+	
+			continue;
+		}
+	
+		Back_Data[Back_Write] = *pData++;
+		Back_Time[Back_Write++] = Sim_Time;
+	}
+}
+
+/* Hal_Timer matrix: 50us tick */
+void Hal_Timer_Creat(en_Timer_ID_t ID, void (*proc)(void), unsigned short Period, en_Timer_State_t State)
+{
+	Timer_Proc[ID] = proc;
+	Timer_Period[ID] = Period;
+	Timer_State[ID] = State;
+	Timer_Start[ID] = Sim_Time;
+}
+
+en_Timer_Result_t Hal_Timer_Reset(en_Timer_ID_t ID, en_Timer_State_t State)
+{
+	Timer_State[ID] = State;
+	Timer_Start[ID] = Sim_Time;
+	
+	return T_SUCCESS;
+}
+
+
+/*-------------Internal Functions Definition--------*/
+/**
+  * @Brief	Run a case: file sent, received, programmed
+  * @Param	pCase: case
+  * @Retval	0->passed, 1->failed
+  */
+static uint8_t Test_Run(const stu_Test_Case_t *pCase)
+{
+	uint8_t  *pData;
+	uint16_t Len;
+	uint32_t Offset = 0;
+	uint32_t Page = 0xFFFFFFFF;
+	uint32_t Addr;
+	uint32_t i;
+	double 	 StartTime = 0;
+	uint8_t  Event;
+	uint8_t  Pass;
+	
+	pTest_Case = pCase;
+	Sim_Time = 0;
+	Line_Write = Line_Read = 0;
+	Line_Free = 0;
+	Sender_Time = 0;
+	Back_Write = Back_Read = 0;
+	Back_AckNumber = 0;
+	Sender_State = SENDER_WAIT_C;
+	Sender_DamagedFlag = 0;
+	Test_RingOverflowFlag = 0;
+	memset(Timer_State, 0, sizeof(Timer_State));
+	memset(Test_Image, 0xFF, sizeof(Test_Image));
+	
+	pSender_File = malloc(pCase->FileSize);
+	srand(pCase->FileSize);
+	
+	for(i=0; i<pCase->FileSize; i++)
+	{
+		pSender_File[i] = rand();
+	}
+	
+	Mid_YModem_Start();
+	
+	do
+	{
+		Test_SenderPro();
+		Test_TimerPro();
+	
+		Event = Mid_YModem_Pro(&pData, &Len);
+		Sim_Time += TEST_POLL_TIME;
+	
+		if(Event == YMODEM_EVT_FILE)
+		{
+			StartTime = Sim_Time;
+			Offset = 0;
+	
+			if(Mid_YModem_GetFileSize() != pCase->FileSize)
+			{
+				break;
+			}
+		}
+		else if(Event == YMODEM_EVT_DATA)
+		{
+			/* padding of the last block dropped, programmed a halfword at a time, each page erased once */
+			if(Len > pCase->FileSize - Offset)
+			{
+				Len = pCase->FileSize - Offset;
+			}
+	
+			memcpy(&Test_Image[Offset], pData, Len);
+	
+			for(Addr=Offset; Addr<Offset + Len; Addr+=2)
+			{
+				if(Addr / TEST_PAGE_SIZE != Page)
+				{
+					Page = Addr / TEST_PAGE_SIZE;
+					Sim_Time += TEST_PAGE_ERASE_TIME;
+				}
+	
+				Sim_Time += TEST_HALFWORD_TIME;
+			}
+	
+			Offset += Len;
+		}
+	}while((Event != YMODEM_EVT_END) && (Event != YMODEM_EVT_ABORT) && (Sim_Time < 120) && !Test_RingOverflowFlag);
+	
+	Pass = (Event == pCase->ResultExpected) && !Test_RingOverflowFlag;
+	
+	if(Pass && (Event == YMODEM_EVT_END))
+	{
+		Pass = (Offset == pCase->FileSize) && (memcmp(Test_Image, pSender_File, pCase->FileSize) == 0);
+	}
+	
+	printf("%-28s: %s, %6u byte in %.2f s%s\n", pCase->pName, Pass ? "pass" : "FAIL", Offset, Sim_Time - StartTime,
+		   Test_RingOverflowFlag ? " (Rx ring overflow)" : "");
+	
+	free(pSender_File);
+	
+	return !Pass;
+}
+
+/**
+  * @Brief	Sender puts a byte on the line(after the bytes before it)
+  */
+static void Test_LinePut(uint8_t Data)
+{
+	Line_Free = ((Line_Free > Sender_Time) ? Line_Free : Sender_Time) + TEST_BYTE_TIME;
+	
+	Line_Data[Line_Write] = Data;
+	Line_Time[Line_Write++] = Line_Free;
+}
+
+/**
+  * @Brief	Sender puts a block on the line: STX/SOH, Seq, ~Seq, data padded 0x1A(header 0x00), CRC16 high byte first
+  */
+static void Test_SenderBlock(uint8_t Seq, const uint8_t *pData, uint16_t Len)
+{
+	uint8_t  Block[YMODEM_BLOCK_HEAD + YMODEM_BLOCK_SIZE_1K + YMODEM_BLOCK_TAIL];
+	uint16_t Size;
+	uint16_t CRC16;
+	uint16_t i;
+	
+	Size = (Len > YMODEM_BLOCK_SIZE_128) ? YMODEM_BLOCK_SIZE_1K : YMODEM_BLOCK_SIZE_128;
+	
+	Block[0] = (Size == YMODEM_BLOCK_SIZE_1K) ? YMODEM_STX : YMODEM_SOH;
+	Block[1] = Seq;
+	Block[2] = ~Seq;
+	
+	memset(&Block[YMODEM_BLOCK_HEAD], (Seq == 0) ? 0x00 : 0x1A, Size);
+	memcpy(&Block[YMODEM_BLOCK_HEAD], pData, Len);
+	
+	CRC16 = Mid_CRC16_XModem(&Block[YMODEM_BLOCK_HEAD], Size);
+	
+	Block[YMODEM_BLOCK_HEAD + Size] = CRC16 >> 8;
+	Block[YMODEM_BLOCK_HEAD + Size + 1] = CRC16 & 0xFF;
+	
+	/* damaged once on the line */
+	if(((int32_t)Sender_Block == pTest_Case->DamagedBlock) && !Sender_DamagedFlag && (Seq != 0))
+	{
+		Sender_DamagedFlag = 1;
+		Block[YMODEM_BLOCK_HEAD + 7] ^= 0x10;
+	}
+	
+	for(i=0; i<Size + YMODEM_BLOCK_HEAD + YMODEM_BLOCK_TAIL; i++)
+	{
+		Test_LinePut(Block[i]);
+	}
+}
+
+/**
+  * @Brief	Sender puts the file header(name '\0' size) / the empty header ending the batch
+  */
+static void Test_SenderHeader(uint8_t Empty)
+{
+	uint8_t Header[YMODEM_BLOCK_SIZE_128];
+	uint8_t Len = 0;
+	
+	memset(Header, 0, sizeof(Header));
+	
+	if(!Empty)
+	{
+		Len = sprintf((char *)Header, "Firmware.bin") + 1;
+		Len += sprintf((char *)&Header[Len], "%u 0", pTest_Case->FileSize) + 1;
+	}
+	
+	Test_SenderBlock(0, Header, YMODEM_BLOCK_SIZE_128);
+}
+
+/**
+  * @Brief	Sender puts the data block Sender_Block(1K, the last one padded)
+  */
+static void Test_SenderData(void)
+{
+	uint32_t Offset;
+	
+	if((int32_t)Sender_Block == pTest_Case->CancelBlock)
+	{
+		Test_LinePut(YMODEM_CAN);
+		Test_LinePut(YMODEM_CAN);
+	
+		Sender_State = SENDER_DONE;
+	
+		return;
+	}
+	
+	Offset = (Sender_Block - 1) * YMODEM_BLOCK_SIZE_1K;
+	
+	/* 1K blocks, a last piece of 128 byte or less in a 128 byte block(SOH), padded */
+	Test_SenderBlock(Sender_Block & 0xFF, &pSender_File[Offset], 
+					 (pTest_Case->FileSize - Offset > YMODEM_BLOCK_SIZE_1K) ? YMODEM_BLOCK_SIZE_1K : (pTest_Case->FileSize - Offset));
+}
+
+/**
+  * @Brief	Sender answers the bytes received from the BootLoader
+  */
+static void Test_SenderPro(void)
+{
+	uint8_t Data;
+	
+	while((Back_Read < Back_Write) && (Back_Time[Back_Read] <= Sim_Time))
+	{
+		/* the sender answers once the byte is in(200us turnaround), while the BootLoader programs the block */
+		Sender_Time = Back_Time[Back_Read] + 200e-6;
+	
+		Data = Back_Data[Back_Read++];
+	
+		switch(Sender_State)
+		{
+			case SENDER_WAIT_C:
+			{
+				if(Data == YMODEM_CRC)
+				{
+					Test_SenderHeader(0);
+	
+					Sender_State = SENDER_WAIT_HEADER_ACK;
+				}
+			}
+			break;
+	
+			case SENDER_WAIT_HEADER_ACK:
+			{
+				if(Data == YMODEM_ACK)
+				{
+					Sender_State = SENDER_WAIT_DATA_C;
+				}
+				else if(Data == YMODEM_NAK)
+				{
+					Test_SenderHeader(0);
+				}
+			}
+			break;
+	
+			case SENDER_WAIT_DATA_C:
+			{
+				if(Data == YMODEM_CRC)
+				{
+					Sender_Block = 1;
+					Test_SenderData();
+	
+					Sender_State = (Sender_State == SENDER_DONE) ? SENDER_DONE : SENDER_DATA;
+				}
+			}
+			break;
+	
+			case SENDER_DATA:
+			{
+				if(Data == YMODEM_ACK)
+				{
+					if(Sender_Block * YMODEM_BLOCK_SIZE_1K >= pTest_Case->FileSize)
+					{
+						Test_LinePut(YMODEM_EOT);
+	
+						Sender_State = SENDER_EOT;
+					}
+					else
+					{
+						Sender_Block++;
+						Test_SenderData();
+					}
+				}
+				else if(Data == YMODEM_NAK)
+				{
+					Test_SenderData();
+				}
+			}
+			break;
+	
+			case SENDER_EOT:
+			{
+				if(Data == YMODEM_NAK)
+				{
+					Test_LinePut(YMODEM_EOT);
+				}
+				else if(Data == YMODEM_ACK)
+				{
+					Sender_State = SENDER_WAIT_END_C;
+				}
+			}
+			break;
+	
+			case SENDER_WAIT_END_C:
+			{
+				if(Data == YMODEM_CRC)
+				{
+					Test_SenderHeader(1);
+	
+					Sender_State = SENDER_WAIT_END_ACK;
+				}
+			}
+			break;
+	
+			case SENDER_WAIT_END_ACK:
+			{
+				if(Data == YMODEM_ACK)
+				{
+					Sender_State = SENDER_DONE;
+				}
+			}
+			break;
+	
+		}
+	}
+}
+
+/**
+  * @Brief	Timer matrix: handler called once the period has passed
+  */
+static void Test_TimerPro(void)
+{
+	uint8_t i;
+	
+	for(i=0; i<T_SUM; i++)
+	{
+		if((Timer_State[i] == T_STATE_START) && (Sim_Time - Timer_Start[i] >= Timer_Period[i] * 50e-6))
+		{
+			Timer_State[i] = T_STATE_STOP;
+			Timer_Proc[i]();
+		}
+	}
+}